@@ -1,4 +1,5 @@
 #include "ble_sync.h"
+#include "ble_sync_proto.h"
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,38 +7,30 @@
 #include <time.h>
 
 #include "cJSON.h"
+#include "esp_attr.h"
 #include "esp_err.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/ringbuf.h"
 #include "freertos/task.h"
-#include "freertos/timers.h"
 #include "nimble-nordic-uart.h"
 #include "rtc_lib.h"
+#include "alarm_sched.h"
+#include "pmu.h"
 #include "esp-bsp.h"
 #include "sensors.h"
+#include "step_store.h"
+#include "sleep_track.h"
 #include "esp_event.h"
 #include "bsp/esp32_s3_touch_amoled_2_06.h"
 #include "notifications.h"
 #include "display_manager.h"
-#include "ui.h"
+#include "display_lock_prof.h"
+#include "ui_msg.h"
 #include "audio_alert.h"
-
-typedef struct {
-    char* ts; char* app; char* title; char* msg;
-} notif_async_t;
-
-static void notif_async_cb(void* p)
-{
-    notif_async_t* c = (notif_async_t*)p;
-    ui_show_messages_tile();
-    notifications_show(c->app, c->title, c->msg, c->ts);
-    free(c->ts);
-    free(c->app);
-    free(c->title);
-    free(c->msg);
-    free(c);
-}
+#include "app_icons.h"
+#include "timer_svc.h"
+#include "mbedtls/base64.h"
 
 static const char* TAG = "BLE_SYNC";
 
@@ -46,29 +39,77 @@ ESP_EVENT_DEFINE_BASE(BLE_SYNC_EVENT_BASE);
 
 // Track BLE connection state to gate periodic status updates
 static volatile bool s_ble_connected = false;
-static TimerHandle_t s_status_timer = NULL;
-static TimerHandle_t s_time_sync_timer = NULL;
+#define STATUS_PERIOD_MS (5 * 60 * 1000)
+#define STATUS_SLACK_MS (30 * 1000)
+#define TIME_SYNC_DELAY_MS 1500
+#define TIME_SYNC_SLACK_MS 500
+static timer_svc_id_t s_status_timer = -1;
+static timer_svc_id_t s_time_sync_timer = -1;
 static bool s_time_sync_requested = false;
 static bool s_ble_enabled = false;
 static bool s_ble_stack_started = false;
 
-static void status_timer_cb(TimerHandle_t xTimer)
+// Packages we already asked the phone an icon for during this connection
+#define ICON_REQ_MEMORY 8
+static uint32_t s_icon_requested[ICON_REQ_MEMORY];
+static uint8_t s_icon_requested_next;
+
+static void send_power_status(void)
 {
-    (void)xTimer;
+    pmu_snapshot_t p;
+    (void)pmu_get(&p);
+    ble_sync_send_status(p.battery_percent, p.charging);
+}
+
+static void status_timer_cb(void* arg)
+{
+    (void)arg;
     if (s_ble_connected) {
-        ble_sync_send_status(bsp_power_get_battery_percent(), bsp_power_is_charging());
+        send_power_status();
     }
 }
 
-static void time_sync_timer_cb(TimerHandle_t xTimer)
+static void time_sync_timer_cb(void* arg)
 {
-    (void)xTimer;
+    (void)arg;
     // Send the time sync request now that the link is fully up
     const char* sync_cmd = "{\"cmd\":\"time_sync\"}\n";
     (void)nordic_uart_sendln(sync_cmd);
     ESP_LOGI(TAG, "Requested time sync on connect (delayed)");
 }
 
+// Send and free a reply. Anything that came from the phone goes in through
+// cJSON so it is escaped, never through a format string.
+static esp_err_t send_json(cJSON* root)
+{
+    if (!root) return ESP_ERR_NO_MEM;
+    char* json_str = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    if (!json_str) return ESP_ERR_NO_MEM;
+    esp_err_t err = nordic_uart_sendln(json_str);
+    free(json_str);
+    return err;
+}
+
+static void maybe_request_icon(const char* app)
+{
+    if (!s_ble_connected || !app || !*app || notifications_app_has_icon(app)) return;
+    uint32_t hash = app_icons_hash(app);
+    for (int i = 0; i < ICON_REQ_MEMORY; ++i) {
+        if (s_icon_requested[i] == hash) return;
+    }
+    s_icon_requested[s_icon_requested_next] = hash;
+    s_icon_requested_next = (s_icon_requested_next + 1) % ICON_REQ_MEMORY;
+
+    cJSON* root = cJSON_CreateObject();
+    if (root) {
+        cJSON_AddStringToObject(root, "cmd", "icon_req");
+        cJSON_AddStringToObject(root, "app", app);
+    }
+    (void)send_json(root);
+    ESP_LOGI(TAG, "Requested icon for %s", app);
+}
+
 static void handle_notification_fields(const char* timestamp,
     const char* app,
     const char* title,
@@ -77,86 +118,281 @@ static void handle_notification_fields(const char* timestamp,
     ESP_LOGI(TAG, "Notification: app='%s' title='%s' message='%s' ts='%s'",
         app ? app : "", title ? title : "", message ? message : "", timestamp ? timestamp : "");
 
-    // Wake display for visibility and ensure LVGL is running
+    // Wake the display; the notification shows on its first frame
     display_manager_turn_on();
-    // Try to acquire LVGL lock with a reasonable timeout; avoid calling
-    // LVGL APIs without the lock to prevent races when the display is turning off.
-    bool locked = false;
-    for (int i = 0; i < 3 && !locked; ++i) {
-        locked = bsp_display_lock(150);
-        if (!locked) vTaskDelay(pdMS_TO_TICKS(10));
-    }
-    if (locked) {
-        ui_show_messages_tile();
-        notifications_show(app, title, message, timestamp);
-        bsp_display_unlock();
-    } else {
-        // Fallback: defer safely to LVGL thread by copying strings
-        notif_async_t* ctx = (notif_async_t*)calloc(1, sizeof(notif_async_t));
-        if (ctx) {
-            ctx->ts = timestamp ? strdup(timestamp) : NULL;
-            ctx->app = app ? strdup(app) : NULL;
-            ctx->title = title ? strdup(title) : NULL;
-            ctx->msg = message ? strdup(message) : NULL;
-            lv_async_call(notif_async_cb, ctx);
-        }
-    }
+    (void)ui_msg_post_notification(app, title, message, timestamp);
 
     // Play notification sound if enabled
     audio_alert_notify();
+
+    maybe_request_icon(app);
 }
 
-static void process_one_json_object(const char* json, size_t len)
+static void proto_on_datetime(const struct tm* t, void* ctx)
 {
-    // cJSON requires a C-string; ensure local null-terminated copy for parsing
-    char* tmp = (char*)malloc(len + 1);
-    if (!tmp) return;
-    memcpy(tmp, json, len);
-    tmp[len] = '\0';
+    (void)ctx;
+    rtc_set_time(t);
+    ESP_LOGI(TAG, "RTC updated");
+}
 
-    cJSON* root = cJSON_Parse(tmp);
-    if (!root) {
-        free(tmp);
-        return;
+static void proto_on_notification(const char* timestamp, const char* app,
+    const char* title, const char* message, void* ctx)
+{
+    (void)ctx;
+    ESP_LOGI(TAG, "Notification");
+    handle_notification_fields(timestamp, app, title, message);
+}
+
+static void proto_on_status_request(void* ctx)
+{
+    (void)ctx;
+    ESP_LOGI(TAG, "Status");
+    send_power_status();
+}
+
+static void proto_on_icon_chunk(const char* app, size_t total, size_t offset,
+    const char* data_b64, void* ctx)
+{
+    (void)ctx;
+    // Chunks are bounded by the line length, so decode on the stack
+    uint8_t chunk[CONFIG_NORDIC_UART_MAX_LINE_LENGTH];
+    size_t len = 0;
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (mbedtls_base64_decode(chunk, sizeof(chunk), &len,
+            (const unsigned char*)data_b64, strlen(data_b64)) == 0) {
+        bool done = false;
+        err = app_icons_upload_chunk(app, total, offset, chunk, len, &done);
+        if (err == ESP_OK && !done) return; // more chunks to come
+    }
+
+    cJSON* root = cJSON_CreateObject();
+    if (root) {
+        cJSON_AddStringToObject(root, "icon_ack", app);
+        cJSON_AddBoolToObject(root, "ok", err == ESP_OK);
+    }
+    (void)send_json(root);
+}
+
+static void proto_on_trace(bool start, void* ctx)
+{
+    (void)ctx;
+    esp_err_t err = ESP_OK;
+    if (start) {
+        err = sensors_trace_start(NULL);
+    } else {
+        sensors_trace_stop();
+    }
+    char line[48];
+    snprintf(line, sizeof(line), "{\"trace\":%s,\"ok\":%s}",
+        sensors_trace_active() ? "true" : "false", err == ESP_OK ? "true" : "false");
+    (void)nordic_uart_sendln(line);
+}
+
+// Step history pull: the non-zero totals in [from, to] as
+//   {"hist":"min|hour|day","d":[[t,steps],...]}
+// lines of HISTORY_PER_LINE points, then {"hist_end":"...","n":<points>}.
+// `t` is a step_store unit index (epoch minute, local hour or local day).
+#define HISTORY_PER_LINE 12
+
+static void proto_on_history(const char* res, long long from, long long to, void* ctx)
+{
+    (void)ctx;
+    step_store_res_t r;
+    if (strcmp(res, "min") == 0) r = STEP_STORE_MINUTE;
+    else if (strcmp(res, "hour") == 0) r = STEP_STORE_HOUR;
+    else if (strcmp(res, "day") == 0) r = STEP_STORE_DAY;
+    else return;
+
+    uint32_t t = step_store_unit(r, (time_t)from);
+    uint32_t end = step_store_unit(r, (time_t)to) + 1;
+    step_store_point_t pts[HISTORY_PER_LINE];
+    unsigned total = 0;
+    char line[CONFIG_NORDIC_UART_MAX_LINE_LENGTH];
+    while (t < end) {
+        int n = step_store_query(r, t, end, pts, HISTORY_PER_LINE);
+        if (n == 0) break;
+        int len = snprintf(line, sizeof(line), "{\"hist\":\"%s\",\"d\":[", res);
+        for (int i = 0; i < n && len < (int)sizeof(line); ++i) {
+            len += snprintf(line + len, sizeof(line) - len, "%s[%lu,%lu]", i ? "," : "",
+                (unsigned long)pts[i].t, (unsigned long)pts[i].steps);
+        }
+        if (len < (int)sizeof(line)) snprintf(line + len, sizeof(line) - len, "]}");
+        if (nordic_uart_sendln(line) != ESP_OK) break;
+        total += (unsigned)n;
+        t = pts[n - 1].t + 1;
     }
+    snprintf(line, sizeof(line), "{\"hist_end\":\"%s\",\"n\":%u}", res, total);
+    (void)nordic_uart_sendln(line);
+}
 
-    // Existing handlers (datetime, notification, status)
-    cJSON* datetime = cJSON_GetObjectItem(root, "datetime");
-    if (cJSON_IsString(datetime)) {
-        int year, month, day, hour, minute, second;
-        if (sscanf(datetime->valuestring, "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second) == 6) {
-            struct tm t = {
-                .tm_year = year,
-                .tm_mon = month,
-                .tm_mday = day,
-                .tm_hour = hour,
-                .tm_min = minute,
-                .tm_sec = second };
-            rtc_set_time(&t);
-            ESP_LOGI(TAG, "RTC updated");
+static void proto_on_sleep_mode(bool start, void* ctx)
+{
+    (void)ctx;
+    esp_err_t err = ESP_OK;
+    if (start) {
+        err = sensors_sleep_start();
+    } else {
+        sensors_sleep_stop();
+    }
+    char line[48];
+    snprintf(line, sizeof(line), "{\"sleep\":%s,\"ok\":%s}",
+        sensors_sleep_active() ? "true" : "false", err == ESP_OK ? "true" : "false");
+    (void)nordic_uart_sendln(line);
+}
+
+// Sleep night export:
+//   {"sleep_night":N,"start":<epoch>,"epoch_s":60,"n":<epochs>,"onset":..,
+//    "wake":..,"sleep_min":..,"waso_min":..,"awak":..}
+// then the movement scores as {"sleep_sc":<first epoch>,"d":"<hex>"} lines
+// of SLEEP_SCORES_PER_LINE epochs, the asleep bouts as
+// {"sleep_seg":[[first epoch,epochs],...]} lines of SLEEP_SEGS_PER_LINE, and
+// {"sleep_end":N,"ok":true|false}.
+#define SLEEP_SCORES_PER_LINE 96
+#define SLEEP_SEGS_PER_LINE 16
+
+static void proto_on_sleep_night(int back, void* ctx)
+{
+    (void)ctx;
+    static sleep_track_night_t night; // ~850 B, not on the UART task stack
+    char line[CONFIG_NORDIC_UART_MAX_LINE_LENGTH];
+    bool ok = sleep_track_get(back, &night) == ESP_OK;
+    const sleep_track_summary_t* sum = &night.sum;
+    if (ok) {
+        snprintf(line, sizeof(line),
+            "{\"sleep_night\":%d,\"start\":%lu,\"epoch_s\":%d,\"n\":%u,\"onset\":%u,\"wake\":%u,"
+            "\"sleep_min\":%u,\"waso_min\":%u,\"awak\":%u}",
+            back, (unsigned long)sum->start, SLEEP_TRACK_EPOCH_S, sum->epochs, sum->onset, sum->wake,
+            sum->sleep_min, sum->waso_min, sum->awakenings);
+        ok = nordic_uart_sendln(line) == ESP_OK;
+    }
+    for (int i = 0; ok && i < sum->epochs; i += SLEEP_SCORES_PER_LINE) {
+        int len = snprintf(line, sizeof(line), "{\"sleep_sc\":%d,\"d\":\"", i);
+        for (int k = i; k < sum->epochs && k < i + SLEEP_SCORES_PER_LINE; ++k) {
+            len += snprintf(line + len, sizeof(line) - len, "%02x", night.score[k]);
+        }
+        snprintf(line + len, sizeof(line) - len, "\"}");
+        ok = nordic_uart_sendln(line) == ESP_OK;
+    }
+    int i = 0, segs = 0, len = 0;
+    while (ok && i < sum->epochs) {
+        if (!sleep_track_asleep(&night, i)) {
+            i++;
+            continue;
+        }
+        int first = i;
+        while (i < sum->epochs && sleep_track_asleep(&night, i)) i++;
+        if (segs == 0) len = snprintf(line, sizeof(line), "{\"sleep_seg\":[");
+        len += snprintf(line + len, sizeof(line) - len, "%s[%d,%d]", segs ? "," : "", first, i - first);
+        if (++segs == SLEEP_SEGS_PER_LINE) {
+            snprintf(line + len, sizeof(line) - len, "]}");
+            ok = nordic_uart_sendln(line) == ESP_OK;
+            segs = 0;
         }
     }
+    if (ok && segs > 0) {
+        snprintf(line + len, sizeof(line) - len, "]}");
+        ok = nordic_uart_sendln(line) == ESP_OK;
+    }
+    snprintf(line, sizeof(line), "{\"sleep_end\":%d,\"ok\":%s}", back, ok ? "true" : "false");
+    (void)nordic_uart_sendln(line);
+}
+
+// Wake-up alarm: {"alarm":<epoch>} replaces the pending one, 0 cancels it.
+// Replies {"alarm":<epoch>,"ok":true|false}. Survives standby (deep sleep)
+// in RTC memory, like the scheduler's events; cleared on a cold reset.
+static RTC_DATA_ATTR alarm_sched_id_t s_alarm_id = -1;
+
+static void user_alarm_cb(time_t due, void* arg)
+{
+    (void)arg;
+    struct tm t;
+    localtime_r(&due, &t);
+    char ts[24];
+    snprintf(ts, sizeof(ts), "%04d-%02d-%02dT%02d:%02d:%02d",
+        t.tm_year + 1900, t.tm_mon + 1, t.tm_mday, t.tm_hour, t.tm_min, t.tm_sec);
+    char msg[16];
+    snprintf(msg, sizeof(msg), "%02d:%02d", t.tm_hour, t.tm_min);
+    handle_notification_fields(ts, NULL, "Alarm", msg);
+}
 
-    cJSON* notification = cJSON_GetObjectItem(root, "notification");
-    if (cJSON_IsString(notification)) {
-        ESP_LOGI(TAG, "Notification");
-        cJSON* app = cJSON_GetObjectItem(root, "app");
-        cJSON* title = cJSON_GetObjectItem(root, "title");
-        cJSON* message = cJSON_GetObjectItem(root, "message");
-        const char* app_s = cJSON_IsString(app) ? app->valuestring : "";
-        const char* title_s = cJSON_IsString(title) ? title->valuestring : "";
-        const char* msg_s = cJSON_IsString(message) ? message->valuestring : "";
-        handle_notification_fields(notification->valuestring, app_s, title_s, msg_s);
+static void proto_on_alarm(long long when, void* ctx)
+{
+    (void)ctx;
+    if (s_alarm_id >= 0) {
+        (void)alarm_sched_cancel(s_alarm_id);
+        s_alarm_id = -1;
+    }
+    esp_err_t err = ESP_OK;
+    if (when > 0) {
+        err = alarm_sched_add((time_t)when, 0, user_alarm_cb, NULL, &s_alarm_id);
     }
+    char line[48];
+    snprintf(line, sizeof(line), "{\"alarm\":%lld,\"ok\":%s}", when, err == ESP_OK ? "true" : "false");
+    (void)nordic_uart_sendln(line);
+}
 
-    cJSON* status = cJSON_GetObjectItem(root, "status");
-    if (cJSON_IsString(status)) {
-        ESP_LOGI(TAG, "Status");
-        ble_sync_send_status(bsp_power_get_battery_percent(), bsp_power_is_charging());
+// Display lock profile, one line per call site:
+//   {"lock":"0x<pc>","task":"..","n":<takes>,"to":<timeouts>,"w_avg":us,
+//    "w_max":us,"h_avg":us,"h_max":us,"wh":[..],"hh":[..]}
+// with wait/hold histograms in log2 ms buckets (<1, <2, ... >=256), then
+// {"lock_end":<sites>,"on":true|false}. "reset" clears it and only sends
+// the end line.
+static void hist_json(char* line, size_t size, int* len, const char* key, const uint32_t* h)
+{
+    *len += snprintf(line + *len, size - *len, ",\"%s\":[", key);
+    for (int i = 0; i < DISPLAY_LOCK_PROF_BUCKETS && *len < (int)size; ++i) {
+        *len += snprintf(line + *len, size - *len, "%s%lu", i ? "," : "", (unsigned long)h[i]);
     }
+    if (*len < (int)size) *len += snprintf(line + *len, size - *len, "]");
+}
 
-    cJSON_Delete(root);
-    free(tmp);
+static void proto_on_lock_stats(bool reset, void* ctx)
+{
+    (void)ctx;
+    static display_lock_prof_site_t sites[DISPLAY_LOCK_PROF_MAX_SITES];
+    char line[320];
+    int n = 0;
+    if (reset) {
+        display_lock_prof_reset();
+    } else {
+        n = display_lock_prof_get(sites, DISPLAY_LOCK_PROF_MAX_SITES);
+    }
+    for (int i = 0; i < n; ++i) {
+        const display_lock_prof_site_t* s = &sites[i];
+        uint32_t takes = s->takes ? s->takes : 1;
+        int len = snprintf(line, sizeof(line),
+            "{\"lock\":\"0x%08lx\",\"task\":\"%s\",\"n\":%lu,\"to\":%lu,"
+            "\"w_avg\":%lu,\"w_max\":%lu,\"h_avg\":%lu,\"h_max\":%lu",
+            (unsigned long)s->pc, s->task, (unsigned long)s->takes, (unsigned long)s->timeouts,
+            (unsigned long)(s->wait_total_us / takes), (unsigned long)s->wait_max_us,
+            (unsigned long)(s->hold_total_us / takes), (unsigned long)s->hold_max_us);
+        if (len < (int)sizeof(line)) hist_json(line, sizeof(line), &len, "wh", s->wait_hist);
+        if (len < (int)sizeof(line)) hist_json(line, sizeof(line), &len, "hh", s->hold_hist);
+        if (len < (int)sizeof(line)) snprintf(line + len, sizeof(line) - len, "}");
+        if (nordic_uart_sendln(line) != ESP_OK) break;
+    }
+    snprintf(line, sizeof(line), "{\"lock_end\":%d,\"on\":%s}", n,
+        display_lock_prof_enabled() ? "true" : "false");
+    (void)nordic_uart_sendln(line);
+}
+
+static const ble_sync_proto_handlers_t s_proto_handlers = {
+    .on_datetime = proto_on_datetime,
+    .on_notification = proto_on_notification,
+    .on_status_request = proto_on_status_request,
+    .on_icon_chunk = proto_on_icon_chunk,
+    .on_trace = proto_on_trace,
+    .on_history = proto_on_history,
+    .on_sleep_mode = proto_on_sleep_mode,
+    .on_sleep_night = proto_on_sleep_night,
+    .on_alarm = proto_on_alarm,
+    .on_lock_stats = proto_on_lock_stats,
+    .ctx = NULL,
+};
+
+static void process_one_json_object(const char* json, size_t len)
+{
+    (void)ble_sync_proto_process(json, len, &s_proto_handlers);
 }
 
 void uartTask(void* parameter) {
@@ -168,6 +404,9 @@ void uartTask(void* parameter) {
             const char* item = (char*)xRingbufferReceive(nordic_uart_rx_buf_handle, &item_size, portMAX_DELAY);
 
             if (item) {
+                // Items carry the line plus its terminator, i.e. up to
+                // MAX_LINE_LENGTH + 1 bytes; keep room for our own '\0'.
+                if (item_size > sizeof(mbuf) - 1) item_size = sizeof(mbuf) - 1;
                 memcpy(mbuf, item, item_size);
                 mbuf[item_size] = '\0';
                 vRingbufferReturnItem(nordic_uart_rx_buf_handle, (void*)item);
@@ -194,15 +433,16 @@ static void nordic_uart_callback(enum nordic_uart_callback_type callback_type) {
         s_ble_connected = true;
         (void)esp_event_post(BLE_SYNC_EVENT_BASE, BLE_SYNC_EVT_CONNECTED, NULL, 0, 0);
         // Optionally send immediate status upon connect
-        ble_sync_send_status(bsp_power_get_battery_percent(), bsp_power_is_charging());
+        send_power_status();
 
         // Minimize time/date requests: if RTC is earlier than 2025-02-02, request sync once on connect
         {
             bool need_sync = false;
-            // Use direct RTC helpers for clarity
-            int y = rtc_get_year();
-            int m = rtc_get_month();
-            int d = rtc_get_day();
+            struct tm now = { 0 };
+            (void)rtc_get_time(&now);
+            int y = now.tm_year + 1900;
+            int m = now.tm_mon + 1;
+            int d = now.tm_mday;
             if (y <= 0 || m <= 0 || d <= 0) {
                 need_sync = true;
             } else {
@@ -214,12 +454,15 @@ static void nordic_uart_callback(enum nordic_uart_callback_type callback_type) {
             if (need_sync && !s_time_sync_requested) {
                 s_time_sync_requested = true;
                 // Fire once shortly after connect to avoid race with ATT setup
-                if (!s_time_sync_timer) {
-                    s_time_sync_timer = xTimerCreate("ble_time_sync", pdMS_TO_TICKS(1500), pdFALSE, NULL, time_sync_timer_cb);
+                if (s_time_sync_timer < 0) {
+                    const timer_svc_config_t cfg = {
+                        .name = "ble_time_sync",
+                        .slack_ms = TIME_SYNC_SLACK_MS,
+                        .cb = time_sync_timer_cb,
+                    };
+                    (void)timer_svc_add(&cfg, &s_time_sync_timer);
                 }
-                if (s_time_sync_timer) {
-                    xTimerStart(s_time_sync_timer, 0);
-                } else {
+                if (timer_svc_arm(s_time_sync_timer, TIME_SYNC_DELAY_MS) != ESP_OK) {
                     // Fallback: send immediately
                     time_sync_timer_cb(NULL);
                 }
@@ -231,9 +474,8 @@ static void nordic_uart_callback(enum nordic_uart_callback_type callback_type) {
         ESP_LOGI(TAG, "Nordic UART disconnected");
         s_ble_connected = false;
         s_time_sync_requested = false;
-        if (s_time_sync_timer) {
-            xTimerStop(s_time_sync_timer, 0);
-        }
+        memset(s_icon_requested, 0, sizeof(s_icon_requested));
+        (void)timer_svc_disarm(s_time_sync_timer);
         (void)esp_event_post(BLE_SYNC_EVENT_BASE, BLE_SYNC_EVT_DISCONNECTED, NULL, 0, 0);
         break;
     }
@@ -245,9 +487,9 @@ static void power_ble_evt(void* handler_arg, esp_event_base_t base, int32_t id,
     (void)handler_arg;
     (void)base;
     (void)id;
-    bsp_power_event_payload_t* pl = (bsp_power_event_payload_t*)event_data;
-    if (pl) {
-        ble_sync_send_status(pl->battery_percent, pl->charging);
+    const pmu_snapshot_t* p = (const pmu_snapshot_t*)event_data;
+    if (p) {
+        ble_sync_send_status(p->battery_percent, p->charging);
     }
 }
 
@@ -263,15 +505,20 @@ esp_err_t ble_sync_init(void)
     xTaskCreate(uartTask, "uartTask", 4000, NULL, 3, NULL);
 
     // Periodic status every 5 minutes when connected
-    if (!s_status_timer) {
-        s_status_timer = xTimerCreate("ble_status_5m", pdMS_TO_TICKS(5 * 60 * 1000), pdTRUE, NULL, status_timer_cb);
-        if (s_status_timer && s_ble_enabled) {
-            xTimerStart(s_status_timer, 0);
+    if (s_status_timer < 0) {
+        const timer_svc_config_t cfg = {
+            .name = "ble_status_5m",
+            .period_ms = STATUS_PERIOD_MS,
+            .slack_ms = STATUS_SLACK_MS,
+            .cb = status_timer_cb,
+        };
+        if (timer_svc_add(&cfg, &s_status_timer) == ESP_OK && !s_ble_enabled) {
+            (void)timer_svc_disarm(s_status_timer);
         }
     }
 
     // Enviar estado em cada evento de energia
-    esp_event_handler_register(BSP_POWER_EVENT_BASE, ESP_EVENT_ANY_ID, power_ble_evt, NULL);
+    esp_event_handler_register(PMU_EVENT_BASE, PMU_EVENT_CHANGED, power_ble_evt, NULL);
 
     return ESP_OK;
 }
@@ -290,19 +537,11 @@ esp_err_t ble_sync_send_status(int battery_percent, bool charging)
     cJSON_AddNumberToObject(root, "battery", battery_percent);
     cJSON_AddBoolToObject(root, "charging", charging);
     // Include VBUS presence for richer client status
-    bool vbus = (bsp_power_get_vbus_voltage_mv() > 0);
-    cJSON_AddBoolToObject(root, "vbus", vbus);
+    pmu_snapshot_t p;
+    (void)pmu_get(&p);
+    cJSON_AddBoolToObject(root, "vbus", p.vbus_in);
     cJSON_AddNumberToObject(root, "steps", sensors_get_step_count());
-
-    char* json_str = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
-    if (!json_str) {
-        return ESP_FAIL;
-    }
-
-    esp_err_t err = nordic_uart_sendln(json_str);
-    free(json_str);
-    return err;
+    return send_json(root);
 }
 
 esp_err_t ble_sync_set_enabled(bool enabled)
@@ -337,9 +576,7 @@ esp_err_t ble_sync_set_enabled(bool enabled)
             return adv_err;
         }
 
-        if (s_status_timer) {
-            xTimerStart(s_status_timer, 0);
-        }
+        (void)timer_svc_arm(s_status_timer, STATUS_PERIOD_MS);
         ESP_LOGI(TAG, "BLE enabled");
         return ESP_OK;
     }
@@ -348,12 +585,8 @@ esp_err_t ble_sync_set_enabled(bool enabled)
     s_ble_connected = false;
     s_time_sync_requested = false;
 
-    if (s_status_timer) {
-        xTimerStop(s_status_timer, 0);
-    }
-    if (s_time_sync_timer) {
-        xTimerStop(s_time_sync_timer, 0);
-    }
+    (void)timer_svc_disarm(s_status_timer);
+    (void)timer_svc_disarm(s_time_sync_timer);
 
     if (s_ble_stack_started) {
         esp_err_t adv_err = nordic_uart_set_advertising_enabled(false);
@@ -375,3 +608,8 @@ bool ble_sync_is_enabled(void)
 {
     return s_ble_enabled;
 }
+
+bool ble_sync_is_connected(void)
+{
+    return s_ble_connected;
+}
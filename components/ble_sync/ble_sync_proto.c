@@ -0,0 +1,114 @@
+#include "ble_sync_proto.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+
+bool ble_sync_proto_process(const char* json, size_t len, const ble_sync_proto_handlers_t* h)
+{
+    if (!json || !h) return false;
+
+    // cJSON requires a C-string; ensure local null-terminated copy for parsing
+    char* tmp = (char*)malloc(len + 1);
+    if (!tmp) return false;
+    memcpy(tmp, json, len);
+    tmp[len] = '\0';
+
+    cJSON* root = cJSON_Parse(tmp);
+    if (!root) {
+        free(tmp);
+        return false;
+    }
+
+    cJSON* datetime = cJSON_GetObjectItem(root, "datetime");
+    if (cJSON_IsString(datetime) && h->on_datetime) {
+        int year, month, day, hour, minute, second;
+        // Years the PCF85063A can hold; rtc_set_time() checks the day of
+        // the month
+        if (sscanf(datetime->valuestring, "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second) == 6 &&
+            year >= 2000 && year <= 2099 && month >= 1 && month <= 12 && day >= 1 && day <= 31 &&
+            hour >= 0 && hour <= 23 && minute >= 0 && minute <= 59 && second >= 0 && second <= 59) {
+            struct tm t = {
+                .tm_year = year - 1900,
+                .tm_mon = month - 1,
+                .tm_mday = day,
+                .tm_hour = hour,
+                .tm_min = minute,
+                .tm_sec = second,
+                .tm_isdst = -1 };
+            h->on_datetime(&t, h->ctx);
+        }
+    }
+
+    cJSON* notification = cJSON_GetObjectItem(root, "notification");
+    if (cJSON_IsString(notification) && h->on_notification) {
+        cJSON* app = cJSON_GetObjectItem(root, "app");
+        cJSON* title = cJSON_GetObjectItem(root, "title");
+        cJSON* message = cJSON_GetObjectItem(root, "message");
+        const char* app_s = cJSON_IsString(app) ? app->valuestring : "";
+        const char* title_s = cJSON_IsString(title) ? title->valuestring : "";
+        const char* msg_s = cJSON_IsString(message) ? message->valuestring : "";
+        h->on_notification(notification->valuestring, app_s, title_s, msg_s, h->ctx);
+    }
+
+    cJSON* status = cJSON_GetObjectItem(root, "status");
+    if (cJSON_IsString(status) && h->on_status_request) {
+        h->on_status_request(h->ctx);
+    }
+
+    cJSON* icon = cJSON_GetObjectItem(root, "icon");
+    if (cJSON_IsString(icon) && h->on_icon_chunk) {
+        cJSON* size = cJSON_GetObjectItem(root, "size");
+        cJSON* off = cJSON_GetObjectItem(root, "off");
+        cJSON* data = cJSON_GetObjectItem(root, "data");
+        if (cJSON_IsNumber(size) && cJSON_IsNumber(off) && cJSON_IsString(data) &&
+            size->valuedouble >= 0 && off->valuedouble >= 0 && off->valuedouble <= size->valuedouble) {
+            h->on_icon_chunk(icon->valuestring, (size_t)size->valuedouble, (size_t)off->valuedouble,
+                             data->valuestring, h->ctx);
+        }
+    }
+
+    cJSON* trace = cJSON_GetObjectItem(root, "trace");
+    if (cJSON_IsString(trace) && h->on_trace) {
+        if (strcmp(trace->valuestring, "start") == 0) h->on_trace(true, h->ctx);
+        else if (strcmp(trace->valuestring, "stop") == 0) h->on_trace(false, h->ctx);
+    }
+
+    cJSON* history = cJSON_GetObjectItem(root, "history");
+    if (cJSON_IsString(history) && h->on_history) {
+        cJSON* from = cJSON_GetObjectItem(root, "from");
+        cJSON* to = cJSON_GetObjectItem(root, "to");
+        long long to_v = cJSON_IsNumber(to) ? (long long)to->valuedouble : (long long)time(NULL);
+        long long from_v = cJSON_IsNumber(from) ? (long long)from->valuedouble : to_v - 86400;
+        if (from_v >= 0 && from_v <= to_v) {
+            h->on_history(history->valuestring, from_v, to_v, h->ctx);
+        }
+    }
+
+    cJSON* sleep = cJSON_GetObjectItem(root, "sleep");
+    if (cJSON_IsString(sleep) && h->on_sleep_mode) {
+        if (strcmp(sleep->valuestring, "start") == 0) h->on_sleep_mode(true, h->ctx);
+        else if (strcmp(sleep->valuestring, "stop") == 0) h->on_sleep_mode(false, h->ctx);
+    }
+
+    cJSON* night = cJSON_GetObjectItem(root, "sleep_night");
+    if (cJSON_IsNumber(night) && h->on_sleep_night && night->valuedouble >= 0 && night->valuedouble < 1000) {
+        h->on_sleep_night((int)night->valuedouble, h->ctx);
+    }
+
+    cJSON* alarm = cJSON_GetObjectItem(root, "alarm");
+    if (cJSON_IsNumber(alarm) && h->on_alarm && alarm->valuedouble >= 0 && alarm->valuedouble < 4e9) {
+        h->on_alarm((long long)alarm->valuedouble, h->ctx);
+    }
+
+    cJSON* lock = cJSON_GetObjectItem(root, "lock_stats");
+    if (cJSON_IsString(lock) && h->on_lock_stats) {
+        if (strcmp(lock->valuestring, "get") == 0) h->on_lock_stats(false, h->ctx);
+        else if (strcmp(lock->valuestring, "reset") == 0) h->on_lock_stats(true, h->ctx);
+    }
+
+    cJSON_Delete(root);
+    free(tmp);
+    return true;
+}
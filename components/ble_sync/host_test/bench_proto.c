@@ -0,0 +1,252 @@
+// Throughput / allocation benchmark for the BLE sync receive path.
+//
+// Usage: ble_sync_bench [-n iterations] [corpus files or directories...]
+// With no paths, the bundled corpus/ directory is used. A set of generated
+// worst-case payloads (oversized lines, deep nesting, escape-heavy strings)
+// is always appended.
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "proto_harness.h"
+
+#ifndef BLE_SYNC_CORPUS_DIR
+#define BLE_SYNC_CORPUS_DIR "corpus"
+#endif
+
+#define MAX_CASES 128
+
+// Allocation accounting via -Wl,--wrap (see CMakeLists.txt)
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t size);
+void __real_free(void* p);
+
+static int s_counting;
+static uint64_t s_allocs, s_alloc_bytes, s_frees;
+
+void* __wrap_malloc(size_t size)
+{
+    if (s_counting) { s_allocs++; s_alloc_bytes += size; }
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size)
+{
+    if (s_counting) { s_allocs++; s_alloc_bytes += n * size; }
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* p, size_t size)
+{
+    if (s_counting) {
+        s_allocs++;
+        s_alloc_bytes += size;
+        if (p) s_frees++;
+    }
+    return __real_realloc(p, size);
+}
+
+void __wrap_free(void* p)
+{
+    if (s_counting && p) s_frees++;
+    __real_free(p);
+}
+
+typedef struct {
+    char name[64];
+    uint8_t* data;
+    size_t len;
+} bench_case_t;
+
+static bench_case_t s_cases[MAX_CASES];
+static int s_num_cases;
+
+static void add_case(const char* name, uint8_t* data, size_t len)
+{
+    if (s_num_cases >= MAX_CASES) {
+        free(data);
+        return;
+    }
+    bench_case_t* c = &s_cases[s_num_cases++];
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    c->data = data;
+    c->len = len;
+}
+
+static void load_file(const char* path)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) return;
+    fseek(f, 0, SEEK_END);
+    long sz = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (sz <= 0) { fclose(f); return; }
+    uint8_t* buf = (uint8_t*)malloc((size_t)sz);
+    if (buf && fread(buf, 1, (size_t)sz, f) == (size_t)sz) {
+        const char* base = strrchr(path, '/');
+        add_case(base ? base + 1 : path, buf, (size_t)sz);
+    } else {
+        free(buf);
+    }
+    fclose(f);
+}
+
+static void load_path(const char* path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "skipping %s: not found\n", path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        load_file(path);
+        return;
+    }
+    DIR* d = opendir(path);
+    if (!d) return;
+    struct dirent* e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        char full[512];
+        snprintf(full, sizeof(full), "%s/%s", path, e->d_name);
+        load_file(full);
+    }
+    closedir(d);
+}
+
+static uint8_t* repeat_line(const char* prefix, char fill, size_t n, const char* suffix, size_t* out_len)
+{
+    size_t pl = strlen(prefix), sl = strlen(suffix);
+    uint8_t* b = (uint8_t*)malloc(pl + n + sl + 1);
+    if (!b) return NULL;
+    memcpy(b, prefix, pl);
+    memset(b + pl, fill, n);
+    memcpy(b + pl + n, suffix, sl);
+    b[pl + n + sl] = '\n';
+    *out_len = pl + n + sl + 1;
+    return b;
+}
+
+static void add_generated_cases(void)
+{
+    size_t len;
+    uint8_t* b;
+
+    // Single notification far beyond CONFIG_NORDIC_UART_MAX_LINE_LENGTH
+    b = repeat_line("{\"notification\":\"2025-01-01T10:00:00\",\"app\":\"sms\",\"message\":\"", 'x', 4000, "\"}", &len);
+    if (b) add_case("gen:oversized_notification", b, len);
+
+    // Deep nesting just under the line limit
+    b = (uint8_t*)malloc(CONFIG_NORDIC_UART_MAX_LINE_LENGTH + 1);
+    if (b) {
+        size_t depth = CONFIG_NORDIC_UART_MAX_LINE_LENGTH / 2;
+        for (size_t i = 0; i < depth; ++i) b[i] = '[';
+        for (size_t i = 0; i < depth; ++i) b[depth + i] = ']';
+        b[2 * depth] = '\n';
+        add_case("gen:deep_nesting", b, 2 * depth + 1);
+    }
+
+    // Escape-heavy string that exercises cJSON's unicode path
+    b = (uint8_t*)malloc(CONFIG_NORDIC_UART_MAX_LINE_LENGTH + 1);
+    if (b) {
+        size_t p = 0;
+        const char* head = "{\"notification\":\"t\",\"title\":\"";
+        memcpy(b, head, strlen(head));
+        p = strlen(head);
+        while (p + 8 < CONFIG_NORDIC_UART_MAX_LINE_LENGTH) {
+            memcpy(b + p, "\\u00e9", 6);
+            p += 6;
+        }
+        b[p++] = '"';
+        b[p++] = '}';
+        b[p++] = '\n';
+        add_case("gen:unicode_escapes", b, p);
+    }
+
+    // Burst of small valid messages with no consumer gap
+    b = (uint8_t*)malloc(64 * 1024);
+    if (b) {
+        size_t p = 0;
+        const char* m = "{\"status\":\"get\"}\n";
+        size_t ml = strlen(m);
+        while (p + ml <= 64 * 1024) {
+            memcpy(b + p, m, ml);
+            p += ml;
+        }
+        add_case("gen:status_burst", b, p);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 200;
+    int first_path = 1;
+    if (argc > 2 && strcmp(argv[1], "-n") == 0) {
+        iterations = atoi(argv[2]);
+        if (iterations < 1) iterations = 1;
+        first_path = 3;
+    }
+    if (first_path >= argc) {
+        load_path(BLE_SYNC_CORPUS_DIR);
+    }
+    for (int i = first_path; i < argc; ++i) {
+        load_path(argv[i]);
+    }
+    add_generated_cases();
+
+    printf("%-32s %8s %8s %12s %10s %10s %10s\n",
+        "case", "msgs", "valid", "msgs/s", "allocs/msg", "bytes/msg", "worst_us");
+
+    proto_harness_stats_t all = { 0 };
+    uint64_t all_allocs = 0;
+    for (int c = 0; c < s_num_cases; ++c) {
+        proto_harness_stats_t st = { 0 };
+        s_allocs = s_alloc_bytes = s_frees = 0;
+        for (int it = 0; it < iterations; ++it) {
+            if (proto_harness_init() != 0) {
+                fprintf(stderr, "harness init failed\n");
+                return 1;
+            }
+            s_counting = 1;
+            proto_harness_feed(s_cases[c].data, s_cases[c].len, &st);
+            s_counting = 0;
+            proto_harness_deinit();
+        }
+        double msgs_s = st.total_ns ? (double)st.messages * 1e9 / (double)st.total_ns : 0.0;
+        double allocs = st.messages ? (double)s_allocs / (double)st.messages : 0.0;
+        double bytes = st.messages ? (double)s_alloc_bytes / (double)st.messages : 0.0;
+        printf("%-32s %8llu %8llu %12.0f %10.2f %10.1f %10.2f\n",
+            s_cases[c].name,
+            (unsigned long long)(st.messages / (uint64_t)iterations),
+            (unsigned long long)(st.parsed / (uint64_t)iterations),
+            msgs_s, allocs, bytes, (double)st.worst_ns / 1000.0);
+        if (s_allocs != s_frees) {
+            printf("  !! %llu allocations vs %llu frees\n",
+                (unsigned long long)s_allocs, (unsigned long long)s_frees);
+        }
+        if (st.datetime_bad) {
+            printf("  !! %llu datetimes out of struct tm range\n",
+                (unsigned long long)(st.datetime_bad / (uint64_t)iterations));
+        }
+        if (st.linebuf_errors) {
+            printf("  !! %llu ring buffer overflows\n", (unsigned long long)(st.linebuf_errors / (uint64_t)iterations));
+        }
+        all.messages += st.messages;
+        all.total_ns += st.total_ns;
+        if (st.worst_ns > all.worst_ns) all.worst_ns = st.worst_ns;
+        all_allocs += s_allocs;
+    }
+
+    printf("\nTOTAL: %llu messages, %.0f msgs/s, %.2f allocs/msg, worst %.2f us\n",
+        (unsigned long long)all.messages,
+        all.total_ns ? (double)all.messages * 1e9 / (double)all.total_ns : 0.0,
+        all.messages ? (double)all_allocs / (double)all.messages : 0.0,
+        (double)all.worst_ns / 1000.0);
+
+    for (int c = 0; c < s_num_cases; ++c) free(s_cases[c].data);
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include "proto_harness.h"
+#include <string.h>
+#include <time.h>
+
+#include "ble_sync_proto.h"
+#include "nimble-nordic-uart.h"
+
+static void on_datetime(const struct tm* t, void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    // Touch the fields the device forwards to the RTC
+    volatile int sink = t->tm_year + t->tm_mon + t->tm_mday + t->tm_hour + t->tm_min + t->tm_sec;
+    (void)sink;
+    st->datetimes++;
+    // What rtc_set_time() expects: years since 1900, months 0-11
+    if (t->tm_year < 100 || t->tm_year > 199 || t->tm_mon < 0 || t->tm_mon > 11 ||
+        t->tm_mday < 1 || t->tm_mday > 31 || t->tm_hour < 0 || t->tm_hour > 23 ||
+        t->tm_min < 0 || t->tm_min > 59 || t->tm_sec < 0 || t->tm_sec > 59) {
+        st->datetime_bad++;
+    }
+}
+
+static void on_notification(const char* timestamp, const char* app,
+    const char* title, const char* message, void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    volatile size_t sink = strlen(timestamp) + strlen(app) + strlen(title) + strlen(message);
+    (void)sink;
+    st->notifications++;
+}
+
+static void on_status_request(void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    st->status_requests++;
+}
+
+static void on_icon_chunk(const char* app, size_t total, size_t offset,
+    const char* data_b64, void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    volatile size_t sink = strlen(app) + total + offset + strlen(data_b64);
+    (void)sink;
+    st->icon_chunks++;
+}
+
+static void on_trace(bool start, void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    (void)start;
+    st->trace_cmds++;
+}
+
+static void on_history(const char* res, long long from, long long to, void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    volatile long long sink = (long long)strlen(res) + from + to;
+    (void)sink;
+    st->history_reqs++;
+}
+
+static void on_sleep_mode(bool start, void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    (void)start;
+    st->sleep_cmds++;
+}
+
+static void on_sleep_night(int back, void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    volatile int sink = back;
+    (void)sink;
+    st->sleep_cmds++;
+}
+
+static void on_alarm(long long when, void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    volatile long long sink = when;
+    (void)sink;
+    st->alarm_cmds++;
+}
+
+static void on_lock_stats(bool reset, void* ctx)
+{
+    proto_harness_stats_t* st = (proto_harness_stats_t*)ctx;
+    (void)reset;
+    st->lock_stats_reqs++;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Mirrors the body of uartTask() in ble_sync.c
+static void drain(proto_harness_stats_t* st)
+{
+    static char mbuf[CONFIG_NORDIC_UART_MAX_LINE_LENGTH + 1];
+    const ble_sync_proto_handlers_t h = {
+        .on_datetime = on_datetime,
+        .on_notification = on_notification,
+        .on_status_request = on_status_request,
+        .on_icon_chunk = on_icon_chunk,
+        .on_trace = on_trace,
+        .on_history = on_history,
+        .on_sleep_mode = on_sleep_mode,
+        .on_sleep_night = on_sleep_night,
+        .on_alarm = on_alarm,
+        .on_lock_stats = on_lock_stats,
+        .ctx = st,
+    };
+
+    for (;;) {
+        size_t item_size;
+        const char* item = (const char*)xRingbufferReceive(nordic_uart_rx_buf_handle, &item_size, 0);
+        if (!item) return;
+        if (item_size > sizeof(mbuf) - 1) item_size = sizeof(mbuf) - 1;
+        memcpy(mbuf, item, item_size);
+        mbuf[item_size] = '\0';
+        vRingbufferReturnItem(nordic_uart_rx_buf_handle, (void*)item);
+
+        uint64_t t0 = now_ns();
+        bool ok = ble_sync_proto_process(mbuf, item_size, &h);
+        uint64_t dt = now_ns() - t0;
+
+        st->messages++;
+        if (ok) st->parsed++;
+        st->total_ns += dt;
+        if (dt > st->worst_ns) st->worst_ns = dt;
+    }
+}
+
+int proto_harness_init(void)
+{
+    return _nordic_uart_buf_init() == ESP_OK ? 0 : -1;
+}
+
+void proto_harness_deinit(void)
+{
+    (void)_nordic_uart_buf_deinit();
+}
+
+void proto_harness_feed(const uint8_t* data, size_t size, proto_harness_stats_t* st)
+{
+    for (size_t i = 0; i < size; ++i) {
+        if (_nordic_uart_linebuf_append((char)data[i]) != ESP_OK) {
+            st->linebuf_errors++;
+        }
+        // uartTask runs at a lower priority than the NimBLE host; draining on
+        // line boundaries approximates it keeping up between GATT writes.
+        if (data[i] == '\n' || data[i] == '\0' || data[i] == '\003') {
+            drain(st);
+        }
+    }
+    st->bytes += size;
+    drain(st);
+}
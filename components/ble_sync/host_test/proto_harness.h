@@ -0,0 +1,38 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint64_t bytes;
+    uint64_t messages;       // lines handed to the parser
+    uint64_t parsed;         // lines that were valid JSON
+    uint64_t datetimes;
+    uint64_t datetime_bad;   // dispatched with struct tm fields out of range
+    uint64_t notifications;
+    uint64_t status_requests;
+    uint64_t icon_chunks;
+    uint64_t trace_cmds;
+    uint64_t history_reqs;
+    uint64_t sleep_cmds;     // sleep mode changes and night exports
+    uint64_t alarm_cmds;
+    uint64_t lock_stats_reqs;
+    uint64_t linebuf_errors; // _nordic_uart_linebuf_append() failures (ring full)
+    uint64_t total_ns;       // time spent in the parser
+    uint64_t worst_ns;       // slowest single message
+} proto_harness_stats_t;
+
+// Set up the Nordic UART line buffer and ring buffer.
+int proto_harness_init(void);
+void proto_harness_deinit(void);
+
+// Push a raw byte stream through _nordic_uart_linebuf_append() and drain
+// every completed line through the same path as uartTask().
+void proto_harness_feed(const uint8_t* data, size_t size, proto_harness_stats_t* st);
+
+#ifdef __cplusplus
+}
+#endif
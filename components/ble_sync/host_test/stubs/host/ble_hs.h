@@ -0,0 +1,3 @@
+#pragma once
+// Only the opaque context type is referenced by nimble-nordic-uart.h.
+struct ble_gatt_access_ctxt;
@@ -16,6 +16,7 @@ esp_err_t ble_sync_init(void);
 esp_err_t ble_sync_send_status(int battery_percent, bool charging);
 esp_err_t ble_sync_set_enabled(bool enabled);
 bool ble_sync_is_enabled(void);
+bool ble_sync_is_connected(void);
 
 // BLE connection status events for UI/other components
 // Event base published by ble_sync component
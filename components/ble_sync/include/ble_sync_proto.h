@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Message layer of the BLE sync protocol: one JSON object per line, as
+// delivered by the Nordic UART line buffer. Kept free of FreeRTOS/LVGL so it
+// can be built on the host (see host_test/).
+typedef struct {
+    // {"datetime":"YYYY-MM-DDTHH:MM:SS"}, local time; `t` follows struct tm
+    // (years since 1900, months 0-11). Out-of-range fields are not
+    // dispatched.
+    void (*on_datetime)(const struct tm* t, void* ctx);
+    // {"notification":"<ts>","app":...,"title":...,"message":...}
+    void (*on_notification)(const char* timestamp, const char* app,
+                            const char* title, const char* message, void* ctx);
+    // {"status":"..."}
+    void (*on_status_request)(void* ctx);
+    // {"icon":"<package>","size":N,"off":O,"data":"<base64>"}, one chunk
+    // of an app icon blob (see gui/app_icons.h); `data` is still encoded
+    void (*on_icon_chunk)(const char* app, size_t total, size_t offset,
+                          const char* data_b64, void* ctx);
+    // {"trace":"start"|"stop"}, IMU trace recording to the SD card
+    void (*on_trace)(bool start, void* ctx);
+    // {"history":"min"|"hour"|"day","from":<epoch>,"to":<epoch>}, bulk
+    // step history pull (see sensors/step_store.h); from/to default to the
+    // last day
+    void (*on_history)(const char* res, long long from, long long to, void* ctx);
+    // {"sleep":"start"|"stop"}, sleep tracking mode (see sensors.h)
+    void (*on_sleep_mode)(bool start, void* ctx);
+    // {"sleep_night":N}, export of the stored night N nights back
+    // (0 = last; see sensors/sleep_track.h)
+    void (*on_sleep_night)(int back, void* ctx);
+    // {"alarm":<epoch>}, set the wake-up alarm (0 cancels; see
+    // bsp_extra/alarm_sched.h)
+    void (*on_alarm)(long long when, void* ctx);
+    // {"lock_stats":"get"|"reset"}, display lock profile (see
+    // display_manager/display_lock_prof.h)
+    void (*on_lock_stats)(bool reset, void* ctx);
+    void* ctx;
+} ble_sync_proto_handlers_t;
+
+// Parse one received line and dispatch every recognised field to `h`.
+// Returns false when the line is not valid JSON (nothing is dispatched).
+bool ble_sync_proto_process(const char* json, size_t len, const ble_sync_proto_handlers_t* h);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Wall-clock scheduler for alarms, reminders and other events minutes to
+// days away. Events sit in a hashed timing wheel; only the earliest one is
+// programmed into the PCF85063A alarm, whose INT line wakes the scheduler
+// task (and the SoC from light sleep, and from standby on an RTC-capable
+// pin, see CONFIG_BSP_EXTRA_RTC_INT_GPIO), so nothing polls the clock in
+// between. Events are kept in RTC memory: they survive standby but not a
+// reset, and `arg` must point to static data for the same reason. Besides
+// user alarms, rtc_lib.c schedules each local midnight (day_clock) and the
+// hourly clock resync here.
+
+#define ALARM_SCHED_MAX_EVENTS 16
+
+typedef int alarm_sched_id_t;
+
+// Runs in the scheduler task; `due` is the time the event was set for
+typedef void (*alarm_sched_cb_t)(time_t due, void *arg);
+
+esp_err_t alarm_sched_init(void);
+
+// Run `cb` at epoch second `when`, then every `period_s` seconds if
+// non-zero. A time already past fires at once. `id` may be NULL.
+esp_err_t alarm_sched_add(time_t when, uint32_t period_s, alarm_sched_cb_t cb,
+                          void *arg, alarm_sched_id_t *id);
+
+// Same, for housekeeping that can wait: runs on time while the SoC is up,
+// but does not wake it from standby (it fires after the next wake)
+esp_err_t alarm_sched_add_lazy(time_t when, uint32_t period_s, alarm_sched_cb_t cb,
+                               void *arg, alarm_sched_id_t *id);
+esp_err_t alarm_sched_cancel(alarm_sched_id_t id);
+
+// Earliest pending event that wakes the SoC, 0 if there is none
+time_t alarm_sched_next(void);
+
+// Right before standby: program the RTC alarm with that event, leaving out
+// the lazy ones
+void alarm_sched_standby_prepare(void);
+
+// The wall clock was set; reprogram the RTC alarm
+void alarm_sched_time_changed(void);
+
+#ifdef __cplusplus
+}
+#endif
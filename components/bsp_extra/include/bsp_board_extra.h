@@ -14,6 +14,10 @@ extern "C" {
 
 esp_err_t bsp_extra_init(void);
 
+// Mounts the uSD card at /sdcard unless the BSP already has; ESP_OK once
+// it is mounted
+esp_err_t bsp_extra_sdcard_mount(void);
+
 #ifdef __cplusplus
 }
 #endif
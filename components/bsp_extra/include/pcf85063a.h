@@ -7,6 +7,7 @@
 #include "esp_err.h"
 #include "esp_log.h"
 #include <time.h>
+#include <stdbool.h>
 
 #define PCF85063A_BCD_UPPER_SHIFT 4
 #define PCF85063A_BCD_LOWER_MASK 0x0f
@@ -102,7 +103,7 @@
 #define PCF85063A_HOUR_ALARM_AM_PM BIT(5)
 
 #define PCF85063A_DAY_ALARM 0x0e
-#define PCF85063A_DAY_ALARM_EN BIT_MASK(7)
+#define PCF85063A_DAY_ALARM_EN BIT(7)
 
 #define PCF85063A_WEEKDAY_ALARM 0x0f
 #define PCF85063A_WEEKDAY_ALARM_EN BIT(7)
@@ -131,4 +132,12 @@ esp_err_t pcf85063a_set_offset_value(uint8_t offset_value);
 esp_err_t pcf85063a_set_time(const struct tm *time);
 esp_err_t pcf85063a_get_time(struct tm *time);
 
+// Alarm on the second, minute, hour and day of month of `time` (weekday
+// ignored). Clears a pending flag and enables the INT output.
+esp_err_t pcf85063a_set_alarm(const struct tm *time);
+// Disables every alarm field and the INT output, clears the flag
+esp_err_t pcf85063a_disable_alarm(void);
+// Reads and clears the alarm flag, which releases INT
+esp_err_t pcf85063a_clear_alarm_flag(bool *fired);
+
 #endif /* __PCF85063A_H__ */
\ No newline at end of file
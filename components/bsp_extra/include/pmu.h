@@ -0,0 +1,64 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_event.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// AXP2101 status cache and power key. One task reads the status, ADC and
+// fuel gauge registers in three bursts and keeps the result as a snapshot;
+// consumers copy the snapshot instead of reading the chip. The cache
+// refreshes on PMU interrupts (CONFIG_BSP_EXTRA_PMU_INT_GPIO), on the BSP's
+// power events, on pmu_refresh() and otherwise every
+// CONFIG_BSP_EXTRA_PMU_POLL_S. The same task takes key presses from the
+// interrupt status into one queue; without the IRQ line it polls the status
+// every CONFIG_BSP_EXTRA_PMU_KEY_POLL_MS while the screen is on and every
+// CONFIG_BSP_EXTRA_PMU_KEY_POLL_OFF_MS while it is off.
+
+typedef struct {
+    int battery_percent;  // fuel gauge, -1 without a battery
+    int batt_mv;          // 0 without a battery
+    int vbus_mv;          // 0 without VBUS
+    int sys_mv;
+    float temp_c;         // die temperature
+    bool battery_present;
+    bool vbus_in;
+    bool charging;
+    int64_t updated_us;   // esp_timer time of the read, 0 before the first
+} pmu_snapshot_t;
+
+// Posted from the PMU task when the percentage, VBUS or charging state
+// changes; the data is the new pmu_snapshot_t
+ESP_EVENT_DECLARE_BASE(PMU_EVENT_BASE);
+enum {
+    PMU_EVENT_CHANGED,
+};
+
+typedef enum {
+    PMU_KEY_SHORT,
+    PMU_KEY_LONG,
+    PMU_KEY_DOUBLE, // a second short press soon after one already queued
+} pmu_key_t;
+
+// After bsp_power_init(); reads the chip once before returning
+esp_err_t pmu_init(void);
+
+// Copy of the latest snapshot. False (and zeros) before the first read.
+bool pmu_get(pmu_snapshot_t *out);
+
+// Ask for a read soon, e.g. while a page shows live values
+void pmu_refresh(void);
+
+// Screen state from the display manager; picks the key poll period when
+// there is no IRQ line
+void pmu_key_poll_fast(bool fast);
+
+// Next key press, in order. The queue has one consumer (the display
+// manager, which hands on what it does not use to wake the screen).
+bool pmu_key_get(pmu_key_t *key, uint32_t timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
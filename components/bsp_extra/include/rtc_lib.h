@@ -4,9 +4,19 @@
 #include <time.h>
 #include "esp_err.h"
 
+// Wall clock derived from esp_timer, checked against the PCF85063A once an
+// hour (see rtc_lib.c). rtc_get_time() returns one consistent snapshot; the
+// single-field getters each take their own, so read several fields that
+// must agree (hour and minute) through rtc_get_time().
 esp_err_t rtc_start(void);
 esp_err_t rtc_get_time(struct tm *time);
+// Local time as struct tm (years since 1900, months 0-11) within the
+// PCF85063A's 2000-2099; ESP_ERR_INVALID_ARG for any field out of range,
+// leaving the clock alone
+#define RTC_TM_YEAR_MIN 100
+#define RTC_TM_YEAR_MAX 199
 esp_err_t rtc_set_time(const struct tm *time);
+int rtc_days_in_month(int tm_year, int tm_mon);
 
 int rtc_get_hour(void);
 int rtc_get_minute(void);
@@ -18,4 +28,8 @@ const char *rtc_get_weekday_string(void);
 const char *rtc_get_weekday_short_string(void);
 const char *rtc_get_month_string(void);
 
+// Names for tm_wday, for snapshots from rtc_get_time()
+const char *rtc_weekday_string(int wday);
+const char *rtc_weekday_short_string(int wday);
+
 #endif /* __RTC_H__ */
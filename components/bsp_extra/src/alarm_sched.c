@@ -0,0 +1,403 @@
+#include "alarm_sched.h"
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "pcf85063a.h"
+
+// Events hash into one-minute slots by due time. The wheel spans a bit over
+// an hour; later events share the slots and are skipped until their lap
+// comes round. Finding the next event walks the slots from now and stops at
+// the first slot holding an event due in the minute being walked.
+#define WHEEL_SLOTS 64
+#define SLOT_S 60
+#define ALARM_SLACK_S 2 // chip seconds may run ahead of the system clock
+#define FALLBACK_MAX_MS (60 * 60 * 1000)
+#define SCHED_TASK_STACK 4096
+#define SCHED_TASK_PRIO 3
+
+#define RTC_INT_GPIO CONFIG_BSP_EXTRA_RTC_INT_GPIO
+
+static const char *TAG = "ALARM_SCHED";
+
+typedef struct {
+    time_t when;
+    uint32_t period_s;
+    alarm_sched_cb_t cb;
+    void *arg;
+    int8_t next;  // next event in the same slot, -1 ends the list
+    bool used;
+    bool lazy;    // does not wake the SoC from standby (alarm_sched_add_lazy)
+    uint8_t gen;  // bumped on reuse so stale ids do not cancel a new event
+} sched_event_t;
+
+typedef struct {
+    alarm_sched_cb_t cb;
+    void *arg;
+    time_t due;
+} sched_fire_t;
+
+// Events live in RTC memory, so they survive deep sleep (standby) along
+// with the alarm programmed into the chip; any other reset clears them
+static RTC_DATA_ATTR sched_event_t s_events[ALARM_SCHED_MAX_EVENTS];
+static RTC_DATA_ATTR int8_t s_wheel[WHEEL_SLOTS] = { [0 ... WHEEL_SLOTS - 1] = -1 };
+static SemaphoreHandle_t s_lock;
+static SemaphoreHandle_t s_wake;
+static volatile bool s_irq = true; // clear a flag left from before the reset
+static volatile bool s_resync;
+static bool s_int_ready; // INT handler installed
+// Scheduler task state
+static RTC_DATA_ATTR time_t s_scan_min;   // minute the last due scan reached
+static RTC_DATA_ATTR time_t s_programmed; // event in the RTC alarm, 0 if none
+static bool s_program_valid;  // s_programmed matches the chip
+
+static int slot_of(time_t when)
+{
+    return (int)((when / SLOT_S) % WHEEL_SLOTS);
+}
+
+static void wheel_insert(int i)
+{
+    int slot = slot_of(s_events[i].when);
+    s_events[i].next = s_wheel[slot];
+    s_wheel[slot] = (int8_t)i;
+}
+
+static void wheel_remove(int i)
+{
+    int8_t *p = &s_wheel[slot_of(s_events[i].when)];
+    while (*p >= 0) {
+        if (*p == i) {
+            *p = s_events[i].next;
+            return;
+        }
+        p = &s_events[*p].next;
+    }
+}
+
+// Earliest event at or after `now`, -1 if none; with `wake_only`, lazy
+// events are skipped. Called with s_lock held.
+static int next_event(time_t now, bool wake_only)
+{
+    time_t min0 = now / SLOT_S;
+    for (int k = 0; k < WHEEL_SLOTS; ++k) {
+        int best = -1;
+        for (int i = s_wheel[(min0 + k) % WHEEL_SLOTS]; i >= 0; i = s_events[i].next) {
+            if (s_events[i].when / SLOT_S != min0 + k || (wake_only && s_events[i].lazy)) {
+                continue;
+            }
+            if (best < 0 || s_events[i].when < s_events[best].when) {
+                best = i;
+            }
+        }
+        if (best >= 0) {
+            return best;
+        }
+    }
+    // Nothing within the wheel's span
+    int best = -1;
+    for (int i = 0; i < ALARM_SCHED_MAX_EVENTS; ++i) {
+        if (s_events[i].used && !(wake_only && s_events[i].lazy) &&
+            (best < 0 || s_events[i].when < s_events[best].when)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+// Collect events due by `now`, rescheduling repeats, and run them unlocked
+static void run_due(time_t now)
+{
+    sched_fire_t fire[ALARM_SCHED_MAX_EVENTS];
+    int n = 0;
+    time_t now_min = now / SLOT_S;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // Only the minutes since the last scan can hold new due events, unless
+    // the clock jumped by more than a lap
+    time_t from = s_scan_min;
+    if (from > now_min || now_min - from >= WHEEL_SLOTS) {
+        from = now_min - (WHEEL_SLOTS - 1);
+    }
+    for (time_t m = from; m <= now_min; ++m) {
+        int i = s_wheel[m % WHEEL_SLOTS];
+        while (i >= 0) {
+            sched_event_t *e = &s_events[i];
+            int next = e->next;
+            if (e->when <= now) {
+                fire[n++] = (sched_fire_t){ .cb = e->cb, .arg = e->arg, .due = e->when };
+                wheel_remove(i);
+                if (e->period_s) {
+                    // Skip the periods missed while the clock jumped or slept
+                    e->when += ((now - e->when) / e->period_s + 1) * e->period_s;
+                    wheel_insert(i);
+                } else {
+                    e->used = false;
+                }
+            }
+            i = next;
+        }
+    }
+    s_scan_min = now_min;
+    xSemaphoreGive(s_lock);
+
+    for (int k = 0; k < n; ++k) {
+        fire[k].cb(fire[k].due, fire[k].arg);
+    }
+}
+
+// Put the next event into the RTC alarm. Only the day of month is matched,
+// so an event more than a month out fires early; the task then finds
+// nothing due and programs it again.
+static void program_next(time_t now, bool wake_only)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = next_event(now, wake_only);
+    time_t when = i >= 0 ? s_events[i].when : 0;
+    xSemaphoreGive(s_lock);
+
+    if (s_program_valid && when == s_programmed) {
+        return;
+    }
+    esp_err_t err;
+    if (when == 0) {
+        err = pcf85063a_disable_alarm();
+    } else {
+        struct tm t;
+        localtime_r(&when, &t);
+        err = pcf85063a_set_alarm(&t);
+    }
+    s_program_valid = err == ESP_OK;
+    s_programmed = when;
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "RTC alarm update failed: %s", esp_err_to_name(err));
+    }
+}
+
+static TickType_t wait_ticks(time_t now)
+{
+    if (s_int_ready && s_program_valid) {
+        return portMAX_DELAY;
+    }
+    // No interrupt to rely on: sleep until the next event, or an hour
+    uint32_t ms = FALLBACK_MAX_MS;
+    if (s_programmed > now && (uint64_t)(s_programmed - now) * 1000 < ms) {
+        ms = (uint32_t)(s_programmed - now) * 1000;
+    }
+    return pdMS_TO_TICKS(ms) + 1;
+}
+
+static void sched_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        bool fired = false;
+        if (s_irq) {
+            s_irq = false;
+            (void)pcf85063a_clear_alarm_flag(&fired);
+            s_program_valid = false;
+            if (s_int_ready) {
+                gpio_intr_enable((gpio_num_t)RTC_INT_GPIO);
+            }
+        }
+        if (s_resync) {
+            s_resync = false;
+            s_program_valid = false;
+        }
+        time_t now = time(NULL);
+        if (fired && s_programmed > now && s_programmed - now <= ALARM_SLACK_S) {
+            now = s_programmed;
+        }
+        run_due(now);
+        program_next(now, false);
+        xSemaphoreTake(s_wake, wait_ticks(now));
+    }
+}
+
+static void IRAM_ATTR rtc_int_isr(void *arg)
+{
+    (void)arg;
+    BaseType_t hp = pdFALSE;
+    // Level-triggered once it is a wake source; masked until the task has
+    // cleared the flag
+    gpio_intr_disable((gpio_num_t)RTC_INT_GPIO);
+    s_irq = true;
+    xSemaphoreGiveFromISR(s_wake, &hp);
+    if (hp) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+static esp_err_t rtc_int_setup(gpio_num_t gpio)
+{
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << gpio,
+        .mode = GPIO_MODE_INPUT,
+        // INT is open drain, active low
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    esp_err_t ret = gpio_config(&io);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        return ret;
+    }
+    ret = gpio_isr_handler_add(gpio, rtc_int_isr, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    // The line stays low until the flag is cleared, so a level wake from
+    // light sleep cannot be missed. Deep sleep wakes are set up by standby.
+    (void)gpio_wakeup_enable(gpio, GPIO_INTR_LOW_LEVEL);
+    (void)esp_sleep_enable_gpio_wakeup();
+    return ESP_OK;
+}
+
+esp_err_t alarm_sched_init(void)
+{
+    if (s_lock) {
+        return ESP_OK;
+    }
+    s_lock = xSemaphoreCreateMutex();
+    s_wake = xSemaphoreCreateBinary();
+    if (!s_lock || !s_wake) {
+        return ESP_ERR_NO_MEM;
+    }
+    // After standby the first scan catches up with the minutes slept
+    if (s_scan_min == 0) {
+        s_scan_min = time(NULL) / SLOT_S;
+    }
+
+    if (RTC_INT_GPIO >= 0) {
+        esp_err_t ret = rtc_int_setup((gpio_num_t)RTC_INT_GPIO);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "RTC INT setup failed (%s), using timeouts", esp_err_to_name(ret));
+        }
+        s_int_ready = ret == ESP_OK;
+    }
+
+    if (xTaskCreate(sched_task, "alarm_sched", SCHED_TASK_STACK, NULL, SCHED_TASK_PRIO, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t add_event(time_t when, uint32_t period_s, bool lazy,
+                           alarm_sched_cb_t cb, void *arg, alarm_sched_id_t *id)
+{
+    if (!cb || when <= 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Past times go into the current minute, which the next scan covers
+    time_t now = time(NULL);
+    if (when < now) {
+        when = now;
+    }
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < ALARM_SCHED_MAX_EVENTS; ++i) {
+        sched_event_t *e = &s_events[i];
+        if (e->used) {
+            continue;
+        }
+        e->when = when;
+        e->period_s = period_s;
+        e->cb = cb;
+        e->arg = arg;
+        e->used = true;
+        e->lazy = lazy;
+        e->gen++;
+        wheel_insert(i);
+        if (id) {
+            *id = (alarm_sched_id_t)((e->gen << 8) | i);
+        }
+        err = ESP_OK;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (err == ESP_OK) {
+        xSemaphoreGive(s_wake);
+    }
+    return err;
+}
+
+esp_err_t alarm_sched_add(time_t when, uint32_t period_s, alarm_sched_cb_t cb,
+                          void *arg, alarm_sched_id_t *id)
+{
+    return add_event(when, period_s, false, cb, arg, id);
+}
+
+esp_err_t alarm_sched_add_lazy(time_t when, uint32_t period_s, alarm_sched_cb_t cb,
+                               void *arg, alarm_sched_id_t *id)
+{
+    return add_event(when, period_s, true, cb, arg, id);
+}
+
+esp_err_t alarm_sched_cancel(alarm_sched_id_t id)
+{
+    int i = id & 0xff;
+    if (id < 0 || i >= ALARM_SCHED_MAX_EVENTS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    sched_event_t *e = &s_events[i];
+    if (e->used && e->gen == (uint8_t)(id >> 8)) {
+        wheel_remove(i);
+        e->used = false;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (err == ESP_OK) {
+        xSemaphoreGive(s_wake);
+    }
+    return err;
+}
+
+time_t alarm_sched_next(void)
+{
+    if (!s_lock) {
+        return 0;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int i = next_event(time(NULL), true);
+    time_t when = i >= 0 ? s_events[i].when : 0;
+    xSemaphoreGive(s_lock);
+    return when;
+}
+
+void alarm_sched_standby_prepare(void)
+{
+    if (!s_lock) {
+        return;
+    }
+    s_program_valid = false;
+    program_next(time(NULL), true);
+}
+
+void alarm_sched_time_changed(void)
+{
+    if (!s_wake) {
+        return;
+    }
+    s_resync = true;
+    xSemaphoreGive(s_wake);
+}
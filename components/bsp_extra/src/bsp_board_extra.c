@@ -9,38 +9,34 @@
 #include "driver/gpio.h"
 #include "driver/ledc.h"
 #include "esp_event.h"
+#include "esp_system.h"
 #include "settings.h"
 #include "bsp/esp-bsp.h"
 #include "bsp_board_extra.h"
 #include "pcf85063a.h"
+#include "pmu.h"
+#include "i2c_bus.h"
 #include "ble_sync.h"
 #include "nvs_flash.h"
 static const char *TAG = "bsp_extra_board";
 
 static i2c_master_bus_handle_t bus_handle;
 
-static i2c_master_dev_handle_t rtc_dev_handle = NULL;
+static i2c_bus_dev_t rtc_dev = -1;
 
 esp_err_t bsp_rtc_init(void)
 {
-    i2c_device_config_t dev_config = {
-        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
-        .device_address = 0x51,
-        .scl_speed_hz = CONFIG_I2C_MASTER_FREQUENCY,
-        .scl_wait_us = 0,
-        .flags = {
-            .disable_ack_check = 0
-        }
-    };
-
-    i2c_master_bus_add_device(bus_handle, &dev_config, &rtc_dev_handle);
-
-    return ESP_OK;
+    // The RTC shares the bus with the IMU and the PMU; its transactions go
+    // through the bus manager at low priority
+    esp_err_t ret = i2c_bus_init(bus_handle);
+    if (ret == ESP_OK) {
+        ret = i2c_bus_add_device(0x51, CONFIG_I2C_MASTER_FREQUENCY, &rtc_dev);
+    }
+    return ret;
 }
 
-// read function using new API
 int rtc_register_read(uint8_t regAddr, uint8_t *data, uint8_t len) {
-    esp_err_t ret = i2c_master_transmit_receive(rtc_dev_handle, &regAddr, 1, data, len, I2C_MASTER_TIMEOUT_MS);
+    esp_err_t ret = i2c_bus_read(rtc_dev, regAddr, data, len, I2C_BUS_PRIO_LOW);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "RTC READ FAILED!");
         return -1;
@@ -48,16 +44,8 @@ int rtc_register_read(uint8_t regAddr, uint8_t *data, uint8_t len) {
     return 0;
 }
 
-// write function using new API
 int rtc_register_write(uint8_t regAddr, uint8_t *data, uint8_t len) {
-    uint8_t *buffer = (uint8_t *)malloc(len + 1);
-    if (!buffer) return -1;
-    buffer[0] = regAddr;
-    memcpy(&buffer[1], data, len);
-
-    esp_err_t ret = i2c_master_transmit(rtc_dev_handle, buffer, len + 1, I2C_MASTER_TIMEOUT_MS);
-    free(buffer);
-
+    esp_err_t ret = i2c_bus_write(rtc_dev, regAddr, data, len, I2C_BUS_PRIO_LOW);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "RTC WRITE FAILED!");
         return -1;
@@ -65,6 +53,17 @@ int rtc_register_write(uint8_t regAddr, uint8_t *data, uint8_t len) {
     return 0;
 }
 
+// The BSP keeps its card handle in a global; it is NULL while unmounted
+extern sdmmc_card_t *bsp_sdcard;
+
+esp_err_t bsp_extra_sdcard_mount(void)
+{
+    if (bsp_sdcard != NULL) {
+        return ESP_OK;
+    }
+    return bsp_sdcard_mount();
+}
+
 esp_err_t bsp_extra_init(void)
 {
     esp_err_t ret;
@@ -98,8 +97,11 @@ esp_err_t bsp_extra_init(void)
         return ret;
     }
     
+    // The chip kept running through standby; the NVS copy is older
     struct tm saved_time;
-    if (settings_load_time(&saved_time) == ESP_OK) {
+    if (esp_reset_reason() == ESP_RST_DEEPSLEEP) {
+        ESP_LOGI(TAG, "Woke from deep sleep, keeping RTC hardware time");
+    } else if (settings_load_time(&saved_time) == ESP_OK) {
         if (pcf85063a_set_time(&saved_time) == ESP_OK) {
             ESP_LOGI(TAG, "Time restored from NVS: %04d-%02d-%02d %02d:%02d:%02d",
                      saved_time.tm_year + 1900, saved_time.tm_mon + 1, saved_time.tm_mday,
@@ -118,6 +120,8 @@ esp_err_t bsp_extra_init(void)
     ret = bsp_power_init();
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Power init failed");
+    } else if (pmu_init() != ESP_OK) {
+        ESP_LOGE(TAG, "PMU status cache init failed");
     }
     
     return ESP_OK;
@@ -165,4 +165,75 @@ esp_err_t pcf85063a_set_offset_value(uint8_t offset_value)
     reg |= (offset_value & PCF85063A_OFFSET_VALUE_MASK);
 
     return rtc_register_write(PCF85063A_OFFSET, &reg, 1);
-}
\ No newline at end of file
+}
+
+// CTRL2 with AF written as 0 and AIE as given; TF is written as 0 too, the
+// countdown timer is not used
+static esp_err_t pcf85063a_write_ctrl2(bool aie)
+{
+    uint8_t reg;
+    esp_err_t ret = rtc_register_read(PCF85063A_CTRL2, &reg, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    reg &= ~(PCF85063A_CTRL2_AF | PCF85063A_CTRL2_TF | PCF85063A_CTRL2_AIE);
+    if (aie) {
+        reg |= PCF85063A_CTRL2_AIE;
+    }
+
+    return rtc_register_write(PCF85063A_CTRL2, &reg, 1);
+}
+
+esp_err_t pcf85063a_set_alarm(const struct tm *time)
+{
+    uint8_t alarm_buf[5];
+
+    // A clear enable bit turns the field on
+    alarm_buf[0] = dec_to_bcd(time->tm_sec) & PCF85063A_SECONDS_MASK;
+    alarm_buf[1] = dec_to_bcd(time->tm_min) & PCF85063A_MINUTES_MASK;
+    alarm_buf[2] = dec_to_bcd(time->tm_hour) & PCF85063A_HOURS_MASK;
+    alarm_buf[3] = dec_to_bcd(time->tm_mday) & PCF85063A_DAYS_MASK;
+    alarm_buf[4] = PCF85063A_WEEKDAY_ALARM_EN;
+
+    esp_err_t ret = rtc_register_write(PCF85063A_SECOND_ALARM, alarm_buf, 5);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    return pcf85063a_write_ctrl2(true);
+}
+
+esp_err_t pcf85063a_disable_alarm(void)
+{
+    uint8_t alarm_buf[5] = {
+        PCF85063A_SECOND_ALARM_EN, PCF85063A_MINUTE_ALARM_EN, PCF85063A_HOUR_ALARM_EN,
+        PCF85063A_DAY_ALARM_EN, PCF85063A_WEEKDAY_ALARM_EN,
+    };
+
+    esp_err_t ret = rtc_register_write(PCF85063A_SECOND_ALARM, alarm_buf, 5);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    return pcf85063a_write_ctrl2(false);
+}
+
+esp_err_t pcf85063a_clear_alarm_flag(bool *fired)
+{
+    uint8_t reg;
+    esp_err_t ret = rtc_register_read(PCF85063A_CTRL2, &reg, 1);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    if (fired) {
+        *fired = (reg & PCF85063A_CTRL2_AF) != 0;
+    }
+    if (!(reg & PCF85063A_CTRL2_AF)) {
+        return ESP_OK;
+    }
+
+    reg &= ~(PCF85063A_CTRL2_AF | PCF85063A_CTRL2_TF);
+    return rtc_register_write(PCF85063A_CTRL2, &reg, 1);
+}
@@ -0,0 +1,323 @@
+#include "pmu.h"
+#include <string.h>
+#include "sdkconfig.h"
+#include "bsp/esp-bsp.h"
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "i2c_bus.h"
+
+#define AXP2101_ADDR 0x34
+#define AXP2101_REG_STATUS1 0x00    // STATUS1, STATUS2
+#define AXP2101_REG_ADC_VBAT_H 0x34 // VBAT, TS, VBUS, VSYS, TDIE; H/L pairs
+#define AXP2101_REG_BAT_PERCENT 0xA4
+#define AXP2101_STATUS1_VBUS_GOOD (1u << 5)
+#define AXP2101_STATUS1_BAT_PRESENT (1u << 3)
+#define AXP2101_STATUS2_VBUS_OFF (1u << 3)  // set when VBUS is not the input
+#define AXP2101_STATUS2_DIR_SHIFT 5
+#define AXP2101_STATUS2_DIR_CHARGE 0x01
+#define AXP2101_REG_IRQ_EN0 0x40     // three enable bytes
+#define AXP2101_REG_IRQ_STATUS0 0x48 // three status bytes, write 1 to clear
+// IRQ bits as status0 | status1 << 8 | status2 << 16
+#define AXP2101_IRQ_PKEY_LONG (1u << 10)
+#define AXP2101_IRQ_PKEY_SHORT (1u << 11)
+#define AXP2101_IRQ_BAT_REMOVE (1u << 12)
+#define AXP2101_IRQ_BAT_INSERT (1u << 13)
+#define AXP2101_IRQ_VBUS_REMOVE (1u << 14)
+#define AXP2101_IRQ_VBUS_INSERT (1u << 15)
+#define AXP2101_IRQ_CHG_START (1u << 19)
+#define AXP2101_IRQ_CHG_DONE (1u << 20)
+#define PMU_IRQ_KEYS (AXP2101_IRQ_PKEY_SHORT | AXP2101_IRQ_PKEY_LONG)
+#define PMU_IRQ_ENABLE (PMU_IRQ_KEYS | AXP2101_IRQ_BAT_REMOVE | AXP2101_IRQ_BAT_INSERT | \
+                        AXP2101_IRQ_VBUS_REMOVE | AXP2101_IRQ_VBUS_INSERT | \
+                        AXP2101_IRQ_CHG_START | AXP2101_IRQ_CHG_DONE)
+
+#define PMU_INT_GPIO CONFIG_BSP_EXTRA_PMU_INT_GPIO
+#define PMU_KEY_DOUBLE_US 400000
+#define PMU_KEY_QUEUE_LEN 8
+#define PMU_TASK_STACK 3072
+#define PMU_TASK_PRIO 4 // key presses are user input
+
+static const char *TAG = "PMU";
+
+ESP_EVENT_DEFINE_BASE(PMU_EVENT_BASE);
+
+static i2c_bus_dev_t s_dev = -1;
+static SemaphoreHandle_t s_wake;
+static QueueHandle_t s_keys;
+static volatile bool s_refresh;
+static volatile bool s_key_fast = true; // screen on, see pmu_key_poll_fast()
+static bool s_int_ready; // INT handler installed
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static pmu_snapshot_t s_snap;
+static int64_t s_last_short_us; // for double presses
+
+static int adc_mv(const uint8_t *hl, uint8_t high_mask)
+{
+    return ((hl[0] & high_mask) << 8) | hl[1];
+}
+
+// Three bursts: status, the ADC block and the fuel gauge
+static esp_err_t pmu_read(pmu_snapshot_t *s)
+{
+    uint8_t st[2], adc[10], pct;
+    // Plain status and measurement registers, safe to share a burst
+    const i2c_bus_prio_t prio = I2C_BUS_PRIO_LOW | I2C_BUS_MERGE;
+    esp_err_t err = i2c_bus_read(s_dev, AXP2101_REG_STATUS1, st, sizeof(st), prio);
+    if (err == ESP_OK) {
+        err = i2c_bus_read(s_dev, AXP2101_REG_ADC_VBAT_H, adc, sizeof(adc), prio);
+    }
+    if (err == ESP_OK) {
+        err = i2c_bus_read(s_dev, AXP2101_REG_BAT_PERCENT, &pct, 1, prio);
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    memset(s, 0, sizeof(*s));
+    s->battery_present = st[0] & AXP2101_STATUS1_BAT_PRESENT;
+    s->vbus_in = (st[0] & AXP2101_STATUS1_VBUS_GOOD) && !(st[1] & AXP2101_STATUS2_VBUS_OFF);
+    s->charging = (st[1] >> AXP2101_STATUS2_DIR_SHIFT) == AXP2101_STATUS2_DIR_CHARGE;
+    s->battery_percent = s->battery_present ? pct : -1;
+    s->batt_mv = s->battery_present ? adc_mv(&adc[0], 0x1F) : 0;
+    s->vbus_mv = s->vbus_in ? adc_mv(&adc[4], 0x3F) : 0;
+    s->sys_mv = adc_mv(&adc[6], 0x3F);
+    s->temp_c = 22.0f + (7274 - adc_mv(&adc[8], 0x3F)) / 20.0f;
+    s->updated_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static void pmu_update(void)
+{
+    pmu_snapshot_t now;
+    esp_err_t err = pmu_read(&now);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Status read failed: %s", esp_err_to_name(err));
+        return;
+    }
+    portENTER_CRITICAL(&s_mux);
+    pmu_snapshot_t old = s_snap;
+    s_snap = now;
+    portEXIT_CRITICAL(&s_mux);
+    if (old.updated_us == 0 || old.battery_percent != now.battery_percent ||
+        old.vbus_in != now.vbus_in || old.charging != now.charging) {
+        (void)esp_event_post(PMU_EVENT_BASE, PMU_EVENT_CHANGED, &now, sizeof(now), 0);
+    }
+}
+
+// Read and clear the interrupt status; 0 if the read failed
+static uint32_t pmu_irq_take(void)
+{
+    uint8_t st[3];
+    if (i2c_bus_read(s_dev, AXP2101_REG_IRQ_STATUS0, st, sizeof(st), I2C_BUS_PRIO_HIGH) != ESP_OK) {
+        return 0;
+    }
+    uint32_t irq = st[0] | (st[1] << 8) | ((uint32_t)st[2] << 16);
+    if (irq) {
+        // Only the bits read; one raised meanwhile keeps the line low
+        (void)i2c_bus_write(s_dev, AXP2101_REG_IRQ_STATUS0, st, sizeof(st), I2C_BUS_PRIO_HIGH);
+    }
+    return irq;
+}
+
+static void key_push(pmu_key_t key)
+{
+    if (xQueueSend(s_keys, &key, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Key queue full, dropping key %d", (int)key);
+    }
+}
+
+// A short press goes out at once; one following within the window also
+// goes out as a double, so single presses are not delayed
+static void key_decode(uint32_t irq)
+{
+    if (irq & AXP2101_IRQ_PKEY_SHORT) {
+        int64_t now = esp_timer_get_time();
+        if (s_last_short_us && now - s_last_short_us < PMU_KEY_DOUBLE_US) {
+            key_push(PMU_KEY_DOUBLE);
+            s_last_short_us = 0;
+        } else {
+            key_push(PMU_KEY_SHORT);
+            s_last_short_us = now;
+        }
+    }
+    if (irq & AXP2101_IRQ_PKEY_LONG) {
+        key_push(PMU_KEY_LONG);
+    }
+}
+
+static TickType_t wait_ticks(int64_t next_update_us)
+{
+    int64_t left_us = next_update_us - esp_timer_get_time();
+    if (left_us < 0) {
+        left_us = 0;
+    }
+    if (!s_int_ready) {
+        int64_t poll_us = (s_key_fast ? CONFIG_BSP_EXTRA_PMU_KEY_POLL_MS
+                                      : CONFIG_BSP_EXTRA_PMU_KEY_POLL_OFF_MS) * 1000LL;
+        if (poll_us > 0 && left_us > poll_us) {
+            left_us = poll_us;
+        }
+    }
+    return pdMS_TO_TICKS(left_us / 1000) + 1;
+}
+
+static void pmu_task(void *arg)
+{
+    (void)arg;
+    int64_t next_update_us = esp_timer_get_time() + CONFIG_BSP_EXTRA_PMU_POLL_S * 1000000LL;
+    for (;;) {
+        (void)xSemaphoreTake(s_wake, wait_ticks(next_update_us));
+        uint32_t irq = pmu_irq_take();
+        key_decode(irq);
+        if (s_int_ready) {
+            // Fires again at once if raised while clearing
+            gpio_intr_enable((gpio_num_t)PMU_INT_GPIO);
+        }
+        int64_t now = esp_timer_get_time();
+        if (s_refresh || (irq & ~PMU_IRQ_KEYS) || now >= next_update_us) {
+            s_refresh = false;
+            pmu_update();
+            next_update_us = now + CONFIG_BSP_EXTRA_PMU_POLL_S * 1000000LL;
+        }
+    }
+}
+
+static void IRAM_ATTR pmu_int_isr(void *arg)
+{
+    (void)arg;
+    BaseType_t hp = pdFALSE;
+    // The wake setup makes the interrupt level-triggered; the task unmasks
+    // it once the status is cleared
+    gpio_intr_disable((gpio_num_t)PMU_INT_GPIO);
+    xSemaphoreGiveFromISR(s_wake, &hp);
+    if (hp) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Keys and charger changes raise the IRQ, next to what the BSP enabled
+static esp_err_t pmu_irq_enable(void)
+{
+    uint8_t en[3];
+    esp_err_t err = i2c_bus_read(s_dev, AXP2101_REG_IRQ_EN0, en, sizeof(en), I2C_BUS_PRIO_LOW);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (int i = 0; i < 3; ++i) {
+        en[i] |= (PMU_IRQ_ENABLE >> (8 * i)) & 0xFF;
+    }
+    err = i2c_bus_write(s_dev, AXP2101_REG_IRQ_EN0, en, sizeof(en), I2C_BUS_PRIO_LOW);
+    if (err == ESP_OK) {
+        (void)pmu_irq_take(); // whatever happened before boot
+    }
+    return err;
+}
+
+static esp_err_t pmu_int_setup(gpio_num_t gpio)
+{
+    gpio_config_t io = {
+        .pin_bit_mask = 1ULL << gpio,
+        .mode = GPIO_MODE_INPUT,
+        // IRQ is open drain, active low
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_NEGEDGE,
+    };
+    esp_err_t ret = gpio_config(&io);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    ret = gpio_install_isr_service(0);
+    if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+        return ret;
+    }
+    ret = gpio_isr_handler_add(gpio, pmu_int_isr, NULL);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    // The line stays low until the status is cleared, so a key press wakes
+    // the CPU from light sleep
+    (void)gpio_wakeup_enable(gpio, GPIO_INTR_LOW_LEVEL);
+    (void)esp_sleep_enable_gpio_wakeup();
+    return ESP_OK;
+}
+
+// The BSP's own power events: charger plugged, state changed
+static void bsp_power_evt(void *handler_arg, esp_event_base_t base, int32_t id, void *event_data)
+{
+    (void)handler_arg;
+    (void)base;
+    (void)id;
+    (void)event_data;
+    pmu_refresh();
+}
+
+esp_err_t pmu_init(void)
+{
+    if (s_wake) {
+        return ESP_OK;
+    }
+    esp_err_t ret = i2c_bus_add_device(AXP2101_ADDR, CONFIG_I2C_MASTER_FREQUENCY, &s_dev);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    s_wake = xSemaphoreCreateBinary();
+    s_keys = xQueueCreate(PMU_KEY_QUEUE_LEN, sizeof(pmu_key_t));
+    if (!s_wake || !s_keys) {
+        return ESP_ERR_NO_MEM;
+    }
+    ret = pmu_irq_enable();
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "IRQ enable failed: %s", esp_err_to_name(ret));
+    }
+    pmu_update();
+
+    if (PMU_INT_GPIO >= 0) {
+        ret = pmu_int_setup((gpio_num_t)PMU_INT_GPIO);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "PMU INT setup failed (%s), polling", esp_err_to_name(ret));
+        }
+        s_int_ready = ret == ESP_OK;
+    }
+    (void)esp_event_handler_register(BSP_POWER_EVENT_BASE, ESP_EVENT_ANY_ID, bsp_power_evt, NULL);
+
+    if (xTaskCreate(pmu_task, "pmu", PMU_TASK_STACK, NULL, PMU_TASK_PRIO, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool pmu_get(pmu_snapshot_t *out)
+{
+    portENTER_CRITICAL(&s_mux);
+    *out = s_snap;
+    portEXIT_CRITICAL(&s_mux);
+    return out->updated_us != 0;
+}
+
+void pmu_refresh(void)
+{
+    if (s_wake) {
+        s_refresh = true;
+        xSemaphoreGive(s_wake);
+    }
+}
+
+void pmu_key_poll_fast(bool fast)
+{
+    s_key_fast = fast;
+}
+
+bool pmu_key_get(pmu_key_t *key, uint32_t timeout_ms)
+{
+    if (!s_keys) {
+        vTaskDelay(pdMS_TO_TICKS(timeout_ms));
+        return false;
+    }
+    return xQueueReceive(s_keys, key, pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
@@ -1,18 +1,134 @@
 #include "rtc_lib.h"
 #include "pcf85063a.h"
+#include <stdbool.h>
 #include <time.h>
+#include <sys/time.h>
+#include "esp_attr.h"
+#include "esp_log.h"
 #include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "day_clock.h"
+#include "alarm_sched.h"
 
-static struct tm current_time;
-static esp_timer_handle_t rtc_timer;
+// The wall clock is the monotonic esp_timer clock plus an offset. The
+// PCF85063A is read once at boot, after each set and then once an hour to
+// correct the drift between the two crystals; the time of day is computed,
+// not polled over I2C. The hourly resync and each local midnight are
+// alarm scheduler events, so neither needs a timer or a poll.
+#define RTC_RESYNC_PERIOD_S 3600
+#define RTC_DRIFT_LIMIT_US 1000000LL // the chip only counts whole seconds
+#define RTC_MID_SECOND_US 500000     // where in a chip second we assume to be
+
+static const char *TAG = "RTC";
+
+static portMUX_TYPE s_clock_mux = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_offset_us;   // epoch microseconds minus esp_timer time
+static volatile bool s_valid; // offset loaded from the chip or set
+// Scheduler events survive standby in RTC memory, and so must their ids
+static RTC_DATA_ATTR alarm_sched_id_t s_resync_id = -1;
+static RTC_DATA_ATTR alarm_sched_id_t s_midnight_id = -1;
+
+static void rtc_midnight_arm(time_t now);
 
 static const char *weekdays[] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
 static const char *weekdaysshort[] = {"SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"};
 static const char *months[] = {"January", "February", "March", "April", "May", "June", "July", "August", "September", "October", "November", "December"};
 
-static void rtc_update_task(void *arg)
+static int64_t rtc_now_us(void)
+{
+    int64_t mono = esp_timer_get_time();
+    portENTER_CRITICAL(&s_clock_mux);
+    int64_t offset = s_offset_us;
+    portEXIT_CRITICAL(&s_clock_mux);
+    return mono + offset;
+}
+
+// Move the wall clock to `epoch_us`. The system clock (time(), localtime())
+// follows, so day boundaries and step history match what the watch face
+// shows.
+static void rtc_clock_set(int64_t epoch_us)
+{
+    int64_t offset = epoch_us - esp_timer_get_time();
+    portENTER_CRITICAL(&s_clock_mux);
+    s_offset_us = offset;
+    portEXIT_CRITICAL(&s_clock_mux);
+    s_valid = true;
+
+    struct timeval tv = {
+        .tv_sec = (time_t)(epoch_us / 1000000),
+        .tv_usec = (suseconds_t)(epoch_us % 1000000),
+    };
+    settimeofday(&tv, NULL);
+    day_clock_time_changed();
+    alarm_sched_time_changed();
+    rtc_midnight_arm(tv.tv_sec);
+}
+
+// Chip time as epoch microseconds, -1 if it cannot be read
+static int64_t rtc_chip_us(void)
+{
+    struct tm t;
+    if (pcf85063a_get_time(&t) != ESP_OK) {
+        return -1;
+    }
+    t.tm_isdst = -1;
+    time_t epoch = mktime(&t);
+    if (epoch == (time_t)-1) {
+        return -1;
+    }
+    return (int64_t)epoch * 1000000 + RTC_MID_SECOND_US;
+}
+
+static esp_err_t rtc_clock_load(void)
+{
+    int64_t chip = rtc_chip_us();
+    if (chip < 0) {
+        return ESP_FAIL;
+    }
+    rtc_clock_set(chip);
+    return ESP_OK;
+}
+
+// Hourly drift check against the chip
+static void rtc_resync_cb(time_t due, void *arg)
+{
+    (void)due;
+    (void)arg;
+    int64_t chip = rtc_chip_us();
+    if (chip < 0) {
+        return;
+    }
+    int64_t drift = rtc_now_us() - chip;
+    if (drift > RTC_DRIFT_LIMIT_US || drift < -RTC_DRIFT_LIMIT_US) {
+        ESP_LOGI(TAG, "Clock %lld ms off the RTC, corrected", (long long)(drift / 1000));
+        rtc_clock_set(chip);
+    }
+}
+
+// Local midnight: the day rolls over (day_clock) and the next one is set
+static void rtc_midnight_cb(time_t due, void *arg)
+{
+    (void)arg;
+    // The chip alarm may fire a second ahead of the system clock
+    time_t now = time(NULL);
+    if (now < due) {
+        now = due;
+    }
+    (void)day_clock_check(now);
+    rtc_midnight_arm(now);
+}
+
+// One-shot each day, since DST days are 23 or 25 hours long. Also called
+// whenever the clock is set. Before rtc_start() the scheduler is not up;
+// rtc_start() arms it then.
+static void rtc_midnight_arm(time_t now)
 {
-    pcf85063a_get_time(&current_time);
+    if (s_midnight_id >= 0 && alarm_sched_cancel(s_midnight_id) == ESP_ERR_INVALID_STATE) {
+        return;
+    }
+    s_midnight_id = -1;
+    (void)alarm_sched_add(day_clock_next_midnight(now), 0, rtc_midnight_cb, NULL,
+                          &s_midnight_id);
 }
 
 esp_err_t rtc_start(void)
@@ -21,83 +137,142 @@ esp_err_t rtc_start(void)
     if (ret != ESP_OK) {
         return ret;
     }
-
-    const esp_timer_create_args_t rtc_timer_args = {
-        .callback = &rtc_update_task,
-        .name = "rtc_timer"
-    };
-
-    ret = esp_timer_create(&rtc_timer_args, &rtc_timer);
+    if (rtc_clock_load() != ESP_OK) {
+        ESP_LOGW(TAG, "RTC read failed");
+    }
+    ret = alarm_sched_init();
     if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Alarm scheduler init failed");
         return ret;
     }
 
-    return esp_timer_start_periodic(rtc_timer, 1000000); // 1 second
+    time_t now = time(NULL);
+    rtc_midnight_arm(now);
+    // Kept from before standby; the clock was just reloaded anyway
+    if (s_resync_id >= 0) {
+        (void)alarm_sched_cancel(s_resync_id);
+    }
+    // Only worth doing while awake: a wake from standby reloads the clock
+    return alarm_sched_add_lazy(now + RTC_RESYNC_PERIOD_S, RTC_RESYNC_PERIOD_S,
+                                rtc_resync_cb, NULL, &s_resync_id);
 }
 
 esp_err_t rtc_get_time(struct tm *time)
 {
-    *time = current_time;
+    // Used before rtc_start() while settings restore the time
+    if (!s_valid) {
+        esp_err_t ret = rtc_clock_load();
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+    time_t now = (time_t)(rtc_now_us() / 1000000);
+    localtime_r(&now, time);
     return ESP_OK;
 }
 
+int rtc_days_in_month(int tm_year, int tm_mon)
+{
+    static const int mdays[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    if (tm_mon < 0 || tm_mon > 11) {
+        return 0;
+    }
+    int y = tm_year + 1900;
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return mdays[tm_mon] + (tm_mon == 1 && leap);
+}
+
+// A date the PCF85063A can hold, with every field in range: mktime() would
+// silently normalise anything else
+static bool rtc_tm_valid(const struct tm *t)
+{
+    return t->tm_year >= RTC_TM_YEAR_MIN && t->tm_year <= RTC_TM_YEAR_MAX &&
+           t->tm_mon >= 0 && t->tm_mon <= 11 &&
+           t->tm_mday >= 1 && t->tm_mday <= rtc_days_in_month(t->tm_year, t->tm_mon) &&
+           t->tm_hour >= 0 && t->tm_hour <= 23 && t->tm_min >= 0 && t->tm_min <= 59 &&
+           t->tm_sec >= 0 && t->tm_sec <= 59;
+}
+
 esp_err_t rtc_set_time(const struct tm *time)
 {
+    if (!time || !rtc_tm_valid(time)) {
+        ESP_LOGW(TAG, "Rejected out-of-range time");
+        return ESP_ERR_INVALID_ARG;
+    }
     esp_err_t ret = pcf85063a_set_time(time);
     if (ret == ESP_OK) {
-        // Update cached time immediately to avoid race condition
-        current_time = *time;
+        struct tm t = *time;
+        t.tm_isdst = -1;
+        time_t epoch = mktime(&t);
+        if (epoch != (time_t)-1) {
+            rtc_clock_set((int64_t)epoch * 1000000 + RTC_MID_SECOND_US);
+        }
     }
     return ret;
 }
 
+static struct tm rtc_now_tm(void)
+{
+    struct tm t = { 0 };
+    (void)rtc_get_time(&t);
+    return t;
+}
+
 int rtc_get_hour(void)
 {
-    return current_time.tm_hour;
+    return rtc_now_tm().tm_hour;
 }
 
 int rtc_get_minute(void)
 {
-    return current_time.tm_min;
+    return rtc_now_tm().tm_min;
 }
 
 int rtc_get_second(void)
 {
-    return current_time.tm_sec;
+    return rtc_now_tm().tm_sec;
 }
 
 int rtc_get_day(void)
 {
-    return current_time.tm_mday;
+    return rtc_now_tm().tm_mday;
 }
 
 int rtc_get_month(void)
 {
-    return current_time.tm_mon + 1;
+    return rtc_now_tm().tm_mon + 1;
 }
 
 int rtc_get_year(void)
 {
-    return current_time.tm_year + 1900;
+    return rtc_now_tm().tm_year + 1900;
 }
 
-const char *rtc_get_weekday_string(void)
+const char *rtc_weekday_string(int wday)
 {
-    int wday = current_time.tm_wday;
     if (wday < 0 || wday > 6) wday = 0; // Default to Sunday if invalid
     return weekdays[wday];
 }
 
-const char *rtc_get_weekday_short_string(void)
+const char *rtc_weekday_short_string(int wday)
 {
-    int wday = current_time.tm_wday;
     if (wday < 0 || wday > 6) wday = 0; // Default to Sunday if invalid
     return weekdaysshort[wday];
 }
 
+const char *rtc_get_weekday_string(void)
+{
+    return rtc_weekday_string(rtc_now_tm().tm_wday);
+}
+
+const char *rtc_get_weekday_short_string(void)
+{
+    return rtc_weekday_short_string(rtc_now_tm().tm_wday);
+}
+
 const char *rtc_get_month_string(void)
 {
-    int mon = current_time.tm_mon;
+    int mon = rtc_now_tm().tm_mon;
     if (mon < 0 || mon > 11) mon = 0; // Default to January if invalid
     return months[mon];
 }
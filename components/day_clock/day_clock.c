@@ -0,0 +1,90 @@
+// Local day-boundary tracking (see day_clock.h)
+
+#include "day_clock.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+
+static const char *TAG = "DAY_CLOCK";
+
+// [start, next) is the current local day; next = 0 forces a recompute
+volatile time_t g_day_clock_start = 0, g_day_clock_next = 0;
+
+static struct {
+    day_clock_cb_t cb;
+    void *arg;
+} s_cbs[DAY_CLOCK_MAX_CALLBACKS];
+static int s_ncbs;
+static int s_day = -1; // local date of the day already announced (y*400+yday)
+static volatile bool s_time_set; // the clock was set since the last check
+static portMUX_TYPE s_cb_mux = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t day_clock_register(day_clock_cb_t cb, void *arg) {
+    if (!cb)
+        return ESP_ERR_INVALID_ARG;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    portENTER_CRITICAL(&s_cb_mux);
+    if (s_ncbs < DAY_CLOCK_MAX_CALLBACKS) {
+        s_cbs[s_ncbs].cb = cb;
+        s_cbs[s_ncbs].arg = arg;
+        s_ncbs++;
+        err = ESP_OK;
+    }
+    portEXIT_CRITICAL(&s_cb_mux);
+    return err;
+}
+
+void day_clock_time_changed(void) {
+    s_time_set = true;
+    g_day_clock_next = 0;
+}
+
+time_t day_clock_today_start(void) { return g_day_clock_start; }
+
+// Local midnight of the day containing `tm`, `days` days later
+static time_t midnight(struct tm tm, int days) {
+    tm.tm_mday += days;
+    tm.tm_hour = 0;
+    tm.tm_min = 0;
+    tm.tm_sec = 0;
+    tm.tm_isdst = -1; // let mktime pick, so DST days are 23 or 25 h long
+    return mktime(&tm);
+}
+
+time_t day_clock_next_midnight(time_t now) {
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return midnight(tm, 1);
+}
+
+bool day_clock_check(time_t now) {
+    struct tm tm;
+    localtime_r(&now, &tm);
+    time_t start = midnight(tm, 0);
+    time_t next = midnight(tm, 1);
+
+    int day = (tm.tm_year + 1900) * 400 + tm.tm_yday;
+    // The midnight alarm and a poll may race; only one of them rolls over
+    portENTER_CRITICAL(&s_cb_mux);
+    g_day_clock_start = start;
+    g_day_clock_next = next;
+    // A clock set back to an earlier date starts over from that date, so the
+    // next real midnight rolls over
+    if (s_time_set) {
+        s_time_set = false;
+        if (day < s_day)
+            s_day = day;
+    }
+    bool rolled = s_day >= 0 && day > s_day;
+    if (s_day < 0 || day > s_day)
+        s_day = day;
+    portEXIT_CRITICAL(&s_cb_mux);
+
+    if (rolled) {
+        ESP_LOGI(TAG, "New day %04d-%02d-%02d", tm.tm_year + 1900, tm.tm_mon + 1,
+                          tm.tm_mday);
+        int n = s_ncbs;
+        for (int i = 0; i < n; ++i)
+            s_cbs[i].cb(start, s_cbs[i].arg);
+    }
+    return rolled;
+}
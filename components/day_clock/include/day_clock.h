@@ -0,0 +1,55 @@
+#pragma once
+#include <stdbool.h>
+#include <time.h>
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Local day boundaries without calendar math in the hot path. The start of
+// the current day and of the next one are computed once (DST-aware, via
+// mktime); day_clock_poll() only compares the time against them and runs
+// the registered rollover callbacks when the local date changes.
+//
+// On the watch the rollover is not polled: rtc_lib.c puts each local
+// midnight into the alarm scheduler (alarm_sched.h) and runs
+// day_clock_check() from that event, so callbacks run in the scheduler
+// task and should hand real work to their own task.
+//
+// Setting the clock (BLE time sync, settings screen) goes through
+// day_clock_time_changed(), which re-arms the boundaries. Callbacks fire
+// only when the date moves past the last one seen; a clock set back to an
+// earlier date fires nothing, and the date seen follows it back so the next
+// real midnight still rolls over.
+
+// Called with the local midnight that started the new day
+typedef void (*day_clock_cb_t)(time_t day_start, void *arg);
+
+#define DAY_CLOCK_MAX_CALLBACKS 8
+
+esp_err_t day_clock_register(day_clock_cb_t cb, void *arg);
+
+// Slow path of day_clock_poll(); returns true if the day rolled over
+bool day_clock_check(time_t now);
+
+// The wall clock was set; boundaries are recomputed on the next poll
+void day_clock_time_changed(void);
+
+// Start of the current local day (as of the last poll)
+time_t day_clock_today_start(void);
+
+// Local midnight that ends the day containing `now` (DST-aware)
+time_t day_clock_next_midnight(time_t now);
+
+// Cheap enough for every loop iteration: two integer compares. Callbacks
+// run in the calling task.
+static inline bool day_clock_poll(time_t now) {
+    extern volatile time_t g_day_clock_start, g_day_clock_next;
+    if (now >= g_day_clock_start && now < g_day_clock_next)
+        return false;
+    return day_clock_check(now);
+}
+
+#ifdef __cplusplus
+}
+#endif
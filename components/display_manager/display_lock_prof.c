@@ -0,0 +1,206 @@
+#include "display_lock_prof.h"
+#include "sdkconfig.h"
+
+#if CONFIG_DISPLAY_LOCK_PROFILE
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "timer_svc.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "LOCK_PROF";
+
+// The BSP's, reached through -Wl,--wrap (see CMakeLists.txt)
+bool __real_bsp_display_lock(uint32_t timeout_ms);
+void __real_bsp_display_unlock(void);
+
+static display_lock_prof_site_t s_sites[DISPLAY_LOCK_PROF_MAX_SITES];
+static uint32_t s_lost; // calls from sites beyond the table
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t s_log_lock; // the log's sorted copy
+
+// Only touched by the task holding the lock
+static uint32_t s_depth;
+static uintptr_t s_hold_pc;
+static int64_t s_hold_start;
+
+// Windowed-ABI return address: the top two bits carry the call size, and
+// the call instruction is 3 bytes before it
+static uintptr_t call_site(void *ra) {
+#if CONFIG_IDF_TARGET_ARCH_XTENSA
+  return ((((uintptr_t)ra) & 0x3fffffffu) | 0x40000000u) - 3;
+#else
+  return (uintptr_t)ra - 4;
+#endif
+}
+
+static int bucket(uint32_t us) {
+  int b = 0;
+  for (uint32_t ms = us / 1000; ms && b < DISPLAY_LOCK_PROF_BUCKETS - 1; ms >>= 1)
+    b++;
+  return b;
+}
+
+// Called inside s_mux
+static display_lock_prof_site_t *site_get(uintptr_t pc) {
+  for (int i = 0; i < DISPLAY_LOCK_PROF_MAX_SITES; ++i) {
+    display_lock_prof_site_t *s = &s_sites[i];
+    if (s->pc == pc)
+      return s;
+    if (s->pc == 0) {
+      s->pc = pc;
+      strncpy(s->task, pcTaskGetName(NULL), sizeof(s->task) - 1);
+      return s;
+    }
+  }
+  s_lost++;
+  return NULL;
+}
+
+bool __wrap_bsp_display_lock(uint32_t timeout_ms) {
+  uintptr_t pc = call_site(__builtin_return_address(0));
+  int64_t t0 = esp_timer_get_time();
+  bool ok = __real_bsp_display_lock(timeout_ms);
+  int64_t t1 = esp_timer_get_time();
+  uint32_t wait = (uint32_t)(t1 - t0);
+
+  portENTER_CRITICAL(&s_mux);
+  display_lock_prof_site_t *s = site_get(pc);
+  if (s) {
+    if (ok) {
+      s->takes++;
+      s->wait_total_us += wait;
+      s->wait_hist[bucket(wait)]++;
+      if (wait > s->wait_max_us)
+        s->wait_max_us = wait;
+    } else {
+      s->timeouts++;
+    }
+  }
+  portEXIT_CRITICAL(&s_mux);
+
+  // The lock is recursive; the outermost take owns the hold time
+  if (ok && s_depth++ == 0) {
+    s_hold_pc = pc;
+    s_hold_start = t1;
+  }
+  return ok;
+}
+
+void __wrap_bsp_display_unlock(void) {
+  if (s_depth > 0 && --s_depth == 0) {
+    uint32_t hold = (uint32_t)(esp_timer_get_time() - s_hold_start);
+    portENTER_CRITICAL(&s_mux);
+    display_lock_prof_site_t *s = site_get(s_hold_pc);
+    if (s) {
+      s->hold_total_us += hold;
+      s->hold_hist[bucket(hold)]++;
+      if (hold > s->hold_max_us)
+        s->hold_max_us = hold;
+    }
+    portEXIT_CRITICAL(&s_mux);
+  }
+  __real_bsp_display_unlock();
+}
+
+bool display_lock_prof_enabled(void) { return true; }
+
+static int by_wait_max(const void *a, const void *b) {
+  const display_lock_prof_site_t *x = a, *y = b;
+  return (y->wait_max_us > x->wait_max_us) - (y->wait_max_us < x->wait_max_us);
+}
+
+int display_lock_prof_get(display_lock_prof_site_t *out, int max) {
+  int n = 0;
+  portENTER_CRITICAL(&s_mux);
+  for (; n < max && n < DISPLAY_LOCK_PROF_MAX_SITES && s_sites[n].pc; ++n)
+    out[n] = s_sites[n];
+  portEXIT_CRITICAL(&s_mux);
+  return n;
+}
+
+void display_lock_prof_reset(void) {
+  portENTER_CRITICAL(&s_mux);
+  memset(s_sites, 0, sizeof(s_sites));
+  s_lost = 0;
+  portEXIT_CRITICAL(&s_mux);
+}
+
+static void hist_str(char *buf, size_t size, const uint32_t *h) {
+  size_t len = 0;
+  for (int i = 0; i < DISPLAY_LOCK_PROF_BUCKETS && len < size; ++i)
+    len += snprintf(buf + len, size - len, "%s%lu", i ? "/" : "", (unsigned long)h[i]);
+}
+
+void display_lock_prof_log(void) {
+  if (!s_log_lock)
+    return;
+  static display_lock_prof_site_t sites[DISPLAY_LOCK_PROF_MAX_SITES];
+  xSemaphoreTake(s_log_lock, portMAX_DELAY);
+  int n = display_lock_prof_get(sites, DISPLAY_LOCK_PROF_MAX_SITES);
+  qsort(sites, n, sizeof(sites[0]), by_wait_max);
+  ESP_LOGI(TAG, "%d sites, %lu calls not tracked; histograms <1/<2/.../>=256 ms",
+           n, (unsigned long)s_lost);
+  for (int i = 0; i < n; ++i) {
+    const display_lock_prof_site_t *s = &sites[i];
+    char wh[64], hh[64];
+    hist_str(wh, sizeof(wh), s->wait_hist);
+    hist_str(hh, sizeof(hh), s->hold_hist);
+    uint32_t takes = s->takes ? s->takes : 1;
+    ESP_LOGI(TAG,
+             "0x%08lx %-10s n=%lu to=%lu wait avg %lu max %lu us [%s] "
+             "hold avg %lu max %lu us [%s]",
+             (unsigned long)s->pc, s->task, (unsigned long)s->takes,
+             (unsigned long)s->timeouts,
+             (unsigned long)(s->wait_total_us / takes),
+             (unsigned long)s->wait_max_us, wh,
+             (unsigned long)(s->hold_total_us / takes),
+             (unsigned long)s->hold_max_us, hh);
+  }
+  xSemaphoreGive(s_log_lock);
+}
+
+static void log_cb(void *arg) {
+  (void)arg;
+  display_lock_prof_log();
+}
+
+void display_lock_prof_init(void) {
+  static StaticSemaphore_t log_lock_buf;
+  if (s_log_lock)
+    return;
+  s_log_lock = xSemaphoreCreateMutexStatic(&log_lock_buf);
+#if CONFIG_DISPLAY_LOCK_PROFILE_LOG_S > 0
+  const timer_svc_config_t cfg = {
+      .name = "lock_prof",
+      .period_ms = CONFIG_DISPLAY_LOCK_PROFILE_LOG_S * 1000u,
+      .slack_ms = 10000,
+      .cb = log_cb,
+  };
+  (void)timer_svc_add(&cfg, NULL);
+#else
+  (void)log_cb;
+#endif
+}
+
+#else
+
+bool display_lock_prof_enabled(void) { return false; }
+
+int display_lock_prof_get(display_lock_prof_site_t *out, int max) {
+  (void)out;
+  (void)max;
+  return 0;
+}
+
+void display_lock_prof_reset(void) {}
+
+void display_lock_prof_log(void) {}
+
+void display_lock_prof_init(void) {}
+
+#endif // CONFIG_DISPLAY_LOCK_PROFILE
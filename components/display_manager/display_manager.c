@@ -1,16 +1,21 @@
 #include "display_manager.h"
+#include "display_lock_prof.h"
 #include "bsp/display.h"
 #include "bsp/esp32_s3_touch_amoled_2_06.h"
 #include "driver/gpio.h"
 #include "esp_check.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_lvgl_port.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "i2c_bus.h"
 #include "lvgl.h"
 #include "nimble-nordic-uart.h"
 #include "settings.h"
+#include "timer_svc.h"
 #include <stdbool.h>
 #include <stdint.h>
 #include <string.h>
@@ -25,15 +30,205 @@
 // On this hardware BSP_CAPS_BUTTONS is 0, so we will use the PMU PWR key
 // instead.
 #define DISPLAY_BUTTON GPIO_NUM_0
+// Longest wait between screen timeout checks while the screen is on. While
+// it is off the task waits a whole timeout: if the screen is turned on from
+// elsewhere (touch, raise, notifications) meanwhile, that is still in time.
+#define DISPLAY_CHECK_MS 500
+
+// FT3168 low-power modes for waking on touch; INT goes low on a touch
+// (monitor mode) or on the gesture (gesture mode)
+#if defined(BSP_LCD_TOUCH_INT) && !CONFIG_DISPLAY_TOUCH_WAKE_NONE
+#define DISPLAY_TOUCH_WAKE 1
+#else
+#define DISPLAY_TOUCH_WAKE 0
+#endif
+#define FT3168_ADDR 0x38
+#define FT3168_REG_PMODE 0xA5
+#define FT3168_PMODE_ACTIVE 0x00
+#define FT3168_PMODE_MONITOR 0x01
+#define FT3168_REG_GESTURE_EN 0xD0
+#define FT3168_REG_GESTURE_MASK 0xD1
+#define FT3168_GESTURE_DOUBLE_TAP 0x10
+#define TOUCH_WAKE_TASK_STACK 3072
 
 static const char *TAG = "DISPLAY_MGR";
 
 static bool display_on = true;
+// Turning the screen on or off, and the PM lock with it, happens under this
+// mutex: sensors, touch wake, BLE and alarms all call turn_on, and a double
+// tap fires the IMU and the touch INT together
+static SemaphoreHandle_t s_state_lock;
+static StaticSemaphore_t s_state_lock_buf;
+static int64_t s_off_since_us;
 static uint32_t timeout_ms;
+static display_manager_key_cb_t s_key_cb;
 #if CONFIG_PM_ENABLE
 static esp_pm_lock_handle_t s_no_ls_lock = NULL;
+static bool s_pm_held;
+#endif
+// Wake to first frame: the request time (touch INT or turn_on), and whether
+// the next refresh ends the measurement
+static volatile int64_t s_wake_req_us;
+static volatile bool s_wake_pending;
+static uint32_t s_wake_last_ms, s_wake_max_ms;
+#if DISPLAY_TOUCH_WAKE
+static bool s_touch_wake; // INT set up and owned here
+static i2c_bus_dev_t s_touch_dev = -1;
+static TaskHandle_t s_touch_task;
+#endif
+
+static void state_lock_init(void) {
+  if (!s_state_lock)
+    s_state_lock = xSemaphoreCreateMutexStatic(&s_state_lock_buf);
+}
+
+static void state_lock(void) { xSemaphoreTake(s_state_lock, portMAX_DELAY); }
+
+static void state_unlock(void) { xSemaphoreGive(s_state_lock); }
+
+// The NO_LIGHT_SLEEP lock is held while the screen is on. Input that turns
+// it on comes from GPIO wake sources (PMU and touch INT) or from task
+// timeouts, both of which light sleep honours. Call under s_state_lock.
+static void pm_hold(bool hold) {
+#if CONFIG_PM_ENABLE
+  if (!s_no_ls_lock || hold == s_pm_held)
+    return;
+  if (hold)
+    (void)esp_pm_lock_acquire(s_no_ls_lock);
+  else
+    (void)esp_pm_lock_release(s_no_ls_lock);
+  s_pm_held = hold;
+#else
+  (void)hold;
 #endif
+}
 
+#if DISPLAY_TOUCH_WAKE
+static esp_err_t touch_low_power(bool on) {
+#if CONFIG_DISPLAY_TOUCH_WAKE_DOUBLE_TAP
+  uint8_t mask = FT3168_GESTURE_DOUBLE_TAP, en = on ? 1 : 0;
+  esp_err_t err = ESP_OK;
+  if (on)
+    err = i2c_bus_write(s_touch_dev, FT3168_REG_GESTURE_MASK, &mask, 1,
+                        I2C_BUS_PRIO_HIGH);
+  if (err == ESP_OK)
+    err = i2c_bus_write(s_touch_dev, FT3168_REG_GESTURE_EN, &en, 1,
+                        I2C_BUS_PRIO_HIGH);
+  return err;
+#else
+  uint8_t mode = on ? FT3168_PMODE_MONITOR : FT3168_PMODE_ACTIVE;
+  return i2c_bus_write(s_touch_dev, FT3168_REG_PMODE, &mode, 1,
+                       I2C_BUS_PRIO_HIGH);
+#endif
+}
+
+// INT is level-triggered while it is a wake source, so the ISR masks it
+// until the next time the screen goes off
+static void IRAM_ATTR touch_int_isr(void *arg) {
+  (void)arg;
+  BaseType_t hp = pdFALSE;
+  gpio_intr_disable(BSP_LCD_TOUCH_INT);
+  s_wake_req_us = esp_timer_get_time();
+  vTaskNotifyGiveFromISR(s_touch_task, &hp);
+  if (hp)
+    portYIELD_FROM_ISR();
+}
+
+static void touch_wake_task(void *arg) {
+  (void)arg;
+  for (;;) {
+    (void)ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (!display_on)
+      display_manager_turn_on();
+  }
+}
+
+static void touch_wake_arm(bool arm) {
+  if (!s_touch_wake)
+    return;
+  if (arm) {
+    esp_err_t err = touch_low_power(true);
+    if (err != ESP_OK)
+      ESP_LOGW(TAG, "Touch low-power mode failed: %s", esp_err_to_name(err));
+    (void)gpio_wakeup_enable(BSP_LCD_TOUCH_INT, GPIO_INTR_LOW_LEVEL);
+    gpio_intr_enable(BSP_LCD_TOUCH_INT);
+  } else {
+    gpio_intr_disable(BSP_LCD_TOUCH_INT);
+    (void)gpio_wakeup_disable(BSP_LCD_TOUCH_INT);
+    // A touch has already brought monitor mode back to active
+    (void)touch_low_power(false);
+  }
+}
+
+static void touch_wake_init(void) {
+  lv_indev_t *indev = bsp_display_get_input_dev();
+#if LVGL_VERSION_MAJOR >= 9
+  if (indev && lv_indev_get_mode(indev) == LV_INDEV_MODE_EVENT) {
+    ESP_LOGW(TAG, "Touch INT belongs to the LVGL port, no touch wake");
+    return;
+  }
+#else
+  (void)indev;
+#endif
+  if (i2c_bus_init(bsp_i2c_get_handle()) != ESP_OK ||
+      i2c_bus_add_device(FT3168_ADDR, CONFIG_I2C_MASTER_FREQUENCY,
+                         &s_touch_dev) != ESP_OK) {
+    ESP_LOGW(TAG, "Touch controller not on the bus manager, no touch wake");
+    return;
+  }
+  if (xTaskCreate(touch_wake_task, "touch_wake", TOUCH_WAKE_TASK_STACK, NULL,
+                  4, &s_touch_task) != pdPASS)
+    return;
+  gpio_config_t io = {
+      .pin_bit_mask = 1ULL << BSP_LCD_TOUCH_INT,
+      .mode = GPIO_MODE_INPUT,
+      // Touch INT is active-low on this board
+      .pull_up_en = GPIO_PULLUP_ENABLE,
+      .pull_down_en = GPIO_PULLDOWN_DISABLE,
+      .intr_type = GPIO_INTR_NEGEDGE,
+  };
+  esp_err_t err = gpio_config(&io);
+  if (err == ESP_OK) {
+    err = gpio_install_isr_service(0);
+    if (err == ESP_ERR_INVALID_STATE)
+      err = ESP_OK;
+  }
+  // Only armed while the screen is off
+  gpio_intr_disable(BSP_LCD_TOUCH_INT);
+  if (err == ESP_OK)
+    err = gpio_isr_handler_add(BSP_LCD_TOUCH_INT, touch_int_isr, NULL);
+  if (err != ESP_OK) {
+    ESP_LOGW(TAG, "Touch INT setup failed: %s", esp_err_to_name(err));
+    return;
+  }
+  (void)esp_sleep_enable_gpio_wakeup();
+  s_touch_wake = true;
+  ESP_LOGI(TAG, "Touch wake on GPIO %d", (int)BSP_LCD_TOUCH_INT);
+}
+#else
+static void touch_wake_arm(bool arm) { (void)arm; }
+static void touch_wake_init(void) {}
+#endif // DISPLAY_TOUCH_WAKE
+
+#if LVGL_VERSION_MAJOR >= 9
+// Runs in the LVGL task after each refresh; the first one after turn_on
+// has redrawn the whole screen
+static void refr_ready_cb(lv_event_t *e) {
+  (void)e;
+  if (!s_wake_pending)
+    return;
+  s_wake_pending = false;
+  uint32_t ms = (uint32_t)((esp_timer_get_time() - s_wake_req_us) / 1000);
+  s_wake_req_us = 0;
+  s_wake_last_ms = ms;
+  if (ms > s_wake_max_ms)
+    s_wake_max_ms = ms;
+  ESP_LOGI(TAG, "Wake to first frame: %lu ms (max %lu ms)",
+           (unsigned long)ms, (unsigned long)s_wake_max_ms);
+}
+#endif
+
+// Under s_state_lock
 static void display_turn_off_internal(void) {
   if (!display_on) {
     return;
@@ -41,9 +236,9 @@ static void display_turn_off_internal(void) {
   ESP_LOGI(TAG, "Turning display off");
   // Stop LVGL timers to pause flushing while panel sleeps. Take LVGL lock to
   // avoid in-flight flush.
-  if (lvgl_port_lock(200)) {
+  if (bsp_display_lock(200)) {
     lvgl_port_stop();
-    lvgl_port_unlock();
+    bsp_display_unlock();
   } else {
     lvgl_port_stop();
   }
@@ -57,25 +252,39 @@ static void display_turn_off_internal(void) {
   bsp_display_brightness_set(0);
   // Hint BLE to prefer low-power connection parameters while screen is off
   nordic_uart_set_low_power_mode(true);
-  // If you rely on GPIO wake (touch or PMU IRQ), you may allow light sleep.
-  // If wake via polling is required, DO NOT release the lock here.
-  // For stability, keep CPU out of light sleep while screen is off.
-  // This avoids missing wake events on boards without IRQ wiring.
-  (void)0;
+  s_off_since_us = esp_timer_get_time();
+  s_wake_req_us = 0;
   display_on = false;
+  // UI timers would only redraw a dark panel
+  timer_svc_set_screen(false);
+  pmu_key_poll_fast(false);
+  touch_wake_arm(true);
+  // Let the CPU light-sleep until a wake source fires
+  pm_hold(false);
 }
 
-void display_manager_turn_off(void) { display_turn_off_internal(); }
+void display_manager_turn_off(void) {
+  state_lock();
+  display_turn_off_internal();
+  state_unlock();
+}
 
 void display_manager_turn_on(void) {
+  state_lock();
+  pm_hold(true);
   if (!display_on) {
     ESP_LOGI(TAG, "Turning display on");
+    if (!s_wake_req_us)
+      s_wake_req_us = esp_timer_get_time();
+    touch_wake_arm(false);
+    timer_svc_set_screen(true);
+    pmu_key_poll_fast(true);
     // Wake the panel first, clear panel, then resume LVGL and restore brightness
     bsp_display_wake();
     (void)bsp_display_clear_black();
     lvgl_port_resume();
 
-    if (lvgl_port_lock(200)) {
+    if (bsp_display_lock(200)) {
 #if LVGL_VERSION_MAJOR >= 9
       lv_display_t *disp = lv_display_get_default();
       if (disp) {
@@ -84,6 +293,7 @@ void display_manager_turn_on(void) {
           lv_obj_invalidate(scr);
         }
       }
+      s_wake_pending = true;
 #else
       lv_disp_t *disp = lv_disp_get_default();
       if (disp) {
@@ -93,7 +303,7 @@ void display_manager_turn_on(void) {
         }
       }
 #endif
-      lvgl_port_unlock();
+      bsp_display_unlock();
     }
 
     bsp_display_brightness_set(settings_get_brightness());
@@ -109,21 +319,31 @@ void display_manager_turn_on(void) {
 #endif
     display_on = true;
   }
-  // Prevent light sleep while actively displaying UI for responsiveness
-#if CONFIG_PM_ENABLE
-  if (s_no_ls_lock) {
-    (void)esp_pm_lock_acquire(s_no_ls_lock);
-  }
-#endif
   // Restore more responsive BLE params when screen is on
   nordic_uart_set_low_power_mode(false);
   display_manager_reset_timer();
+  state_unlock();
 }
 
 bool display_manager_is_on(void) { return display_on; }
 
+uint32_t display_manager_off_ms(void) {
+  if (display_on)
+    return 0;
+  return (uint32_t)((esp_timer_get_time() - s_off_since_us) / 1000);
+}
+
 void display_manager_reset_timer(void) { lv_disp_trig_activity(NULL); }
 
+void display_manager_set_key_cb(display_manager_key_cb_t cb) { s_key_cb = cb; }
+
+void display_manager_get_wake_latency(uint32_t *last_ms, uint32_t *max_ms) {
+  if (last_ms)
+    *last_ms = s_wake_last_ms;
+  if (max_ms)
+    *max_ms = s_wake_max_ms;
+}
+
 static void touch_event_cb(lv_event_t *e) {
   lv_event_code_t code = lv_event_get_code(e);
   switch (code) {
@@ -141,43 +361,56 @@ static void touch_event_cb(lv_event_t *e) {
   }
 }
 
-static bool wake_button_pressed(void) {
-#if BSP_CAPS_BUTTONS
-  return gpio_get_level(DISPLAY_BUTTON) == 0;
-#else
-  // Poll AXP2101 power key short-press event
-  return bsp_power_poll_pwr_button_short();
-#endif
+// A press that turns the screen on does nothing else; the others keep it on
+// and go to the UI
+static void handle_key(pmu_key_t key) {
+  if (!display_on) {
+    display_manager_turn_on();
+    return;
+  }
+  display_manager_reset_timer();
+  if (s_key_cb)
+    s_key_cb(key);
 }
 
 static void display_manager_task(void *arg) {
   ESP_LOGI(TAG, "Display manager task started");
-  TickType_t last = xTaskGetTickCount();
   while (1) {
     // Refresh timeout from settings to apply changes immediately
     timeout_ms = settings_get_display_timeout();
+    uint32_t wait_ms = display_on || timeout_ms < DISPLAY_CHECK_MS
+                           ? DISPLAY_CHECK_MS
+                           : timeout_ms;
+    // Checked under the lock, so a turn_on racing the timeout wins
+    state_lock();
     if (display_on) {
       uint32_t inactive = lv_disp_get_inactive_time(NULL);
-      if (inactive >= timeout_ms) {
+      if (inactive >= timeout_ms)
         display_turn_off_internal();
-      }
-      if (wake_button_pressed()) {
-        display_manager_reset_timer();
-        vTaskDelay(pdMS_TO_TICKS(100));
-        last = xTaskGetTickCount();
-      }
-    } else {
-      if (wake_button_pressed()) {
-        display_manager_turn_on();
-        vTaskDelay(pdMS_TO_TICKS(100));
-        last = xTaskGetTickCount();
-      }
+      else if (timeout_ms - inactive < wait_ms)
+        wait_ms = timeout_ms - inactive < 10 ? 10 : timeout_ms - inactive;
+    }
+    state_unlock();
+#if BSP_CAPS_BUTTONS
+    (void)wait_ms;
+    if (gpio_get_level(DISPLAY_BUTTON) == 0) {
+      handle_key(PMU_KEY_SHORT);
+      vTaskDelay(pdMS_TO_TICKS(100));
     }
-    vTaskDelayUntil(&last, pdMS_TO_TICKS(50));
+    vTaskDelay(pdMS_TO_TICKS(50));
+#else
+    // Key presses come from the PMU interrupt; between them the task only
+    // wakes for the screen timeout
+    pmu_key_t key;
+    if (pmu_key_get(&key, wait_ms))
+      handle_key(key);
+#endif
   }
 }
 
 void display_manager_init(void) {
+  display_lock_prof_init();
+  state_lock_init();
   timeout_ms = settings_get_display_timeout();
 #if BSP_CAPS_BUTTONS
   gpio_config_t io_conf = {
@@ -201,54 +434,35 @@ void display_manager_init(void) {
     (void)esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "display",
                              &s_no_ls_lock);
   }
-  if (s_no_ls_lock) {
-    (void)esp_pm_lock_acquire(s_no_ls_lock);
-  }
 #endif
-/*
-  // Configure GPIO wake-ups so user input can wake CPU from light sleep
-  // Only meaningful if PM/light-sleep is enabled and wake pins are wired.
-#if CONFIG_PM_ENABLE
-  // Touch INT is active-low on this board
-  gpio_config_t touch_io = {
-      .pin_bit_mask = 1ULL << BSP_LCD_TOUCH_INT,
-      .mode = GPIO_MODE_INPUT,
-      .pull_up_en = GPIO_PULLUP_ENABLE,
-      .pull_down_en = GPIO_PULLDOWN_DISABLE,
-      .intr_type = GPIO_INTR_DISABLE,
-  };
-  (void)gpio_config(&touch_io);
-  (void)gpio_wakeup_enable(BSP_LCD_TOUCH_INT, GPIO_INTR_LOW_LEVEL);
-#ifdef CONFIG_PMU_INTERRUPT_PIN
-  // PMU IRQ (e.g., power key) also active-low
-  gpio_config_t pmu_io = {
-      .pin_bit_mask = 1ULL << CONFIG_PMU_INTERRUPT_PIN,
-      .mode = GPIO_MODE_INPUT,
-      .pull_up_en = GPIO_PULLUP_ENABLE,
-      .pull_down_en = GPIO_PULLDOWN_DISABLE,
-      .intr_type = GPIO_INTR_DISABLE,
-  };
-  (void)gpio_config(&pmu_io);
-  (void)gpio_wakeup_enable(CONFIG_PMU_INTERRUPT_PIN, GPIO_INTR_LOW_LEVEL);
+  state_lock();
+  if (display_on)
+    pm_hold(true);
+  state_unlock();
+
+  touch_wake_init();
+#if LVGL_VERSION_MAJOR >= 9
+  if (bsp_display_lock(0)) {
+    lv_display_t *disp = lv_display_get_default();
+    if (disp)
+      lv_display_add_event_cb(disp, refr_ready_cb, LV_EVENT_REFR_READY, NULL);
+    bsp_display_unlock();
+  }
 #endif
-  (void)esp_sleep_enable_gpio_wakeup();
-#endif // CONFIG_PM_ENABLE
-*/
+
   // Higher priority so UI updates aren't delayed by other workloads
   xTaskCreate(display_manager_task, "display_mgr", 4000, NULL, 3, NULL);
 }
 
 void display_manager_pm_early_init(void) {
+  state_lock_init();
 #if CONFIG_PM_ENABLE
   if (!s_no_ls_lock) {
     (void)esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "display",
                              &s_no_ls_lock);
   }
-  if (s_no_ls_lock) {
-    (void)esp_pm_lock_acquire(s_no_ls_lock);
-  }
-#else
-  // No power management; nothing to do
-  (void)0;
 #endif
+  state_lock();
+  pm_hold(true);
+  state_unlock();
 }
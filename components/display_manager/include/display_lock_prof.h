@@ -0,0 +1,49 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Display lock contention profiler (CONFIG_DISPLAY_LOCK_PROFILE). Every
+// bsp_display_lock()/bsp_display_unlock() outside the BSP is wrapped at link
+// time, so call sites stay as they are. Each site is keyed by its return
+// address, which idf.py monitor decodes to function and line in the log.
+// Code in this tree takes the lock only through bsp_display_lock(), never
+// lvgl_port_lock() directly, so every caller is seen except the LVGL task,
+// whose own hold shows up as wait time at the other sites. Without the
+// option everything here is a no-op.
+
+#define DISPLAY_LOCK_PROF_MAX_SITES 32
+// Log2 buckets in ms: <1, <2, <4, ... <256, >=256
+#define DISPLAY_LOCK_PROF_BUCKETS 10
+
+typedef struct {
+  uintptr_t pc;    // call site
+  char task[16];   // task of the first call from it
+  uint32_t takes;
+  uint32_t timeouts;
+  uint32_t wait_max_us;
+  uint32_t hold_max_us;
+  uint64_t wait_total_us;
+  uint64_t hold_total_us;
+  uint32_t wait_hist[DISPLAY_LOCK_PROF_BUCKETS];
+  uint32_t hold_hist[DISPLAY_LOCK_PROF_BUCKETS];
+} display_lock_prof_site_t;
+
+bool display_lock_prof_enabled(void);
+
+// From display_manager_init(); starts the periodic log
+void display_lock_prof_init(void);
+
+// Copies up to `max` sites in order of their first call; returns how many
+int display_lock_prof_get(display_lock_prof_site_t *out, int max);
+void display_lock_prof_reset(void);
+
+// One line per site, worst wait first; also every
+// CONFIG_DISPLAY_LOCK_PROFILE_LOG_S seconds
+void display_lock_prof_log(void);
+
+#ifdef __cplusplus
+}
+#endif
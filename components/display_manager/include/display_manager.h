@@ -1,5 +1,7 @@
 #pragma once
 #include <stdbool.h>
+#include <stdint.h>
+#include "pmu.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -8,10 +10,22 @@ void display_manager_init(void);
 void display_manager_turn_on(void);
 void display_manager_turn_off(void);
 bool display_manager_is_on(void);
+// How long the screen has been off, 0 while it is on
+uint32_t display_manager_off_ms(void);
 void display_manager_reset_timer(void);
 
+// Power key presses that did not turn the screen on, in order; called from
+// the display manager task
+typedef void (*display_manager_key_cb_t)(pmu_key_t key);
+void display_manager_set_key_cb(display_manager_key_cb_t cb);
+
+// Time from the wake request (touch INT or turn_on) to the end of the first
+// refresh after it, for the last wake and the worst since boot
+void display_manager_get_wake_latency(uint32_t *last_ms, uint32_t *max_ms);
+
 // Early PM setup: create and acquire a NO_LIGHT_SLEEP lock so the
-// system won’t enter light-sleep during boot/UI init. Safe to call multiple times.
+// system won’t enter light-sleep during boot/UI init. The lock is released
+// while the screen is off. Safe to call multiple times.
 void display_manager_pm_early_init(void);
 
 #ifdef __cplusplus
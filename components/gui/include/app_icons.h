@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "lvgl.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// App icons pushed by the phone, kept in a bounded store on SPIFFS and
+// decoded on demand into a small LRU in PSRAM.
+//
+// Blob format (what the phone uploads, little endian):
+//   "AIC1" | enc:u8 | cf:u8 | w:u8 | h:u8 | payload
+//   enc 0 = raw, 1 = RLE; cf 0 = RGB565A8 (RGB565 plane followed by A8 plane)
+//   RLE packets, per plane: ctrl:u8, bit7 set -> repeat next element
+//   (ctrl & 0x7F) + 1 times, clear -> (ctrl + 1) literal elements follow.
+//   Elements are 2 bytes in the colour plane and 1 byte in the alpha plane.
+#define APP_ICONS_MAX_STORED  24
+#define APP_ICONS_MAX_DIM     96
+#define APP_ICONS_MAX_BLOB    (8 + APP_ICONS_MAX_DIM * APP_ICONS_MAX_DIM * 3)
+#define APP_ICONS_ID_MAX      64 // package name, including the terminator
+
+// Case-insensitive FNV-1a of the package name. The store is keyed by it but
+// keeps the name too, so two packages with the same hash never share an
+// icon; storing one replaces the other.
+uint32_t app_icons_hash(const char* app_id);
+
+// Load the on-flash index. SPIFFS must already be mounted (settings_init).
+esp_err_t app_icons_init(void);
+
+// True if an icon for this package is in the store (any task)
+bool app_icons_has(const char* app_id);
+
+// Decoded icon for the package or NULL. Call from the LVGL thread only; the
+// returned descriptor stays valid until at least the next lookup.
+const lv_image_dsc_t* app_icons_get(const char* app_id);
+
+// Feed one chunk of an uploaded blob. Chunks must arrive in order starting
+// at offset 0; `*done` is set once the blob is complete and stored.
+esp_err_t app_icons_upload_chunk(const char* app_id, size_t total, size_t offset,
+                                 const uint8_t* data, size_t len, bool* done);
+
+#ifdef __cplusplus
+}
+#endif
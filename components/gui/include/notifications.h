@@ -1,9 +1,19 @@
 #pragma once
+#include <stdbool.h>
 #include "lvgl.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define NOTIFICATIONS_MAX 5
+
+typedef struct {
+    char app[32];
+    char title[64];
+    char message[256];
+    char ts_iso[40];
+} notifications_item_t;
+
 void notifications_screen_create(lv_obj_t* parent);
 lv_obj_t* notifications_screen_get(void);
 
@@ -14,6 +24,15 @@ void notifications_show(const char* app,
                         const char* message,
                         const char* timestamp_iso8601);
 
+// True if a built-in or phone-pushed icon exists for this package (any task)
+bool notifications_app_has_icon(const char* app_id);
+
+// Copy of the recent notifications, newest first, for standby (standby.h).
+// Call with the display lock held. Returns the number copied.
+int notifications_export(notifications_item_t* out, int max);
+// Put exported notifications back, before or after the screen exists
+void notifications_import(const notifications_item_t* items, int n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdbool.h>
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Deep-sleep standby. After a long time with the screen off and nothing
+// going on, the SoC goes to deep sleep; the IMU keeps counting steps and the
+// RTC keeps the alarms. Steps, recent notifications, the active tile and a
+// settings hash are kept in RTC memory, so the next boot comes back where
+// the watch left off instead of starting from scratch.
+
+typedef enum {
+    STANDBY_WAKE_NONE = 0, // cold boot or any other reset
+    STANDBY_WAKE_KEY,      // BOOT or PMU key
+    STANDBY_WAKE_IMU,      // tap or step on INT1
+    STANDBY_WAKE_ALARM,    // RTC INT, or the timer when it is not wired
+} standby_wake_t;
+
+// First thing in app_main: what ended standby, STANDBY_WAKE_NONE if this
+// boot does not resume from it. Hands the saved counts to the sensors.
+standby_wake_t standby_resume_begin(void);
+standby_wake_t standby_wake_reason(void);
+
+// Whether the panel should come on for this boot. A step or an alarm wakes
+// the SoC without anyone looking; valid after sensors_init().
+bool standby_wake_is_visual(void);
+
+// After ui_init(): put the notifications and the tile back. Takes the
+// display lock.
+void standby_resume_finish(void);
+
+// Start the task that enters standby (CONFIG_STANDBY_ENABLE)
+esp_err_t standby_init(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -26,6 +26,20 @@ extern "C" {
     // Switch to the Messages tile (notifications screen)
     void ui_show_messages_tile(void);
 
+    // One step back: close the innermost dynamic tile, else return to the
+    // watchface. Call with the display lock held.
+    void ui_go_back(void);
+
+    // Fixed tiles of the main TileView, for standby (standby.h). Dynamic
+    // tiles report UI_TILE_WATCHFACE. Call with the display lock held.
+    typedef enum {
+        UI_TILE_WATCHFACE = 0,
+        UI_TILE_MESSAGES,
+        UI_TILE_CONTROLS,
+    } ui_tile_t;
+    ui_tile_t ui_get_active_tile(void);
+    void ui_set_active_tile(ui_tile_t tile);
+
     // Accessor for the main TileView screen
     //lv_obj_t* ui_get_main_tileview(void);
 
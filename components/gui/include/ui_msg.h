@@ -0,0 +1,53 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Updates from other tasks into the UI. Producers post typed messages and
+// never take the display lock; the LVGL task applies them at the start of
+// each frame (LV_EVENT_REFR_START), and every LV_DEF_REFR_PERIOD on a screen
+// that is not redrawing. Battery and BLE state keep only the latest value; a
+// post that replaces one not yet applied is counted as coalesced.
+// Notifications and key presses are queued in order in preallocated slots,
+// and dropped (and counted) when the queue is full. While the screen is off
+// nothing is drained; the first frame after turning it on catches up.
+
+#define UI_MSG_QUEUE_LEN 8
+
+typedef enum {
+    UI_MSG_POWER,  // coalesced
+    UI_MSG_BLE,    // coalesced
+    UI_MSG_NOTIFY, // queued
+    UI_MSG_BACK,   // queued
+    UI_MSG_TYPE_COUNT,
+} ui_msg_type_t;
+
+typedef struct {
+    uint32_t posted;
+    uint32_t coalesced; // replaced before the UI saw them
+    uint32_t dropped;   // queue full
+    uint32_t handled;
+    uint32_t last_us;   // post to applied, for the last one handled
+    uint32_t max_us;
+} ui_msg_stats_t;
+
+// Early in app_main, before any producer; idempotent
+esp_err_t ui_msg_init(void);
+// From ui_init() with the display lock held, once the screens exist
+void ui_msg_start(void);
+
+void ui_msg_post_power(bool vbus_in, bool charging, int battery_percent);
+void ui_msg_post_ble(bool connected);
+// Strings are copied (and truncated) into the message; any may be NULL
+bool ui_msg_post_notification(const char *app, const char *title,
+                              const char *message, const char *timestamp);
+bool ui_msg_post_back(void);
+
+void ui_msg_get_stats(ui_msg_type_t type, ui_msg_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
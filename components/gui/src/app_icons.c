@@ -0,0 +1,450 @@
+#include "app_icons.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char* TAG = "AppIcons";
+
+#define ICON_INDEX_FILE   "/spiffs/icons.idx"
+#define ICON_BLOB_FMT     "/spiffs/ic_%08lx.bin"
+#define ICON_INDEX_MAGIC  0x32584449u // "IDX2"
+#define ICON_INDEX_MAGIC_V1 0x31584449u // "IDX1", entries without the name
+#define ICON_BLOB_HDR_LEN 8
+#define ICON_LRU_SLOTS    8
+#define ICON_HASH_SLOTS   64 // power of two, > 2 * APP_ICONS_MAX_STORED
+#define ICON_HASH_EMPTY   0xFF
+
+typedef struct {
+    uint32_t magic;
+    uint16_t count;
+    uint16_t reserved;
+    uint32_t use_clock;
+} icon_index_hdr_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t blob_size;
+    uint32_t last_use;
+    char app[APP_ICONS_ID_MAX];
+} icon_index_entry_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t blob_size;
+    uint32_t last_use;
+} icon_index_entry_v1_t;
+
+typedef struct {
+    uint32_t hash;
+    uint32_t last_use;
+    bool valid;
+    bool stale;
+    lv_image_dsc_t dsc;
+    uint8_t* buf;
+    size_t buf_size;
+} icon_slot_t;
+
+// Store index (mirrors ICON_INDEX_FILE) and its open-addressing lookup table
+static icon_index_entry_t s_index[APP_ICONS_MAX_STORED];
+static int s_index_count;
+static uint32_t s_use_clock;
+static uint8_t s_hash_tab[ICON_HASH_SLOTS];
+static SemaphoreHandle_t s_lock;
+static bool s_ready;
+
+// Decoded icons in PSRAM (LVGL thread)
+static icon_slot_t s_lru[ICON_LRU_SLOTS];
+static uint32_t s_lru_clock;
+static const lv_image_dsc_t* s_last_returned;
+
+// Upload staging (BLE task)
+static uint8_t* s_up_buf;
+static size_t s_up_total;
+static size_t s_up_pos;
+static uint32_t s_up_hash;
+static char s_up_app[APP_ICONS_ID_MAX];
+
+uint32_t app_icons_hash(const char* app_id)
+{
+    uint32_t h = 2166136261u;
+    if (!app_id) return h;
+    for (const char* p = app_id; *p; ++p) {
+        h ^= (uint8_t)tolower((unsigned char)*p);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void rebuild_hash_table(void)
+{
+    memset(s_hash_tab, ICON_HASH_EMPTY, sizeof(s_hash_tab));
+    for (int i = 0; i < s_index_count; ++i) {
+        uint32_t pos = s_index[i].hash & (ICON_HASH_SLOTS - 1);
+        while (s_hash_tab[pos] != ICON_HASH_EMPTY) {
+            pos = (pos + 1) & (ICON_HASH_SLOTS - 1);
+        }
+        s_hash_tab[pos] = (uint8_t)i;
+    }
+}
+
+// Entry stored under this hash, whichever package it belongs to
+static int find_hash(uint32_t hash)
+{
+    uint32_t pos = hash & (ICON_HASH_SLOTS - 1);
+    for (int probes = 0; probes < ICON_HASH_SLOTS; ++probes) {
+        uint8_t i = s_hash_tab[pos];
+        if (i == ICON_HASH_EMPTY) return -1;
+        if (s_index[i].hash == hash) return i;
+        pos = (pos + 1) & (ICON_HASH_SLOTS - 1);
+    }
+    return -1;
+}
+
+// Entry for this package; a colliding package's entry does not match
+static int find_entry(const char* app_id, uint32_t hash)
+{
+    int i = find_hash(hash);
+    return i >= 0 && strcasecmp(s_index[i].app, app_id) == 0 ? i : -1;
+}
+
+static bool app_id_valid(const char* app_id)
+{
+    return app_id && *app_id && strlen(app_id) < APP_ICONS_ID_MAX;
+}
+
+static void blob_path(uint32_t hash, char* out, size_t out_sz)
+{
+    snprintf(out, out_sz, ICON_BLOB_FMT, (unsigned long)hash);
+}
+
+static bool save_index(void)
+{
+    FILE* f = fopen(ICON_INDEX_FILE, "wb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open %s for write", ICON_INDEX_FILE);
+        return false;
+    }
+    icon_index_hdr_t hdr = {
+        .magic = ICON_INDEX_MAGIC,
+        .count = (uint16_t)s_index_count,
+        .use_clock = s_use_clock,
+    };
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    if (ok && s_index_count > 0) {
+        ok = fwrite(s_index, sizeof(s_index[0]), s_index_count, f) == (size_t)s_index_count;
+    }
+    fclose(f);
+    return ok;
+}
+
+esp_err_t app_icons_init(void)
+{
+    if (s_ready) return ESP_OK;
+    if (!s_lock) {
+        s_lock = xSemaphoreCreateMutex();
+        if (!s_lock) return ESP_ERR_NO_MEM;
+    }
+    s_index_count = 0;
+    s_use_clock = 0;
+    FILE* f = fopen(ICON_INDEX_FILE, "rb");
+    if (f) {
+        icon_index_hdr_t hdr;
+        bool read = fread(&hdr, sizeof(hdr), 1, f) == 1 && hdr.count <= APP_ICONS_MAX_STORED;
+        if (read && hdr.magic == ICON_INDEX_MAGIC &&
+            fread(s_index, sizeof(s_index[0]), hdr.count, f) == hdr.count) {
+            s_index_count = hdr.count;
+            s_use_clock = hdr.use_clock;
+            for (int i = 0; i < s_index_count; ++i) {
+                s_index[i].app[APP_ICONS_ID_MAX - 1] = '\0';
+            }
+        } else if (read && hdr.magic == ICON_INDEX_MAGIC_V1) {
+            // Old entries carry no name to check; drop them, the phone
+            // pushes the icons again on the next notification
+            icon_index_entry_v1_t e;
+            char path[32];
+            for (int i = 0; i < hdr.count && fread(&e, sizeof(e), 1, f) == 1; ++i) {
+                blob_path(e.hash, path, sizeof(path));
+                remove(path);
+            }
+            ESP_LOGW(TAG, "Dropped %u icons from the old index", hdr.count);
+        } else {
+            ESP_LOGW(TAG, "Icon index invalid; starting empty");
+        }
+        fclose(f);
+    }
+    rebuild_hash_table();
+    s_ready = true;
+    ESP_LOGI(TAG, "Icon store: %d icons", s_index_count);
+    return ESP_OK;
+}
+
+bool app_icons_has(const char* app_id)
+{
+    if (!s_ready || !app_id_valid(app_id)) return false;
+    uint32_t hash = app_icons_hash(app_id);
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool found = find_entry(app_id, hash) >= 0;
+    xSemaphoreGive(s_lock);
+    return found;
+}
+
+// Decode `count` elements of `elem` bytes. With out == NULL only validates.
+static bool rle_decode(const uint8_t** pp, const uint8_t* end, uint8_t* out, size_t count, size_t elem)
+{
+    const uint8_t* p = *pp;
+    size_t n = 0;
+    while (n < count) {
+        if (p >= end) return false;
+        uint8_t ctrl = *p++;
+        size_t run = (size_t)(ctrl & 0x7F) + 1;
+        if (n + run > count) return false;
+        if (ctrl & 0x80) {
+            if ((size_t)(end - p) < elem) return false;
+            if (out) {
+                for (size_t i = 0; i < run; ++i) memcpy(out + (n + i) * elem, p, elem);
+            }
+            p += elem;
+        } else {
+            if ((size_t)(end - p) < run * elem) return false;
+            if (out) memcpy(out + n * elem, p, run * elem);
+            p += run * elem;
+        }
+        n += run;
+    }
+    *pp = p;
+    return true;
+}
+
+// Validate a blob and optionally decode it into `out` (w * h * 3 bytes)
+static bool decode_blob(const uint8_t* blob, size_t len, uint8_t* out, uint8_t* w_out, uint8_t* h_out)
+{
+    if (len < ICON_BLOB_HDR_LEN || memcmp(blob, "AIC1", 4) != 0) return false;
+    uint8_t enc = blob[4], cf = blob[5], w = blob[6], h = blob[7];
+    if (cf != 0 || w == 0 || h == 0 || w > APP_ICONS_MAX_DIM || h > APP_ICONS_MAX_DIM) return false;
+    size_t px = (size_t)w * h;
+    const uint8_t* p = blob + ICON_BLOB_HDR_LEN;
+    const uint8_t* end = blob + len;
+    if (enc == 0) {
+        if ((size_t)(end - p) != px * 3) return false;
+        if (out) memcpy(out, p, px * 3);
+    } else if (enc == 1) {
+        if (!rle_decode(&p, end, out, px, 2)) return false;
+        if (!rle_decode(&p, end, out ? out + px * 2 : NULL, px, 1)) return false;
+    } else {
+        return false;
+    }
+    if (w_out) *w_out = w;
+    if (h_out) *h_out = h;
+    return true;
+}
+
+static icon_slot_t* pick_victim(void)
+{
+    icon_slot_t* victim = NULL;
+    for (int i = 0; i < ICON_LRU_SLOTS; ++i) {
+        icon_slot_t* s = &s_lru[i];
+        if (!s->valid) return s;
+        // Never recycle the descriptor the notification card may still show
+        if (&s->dsc == s_last_returned) continue;
+        if (s->stale) return s;
+        if (!victim || s->last_use < victim->last_use) victim = s;
+    }
+    return victim;
+}
+
+const lv_image_dsc_t* app_icons_get(const char* app_id)
+{
+    if (!s_ready || !app_id_valid(app_id)) return NULL;
+    uint32_t hash = app_icons_hash(app_id);
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // Slots follow the entry stored under their hash (store_blob() marks
+    // them stale), so they only match once the entry does
+    int idx = find_entry(app_id, hash);
+    if (idx < 0) {
+        xSemaphoreGive(s_lock);
+        return NULL;
+    }
+    for (int i = 0; i < ICON_LRU_SLOTS; ++i) {
+        icon_slot_t* s = &s_lru[i];
+        if (s->valid && !s->stale && s->hash == hash) {
+            s->last_use = ++s_lru_clock;
+            xSemaphoreGive(s_lock);
+            s_last_returned = &s->dsc;
+            return &s->dsc;
+        }
+    }
+    // Persisted lazily with the next store update to spare flash writes
+    s_index[idx].last_use = ++s_use_clock;
+    uint32_t blob_size = s_index[idx].blob_size;
+    xSemaphoreGive(s_lock);
+    if (blob_size == 0 || blob_size > APP_ICONS_MAX_BLOB) return NULL;
+
+    char path[32];
+    blob_path(hash, path, sizeof(path));
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        ESP_LOGW(TAG, "Icon blob missing: %s", path);
+        return NULL;
+    }
+    uint8_t* blob = heap_caps_malloc(blob_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!blob) {
+        fclose(f);
+        return NULL;
+    }
+    size_t n = fread(blob, 1, blob_size, f);
+    fclose(f);
+
+    uint8_t w = 0, h = 0;
+    icon_slot_t* slot = NULL;
+    if (n == blob_size && decode_blob(blob, n, NULL, &w, &h)) {
+        slot = pick_victim();
+    }
+    if (slot) {
+        size_t need = (size_t)w * h * 3;
+        if (slot->valid) {
+            lv_image_cache_drop(&slot->dsc);
+        }
+        if (slot->buf_size < need) {
+            heap_caps_free(slot->buf);
+            slot->buf = heap_caps_malloc(need, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+            slot->buf_size = slot->buf ? need : 0;
+        }
+        slot->valid = false;
+        if (slot->buf && decode_blob(blob, n, slot->buf, NULL, NULL)) {
+            memset(&slot->dsc, 0, sizeof(slot->dsc));
+            slot->dsc.header.magic = LV_IMAGE_HEADER_MAGIC;
+            slot->dsc.header.cf = LV_COLOR_FORMAT_RGB565A8;
+            slot->dsc.header.w = w;
+            slot->dsc.header.h = h;
+            slot->dsc.header.stride = w * 2;
+            slot->dsc.data_size = need;
+            slot->dsc.data = slot->buf;
+            xSemaphoreTake(s_lock, portMAX_DELAY);
+            slot->hash = hash;
+            slot->stale = false;
+            slot->valid = true;
+            slot->last_use = ++s_lru_clock;
+            xSemaphoreGive(s_lock);
+        } else {
+            slot = NULL;
+        }
+    }
+    heap_caps_free(blob);
+    if (!slot) {
+        ESP_LOGW(TAG, "Icon %08lx could not be decoded", (unsigned long)hash);
+        return NULL;
+    }
+    s_last_returned = &slot->dsc;
+    return &slot->dsc;
+}
+
+static esp_err_t store_blob(const char* app_id, uint32_t hash, const uint8_t* blob, size_t len)
+{
+    char path[32];
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    // A package colliding on the hash shares the blob file; replace it
+    int idx = find_hash(hash);
+    if (idx >= 0 && strcasecmp(s_index[idx].app, app_id) != 0) {
+        ESP_LOGW(TAG, "Icon for %s replaces %s (same hash)", app_id, s_index[idx].app);
+    }
+    if (idx < 0 && s_index_count >= APP_ICONS_MAX_STORED) {
+        // Evict the least recently displayed icon to keep flash use bounded
+        int lru = 0;
+        for (int i = 1; i < s_index_count; ++i) {
+            if (s_index[i].last_use < s_index[lru].last_use) lru = i;
+        }
+        blob_path(s_index[lru].hash, path, sizeof(path));
+        remove(path);
+        ESP_LOGI(TAG, "Evicted icon %08lx", (unsigned long)s_index[lru].hash);
+        s_index[lru] = s_index[--s_index_count];
+        rebuild_hash_table();
+    }
+
+    blob_path(hash, path, sizeof(path));
+    FILE* f = fopen(path, "wb");
+    size_t n = 0;
+    if (f) {
+        n = fwrite(blob, 1, len, f);
+        fclose(f);
+    }
+    if (n != len) {
+        remove(path);
+        xSemaphoreGive(s_lock);
+        ESP_LOGE(TAG, "Failed to write %s", path);
+        return ESP_FAIL;
+    }
+
+    if (idx < 0) {
+        idx = s_index_count++;
+    }
+    s_index[idx].hash = hash;
+    snprintf(s_index[idx].app, sizeof(s_index[idx].app), "%s", app_id);
+    s_index[idx].blob_size = (uint32_t)len;
+    s_index[idx].last_use = ++s_use_clock;
+    rebuild_hash_table();
+    for (int i = 0; i < ICON_LRU_SLOTS; ++i) {
+        if (s_lru[i].valid && s_lru[i].hash == hash) s_lru[i].stale = true;
+    }
+    bool ok = save_index();
+    xSemaphoreGive(s_lock);
+    return ok ? ESP_OK : ESP_FAIL;
+}
+
+static void upload_reset(void)
+{
+    heap_caps_free(s_up_buf);
+    s_up_buf = NULL;
+    s_up_total = 0;
+    s_up_pos = 0;
+    s_up_hash = 0;
+    s_up_app[0] = '\0';
+}
+
+esp_err_t app_icons_upload_chunk(const char* app_id, size_t total, size_t offset,
+                                 const uint8_t* data, size_t len, bool* done)
+{
+    if (done) *done = false;
+    if (!app_id_valid(app_id) || !data) return ESP_ERR_INVALID_ARG;
+    if (!s_ready && app_icons_init() != ESP_OK) return ESP_ERR_INVALID_STATE;
+    uint32_t hash = app_icons_hash(app_id);
+
+    if (offset == 0) {
+        upload_reset();
+        if (total < ICON_BLOB_HDR_LEN || total > APP_ICONS_MAX_BLOB) return ESP_ERR_INVALID_SIZE;
+        s_up_buf = heap_caps_malloc(total, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!s_up_buf) return ESP_ERR_NO_MEM;
+        s_up_total = total;
+        s_up_hash = hash;
+        snprintf(s_up_app, sizeof(s_up_app), "%s", app_id);
+    }
+    if (!s_up_buf || hash != s_up_hash || strcasecmp(app_id, s_up_app) != 0 || total != s_up_total || offset != s_up_pos ||
+        len > s_up_total - s_up_pos) {
+        ESP_LOGW(TAG, "Out-of-order icon chunk for %s (off=%u)", app_id, (unsigned)offset);
+        upload_reset();
+        return ESP_ERR_INVALID_STATE;
+    }
+    memcpy(s_up_buf + s_up_pos, data, len);
+    s_up_pos += len;
+    if (s_up_pos < s_up_total) return ESP_OK;
+
+    esp_err_t err = ESP_ERR_INVALID_RESPONSE;
+    if (decode_blob(s_up_buf, s_up_total, NULL, NULL, NULL)) {
+        err = store_blob(app_id, hash, s_up_buf, s_up_total);
+    } else {
+        ESP_LOGW(TAG, "Rejected malformed icon for %s", app_id);
+    }
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Stored icon for %s (%u bytes)", app_id, (unsigned)s_up_total);
+        if (done) *done = true;
+    }
+    upload_reset();
+    return err;
+}
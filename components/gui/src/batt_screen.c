@@ -5,6 +5,8 @@
 #include "settings_screen.h"
 #include "bsp/esp32_s3_touch_amoled_2_06.h"
 #include "esp_log.h"
+#include "pmu.h"
+#include "timer_svc.h"
 
 // Access UI primitives via ui.h accessors
 static const char* TAG = "BatteryScreen";
@@ -20,10 +22,11 @@ static lv_obj_t* row_vbat_val;
 static lv_obj_t* row_vbus_val;
 static lv_obj_t* row_vsys_val;
 static lv_obj_t* row_temp_val;
-static lv_timer_t* batt_timer;
+static timer_svc_id_t batt_timer = -1;
 
 static void batt_screen_events(lv_event_t* e);
-static void batt_update_cb(lv_timer_t* t);
+static void batt_update_cb(void* arg);
+static void batt_timer_stop(void);
 static void batt_update_values(void);
 static lv_obj_t* make_chip(lv_obj_t* parent, const char* txt);
 static lv_obj_t* make_row(lv_obj_t* parent, const char* label_txt, lv_obj_t** out_val);
@@ -102,8 +105,15 @@ void lv_smartwatch_batt_create(lv_obj_t* screen)
     (void)make_row(status, "Temp", &row_temp_val);
 
     // Periodic refresh
-    batt_timer = lv_timer_create(batt_update_cb, 5000, NULL);
-    //lv_timer_ready(batt_timer);
+    const timer_svc_config_t cfg = {
+        .name = "batt_screen",
+        .period_ms = 5000,
+        .slack_ms = 1000,
+        .screen = true,
+        .cb = batt_update_cb,
+    };
+    batt_timer_stop();
+    (void)timer_svc_add(&cfg, &batt_timer);
     batt_update_values();
 
     lv_obj_add_event_cb(batt_screen, batt_screen_events, LV_EVENT_ALL, NULL);
@@ -115,7 +125,7 @@ static void on_delete(lv_event_t* e)
 {
     (void)e;
     ESP_LOGI(TAG, "Battery screen deleted");
-    if (batt_timer) { lv_timer_del(batt_timer); batt_timer = NULL; }
+    batt_timer_stop();
     batt_screen = NULL;
 }
 
@@ -146,26 +156,43 @@ static void batt_screen_events(lv_event_t* e)
             lv_indev_wait_release(lv_indev_active());
             // Return to controls tile and remove dynamic tile
             ui_dynamic_tile_close();
-            if (batt_timer) { lv_timer_del(batt_timer); batt_timer = NULL; }
+            batt_timer_stop();
             batt_screen = NULL;
             //lv_obj_del_async(batt_screen);
         } 
     }
 }
 
-static void batt_update_cb(lv_timer_t* t)
+static void batt_timer_stop(void)
 {
-    (void)t;
-    if (active_screen_get() == batt_screen) {
-        bsp_display_lock(0);
+    if (batt_timer >= 0) {
+        (void)timer_svc_remove(batt_timer);
+        batt_timer = -1;
+    }
+}
+
+// Runs in the timer service task; the page may have closed meanwhile
+static void batt_update_cb(void* arg)
+{
+    (void)arg;
+    bsp_display_lock(0);
+    bool open = batt_screen && active_screen_get() == batt_screen;
+    if (open) {
         batt_update_values();
-        bsp_display_unlock();
+    }
+    bsp_display_unlock();
+    if (open) {
+        // Live voltages while the page is open; read by the next tick
+        pmu_refresh();
     }
 }
 
 static void batt_update_values(void)
 {
-    int pct = bsp_power_get_battery_percent();
+    // One snapshot, so the page agrees with itself and the watchface
+    pmu_snapshot_t p;
+    (void)pmu_get(&p);
+    int pct = p.battery_percent;
     if (pct < 0) pct = 0;
     if (pct > 100) pct = 100;
     lv_bar_set_value(batt_bar, pct, LV_ANIM_ON);
@@ -173,12 +200,12 @@ static void batt_update_values(void)
     snprintf(txt, sizeof(txt), "%d%%", pct);
     lv_label_set_text(batt_percent_label, txt);
 
-    int vbat = bsp_power_get_batt_voltage_mv();
-    int vbus = bsp_power_get_vbus_voltage_mv();
-    int vsys = bsp_power_get_system_voltage_mv();
-    float temp = bsp_power_get_temperature_c();
-    bool chg = bsp_power_is_charging();
-    bool vbus_in = bsp_power_is_vbus_in();
+    int vbat = p.batt_mv;
+    int vbus = p.vbus_mv;
+    int vsys = p.sys_mv;
+    float temp = p.temp_c;
+    bool chg = p.charging;
+    bool vbus_in = p.vbus_in;
 
     // Chips: Source + Charging
     char buf[48];
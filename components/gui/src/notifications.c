@@ -1,4 +1,5 @@
 #include "notifications.h"
+#include "app_icons.h"
 #include "ui_fonts.h"
 #include <string.h>
 #include <strings.h>
@@ -11,7 +12,7 @@
 #include "watchface.h"
 
 // Keep the last N notifications and allow swipe left/right
-#define MAX_NOTIFICATIONS 5
+#define MAX_NOTIFICATIONS NOTIFICATIONS_MAX
 
 LV_IMAGE_DECLARE(image_notification_48);
 LV_IMAGE_DECLARE(image_sms_48);
@@ -27,12 +28,7 @@ LV_IMAGE_DECLARE(image_instagram_48);
 LV_IMAGE_DECLARE(image_tiktok_48);
 LV_IMAGE_DECLARE(image_x_48);
 
-typedef struct NotificationItem {
-    char app[32];
-    char title[64];
-    char message[256];
-    char ts_iso[40];
-} NotificationItem;
+typedef notifications_item_t NotificationItem;
 
 // Data buffer
 static NotificationItem notif_buf[MAX_NOTIFICATIONS];
@@ -112,24 +108,53 @@ static const AppMeta k_known_apps[] = {
     { "com.twitter.android",                "X (Twitter)",  &image_x_48 },
 };
 
+#define KNOWN_APP_COUNT (sizeof(k_known_apps)/sizeof(k_known_apps[0]))
+static uint32_t k_known_hash[KNOWN_APP_COUNT];
+static bool k_known_hash_ready;
+
+static const AppMeta* find_known_app(const char* app_id, uint32_t hash)
+{
+    if (!k_known_hash_ready) {
+        for (size_t i = 0; i < KNOWN_APP_COUNT; ++i) {
+            k_known_hash[i] = app_icons_hash(k_known_apps[i].id);
+        }
+        k_known_hash_ready = true;
+    }
+    for (size_t i = 0; i < KNOWN_APP_COUNT; ++i) {
+        if (k_known_hash[i] == hash && strcasecmp(app_id, k_known_apps[i].id) == 0) {
+            return &k_known_apps[i];
+        }
+    }
+    return NULL;
+}
+
 static const AppMeta* get_app_meta(const char* app_id)
 {
     static AppMeta dyn; // for unknown apps
     if (app_id && *app_id) {
-        for (size_t i = 0; i < sizeof(k_known_apps)/sizeof(k_known_apps[0]); ++i) {
-            if (strcasecmp(app_id, k_known_apps[i].id) == 0) {
-                return &k_known_apps[i];
-            }
+        uint32_t hash = app_icons_hash(app_id);
+        const AppMeta* known = find_known_app(app_id, hash);
+        if (known) {
+            return known;
         }
+        // Icons pushed by the phone for apps we don't ship artwork for
+        const lv_image_dsc_t* pushed = app_icons_get(app_id);
         dyn.id = app_id;
         dyn.friendly = app_id;
-        dyn.icon = &image_notification_48;
+        dyn.icon = pushed ? pushed : &image_notification_48;
         return &dyn;
     }
     static const AppMeta unknown = { "", "Notifications", &image_notification_48 };
     return &unknown;
 }
 
+bool notifications_app_has_icon(const char* app_id)
+{
+    if (!app_id || !*app_id) return true;
+    uint32_t hash = app_icons_hash(app_id);
+    return find_known_app(app_id, hash) != NULL || app_icons_has(app_id);
+}
+
 static void update_card_content(int idx)
 {
     if (idx < 0 || idx >= notif_count) {
@@ -505,6 +530,12 @@ void notifications_screen_create(lv_obj_t* parent)
     lv_obj_add_flag(pager_cont, LV_OBJ_FLAG_HIDDEN);
 
     lv_obj_add_event_cb(notification_screen, gesture_event_cb, LV_EVENT_ALL, NULL);
+
+    // Items imported before the screen existed (standby resume)
+    if (notif_count > 0) {
+        update_card_content(active_idx);
+        update_pager(active_idx);
+    }
 }
 
 lv_obj_t* notifications_screen_get(void)
@@ -569,3 +600,29 @@ void notifications_show(const char* app,
         lv_anim_start(&a2);
     }*/
 }
+
+int notifications_export(notifications_item_t* out, int max)
+{
+    int n = notif_count < max ? notif_count : max;
+    memcpy(out, notif_buf, (size_t)n * sizeof(notif_buf[0]));
+    return n;
+}
+
+void notifications_import(const notifications_item_t* items, int n)
+{
+    if (n > MAX_NOTIFICATIONS) n = MAX_NOTIFICATIONS;
+    if (n < 0) n = 0;
+    memcpy(notif_buf, items, (size_t)n * sizeof(notif_buf[0]));
+    for (int i = 0; i < n; ++i) {
+        notif_buf[i].app[sizeof(notif_buf[i].app) - 1] = '\0';
+        notif_buf[i].title[sizeof(notif_buf[i].title) - 1] = '\0';
+        notif_buf[i].message[sizeof(notif_buf[i].message) - 1] = '\0';
+        notif_buf[i].ts_iso[sizeof(notif_buf[i].ts_iso) - 1] = '\0';
+    }
+    notif_count = n;
+    active_idx = 0;
+    if (notification_screen) {
+        update_card_content(active_idx);
+        update_pager(active_idx);
+    }
+}
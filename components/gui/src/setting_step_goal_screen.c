@@ -4,6 +4,7 @@
 #include "settings.h"
 #include "esp_log.h"
 #include "settings_menu_screen.h"
+#include "steps_screen.h"
 
 static lv_obj_t* sstepgoal_screen;
 static lv_obj_t* sstepgoal_value;
@@ -26,6 +27,7 @@ static void upd(void)
     char buf[16];
     snprintf(buf, sizeof(buf), "%u", (unsigned)settings_get_step_goal());
     lv_label_set_text(sstepgoal_value, buf);
+    steps_screen_set_goal(settings_get_step_goal());
 }
 
 static void minus(lv_event_t* e){ (void)e; uint32_t g=settings_get_step_goal(); g = (g>1000)? g-1000:1000; settings_set_step_goal(g); upd(); }
@@ -128,6 +128,17 @@ static void minute_plus(lv_event_t* e)
     update_time_display();
 }
 
+// Keep the date one the RTC accepts: the year in its range, the day
+// within the month (a step back from the 1st lands on the last day)
+static void set_date(struct tm* time)
+{
+    if (time->tm_year < RTC_TM_YEAR_MIN) time->tm_year = RTC_TM_YEAR_MIN;
+    if (time->tm_year > RTC_TM_YEAR_MAX) time->tm_year = RTC_TM_YEAR_MAX;
+    int days = rtc_days_in_month(time->tm_year, time->tm_mon);
+    if (time->tm_mday > days) time->tm_mday = days;
+    rtc_set_time(time);
+}
+
 static void year_minus(lv_event_t* e)
 {
     (void)e;
@@ -136,7 +147,7 @@ static void year_minus(lv_event_t* e)
     if (time.tm_year > 0) {
         time.tm_year--;
     }
-    rtc_set_time(&time);
+    set_date(&time);
       
     update_date_display();
 }
@@ -149,7 +160,7 @@ static void year_plus(lv_event_t* e)
     if (time.tm_year < 200) {
         time.tm_year++;
     }
-    rtc_set_time(&time);
+    set_date(&time);
       
     update_date_display();
 }
@@ -165,7 +176,7 @@ static void month_minus(lv_event_t* e)
         time.tm_mon = 11;
         if (time.tm_year > 0) time.tm_year--;
     }
-    rtc_set_time(&time);
+    set_date(&time);
       
     update_date_display();
 }
@@ -181,7 +192,7 @@ static void month_plus(lv_event_t* e)
         time.tm_mon = 0;
         if (time.tm_year < 200) time.tm_year++;
     }
-    rtc_set_time(&time);
+    set_date(&time);
       
     update_date_display();
 }
@@ -202,7 +213,7 @@ static void day_minus(lv_event_t* e)
         }
         time.tm_mday = 31;
     }
-    rtc_set_time(&time);
+    set_date(&time);
       
     update_date_display();
 }
@@ -212,7 +223,7 @@ static void day_plus(lv_event_t* e)
     (void)e;
     struct tm time;
     if (rtc_get_time(&time) != ESP_OK) return;
-    if (time.tm_mday < 28) {
+    if (time.tm_mday < rtc_days_in_month(time.tm_year, time.tm_mon)) {
         time.tm_mday++;
     } else {
         if (time.tm_mon < 11) {
@@ -223,7 +234,7 @@ static void day_plus(lv_event_t* e)
         }
         time.tm_mday = 1;
     }
-    rtc_set_time(&time);
+    set_date(&time);
       
     update_date_display();
 }
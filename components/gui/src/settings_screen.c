@@ -13,6 +13,7 @@
 #include "ui.h"
 #include "watchface.h"
 #include "bsp/esp32_s3_touch_amoled_2_06.h"
+#include "timer_svc.h"
 
 static const char* TAG = "SETTINGS SCREEN";
 
@@ -28,13 +29,13 @@ LV_IMAGE_DECLARE(image_settings_icon);
 
 static void click_event_cb(lv_event_t* e);
 static void toggle_event_cb(lv_event_t* e);
-static void time_timer_cb(lv_timer_t* timer);
+static void time_timer_cb(void* arg);
 static void update_time_label(void);
 static void control_screen_on_delete(lv_event_t* e);
 
 static lv_obj_t* control_screen;
 static lv_obj_t* time_label;
-static lv_timer_t* time_timer;
+static timer_svc_id_t time_timer = -1;
 
 static const lv_image_dsc_t* control_icons[] = {
     &image_brightness_icon,
@@ -68,12 +69,16 @@ static void update_time_label(void)
     if (!time_label) {
         return;
     }
-    lv_label_set_text_fmt(time_label, "%02d:%02d", rtc_get_hour(), rtc_get_minute());
+    struct tm now;
+    if (rtc_get_time(&now) != ESP_OK) {
+        return;
+    }
+    lv_label_set_text_fmt(time_label, "%02d:%02d", now.tm_hour, now.tm_min);
 }
 
-static void time_timer_cb(lv_timer_t* timer)
+static void time_timer_cb(void* arg)
 {
-    (void)timer;
+    (void)arg;
     bool locked = bsp_display_lock(0);
     update_time_label();
     if (locked) {
@@ -84,9 +89,9 @@ static void time_timer_cb(lv_timer_t* timer)
 static void control_screen_on_delete(lv_event_t* e)
 {
     (void)e;
-    if (time_timer) {
-        lv_timer_del(time_timer);
-        time_timer = NULL;
+    if (time_timer >= 0) {
+        (void)timer_svc_remove(time_timer);
+        time_timer = -1;
     }
     time_label = NULL;
     control_screen = NULL;
@@ -105,9 +110,6 @@ static void screen_events(lv_event_t* e)
     }
     else if (lv_event_get_code(e) == LV_EVENT_SCREEN_LOADED) {
         update_time_label();
-        if (time_timer) {
-            lv_timer_ready(time_timer);
-        }
     }
 }
 
@@ -224,9 +226,16 @@ void control_screen_create(lv_obj_t* parent)
     }
 
     update_time_label();
-    if (!time_timer) {
-        time_timer = lv_timer_create(time_timer_cb, 1000, NULL);
-        lv_timer_ready(time_timer);
+    if (time_timer < 0) {
+        // Hours and minutes only; runs with the watchface's ticks
+        const timer_svc_config_t cfg = {
+            .name = "control_time",
+            .period_ms = 1000,
+            .slack_ms = 500,
+            .screen = true,
+            .cb = time_timer_cb,
+        };
+        (void)timer_svc_add(&cfg, &time_timer);
     }
 }
 
@@ -0,0 +1,262 @@
+#include "standby.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "sdkconfig.h"
+#include "alarm_sched.h"
+#include "ble_sync.h"
+#include "bsp/esp-bsp.h"
+#include "display_manager.h"
+#include "driver/gpio.h"
+#include "driver/rtc_io.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "notifications.h"
+#include "pmu.h"
+#include "sensors.h"
+#include "settings.h"
+#include "ui.h"
+
+#define STANDBY_KEY_GPIO 0     // BOOT, the back button in ui.c
+#define STANDBY_IMU_GPIO 21    // QMI8658 INT1
+#define STANDBY_RTC_GPIO CONFIG_BSP_EXTRA_RTC_INT_GPIO
+#define STANDBY_PMU_GPIO CONFIG_BSP_EXTRA_PMU_INT_GPIO
+#define STANDBY_POLL_MS 10000
+#define STANDBY_ALARM_GUARD_S 60  // stay up for an alarm this close
+#define STANDBY_REARM_MS 20000    // back to sleep after a wake nobody saw
+#define STANDBY_TASK_STACK 3072
+
+static const char *TAG = "STANDBY";
+
+// Kept in RTC slow memory across deep sleep; cleared on any other reset
+typedef struct {
+    bool valid;
+    uint32_t settings_hash;
+    time_t entered;
+    uint32_t steps;
+    uint32_t hw_steps;
+    uint64_t wake_mask;
+    uint8_t tile;
+    uint8_t notif_count;
+    notifications_item_t notif[NOTIFICATIONS_MAX];
+} standby_state_t;
+
+static RTC_DATA_ATTR standby_state_t s_saved;
+static standby_wake_t s_wake = STANDBY_WAKE_NONE;
+static bool s_dark_wake = false;
+
+standby_wake_t standby_resume_begin(void)
+{
+    bool valid = s_saved.valid;
+    s_saved.valid = false;
+    if (!valid || esp_reset_reason() != ESP_RST_DEEPSLEEP) {
+        return s_wake = STANDBY_WAKE_NONE;
+    }
+    uint64_t pins = 0;
+    switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_EXT1:
+        pins = esp_sleep_get_ext1_wakeup_status();
+        break;
+    case ESP_SLEEP_WAKEUP_TIMER:
+        s_wake = STANDBY_WAKE_ALARM;
+        break;
+    default:
+        s_wake = STANDBY_WAKE_KEY;
+        break;
+    }
+    if (pins) {
+        // Several lines may be low; the user pressing a key wins
+        if (pins & ~((1ULL << STANDBY_IMU_GPIO) |
+                     (STANDBY_RTC_GPIO >= 0 ? 1ULL << STANDBY_RTC_GPIO : 0))) {
+            s_wake = STANDBY_WAKE_KEY;
+        } else if (STANDBY_RTC_GPIO >= 0 && (pins & (1ULL << STANDBY_RTC_GPIO))) {
+            s_wake = STANDBY_WAKE_ALARM;
+        } else {
+            s_wake = STANDBY_WAKE_IMU;
+        }
+    }
+    // Hand the pins back to the GPIO matrix for their drivers
+    for (int i = 0; i < 64; ++i) {
+        if (s_saved.wake_mask & (1ULL << i)) {
+            (void)rtc_gpio_deinit((gpio_num_t)i);
+        }
+    }
+    sensors_standby_resume(s_saved.steps, s_saved.hw_steps, s_saved.entered);
+    ESP_LOGI(TAG, "Resuming from standby (wake %d, %lld s)", (int)s_wake,
+             (long long)(time(NULL) - s_saved.entered));
+    return s_wake;
+}
+
+standby_wake_t standby_wake_reason(void)
+{
+    return s_wake;
+}
+
+bool standby_wake_is_visual(void)
+{
+    switch (s_wake) {
+    case STANDBY_WAKE_IMU:
+        return sensors_standby_tap_woke();
+    case STANDBY_WAKE_ALARM:
+        // The alarm's own notification turns the screen on
+        return false;
+    default:
+        return true;
+    }
+}
+
+void standby_resume_finish(void)
+{
+    if (s_wake == STANDBY_WAKE_NONE) {
+        return;
+    }
+    s_dark_wake = !standby_wake_is_visual();
+    // The saved screen belongs to the configuration it was taken with
+    if (settings_hash() != s_saved.settings_hash) {
+        ESP_LOGW(TAG, "Settings differ from standby entry, not restoring the UI");
+        return;
+    }
+    bsp_display_lock(0);
+    notifications_import(s_saved.notif, s_saved.notif_count);
+    ui_set_active_tile((ui_tile_t)s_saved.tile);
+    bsp_display_unlock();
+}
+
+#if CONFIG_STANDBY_ENABLE
+
+// Add an RTC-capable pin to the ext1 mask. False if it is low already, which
+// would wake the SoC straight away.
+static bool wake_pin_add(int gpio, uint64_t *mask)
+{
+    if (gpio < 0 || !rtc_gpio_is_valid_gpio((gpio_num_t)gpio)) {
+        return true; // cannot wake from deep sleep on this pin
+    }
+    if (gpio_get_level((gpio_num_t)gpio) == 0) {
+        return false;
+    }
+    (void)rtc_gpio_pullup_en((gpio_num_t)gpio);
+    (void)rtc_gpio_pulldown_dis((gpio_num_t)gpio);
+    *mask |= 1ULL << gpio;
+    return true;
+}
+
+static bool standby_allowed(void)
+{
+    // Sleep tracking wins over standby (CONFIG_STANDBY_NIGHT); say so once
+    // per night rather than staying up without a word
+    static bool s_sleep_logged;
+    if (sensors_sleep_active()) {
+        if (!s_sleep_logged) {
+            ESP_LOGI(TAG, "Sleep tracking, no standby until it ends");
+            s_sleep_logged = true;
+        }
+        return false;
+    }
+    s_sleep_logged = false;
+
+    pmu_snapshot_t p;
+    (void)pmu_get(&p);
+    if (ble_sync_is_connected() || sensors_trace_active() || p.vbus_in) {
+        return false;
+    }
+    time_t next = alarm_sched_next();
+    return next == 0 || next - time(NULL) > STANDBY_ALARM_GUARD_S;
+}
+
+// Returns only if standby was called off
+static esp_err_t standby_enter(void)
+{
+    uint32_t steps = 0, hw_steps = 0;
+    esp_err_t err = sensors_standby_enter(&steps, &hw_steps);
+    if (err != ESP_OK) {
+        return err;
+    }
+    s_saved.steps = steps;
+    s_saved.hw_steps = hw_steps;
+    s_saved.entered = time(NULL);
+
+    bsp_display_lock(0);
+    s_saved.tile = (uint8_t)ui_get_active_tile();
+    s_saved.notif_count = (uint8_t)notifications_export(s_saved.notif, NOTIFICATIONS_MAX);
+    bsp_display_unlock();
+    (void)settings_save();
+    s_saved.settings_hash = settings_hash();
+
+    // A PMU interrupt not yet cleared by its task holds the line low and
+    // calls standby off until the next round
+    uint64_t mask = 0;
+    bool idle = wake_pin_add(STANDBY_KEY_GPIO, &mask) &&
+                wake_pin_add(STANDBY_IMU_GPIO, &mask) &&
+                wake_pin_add(STANDBY_RTC_GPIO, &mask) &&
+                wake_pin_add(STANDBY_PMU_GPIO, &mask);
+    if (!idle) {
+        sensors_standby_cancel();
+        return ESP_ERR_INVALID_STATE;
+    }
+    // The RTC domain keeps the pull-ups on while the SoC sleeps
+    (void)esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_PERIPH, ESP_PD_OPTION_ON);
+    (void)esp_sleep_enable_ext1_wakeup(mask, ESP_EXT1_WAKEUP_ANY_LOW);
+    if (STANDBY_RTC_GPIO >= 0 && (mask & (1ULL << STANDBY_RTC_GPIO))) {
+        // Housekeeping events wait for the next wake instead
+        alarm_sched_standby_prepare();
+    } else {
+        // The RTC alarm cannot wake the SoC; the timer has to
+        time_t next = alarm_sched_next();
+        if (next > s_saved.entered) {
+            (void)esp_sleep_enable_timer_wakeup((uint64_t)(next - s_saved.entered) * 1000000ULL);
+        }
+    }
+    s_saved.wake_mask = mask;
+    s_saved.valid = true;
+    ESP_LOGI(TAG, "Entering standby: %lu steps, %u notifications",
+             (unsigned long)steps, s_saved.notif_count);
+    esp_deep_sleep_start();
+    return ESP_OK;
+}
+
+static void standby_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(STANDBY_POLL_MS));
+        uint32_t off_ms = display_manager_off_ms();
+        if (off_ms == 0) {
+            s_dark_wake = false; // someone looked; wait the full idle time
+            continue;
+        }
+        uint32_t idle_ms = s_dark_wake ? STANDBY_REARM_MS
+                                       : CONFIG_STANDBY_IDLE_MIN * 60u * 1000u;
+        if (off_ms < idle_ms || !standby_allowed()) {
+            continue;
+        }
+        esp_err_t err = standby_enter();
+        if (err == ESP_ERR_NOT_SUPPORTED) {
+            ESP_LOGW(TAG, "Standby needs the on-chip pedometer, disabled");
+            break;
+        }
+        ESP_LOGW(TAG, "Standby called off: %s", esp_err_to_name(err));
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t standby_init(void)
+{
+    if (xTaskCreate(standby_task, "standby", STANDBY_TASK_STACK, NULL, 2, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+#else
+
+esp_err_t standby_init(void)
+{
+    return ESP_OK;
+}
+
+#endif // CONFIG_STANDBY_ENABLE
@@ -1,6 +1,7 @@
 #include "lvgl.h"
 #include "steps_screen.h"
 #include "sensors.h"
+#include "step_store.h"
 #include "ui_fonts.h"
 #include "settings.h"
 
@@ -15,56 +16,108 @@ static lv_obj_t* s_activity_label = NULL;
 static lv_obj_t* s_bar = NULL;
 static lv_obj_t* s_ticks[4] = { 0 };
 
+static lv_obj_t* s_chart = NULL;
+static lv_chart_series_t* s_chart_ser = NULL;
+static lv_obj_t* s_chart_label = NULL;
+static bool s_chart_week = false;   // false: today by hour, true: last 7 days
+static uint32_t s_chart_ms = 0;     // sensor time of the last chart redraw
+
 static lv_obj_t* s_icon_left = NULL;
 //static lv_obj_t* s_icon_right = NULL;
-static lv_timer_t* s_timer = NULL;
 static uint32_t s_goal_steps = 8000;
 
+// Latest values from the sensor events
+static volatile uint32_t s_steps = 0;
+static volatile sensors_activity_t s_activity = SENSORS_ACTIVITY_IDLE;
+
 LV_IMAGE_DECLARE(image_walk_48);
 
 static void screen_events(lv_event_t* e);
 
-static void steps_timer_cb(lv_timer_t* t)
+// History chart from the step store: 24 hourly bars or 7 daily bars
+static void refresh_chart(void)
 {
-    LV_UNUSED(t);
-    bsp_display_lock(0);
-    //if (active_screen_get() == step_screen) {
-        //if (!s_value_label) return;
-        // Refresh goal from settings if changed
-        uint32_t new_goal = settings_get_step_goal();
-        if (new_goal != s_goal_steps) {
-            s_goal_steps = new_goal ? new_goal : 1;
-            if (s_goal_label) {
-                char gbuf2[32];
-                lv_snprintf(gbuf2, sizeof(gbuf2), "Goal %u", (unsigned)s_goal_steps);
-                lv_label_set_text(s_goal_label, gbuf2);
-            }
-        }
-        uint32_t steps = sensors_get_step_count();
-        char buf[32];
-        lv_snprintf(buf, sizeof(buf), "%u", (unsigned)steps);
-        lv_label_set_text(s_value_label, buf);
-
-        // Update progress and percent
-        uint32_t goal = s_goal_steps ? s_goal_steps : 1;
-        uint32_t pct = (steps >= goal) ? 100 : (steps * 100u) / goal;
-        if (s_bar) lv_bar_set_value(s_bar, (int32_t)pct, LV_ANIM_OFF);
-
-        // Update activity type label
-        if (s_activity_label) {
-            sensors_activity_t act = sensors_get_activity();
-            const char* text = "Idle";
-            switch (act) {
-            case SENSORS_ACTIVITY_WALK: text = "Walk"; break;
-            case SENSORS_ACTIVITY_RUN:  text = "Run";  break;
-            case SENSORS_ACTIVITY_OTHER:text = "Active"; break;
-            case SENSORS_ACTIVITY_IDLE:
-            default: text = "Idle"; break;
-            }
-            lv_label_set_text(s_activity_label, text);
+    if (!s_chart || !s_chart_ser) return;
+    step_store_point_t pts[24];
+    uint32_t from, count;
+    time_t now = time(NULL);
+    if (s_chart_week) {
+        uint32_t today = step_store_unit(STEP_STORE_DAY, now);
+        from = today - 6;
+        count = 7;
+    } else {
+        uint32_t hour = step_store_unit(STEP_STORE_HOUR, now);
+        from = hour - hour % 24;
+        count = 24;
+    }
+    int n = step_store_query(s_chart_week ? STEP_STORE_DAY : STEP_STORE_HOUR,
+        from, from + count, pts, (int)count);
+
+    lv_chart_set_point_count(s_chart, count);
+    lv_chart_set_all_values(s_chart, s_chart_ser, 0);
+    uint32_t max = 100;
+    for (int i = 0; i < n; ++i) {
+        lv_chart_set_value_by_id(s_chart, s_chart_ser, pts[i].t - from, (int32_t)pts[i].steps);
+        if (pts[i].steps > max) max = pts[i].steps;
+    }
+    lv_chart_set_axis_range(s_chart, LV_CHART_AXIS_PRIMARY_Y, 0, (int32_t)max);
+    lv_chart_refresh(s_chart);
+    if (s_chart_label) lv_label_set_text(s_chart_label, s_chart_week ? "Last 7 days" : "Today");
+}
+
+static void chart_clicked(lv_event_t* e)
+{
+    LV_UNUSED(e);
+    s_chart_week = !s_chart_week;
+    refresh_chart();
+}
+
+static void update_labels(void)
+{
+    uint32_t steps = s_steps;
+    char buf[32];
+    lv_snprintf(buf, sizeof(buf), "%u", (unsigned)steps);
+    lv_label_set_text(s_value_label, buf);
+
+    // Update progress and percent
+    uint32_t goal = s_goal_steps ? s_goal_steps : 1;
+    uint32_t pct = (steps >= goal) ? 100 : (steps * 100u) / goal;
+    if (s_bar) lv_bar_set_value(s_bar, (int32_t)pct, LV_ANIM_OFF);
+
+    // Update activity type label
+    if (s_activity_label) {
+        const char* text = "Idle";
+        switch (s_activity) {
+        case SENSORS_ACTIVITY_WALK: text = "Walk"; break;
+        case SENSORS_ACTIVITY_RUN:  text = "Run";  break;
+        case SENSORS_ACTIVITY_OTHER:text = "Active"; break;
+        case SENSORS_ACTIVITY_CYCLE:text = "Cycle"; break;
+        case SENSORS_ACTIVITY_IDLE:
+        default: text = "Idle"; break;
         }
-    //}
+        lv_label_set_text(s_activity_label, text);
+    }
+}
 
+// Runs in sensors_task, at most once a second per event type. If the UI
+// holds the display lock for long, the labels catch up on the next event.
+static void sensor_event_cb(const sensors_event_t* evt, void* arg)
+{
+    LV_UNUSED(arg);
+    bool reset = false;
+    if (evt->type == SENSORS_EVENT_STEPS) {
+        s_steps = evt->steps.total;
+        reset = evt->steps.total == 0; // midnight
+    } else {
+        s_activity = evt->activity;
+    }
+    if (!bsp_display_lock(50)) return;
+    update_labels();
+    // History changes slowly; redraw it about once a minute
+    if (reset || evt->time_ms - s_chart_ms >= 60000) {
+        s_chart_ms = evt->time_ms;
+        refresh_chart();
+    }
     bsp_display_unlock();
 }
 
@@ -111,7 +164,7 @@ void steps_screen_create(lv_obj_t* parent)
     lv_obj_set_style_text_font(s_value_label, &font_numbers_80, 0);
     lv_label_set_text(s_value_label, "0");
     lv_obj_set_align(s_value_label, LV_ALIGN_CENTER);
-    lv_obj_set_y(s_value_label, -20);
+    lv_obj_set_y(s_value_label, -110);
 
     // Goal text under value
     s_goal_label = lv_label_create(step_screen);
@@ -129,6 +182,28 @@ void steps_screen_create(lv_obj_t* parent)
     lv_obj_set_style_text_font(s_activity_label, &font_normal_32, 0);
     lv_obj_align_to(s_activity_label, s_goal_label, LV_ALIGN_OUT_BOTTOM_MID, 0, 6);
 
+    // Step history chart; tap to switch between today and the last week
+    s_chart = lv_chart_create(step_screen);
+    lv_obj_set_size(s_chart, 300, 100);
+    lv_obj_set_align(s_chart, LV_ALIGN_BOTTOM_MID);
+    lv_obj_set_y(s_chart, -100);
+    lv_chart_set_type(s_chart, LV_CHART_TYPE_BAR);
+    lv_chart_set_div_line_count(s_chart, 0, 0);
+    lv_obj_set_style_bg_opa(s_chart, LV_OPA_TRANSP, LV_PART_MAIN);
+    lv_obj_set_style_border_width(s_chart, 0, LV_PART_MAIN);
+    lv_obj_set_style_pad_all(s_chart, 0, LV_PART_MAIN);
+    lv_obj_set_style_pad_column(s_chart, 2, LV_PART_MAIN);
+    lv_obj_set_style_radius(s_chart, 2, LV_PART_ITEMS);
+    s_chart_ser = lv_chart_add_series(s_chart, lv_color_hex(0x3B82F6), LV_CHART_AXIS_PRIMARY_Y);
+    lv_obj_add_flag(s_chart, LV_OBJ_FLAG_CLICKABLE);
+    lv_obj_add_event_cb(s_chart, chart_clicked, LV_EVENT_CLICKED, NULL);
+
+    s_chart_label = lv_label_create(step_screen);
+    lv_label_set_text(s_chart_label, "Today");
+    lv_obj_set_style_text_color(s_chart_label, lv_color_hex(0x909090), 0);
+    lv_obj_set_style_text_font(s_chart_label, &font_normal_26, 0);
+    lv_obj_align_to(s_chart_label, s_chart, LV_ALIGN_OUT_TOP_LEFT, 0, -4);
+
     // Horizontal progress bar near bottom
     s_bar = lv_bar_create(step_screen);
     lv_obj_set_size(s_bar, 270, 14);
@@ -166,8 +241,13 @@ void steps_screen_create(lv_obj_t* parent)
         lv_obj_align_to(s_ticks[i], s_bar, LV_ALIGN_LEFT_MID, x, 0);
     }
 
-    s_timer = lv_timer_create(steps_timer_cb, 5000, NULL);
-    lv_timer_ready(s_timer);
+    // Current values now, then whatever the sensors publish
+    s_steps = sensors_get_step_count();
+    s_activity = sensors_get_activity();
+    update_labels();
+    refresh_chart();
+    sensors_subscribe(SENSORS_EVENT_STEPS | SENSORS_EVENT_ACTIVITY, 1000,
+        sensor_event_cb, NULL);
 
     //lv_obj_add_event_cb(step_screen, screen_events, LV_EVENT_GESTURE, NULL);
 }
@@ -200,6 +280,7 @@ void steps_screen_set_goal(uint32_t goal_steps)
     s_goal_steps = goal_steps ? goal_steps : 1;
     if (s_goal_label) {
         lv_label_set_text_fmt(s_goal_label, "Goal %u", (unsigned)s_goal_steps);
+        update_labels();
     }
 }
 
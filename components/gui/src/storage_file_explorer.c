@@ -10,6 +10,7 @@
 #include "setting_storage_screen.h"
 #include "lvgl_spiffs_fs.h"
 #include "bsp/esp32_s3_touch_amoled_2_06.h"
+#include "bsp_board_extra.h"
 #include "media_player.h"
 
 static lv_obj_t* s_screen;
@@ -235,18 +236,10 @@ static void create_explorer_2(lv_obj_t* parent)
     lv_obj_set_style_pad_gap(list, 6, 0);
     
     // Try to mount SD card if not already mounted
-    extern sdmmc_card_t *bsp_sdcard;
-    bool sdcard_mounted = (bsp_sdcard != NULL);
-    
+    esp_err_t ret = bsp_extra_sdcard_mount();
+    bool sdcard_mounted = (ret == ESP_OK);
     if (!sdcard_mounted) {
-        ESP_LOGI(TAG, "Attempting to mount SD card...");
-        esp_err_t ret = bsp_sdcard_mount();
-        if (ret == ESP_OK) {
-            sdcard_mounted = true;
-            ESP_LOGI(TAG, "SD card mounted successfully");
-        } else {
-            ESP_LOGW(TAG, "SD card mount failed: %s", esp_err_to_name(ret));
-        }
+        ESP_LOGW(TAG, "SD card mount failed: %s", esp_err_to_name(ret));
     }
     
     // Add SD card section
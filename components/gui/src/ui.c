@@ -9,8 +9,10 @@
 #include "freertos/task.h"
 #include "lvgl.h"
 #include "notifications.h"
+#include "pmu.h"
 #include "sensors.h"
 #include "settings_screen.h"
+#include "standby.h"
 #include "steps_screen.h"
 #include "ui_fonts.h"
 #include "watchface.h"
@@ -18,6 +20,8 @@
 #include "brightness_screen.h"
 #include "driver/gpio.h"
 #include "lvgl_spiffs_fs.h"
+#include "timer_svc.h"
+#include "ui_msg.h"
 
 static const char* TAG = "UI";
 
@@ -218,6 +222,23 @@ void ui_show_messages_tile(void) {
   }
 }
 
+ui_tile_t ui_get_active_tile(void) {
+  lv_obj_t* act = main_screen ? lv_tileview_get_tile_active(main_screen) : NULL;
+  if (act == tile1) return UI_TILE_MESSAGES;
+  if (act == tile4) return UI_TILE_CONTROLS;
+  return UI_TILE_WATCHFACE;
+}
+
+void ui_set_active_tile(ui_tile_t tile) {
+  if (!main_screen) return;
+  lv_obj_t* t = tile == UI_TILE_MESSAGES ? tile1
+              : tile == UI_TILE_CONTROLS ? tile4
+                                         : tile2;
+  if (lv_tileview_get_tile_active(main_screen) != t) {
+    lv_tileview_set_tile(main_screen, t, LV_ANIM_OFF);
+  }
+}
+
 void ui_init(void) {
   ESP_LOGI(TAG, "ui_init: START");
   bsp_display_lock(0);
@@ -233,11 +254,11 @@ void ui_init(void) {
 
   ESP_LOGI(TAG, "ui_init: setting power state");
   {
-    bool vbus = bsp_power_is_vbus_in();
-    bool chg = bsp_power_is_charging();
-    int pct = bsp_power_get_battery_percent();
-    watchface_set_power_state(vbus, chg, pct);
+    pmu_snapshot_t p;
+    (void)pmu_get(&p);
+    watchface_set_power_state(p.vbus_in, p.charging, p.battery_percent);
   }
+  ui_msg_start();
 
   bsp_display_unlock();
   ESP_LOGI(TAG, "ui_init: COMPLETE");
@@ -245,9 +266,7 @@ void ui_init(void) {
 
 #define UI_BACK_BTN GPIO_NUM_0
 
-static void ui_handle_back_async(void* user) {
-  (void)user;
-
+void ui_go_back(void) {
   if (active_screen_get() != get_main_screen()) {
     load_screen(NULL, get_main_screen(), LV_SCR_LOAD_ANIM_OVER_TOP);
   }
@@ -265,8 +284,28 @@ static void ui_handle_back_async(void* user) {
   }
 }
 
-static void ui_back_btn_task(void* arg) {
+// BOOT key, polled every 20 ms while the screen is on; nothing to go
+// back from while it is off
+static int s_back_idle, s_back_prev;
+static TickType_t s_back_last_press;
+
+static void ui_back_btn_poll(void* arg) {
   (void)arg;
+  const TickType_t debounce = pdMS_TO_TICKS(120);
+  int lvl = gpio_get_level(UI_BACK_BTN);
+  if (s_back_prev != lvl) {
+    s_back_prev = lvl;
+    if (lvl != s_back_idle) {
+      TickType_t now = xTaskGetTickCount();
+      if (now - s_back_last_press > debounce) {
+        s_back_last_press = now;
+        (void)ui_msg_post_back();
+      }
+    }
+  }
+}
+
+static void ui_back_btn_init(void) {
   gpio_config_t io = {
       .pin_bit_mask = 1ULL << UI_BACK_BTN,
       .mode = GPIO_MODE_INPUT,
@@ -275,29 +314,22 @@ static void ui_back_btn_task(void* arg) {
       .intr_type = GPIO_INTR_DISABLE,
   };
   (void)gpio_config(&io);
-  int idle = gpio_get_level(UI_BACK_BTN);
-  int prev = idle;
-  TickType_t last_press = 0;
-  const TickType_t debounce = pdMS_TO_TICKS(120);
-  TickType_t last = xTaskGetTickCount();
-  for (;;) {
-    int lvl = gpio_get_level(UI_BACK_BTN);
-    if (prev != lvl) {
-      prev = lvl;
-      if (lvl != idle) {
-        TickType_t now = xTaskGetTickCount();
-        if (now - last_press > debounce) {
-          last_press = now;
-          lv_async_call(ui_handle_back_async, NULL);
-        }
-      }
-    }
-    if (display_manager_is_on()) {
-      if (bsp_power_poll_pwr_button_short()) {
-        lv_async_call(ui_handle_back_async, NULL);
-      }
-    }
-    vTaskDelayUntil(&last, pdMS_TO_TICKS(20));
+  s_back_idle = gpio_get_level(UI_BACK_BTN);
+  s_back_prev = s_back_idle;
+  const timer_svc_config_t cfg = {
+      .name = "ui_back_btn",
+      .period_ms = 20,
+      .slack_ms = 10,
+      .screen = true,
+      .cb = ui_back_btn_poll,
+  };
+  (void)timer_svc_add(&cfg, NULL);
+}
+
+// Power key presses the display manager did not use to wake the screen
+static void ui_power_key(pmu_key_t key) {
+  if (key == PMU_KEY_SHORT) {
+    (void)ui_msg_post_back();
   }
 }
 
@@ -306,13 +338,9 @@ static void power_ui_evt(void* handler_arg, esp_event_base_t base, int32_t id,
   (void)handler_arg;
   (void)base;
   (void)id;
-  bsp_power_event_payload_t* pl = (bsp_power_event_payload_t*)event_data;
-  if (pl) {
-    int pct = bsp_power_get_battery_percent();
-    bsp_display_lock(0);
-    watchface_set_power_state(pl->vbus_in, pl->charging, pct);
-    bsp_display_unlock();
-  }
+  const pmu_snapshot_t* p = (const pmu_snapshot_t*)event_data;
+  if (p)
+    ui_msg_post_power(p->vbus_in, p->charging, p->battery_percent);
 }
 
 static void ble_ui_evt(void* handler_arg, esp_event_base_t base, int32_t id,
@@ -320,20 +348,7 @@ static void ble_ui_evt(void* handler_arg, esp_event_base_t base, int32_t id,
   (void)handler_arg;
   (void)base;
   (void)event_data;
-  bool connected = (id == BLE_SYNC_EVT_CONNECTED);
-  bsp_display_lock(0);
-  watchface_set_ble_connected(connected);
-  bsp_display_unlock();
-}
-
-static void power_poll_cb(lv_timer_t* t) {
-  (void)t;
-  bool vbus = bsp_power_is_vbus_in();
-  bool chg = bsp_power_is_charging();
-  int pct = bsp_power_get_battery_percent();
-  bsp_display_lock(0);
-  watchface_set_power_state(vbus, chg, pct);
-  bsp_display_unlock();
+  ui_msg_post_ble(id == BLE_SYNC_EVT_CONNECTED);
 }
 
 void ui_task(void* pvParameters) {
@@ -341,18 +356,23 @@ void ui_task(void* pvParameters) {
 
   ui_init();
   display_manager_init();
+  // Back from standby: same notifications and tile, and the panel stays
+  // dark unless the wake was meant to look at the watch
+  standby_resume_finish();
+  if (!standby_wake_is_visual()) {
+    display_manager_turn_off();
+  }
+  (void)standby_init();
 
-  esp_event_handler_register(BSP_POWER_EVENT_BASE, ESP_EVENT_ANY_ID,
-    power_ui_evt, NULL);
+  // The PMU cache posts every change of percentage, VBUS or charging
+  esp_event_handler_register(PMU_EVENT_BASE, PMU_EVENT_CHANGED, power_ui_evt,
+    NULL);
   esp_event_handler_register(BLE_SYNC_EVENT_BASE, ESP_EVENT_ANY_ID, ble_ui_evt,
     NULL);
 
-  xTaskCreate(ui_back_btn_task, "ui_back_btn", 2048, NULL, 5, NULL);
+  display_manager_set_key_cb(ui_power_key);
+  ui_back_btn_init();
 
-  lv_timer_t* t = lv_timer_create(power_poll_cb, 5000, NULL);
-  lv_timer_ready(t);
-
-  while (1) {
-    vTaskDelay(pdMS_TO_TICKS(500));
-  }
+  // Everything from here on runs from events and the timer service
+  vTaskDelete(NULL);
 }
\ No newline at end of file
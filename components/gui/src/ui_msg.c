@@ -0,0 +1,209 @@
+#include "ui_msg.h"
+
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "lvgl.h"
+#include "notifications.h"
+#include "ui.h"
+#include "watchface.h"
+
+static const char *TAG = "UI_MSG";
+
+typedef struct {
+    uint8_t type;
+    int64_t posted_us;
+    notifications_item_t notify; // UI_MSG_NOTIFY only
+} ui_msg_t;
+
+// Latest battery and BLE state, waiting for the next frame
+typedef struct {
+    bool pending;
+    int64_t posted_us; // oldest post not yet applied
+    bool vbus_in;
+    bool charging;
+    int battery_percent;
+    bool ble_connected;
+} ui_msg_latest_t;
+
+static StaticQueue_t s_queue_buf;
+static uint8_t s_queue_storage[UI_MSG_QUEUE_LEN * sizeof(ui_msg_t)];
+static QueueHandle_t s_queue;
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static ui_msg_latest_t s_power, s_ble;
+static ui_msg_stats_t s_stats[UI_MSG_TYPE_COUNT];
+static ui_msg_t s_rx; // drained one at a time in the LVGL task
+
+// Called inside s_mux
+static void latest_mark(ui_msg_latest_t *l, ui_msg_type_t type)
+{
+    s_stats[type].posted++;
+    if (l->pending) {
+        s_stats[type].coalesced++;
+    } else {
+        l->pending = true;
+        l->posted_us = esp_timer_get_time();
+    }
+}
+
+static void handled(ui_msg_type_t type, int64_t posted_us)
+{
+    uint32_t us = (uint32_t)(esp_timer_get_time() - posted_us);
+    portENTER_CRITICAL(&s_mux);
+    s_stats[type].handled++;
+    s_stats[type].last_us = us;
+    if (us > s_stats[type].max_us) {
+        s_stats[type].max_us = us;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static bool enqueue(const ui_msg_t *msg)
+{
+    ui_msg_type_t type = (ui_msg_type_t)msg->type;
+    bool ok = s_queue && xQueueSend(s_queue, msg, 0) == pdTRUE;
+    portENTER_CRITICAL(&s_mux);
+    s_stats[type].posted++;
+    if (!ok) {
+        s_stats[type].dropped++;
+    }
+    portEXIT_CRITICAL(&s_mux);
+    if (!ok) {
+        ESP_LOGW(TAG, "Queue full, dropped message %d", (int)type);
+    }
+    return ok;
+}
+
+static void copy_field(char *dst, size_t size, const char *src)
+{
+    strncpy(dst, src ? src : "", size - 1);
+    dst[size - 1] = '\0';
+}
+
+void ui_msg_post_power(bool vbus_in, bool charging, int battery_percent)
+{
+    portENTER_CRITICAL(&s_mux);
+    latest_mark(&s_power, UI_MSG_POWER);
+    s_power.vbus_in = vbus_in;
+    s_power.charging = charging;
+    s_power.battery_percent = battery_percent;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+void ui_msg_post_ble(bool connected)
+{
+    portENTER_CRITICAL(&s_mux);
+    latest_mark(&s_ble, UI_MSG_BLE);
+    s_ble.ble_connected = connected;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+bool ui_msg_post_notification(const char *app, const char *title,
+                              const char *message, const char *timestamp)
+{
+    ui_msg_t msg = {
+        .type = UI_MSG_NOTIFY,
+        .posted_us = esp_timer_get_time(),
+    };
+    copy_field(msg.notify.app, sizeof(msg.notify.app), app);
+    copy_field(msg.notify.title, sizeof(msg.notify.title), title);
+    copy_field(msg.notify.message, sizeof(msg.notify.message), message);
+    copy_field(msg.notify.ts_iso, sizeof(msg.notify.ts_iso), timestamp);
+    return enqueue(&msg);
+}
+
+bool ui_msg_post_back(void)
+{
+    ui_msg_t msg = {
+        .type = UI_MSG_BACK,
+        .posted_us = esp_timer_get_time(),
+    };
+    return enqueue(&msg);
+}
+
+// LVGL task, display lock held
+static void ui_msg_drain(void)
+{
+    ui_msg_latest_t power, ble;
+    portENTER_CRITICAL(&s_mux);
+    power = s_power;
+    ble = s_ble;
+    s_power.pending = false;
+    s_ble.pending = false;
+    portEXIT_CRITICAL(&s_mux);
+
+    if (power.pending) {
+        watchface_set_power_state(power.vbus_in, power.charging, power.battery_percent);
+        handled(UI_MSG_POWER, power.posted_us);
+    }
+    if (ble.pending) {
+        watchface_set_ble_connected(ble.ble_connected);
+        handled(UI_MSG_BLE, ble.posted_us);
+    }
+    while (xQueueReceive(s_queue, &s_rx, 0) == pdTRUE) {
+        switch ((ui_msg_type_t)s_rx.type) {
+        case UI_MSG_NOTIFY:
+            ui_show_messages_tile();
+            notifications_show(s_rx.notify.app, s_rx.notify.title,
+                               s_rx.notify.message, s_rx.notify.ts_iso);
+            break;
+        case UI_MSG_BACK:
+            ui_go_back();
+            break;
+        default:
+            break;
+        }
+        handled((ui_msg_type_t)s_rx.type, s_rx.posted_us);
+    }
+}
+
+// Before layout and rendering of each frame
+static void ui_msg_refr_start_cb(lv_event_t *e)
+{
+    (void)e;
+    ui_msg_drain();
+}
+
+// LVGL pauses its refresh timer while nothing is invalid; this keeps posts
+// from waiting for the next redraw. It runs with the touch read timer, so it
+// adds no wakeups of its own.
+static void ui_msg_timer_cb(lv_timer_t *t)
+{
+    (void)t;
+    ui_msg_drain();
+}
+
+esp_err_t ui_msg_init(void)
+{
+    if (s_queue) {
+        return ESP_OK;
+    }
+    s_queue = xQueueCreateStatic(UI_MSG_QUEUE_LEN, sizeof(ui_msg_t),
+                                 s_queue_storage, &s_queue_buf);
+    return s_queue ? ESP_OK : ESP_FAIL;
+}
+
+void ui_msg_start(void)
+{
+    lv_display_t *disp = lv_display_get_default();
+    if (!disp || !s_queue) {
+        ESP_LOGE(TAG, "No display or queue, UI messages are not applied");
+        return;
+    }
+    lv_display_add_event_cb(disp, ui_msg_refr_start_cb, LV_EVENT_REFR_START, NULL);
+    (void)lv_timer_create(ui_msg_timer_cb, LV_DEF_REFR_PERIOD, NULL);
+}
+
+void ui_msg_get_stats(ui_msg_type_t type, ui_msg_stats_t *out)
+{
+    if (type >= UI_MSG_TYPE_COUNT) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    portENTER_CRITICAL(&s_mux);
+    *out = s_stats[type];
+    portEXIT_CRITICAL(&s_mux);
+}
@@ -15,6 +15,8 @@
 #include <strings.h>       
 #include <string.h>
 #include "bsp/esp-bsp.h"
+#include "bsp_board_extra.h"
+#include "timer_svc.h"
 static lv_obj_t* watchface_screen;
 static lv_obj_t* label_hour;
 static lv_obj_t* label_minute;
@@ -25,11 +27,11 @@ static lv_obj_t* img_battery;
 static lv_obj_t* lbl_batt_pct;
 static lv_obj_t* lbl_charge_icon;
 static lv_obj_t* img_ble;
-static lv_timer_t* s_timer = NULL;
+static timer_svc_id_t s_timer = -1;
 
 // Forward declarations
 static void screen_events(lv_event_t* e);
-static void update_time_task(lv_timer_t* timer);
+static void update_time_task(void* arg);
 esp_err_t watchface_load_saved_background(void); 
 
 
@@ -38,13 +40,16 @@ esp_err_t watchface_load_saved_background(void);
 
 static void screen_events(lv_event_t* e);
 
-static void update_time_task(lv_timer_t* timer)
+static void update_time_task(void* arg)
 {
-    (void)timer;
+    (void)arg;
+    // One snapshot, so hour and minute never come from different reads
+    struct tm now;
+    if (rtc_get_time(&now) != ESP_OK) return;
     bsp_display_lock(0);
     //if (active_screen_get() == watchface_screen) {
         if (label_hour) {
-            int hour = rtc_get_hour();
+            int hour = now.tm_hour;
             bool is_24h = settings_get_time_format_24h();
             if (is_24h) {
                 lv_label_set_text_fmt(label_hour, "%02d", hour);
@@ -56,16 +61,16 @@ static void update_time_task(lv_timer_t* timer)
             }
         }
         if (label_minute) {
-            lv_label_set_text_fmt(label_minute, "%02d", rtc_get_minute());
+            lv_label_set_text_fmt(label_minute, "%02d", now.tm_min);
         }
         if (label_second) {
-            lv_label_set_text_fmt(label_second, "%02d", rtc_get_second());
+            lv_label_set_text_fmt(label_second, "%02d", now.tm_sec);
         }
         if (label_date) {
-            lv_label_set_text_fmt(label_date, "%02d/%02d", rtc_get_day(), rtc_get_month());
+            lv_label_set_text_fmt(label_date, "%02d/%02d", now.tm_mday, now.tm_mon + 1);
         }
         if (label_weekday) {
-            const char *weekday_str = rtc_get_weekday_short_string();
+            const char *weekday_str = rtc_weekday_short_string(now.tm_wday);
             if (weekday_str) {
                 lv_label_set_text(label_weekday, weekday_str);
             }
@@ -76,15 +81,11 @@ static void update_time_task(lv_timer_t* timer)
 
 esp_err_t watchface_load_saved_background(void)
 {
-    // Check if SD card is mounted first
-    extern sdmmc_card_t *bsp_sdcard;
-    if (bsp_sdcard == NULL) {
-        ESP_LOGI("Watchface", "SD card not mounted yet, attempting to mount...");
-        esp_err_t mount_err = bsp_sdcard_mount();
-        if (mount_err != ESP_OK) {
-            ESP_LOGW("Watchface", "Failed to mount SD card: %s", esp_err_to_name(mount_err));
-            return ESP_ERR_NOT_FOUND;
-        }
+    // Mount the SD card first if it is not mounted yet
+    esp_err_t mount_err = bsp_extra_sdcard_mount();
+    if (mount_err != ESP_OK) {
+        ESP_LOGW("Watchface", "Failed to mount SD card: %s", esp_err_to_name(mount_err));
+        return ESP_ERR_NOT_FOUND;
     }
     
     char filepath[256];
@@ -205,8 +206,18 @@ void watchface_create(lv_obj_t* parent) {
     lv_obj_set_style_img_recolor_opa(img_ble, LV_OPA_COVER, 0);
     lv_obj_set_style_img_recolor(img_ble, lv_color_hex(0x606060), 0);
 
-    s_timer = lv_timer_create(update_time_task, 1000, NULL);
-    lv_timer_ready(s_timer);
+    // Seconds on the face, so little slack; the other 1 s clients are due
+    // on the same boundaries anyway
+    const timer_svc_config_t cfg = {
+        .name = "watchface",
+        .period_ms = 1000,
+        .slack_ms = 20,
+        .screen = true,
+        .cb = update_time_task,
+    };
+    if (s_timer < 0 && timer_svc_add(&cfg, &s_timer) == ESP_OK) {
+        (void)timer_svc_arm(s_timer, 0);
+    }
 
     // Restore saved wallpaper
     watchface_load_saved_background();
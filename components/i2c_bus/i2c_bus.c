@@ -0,0 +1,324 @@
+// Queued register transactions on the shared I2C bus (see i2c_bus.h)
+
+#include "i2c_bus.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static const char *TAG = "I2C_BUS";
+
+#define XFER_TIMEOUT_MS 50
+#define BATCH_MAX 8   // transactions taken from a queue at once
+#define BURST_MAX 64  // longest merged read
+#define STATS_LOG_US (600LL * 1000000LL) // utilization log, at most this often
+#define NO_SLOT 0xFF
+
+typedef struct {
+    uint8_t dev;
+    uint8_t reg;
+    uint8_t len;
+    bool write;
+    bool merge;             // may share a burst (I2C_BUS_MERGE)
+    uint8_t slot;           // pool slot or NO_SLOT
+    uint8_t *buf;           // the slot, or the blocked caller's buffer
+    i2c_bus_cb_t cb;
+    void *arg;
+    SemaphoreHandle_t done; // blocked caller
+    esp_err_t *result;
+    int64_t queued_us;
+} txn_t;
+
+static i2c_master_bus_handle_t s_bus;
+static i2c_master_dev_handle_t s_devs[I2C_BUS_MAX_DEVICES];
+static int s_ndevs;
+static QueueHandle_t s_queue[2]; // by i2c_bus_prio_t
+static SemaphoreHandle_t s_work; // one count per queued transaction
+static TaskHandle_t s_task;
+static uint8_t s_pool[I2C_BUS_POOL_SLOTS][I2C_BUS_SLOT_SIZE];
+static uint32_t s_pool_free = (1u << I2C_BUS_POOL_SLOTS) - 1;
+static uint8_t s_tx[1 + I2C_BUS_SLOT_SIZE]; // register + write payload
+static uint8_t s_burst[BURST_MAX];
+static portMUX_TYPE s_mux = portMUX_INITIALIZER_UNLOCKED;
+static i2c_bus_stats_t s_stats;
+static int64_t s_stats_start_us;
+static int64_t s_stats_logged_us;
+
+static uint8_t slot_alloc(void) {
+    uint8_t slot = NO_SLOT;
+    portENTER_CRITICAL(&s_mux);
+    if (s_pool_free) {
+        slot = (uint8_t)__builtin_ctz(s_pool_free);
+        s_pool_free &= ~(1u << slot);
+    }
+    portEXIT_CRITICAL(&s_mux);
+    return slot;
+}
+
+static void slot_free(uint8_t slot) {
+    portENTER_CRITICAL(&s_mux);
+    s_pool_free |= 1u << slot;
+    portEXIT_CRITICAL(&s_mux);
+}
+
+static esp_err_t xfer(const txn_t *t, uint8_t *buf, size_t len) {
+    int64_t t0 = esp_timer_get_time();
+    esp_err_t err;
+    if (t->write) {
+        s_tx[0] = t->reg;
+        memcpy(&s_tx[1], t->buf, t->len);
+        err = i2c_master_transmit(s_devs[t->dev], s_tx, t->len + 1, XFER_TIMEOUT_MS);
+    } else {
+        err = i2c_master_transmit_receive(s_devs[t->dev], &t->reg, 1, buf, len,
+                                          XFER_TIMEOUT_MS);
+    }
+    int64_t busy = esp_timer_get_time() - t0;
+    portENTER_CRITICAL(&s_mux);
+    s_stats.transfers++;
+    s_stats.busy_us += (uint64_t)busy;
+    if (err != ESP_OK)
+        s_stats.errors++;
+    portEXIT_CRITICAL(&s_mux);
+    return err;
+}
+
+static void complete(txn_t *t, esp_err_t err, int64_t start_us) {
+    uint32_t wait = (uint32_t)(start_us - t->queued_us);
+    portENTER_CRITICAL(&s_mux);
+    s_stats.txns++;
+    s_stats.wait_us += wait;
+    if (wait > s_stats.max_wait_us)
+        s_stats.max_wait_us = wait;
+    portEXIT_CRITICAL(&s_mux);
+    if (t->done) {
+        *t->result = err;
+        xSemaphoreGive(t->done);
+    } else if (t->cb) {
+        t->cb(err, t->write ? NULL : t->buf, t->len, t->arg);
+    }
+    if (t->slot != NO_SLOT)
+        slot_free(t->slot);
+}
+
+// A run of mergeable reads with nothing else between them. Their order does
+// not matter, so they are sorted and reads that continue exactly where the
+// previous one ends on the same device share one burst.
+static void run_reads(txn_t *t, int n) {
+    for (int i = 1; i < n; ++i) {
+        txn_t x = t[i];
+        int j = i;
+        while (j > 0 && (t[j - 1].dev > x.dev ||
+                         (t[j - 1].dev == x.dev && t[j - 1].reg > x.reg))) {
+            t[j] = t[j - 1];
+            j--;
+        }
+        t[j] = x;
+    }
+    int i = 0;
+    while (i < n) {
+        int j = i + 1;
+        int end = t[i].reg + t[i].len;
+        while (j < n && t[j].dev == t[i].dev && t[j].reg == end &&
+               end + t[j].len - t[i].reg <= BURST_MAX) {
+            end += t[j].len;
+            j++;
+        }
+        int64_t start = esp_timer_get_time();
+        if (j == i + 1) {
+            complete(&t[i], xfer(&t[i], t[i].buf, t[i].len), start);
+        } else {
+            esp_err_t err = xfer(&t[i], s_burst, (size_t)(end - t[i].reg));
+            portENTER_CRITICAL(&s_mux);
+            s_stats.merged += (uint32_t)(j - i - 1);
+            portEXIT_CRITICAL(&s_mux);
+            for (int k = i; k < j; ++k) {
+                if (err == ESP_OK)
+                    memcpy(t[k].buf, &s_burst[t[k].reg - t[i].reg], t[k].len);
+                complete(&t[k], err, start);
+            }
+        }
+        i = j;
+    }
+}
+
+static void run_batch(txn_t *t, int n) {
+    int i = 0;
+    while (i < n) {
+        if (!t[i].merge) {
+            int64_t start = esp_timer_get_time();
+            complete(&t[i], xfer(&t[i], t[i].buf, t[i].len), start);
+            i++;
+            continue;
+        }
+        int j = i;
+        while (j < n && t[j].merge)
+            j++;
+        run_reads(&t[i], j - i);
+        i = j;
+    }
+}
+
+static void log_stats(void) {
+    int64_t now = esp_timer_get_time();
+    if (now - s_stats_logged_us < STATS_LOG_US)
+        return;
+    s_stats_logged_us = now;
+    i2c_bus_stats_t st;
+    i2c_bus_get_stats(&st, false);
+    if (!st.txns || !st.elapsed_us)
+        return;
+    ESP_LOGI(TAG, "%lu txns in %lu transfers (%lu merged, %lu errors), %.2f%% busy, wait avg %lu us max %lu us",
+             (unsigned long)st.txns, (unsigned long)st.transfers, (unsigned long)st.merged,
+             (unsigned long)st.errors, 100.0 * (double)st.busy_us / (double)st.elapsed_us,
+             (unsigned long)(st.wait_us / st.txns), (unsigned long)st.max_wait_us);
+}
+
+static void bus_task(void *arg) {
+    (void)arg;
+    static txn_t batch[BATCH_MAX];
+    for (;;) {
+        xSemaphoreTake(s_work, portMAX_DELAY);
+        // High priority first. Batches are short, so high priority work
+        // waits at most for one low priority batch.
+        int prio = uxQueueMessagesWaiting(s_queue[I2C_BUS_PRIO_HIGH]) ? I2C_BUS_PRIO_HIGH
+                                                                       : I2C_BUS_PRIO_LOW;
+        int n = 0;
+        while (n < BATCH_MAX && xQueueReceive(s_queue[prio], &batch[n], 0) == pdTRUE)
+            n++;
+        // The take above counted the first one
+        for (int i = 1; i < n; ++i)
+            (void)xSemaphoreTake(s_work, 0);
+        run_batch(batch, n);
+        log_stats();
+    }
+}
+
+esp_err_t i2c_bus_init(i2c_master_bus_handle_t bus) {
+    if (!bus)
+        return ESP_ERR_INVALID_ARG;
+    if (s_bus)
+        return bus == s_bus ? ESP_OK : ESP_ERR_INVALID_STATE;
+    s_queue[I2C_BUS_PRIO_HIGH] = xQueueCreate(I2C_BUS_QUEUE_LEN, sizeof(txn_t));
+    s_queue[I2C_BUS_PRIO_LOW] = xQueueCreate(I2C_BUS_QUEUE_LEN, sizeof(txn_t));
+    s_work = xSemaphoreCreateCounting(2 * I2C_BUS_QUEUE_LEN, 0);
+    if (!s_queue[0] || !s_queue[1] || !s_work)
+        return ESP_ERR_NO_MEM;
+    // Above the sensor and UI tasks, so a blocked caller resumes promptly
+    if (xTaskCreate(bus_task, "i2c_bus", 3072, NULL, 6, &s_task) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    s_stats_start_us = esp_timer_get_time();
+    s_stats_logged_us = s_stats_start_us;
+    s_bus = bus;
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_add_device(uint8_t addr, uint32_t scl_hz, i2c_bus_dev_t *dev) {
+    if (!s_bus)
+        return ESP_ERR_INVALID_STATE;
+    if (s_ndevs >= I2C_BUS_MAX_DEVICES)
+        return ESP_ERR_NO_MEM;
+    i2c_device_config_t cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = addr,
+        .scl_speed_hz = scl_hz,
+    };
+    esp_err_t err = i2c_master_bus_add_device(s_bus, &cfg, &s_devs[s_ndevs]);
+    if (err != ESP_OK)
+        return err;
+    *dev = s_ndevs++;
+    return ESP_OK;
+}
+
+static esp_err_t submit(txn_t *t, i2c_bus_prio_t prio, TickType_t wait) {
+    t->queued_us = esp_timer_get_time();
+    if (xQueueSend(s_queue[prio], t, wait) != pdTRUE)
+        return ESP_ERR_NO_MEM;
+    xSemaphoreGive(s_work);
+    return ESP_OK;
+}
+
+static esp_err_t submit_async(txn_t *t, const uint8_t *data, i2c_bus_prio_t prio) {
+    if (!s_bus)
+        return ESP_ERR_INVALID_STATE;
+    if (t->dev >= s_ndevs || t->len == 0 || t->len > I2C_BUS_SLOT_SIZE || prio > I2C_BUS_PRIO_LOW)
+        return ESP_ERR_INVALID_ARG;
+    t->slot = slot_alloc();
+    if (t->slot == NO_SLOT)
+        return ESP_ERR_NO_MEM;
+    t->buf = s_pool[t->slot];
+    if (data)
+        memcpy(t->buf, data, t->len);
+    esp_err_t err = submit(t, prio, 0);
+    if (err != ESP_OK)
+        slot_free(t->slot);
+    return err;
+}
+
+esp_err_t i2c_bus_read_async(i2c_bus_dev_t dev, uint8_t reg, uint8_t len,
+                             i2c_bus_prio_t prio, i2c_bus_cb_t cb, void *arg) {
+    txn_t t = {.dev = (uint8_t)dev, .reg = reg, .len = len,
+               .merge = (prio & I2C_BUS_MERGE) != 0, .cb = cb, .arg = arg};
+    if (!cb)
+        return ESP_ERR_INVALID_ARG;
+    return submit_async(&t, NULL, (i2c_bus_prio_t)(prio & ~I2C_BUS_MERGE));
+}
+
+esp_err_t i2c_bus_write_async(i2c_bus_dev_t dev, uint8_t reg,
+                              const uint8_t *data, uint8_t len,
+                              i2c_bus_prio_t prio, i2c_bus_cb_t cb, void *arg) {
+    txn_t t = {.dev = (uint8_t)dev, .reg = reg, .len = len, .write = true,
+               .cb = cb, .arg = arg};
+    return submit_async(&t, data, prio);
+}
+
+// The caller's buffer is used in place; it waits until the bus task is done
+// with it. Not from a completion callback, which runs in the bus task.
+static esp_err_t run_blocking(txn_t *t, i2c_bus_prio_t prio) {
+    if (!s_bus || xTaskGetCurrentTaskHandle() == s_task)
+        return ESP_ERR_INVALID_STATE;
+    if (t->dev >= s_ndevs || t->len == 0 || prio > I2C_BUS_PRIO_LOW)
+        return ESP_ERR_INVALID_ARG;
+    StaticSemaphore_t sem;
+    esp_err_t result = ESP_FAIL;
+    t->slot = NO_SLOT;
+    t->done = xSemaphoreCreateBinaryStatic(&sem);
+    t->result = &result;
+    esp_err_t err = submit(t, prio, portMAX_DELAY);
+    if (err == ESP_OK) {
+        xSemaphoreTake(t->done, portMAX_DELAY);
+        err = result;
+    }
+    vSemaphoreDelete(t->done);
+    return err;
+}
+
+esp_err_t i2c_bus_read(i2c_bus_dev_t dev, uint8_t reg, uint8_t *data,
+                       uint8_t len, i2c_bus_prio_t prio) {
+    txn_t t = {.dev = (uint8_t)dev, .reg = reg, .len = len,
+               .merge = (prio & I2C_BUS_MERGE) != 0, .buf = data};
+    return run_blocking(&t, (i2c_bus_prio_t)(prio & ~I2C_BUS_MERGE));
+}
+
+esp_err_t i2c_bus_write(i2c_bus_dev_t dev, uint8_t reg, const uint8_t *data,
+                        uint8_t len, i2c_bus_prio_t prio) {
+    if (len > I2C_BUS_SLOT_SIZE)
+        return ESP_ERR_INVALID_ARG;
+    txn_t t = {.dev = (uint8_t)dev, .reg = reg, .len = len, .write = true,
+               .buf = (uint8_t *)data};
+    return run_blocking(&t, prio);
+}
+
+void i2c_bus_get_stats(i2c_bus_stats_t *stats, bool reset) {
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&s_mux);
+    *stats = s_stats;
+    stats->elapsed_us = (uint64_t)(now - s_stats_start_us);
+    if (reset) {
+        memset(&s_stats, 0, sizeof(s_stats));
+        s_stats_start_us = now;
+    }
+    portEXIT_CRITICAL(&s_mux);
+}
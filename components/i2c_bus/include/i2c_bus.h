@@ -0,0 +1,79 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/i2c_master.h"
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shared I2C bus manager. Drivers queue register transactions instead of
+// calling the i2c_master driver on their own schedule; one task runs them,
+// high priority first, and merges reads of adjacent registers on the same
+// device into one burst. Only reads queued with I2C_BUS_MERGE take part:
+// they may be reordered and share a burst, so they must be plain registers
+// (no clear-on-read status, no FIFO port). Asynchronous transactions complete through a
+// callback, synchronous ones wake the caller. Payloads of asynchronous
+// transactions live in a preallocated slot pool and writes are staged in a
+// static buffer, so nothing allocates per transaction.
+
+#define I2C_BUS_MAX_DEVICES 4
+#define I2C_BUS_SLOT_SIZE 32  // largest async payload, largest write
+#define I2C_BUS_POOL_SLOTS 16
+#define I2C_BUS_QUEUE_LEN 16  // per priority
+
+typedef enum {
+    I2C_BUS_PRIO_HIGH, // sensor batches, interrupt status
+    I2C_BUS_PRIO_LOW,  // clock, battery, housekeeping
+} i2c_bus_prio_t;
+
+// OR into the priority of a read whose registers have no read side effects,
+// e.g. I2C_BUS_PRIO_LOW | I2C_BUS_MERGE. Other reads and all writes run
+// alone, in queue order.
+#define I2C_BUS_MERGE 0x80
+
+typedef int i2c_bus_dev_t;
+
+// Runs in the bus task. `data` holds the bytes read (NULL for writes) and
+// is only valid during the call.
+typedef void (*i2c_bus_cb_t)(esp_err_t err, const uint8_t *data, uint8_t len,
+                             void *arg);
+
+typedef struct {
+    uint32_t txns;        // completed transactions
+    uint32_t transfers;   // bus transfers they took
+    uint32_t merged;      // reads served by another read's burst
+    uint32_t errors;
+    uint64_t busy_us;     // time in bus transfers
+    uint64_t wait_us;     // queued time, summed over transactions
+    uint32_t max_wait_us;
+    uint64_t elapsed_us;  // since the counters started
+} i2c_bus_stats_t;
+
+// Idempotent; every driver on the bus may call it with the same handle
+esp_err_t i2c_bus_init(i2c_master_bus_handle_t bus);
+
+esp_err_t i2c_bus_add_device(uint8_t addr, uint32_t scl_hz, i2c_bus_dev_t *dev);
+
+// Queue a read of `len` (<= I2C_BUS_SLOT_SIZE) registers from `reg`
+esp_err_t i2c_bus_read_async(i2c_bus_dev_t dev, uint8_t reg, uint8_t len,
+                             i2c_bus_prio_t prio, i2c_bus_cb_t cb, void *arg);
+
+// Queue a write; `data` is copied. `cb` may be NULL.
+esp_err_t i2c_bus_write_async(i2c_bus_dev_t dev, uint8_t reg,
+                              const uint8_t *data, uint8_t len,
+                              i2c_bus_prio_t prio, i2c_bus_cb_t cb, void *arg);
+
+// Blocking forms, for callers that need the result before going on. Reads
+// go straight into `data`, so `len` is only limited by the driver.
+esp_err_t i2c_bus_read(i2c_bus_dev_t dev, uint8_t reg, uint8_t *data,
+                       uint8_t len, i2c_bus_prio_t prio);
+esp_err_t i2c_bus_write(i2c_bus_dev_t dev, uint8_t reg, const uint8_t *data,
+                        uint8_t len, i2c_bus_prio_t prio);
+
+// Counters; utilization is busy_us / elapsed_us. `reset` starts over.
+void i2c_bus_get_stats(i2c_bus_stats_t *stats, bool reset);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,273 @@
+// Scores the windowed activity classifier (motion_activity.c) against
+// labelled *.imt traces, next to the cadence-only classes it replaces.
+//
+// Usage: activity_eval activity.txt [more manifests...]
+//
+// Manifest lines (paths relative to the manifest, '#' starts a comment):
+//   <trace.imt> <start_s>:<label>[,<start_s>:<label>...]
+// with labels idle, walk, run, other, cycle; each holds from its start
+// offset (seconds from the first sample) until the next one. Windows that
+// straddle a label change are not scored. Reports the confusion matrix of
+// the debounced class, accuracy of the debounced / per-window / cadence
+// classes, class changes per hour, and the cost of one window (features
+// plus decision tree) in ns and cycles.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "motion_activity.h"
+#include "motion_algo.h"
+#include "motion_trace.h"
+
+#define NCLASS 5
+#define MAX_LABELS 64
+
+static const char *k_names[NCLASS] = {"idle", "walk", "run", "other", "cycle"};
+
+typedef struct {
+  float t_s;
+  int cls;
+} label_t;
+
+typedef struct {
+  uint32_t confusion[NCLASS][NCLASS]; // [truth][debounced]
+  uint32_t windows, ok_out, ok_raw, ok_cadence;
+  uint32_t flips_out, flips_cadence;
+  double duration_s;
+  uint64_t cost_ns, cost_cycles, cost_windows;
+} eval_t;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void) {
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static int class_of(const char *s) {
+  for (int i = 0; i < NCLASS; ++i) {
+    if (strcmp(s, k_names[i]) == 0)
+      return i;
+  }
+  return -1;
+}
+
+static int parse_labels(char *s, label_t *out) {
+  int n = 0;
+  for (char *tok = strtok(s, ","); tok && n < MAX_LABELS;
+       tok = strtok(NULL, ",")) {
+    char name[16];
+    float t;
+    if (sscanf(tok, "%f:%15s", &t, name) != 2 || class_of(name) < 0) {
+      fprintf(stderr, "bad label '%s'\n", tok);
+      continue;
+    }
+    out[n].t_s = t;
+    out[n].cls = class_of(name);
+    n++;
+  }
+  return n;
+}
+
+// Label holding over all of [from_s, to_s], or -1 across a change
+static int label_over(const label_t *l, int n, float from_s, float to_s) {
+  int cls = -1;
+  for (int i = 0; i < n; ++i) {
+    if (l[i].t_s <= from_s)
+      cls = l[i].cls;
+    else if (l[i].t_s < to_s)
+      return -1;
+  }
+  return cls;
+}
+
+static bool eval_file(const char *path, const label_t *labels, int nlabels,
+                      eval_t *ev) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  motion_trace_header_t hdr;
+  if (!motion_trace_read_header(f, &hdr)) {
+    fprintf(stderr, "%s: not an IMT1 trace\n", path);
+    fclose(f);
+    return false;
+  }
+  static int16_t xyz[MOTION_TRACE_MAX_BATCH * 3];
+  static motion_algo_t algo;
+  motion_algo_init(&algo);
+  motion_trace_batch_t b;
+  bool first = true;
+  uint32_t t_first = 0, t_last = 0;
+  int prev_out = -1, prev_cad = -1;
+
+  while (motion_trace_read_batch(f, &b, xyz, NULL)) {
+    if (first) {
+      t_first = b.t_ms;
+      first = false;
+    }
+    uint32_t period_us = (b.flags & MOTION_TRACE_F_GYRO) ? hdr.gyro_period_us
+                                                         : hdr.sample_period_us;
+    motion_batch_t batch = {
+        .xyz = xyz, .n = b.count, .t0_ms = b.t_ms, .period_us = period_us};
+    motion_algo_result_t res;
+    motion_algo_process(&algo, &batch, true, false, &res);
+    t_last = b.t_ms + (uint32_t)((uint64_t)(b.count - 1) * period_us / 1000);
+    if (!res.activity_window)
+      continue;
+
+    const motion_activity_t *a = &algo.classifier;
+    float end_s = (a->window_end_ms - t_first) / 1000.0f;
+    float start_s = end_s - MOTION_ACTIVITY_WINDOW * (period_us / 1e6f);
+    int out = a->out, raw = a->raw, cad = algo.cadence_activity;
+    if (prev_out >= 0 && out != prev_out)
+      ev->flips_out++;
+    if (prev_cad >= 0 && cad != prev_cad)
+      ev->flips_cadence++;
+    prev_out = out;
+    prev_cad = cad;
+
+    // The window is still in the classifier's buffer: time it again
+    motion_activity_features_t feat;
+    volatile int sink = 0;
+    uint64_t c0 = now_cycles(), t0 = now_ns();
+    for (int r = 0; r < 20; ++r) {
+      motion_activity_features(a->mag, a->pitch, MOTION_ACTIVITY_WINDOW,
+                               period_us, &feat);
+      sink += motion_activity_classify(&feat);
+    }
+    ev->cost_ns += (now_ns() - t0) / 20;
+    ev->cost_cycles += (now_cycles() - c0) / 20;
+    ev->cost_windows++;
+    (void)sink;
+
+    int truth = label_over(labels, nlabels, start_s, end_s);
+    if (truth < 0)
+      continue;
+    ev->windows++;
+    ev->confusion[truth][out]++;
+    ev->ok_out += out == truth;
+    ev->ok_raw += raw == truth;
+    ev->ok_cadence += cad == truth;
+  }
+  fclose(f);
+  ev->duration_s += first ? 0.0 : (t_last - t_first) / 1000.0;
+  return true;
+}
+
+static void print_row(const char *name, const eval_t *ev) {
+  double w = ev->windows ? ev->windows : 1;
+  double h = ev->duration_s > 0 ? ev->duration_s / 3600.0 : 1;
+  printf("%-24.24s %7u %7.1f%% %7.1f%% %7.1f%% %8.0f %8.0f\n", name,
+         ev->windows, 100.0 * ev->ok_out / w, 100.0 * ev->ok_raw / w,
+         100.0 * ev->ok_cadence / w, ev->flips_out / h,
+         ev->flips_cadence / h);
+}
+
+static void accumulate(eval_t *tot, const eval_t *ev) {
+  for (int i = 0; i < NCLASS; ++i)
+    for (int j = 0; j < NCLASS; ++j)
+      tot->confusion[i][j] += ev->confusion[i][j];
+  tot->windows += ev->windows;
+  tot->ok_out += ev->ok_out;
+  tot->ok_raw += ev->ok_raw;
+  tot->ok_cadence += ev->ok_cadence;
+  tot->flips_out += ev->flips_out;
+  tot->flips_cadence += ev->flips_cadence;
+  tot->duration_s += ev->duration_s;
+  tot->cost_ns += ev->cost_ns;
+  tot->cost_cycles += ev->cost_cycles;
+  tot->cost_windows += ev->cost_windows;
+}
+
+static int run_manifest(const char *manifest, eval_t *tot) {
+  FILE *m = fopen(manifest, "r");
+  if (!m) {
+    fprintf(stderr, "cannot open %s\n", manifest);
+    return -1;
+  }
+  char dir[512] = ".";
+  const char *slash = strrchr(manifest, '/');
+  if (slash)
+    snprintf(dir, sizeof(dir), "%.*s", (int)(slash - manifest), manifest);
+
+  char line[2048];
+  int files = 0;
+  while (fgets(line, sizeof(line), m)) {
+    char *hash = strchr(line, '#');
+    if (hash)
+      *hash = '\0';
+    char name[256], labels_s[1536];
+    if (sscanf(line, "%255s %1535s", name, labels_s) != 2)
+      continue;
+    label_t labels[MAX_LABELS];
+    int nlabels = parse_labels(labels_s, labels);
+    char path[1024];
+    if (name[0] == '/')
+      snprintf(path, sizeof(path), "%s", name);
+    else
+      snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    eval_t ev = {0};
+    if (!eval_file(path, labels, nlabels, &ev))
+      continue;
+    print_row(name, &ev);
+    accumulate(tot, &ev);
+    files++;
+  }
+  fclose(m);
+  return files;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s activity.txt...\n", argv[0]);
+    return 2;
+  }
+  printf("%-24s %7s %8s %8s %8s %8s %8s\n", "trace", "windows", "class",
+         "window", "cadence", "flips/h", "cad_fl/h");
+  eval_t tot = {0};
+  int files = 0;
+  for (int i = 1; i < argc; ++i) {
+    int n = run_manifest(argv[i], &tot);
+    if (n < 0)
+      return 1;
+    files += n;
+  }
+  if (files == 0) {
+    fprintf(stderr, "no traces evaluated\n");
+    return 1;
+  }
+  print_row("TOTAL", &tot);
+
+  printf("\nconfusion (rows: label, columns: debounced class)\n%-8s", "");
+  for (int j = 0; j < NCLASS; ++j)
+    printf(" %6s", k_names[j]);
+  printf("\n");
+  for (int i = 0; i < NCLASS; ++i) {
+    printf("%-8s", k_names[i]);
+    for (int j = 0; j < NCLASS; ++j)
+      printf(" %6u", tot.confusion[i][j]);
+    printf("\n");
+  }
+  double wins = tot.cost_windows ? (double)tot.cost_windows : 1.0;
+  printf("\nper %d-sample window: %.1f us, %.0f cycles (host; 0 cycles when "
+         "the TSC is unavailable)\n",
+         MOTION_ACTIVITY_WINDOW, tot.cost_ns / wins / 1000.0,
+         tot.cost_cycles / wins);
+  return 0;
+}
@@ -0,0 +1,102 @@
+// Host check for the day rollover (day_clock.c): callbacks fire once per
+// local midnight, DST days are 23 and 25 hours long, setting the clock back
+// (day_clock_time_changed()) fires nothing and setting it forward fires once,
+// and a date set forward then back does not skip the next real midnight.
+//
+// Usage: day_clock_check
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "day_clock.h"
+
+static int s_fired;
+static time_t s_last_start;
+static int s_errors;
+
+static void on_day(time_t day_start, void *arg) {
+  (void)arg;
+  s_fired++;
+  s_last_start = day_start;
+}
+
+static time_t local(int y, int mon, int d, int h, int m) {
+  struct tm tm = {.tm_year = y - 1900, .tm_mon = mon - 1, .tm_mday = d,
+                  .tm_hour = h, .tm_min = m, .tm_isdst = -1};
+  return mktime(&tm);
+}
+
+// Poll once and compare the number of rollovers against `want`
+static void expect(const char *what, time_t now, int want) {
+  s_fired = 0;
+  (void)day_clock_poll(now);
+  if (s_fired != want) {
+    printf("%s: %d rollovers, want %d\n", what, s_fired, want);
+    s_errors++;
+  }
+}
+
+// Poll every minute over [from, to) and count the rollovers
+static int walk(time_t from, time_t to) {
+  int n = 0;
+  for (time_t t = from; t < to; t += 60) {
+    s_fired = 0;
+    (void)day_clock_poll(t);
+    n += s_fired;
+  }
+  return n;
+}
+
+int main(void) {
+  setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+  tzset();
+  day_clock_register(on_day, NULL);
+
+  expect("first poll", local(2025, 3, 10, 12, 0), 0);
+  expect("same day", local(2025, 3, 10, 23, 59), 0);
+  expect("midnight", local(2025, 3, 11, 0, 0), 1);
+  if (s_last_start != local(2025, 3, 11, 0, 0)) {
+    printf("midnight: day start %ld\n", (long)s_last_start);
+    s_errors++;
+  }
+
+  // Ten days of minute polls across the spring-forward Sunday
+  expect("before spring DST", local(2025, 3, 25, 12, 0), 1);
+  int n = walk(local(2025, 3, 25, 12, 1), local(2025, 4, 4, 12, 0));
+  if (n != 10) {
+    printf("spring DST: %d rollovers over 10 days\n", n);
+    s_errors++;
+  }
+
+  // Clock set back across midnight: no rollover for the set itself, the
+  // date follows the clock back and rolls again at the next midnight
+  expect("settle", local(2025, 6, 1, 0, 30), 1);
+  day_clock_time_changed();
+  expect("set back an hour", local(2025, 5, 31, 23, 30), 0);
+  expect("midnight again", local(2025, 6, 1, 0, 0), 1);
+
+  // Date set forward, then back to today: the next real midnight still rolls
+  expect("today", local(2025, 6, 1, 22, 0), 0);
+  day_clock_time_changed();
+  expect("set forward", local(2025, 6, 5, 22, 0), 1);
+  day_clock_time_changed();
+  expect("set back", local(2025, 6, 1, 22, 5), 0);
+  expect("next midnight", local(2025, 6, 2, 0, 0), 1);
+  expect("day after", local(2025, 6, 3, 0, 0), 1);
+
+  // A set back without a later poll in between must not be lost
+  day_clock_time_changed();
+  expect("set back a week", local(2025, 5, 27, 9, 0), 0);
+  expect("midnight after week back", local(2025, 5, 28, 0, 0), 1);
+
+  // And across the fall-back one
+  expect("before autumn DST", local(2025, 10, 20, 12, 0), 1);
+  n = walk(local(2025, 10, 20, 12, 1), local(2025, 10, 30, 12, 0));
+  if (n != 10) {
+    printf("autumn DST: %d rollovers over 10 days\n", n);
+    s_errors++;
+  }
+
+  printf("%s\n", s_errors ? "FAIL" : "OK");
+  return s_errors ? 1 : 0;
+}
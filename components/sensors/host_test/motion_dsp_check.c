@@ -0,0 +1,184 @@
+// Host check for the fixed-point accelerometer kernel (motion_dsp.c):
+//  1. motion_dsp_block() is bit-exact with the per-sample motion_dsp_ref()
+//  2. the golden checksum in motion_dsp.h matches (the device self-test
+//     compares its accelerated output against the same constant)
+//  3. accuracy against the float formulas the kernel replaces
+//  4. time/cycles per sample, fixed-point block vs float per sample
+//
+// Usage: motion_dsp_check [-n blocks]
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "motion_dsp.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define BLK MOTION_DSP_MAX_BLOCK
+
+static uint32_t s_rng = 1;
+
+static int16_t rnd16(void) {
+  s_rng = s_rng * 1103515245u + 12345u;
+  return (int16_t)(s_rng >> 16);
+}
+
+// Realistic wrist data: ~1 g in a random direction plus motion
+static void fill_realistic(int16_t *xyz, int n) {
+  for (int i = 0; i < n; ++i) {
+    float th = (rnd16() / 32768.0f) * (float)M_PI;
+    float ph = (rnd16() / 32768.0f) * (float)M_PI;
+    float g = 8192.0f * (1.0f + 0.5f * (rnd16() / 32768.0f));
+    xyz[i * 3 + 0] = (int16_t)(g * sinf(th) * cosf(ph));
+    xyz[i * 3 + 1] = (int16_t)(g * sinf(th) * sinf(ph));
+    xyz[i * 3 + 2] = (int16_t)(g * cosf(th));
+  }
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void) {
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static int check_bit_exact(int blocks) {
+  int16_t xyz[BLK * 3], m1[BLK], l1[BLK], p1[BLK];
+  motion_dsp_state_t sb, sr;
+  motion_dsp_init(&sb);
+  motion_dsp_init(&sr);
+  for (int b = 0; b < blocks; ++b) {
+    int n = 1 + (b % BLK); // exercise partial blocks too
+    if (b & 1) {
+      for (int i = 0; i < n * 3; ++i)
+        xyz[i] = rnd16();
+    } else {
+      fill_realistic(xyz, n);
+    }
+    motion_dsp_block(&sb, xyz, n, m1, l1, p1);
+    for (int i = 0; i < n; ++i) {
+      int16_t m2, l2, p2;
+      motion_dsp_ref(&sr, &xyz[i * 3], &m2, &l2, &p2);
+      if (m1[i] != m2 || l1[i] != l2 || p1[i] != p2) {
+        printf("MISMATCH block %d sample %d: in=(%d,%d,%d) block=(%d,%d,%d) "
+               "ref=(%d,%d,%d)\n",
+               b, i, xyz[i * 3], xyz[i * 3 + 1], xyz[i * 3 + 2], m1[i], l1[i],
+               p1[i], m2, l2, p2);
+        return 1;
+      }
+    }
+  }
+  printf("bit-exact: block == ref over %d blocks\n", blocks);
+  return 0;
+}
+
+static int check_accuracy(int blocks) {
+  int16_t xyz[BLK * 3], mag[BLK], pitch[BLK];
+  motion_dsp_state_t st;
+  motion_dsp_init(&st);
+  double max_mag_mg = 0, max_pitch_deg = 0;
+  for (int b = 0; b < blocks; ++b) {
+    fill_realistic(xyz, BLK);
+    motion_dsp_block(&st, xyz, BLK, mag, NULL, pitch);
+    for (int i = 0; i < BLK; ++i) {
+      double x = xyz[i * 3] / 8.192, y = xyz[i * 3 + 1] / 8.192,
+             z = xyz[i * 3 + 2] / 8.192; // mg
+      double fm = sqrt(x * x + y * y + z * z);
+      double fp = atan2(-x, sqrt(y * y + z * z)) * 180.0 / M_PI;
+      double em = fabs(mag[i] * 1000.0 / 4096.0 - fm);
+      double ep = fabs(pitch[i] / 128.0 - fp);
+      if (em > max_mag_mg)
+        max_mag_mg = em;
+      if (ep > max_pitch_deg)
+        max_pitch_deg = ep;
+    }
+  }
+  printf("accuracy vs float: max |mag| error %.3f mg, max pitch error %.3f "
+         "deg\n",
+         max_mag_mg, max_pitch_deg);
+  // Magnitude goes through Q11 squares (worst near 0.5 g); the step
+  // threshold is 80 mg. Pitch output resolution is 1/128 deg.
+  return (max_mag_mg < 2.0 && max_pitch_deg < 0.05) ? 0 : 1;
+}
+
+static void bench(int blocks) {
+  int16_t *xyz = malloc(sizeof(int16_t) * BLK * 3 * blocks);
+  int16_t mag[BLK], lp[BLK], pitch[BLK];
+  if (!xyz)
+    return;
+  for (int b = 0; b < blocks; ++b)
+    fill_realistic(&xyz[b * BLK * 3], BLK);
+  uint64_t samples = (uint64_t)blocks * BLK;
+
+  motion_dsp_state_t st;
+  motion_dsp_init(&st);
+  volatile int32_t sink = 0;
+  uint64_t c0 = now_cycles(), t0 = now_ns();
+  for (int b = 0; b < blocks; ++b) {
+    motion_dsp_block(&st, &xyz[b * BLK * 3], BLK, mag, lp, pitch);
+    sink += mag[0] + lp[0] + pitch[0];
+  }
+  uint64_t fx_ns = now_ns() - t0, fx_cyc = now_cycles() - c0;
+
+  // What sensors_task did per sample before this kernel
+  float flp = 0.0f;
+  volatile float fsink = 0.0f;
+  c0 = now_cycles();
+  t0 = now_ns();
+  for (uint64_t i = 0; i < samples; ++i) {
+    float ax = xyz[i * 3] / 8.192f, ay = xyz[i * 3 + 1] / 8.192f,
+          az = xyz[i * 3 + 2] / 8.192f;
+    float m = sqrtf(ax * ax + ay * ay + az * az);
+    flp = 0.9f * flp + 0.1f * (m - 1000.0f);
+    float ax_g = ax / 1000.0f, ay_g = ay / 1000.0f, az_g = az / 1000.0f;
+    float p = atan2f(-ax_g, sqrtf(ay_g * ay_g + az_g * az_g)) * 180.0f /
+              (float)M_PI;
+    fsink += p + flp;
+  }
+  uint64_t fl_ns = now_ns() - t0, fl_cyc = now_cycles() - c0;
+  (void)sink;
+
+  printf("\n%-22s %10s %10s\n", "per sample", "ns", "cycles");
+  printf("%-22s %10.2f %10.1f\n", "fixed-point block", (double)fx_ns / samples,
+         (double)fx_cyc / samples);
+  printf("%-22s %10.2f %10.1f\n", "float per-sample", (double)fl_ns / samples,
+         (double)fl_cyc / samples);
+  printf("(host numbers; sensors_init logs the same comparison on the "
+         "device)\n");
+  free(xyz);
+}
+
+int main(int argc, char **argv) {
+  int blocks = 20000;
+  if (argc == 3 && strcmp(argv[1], "-n") == 0)
+    blocks = atoi(argv[2]);
+
+  int fail = check_bit_exact(blocks);
+  uint32_t crc = motion_dsp_checksum();
+  printf("checksum: 0x%08X (golden 0x%08X) %s\n", (unsigned)crc,
+         (unsigned)MOTION_DSP_GOLDEN_CRC,
+         crc == MOTION_DSP_GOLDEN_CRC ? "ok" : "MISMATCH");
+  if (crc != MOTION_DSP_GOLDEN_CRC)
+    fail = 1;
+  fail |= check_accuracy(blocks / 10 + 1);
+  bench(blocks);
+  printf("\n%s\n", fail ? "FAILED" : "PASSED");
+  return fail;
+}
@@ -0,0 +1,311 @@
+// Replays *.imt IMU traces through motion_algo and scores them.
+//
+// Usage: motion_replay [-s screen_on_ms] [-w batch] [-a] manifest.txt...
+//
+// Manifest lines (paths relative to the manifest, '#' starts a comment):
+//   <trace.imt> <true_steps> <raise_ms[,raise_ms...]|->
+// raise_ms are the offsets from the first sample at which a deliberate wrist
+// raise starts. A detection within [-RAISE_EARLY_MS, +RAISE_LATE_MS] of a
+// labelled raise is a hit (latency = detection - label), anything else is a
+// false wake. The screen is simulated: off, except for `screen_on_ms` after
+// each detected raise, as on the watch.
+//
+// Raise-to-wake is gyro-assisted for batches that carry gyro samples; -a
+// drops them to score the accelerometer-only detector on the same traces.
+// -w splits batches into at most `batch` samples, as with a smaller FIFO
+// watermark: a raise only reaches the watch when its batch is read, so
+// wake_ms (label to the end of the batch) is the latency the wearer sees,
+// lat_ms the detection time alone.
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
+
+#include "motion_algo.h"
+#include "motion_trace.h"
+
+#define MAX_RAISES 64
+#define RAISE_EARLY_MS 200
+#define RAISE_LATE_MS 1500
+
+typedef struct {
+  uint64_t samples;
+  double duration_s;
+  uint32_t true_steps, steps;
+  int true_raises, hits, false_wakes;
+  uint64_t latency_sum_ms, wake_sum_ms;
+  uint32_t latency_max_ms;
+  uint64_t ns, cycles;
+} replay_stats_t;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t now_cycles(void) {
+#ifdef HAVE_TSC
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static int parse_raises(const char *s, uint32_t *out) {
+  int n = 0;
+  if (strcmp(s, "-") == 0)
+    return 0;
+  while (*s && n < MAX_RAISES) {
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (end == s)
+      break;
+    out[n++] = (uint32_t)v;
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+typedef struct {
+  uint32_t screen_on_ms;
+  int batch;      // max samples per motion_algo_process() call
+  bool accel_only;
+} replay_opts_t;
+
+static bool replay_file(const char *path, const uint32_t *raises, int nraises,
+                        const replay_opts_t *opt, replay_stats_t *st) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  motion_trace_header_t hdr;
+  if (!motion_trace_read_header(f, &hdr)) {
+    fprintf(stderr, "%s: not an IMT1 trace\n", path);
+    fclose(f);
+    return false;
+  }
+
+  static int16_t xyz[MOTION_TRACE_MAX_BATCH * 3];
+  static int16_t gyro[MOTION_TRACE_MAX_BATCH * 3];
+  bool matched[MAX_RAISES] = {0};
+  motion_algo_t algo;
+  motion_algo_init(&algo);
+  motion_trace_batch_t b;
+  bool first = true;
+  uint32_t t_first = 0, t_last = 0, screen_off_at = 0;
+  bool screen_on = false;
+
+  while (motion_trace_read_batch(f, &b, xyz, gyro)) {
+    if (first) {
+      t_first = b.t_ms;
+      first = false;
+    }
+    // The algorithms take Q13 g (+-4 g); rescale traces recorded otherwise
+    if (fabsf(hdr.mg_per_lsb - 1000.0f / 8192.0f) > 1e-6f) {
+      for (int i = 0; i < b.count * 3; ++i) {
+        long v = lrintf(xyz[i] * hdr.mg_per_lsb * 8.192f);
+        xyz[i] = (int16_t)(v > INT16_MAX ? INT16_MAX
+                                         : v < INT16_MIN ? INT16_MIN : v);
+      }
+    }
+    // Likewise 64 LSB/dps for the gyro
+    bool has_gyro = (b.flags & MOTION_TRACE_F_GYRO) && !opt->accel_only &&
+                    hdr.dps_per_lsb > 0.0f;
+    if (has_gyro && fabsf(hdr.dps_per_lsb * 64.0f - 1.0f) > 1e-6f) {
+      for (int i = 0; i < b.count * 3; ++i) {
+        long v = lrintf(gyro[i] * hdr.dps_per_lsb * 64.0f);
+        gyro[i] = (int16_t)(v > INT16_MAX ? INT16_MAX
+                                          : v < INT16_MIN ? INT16_MIN : v);
+      }
+    }
+
+    // With the gyro on the accelerometer follows the gyro clock
+    uint32_t period_us = (b.flags & MOTION_TRACE_F_GYRO) ? hdr.gyro_period_us
+                                                         : hdr.sample_period_us;
+    for (int base = 0; base < b.count; base += opt->batch) {
+      int n = b.count - base;
+      if (n > opt->batch)
+        n = opt->batch;
+      motion_batch_t batch = {
+          .xyz = &xyz[base * 3],
+          .gyro = has_gyro ? &gyro[base * 3] : NULL,
+          .n = n,
+          .t0_ms = b.t_ms + (uint32_t)((uint64_t)base * period_us / 1000),
+          .period_us = period_us};
+      uint32_t t_end =
+          batch.t0_ms + (uint32_t)((uint64_t)(n - 1) * period_us / 1000);
+      if (screen_on && (int32_t)(batch.t0_ms - screen_off_at) >= 0)
+        screen_on = false;
+
+      motion_algo_result_t res;
+      uint64_t c0 = now_cycles(), t0 = now_ns();
+      motion_algo_process(&algo, &batch, true, !screen_on, &res);
+      st->ns += now_ns() - t0;
+      st->cycles += now_cycles() - c0;
+
+      st->samples += n;
+      st->steps += res.steps;
+      t_last = t_end;
+      if (!res.raise)
+        continue;
+      screen_on = true;
+      screen_off_at = res.raise_t_ms + opt->screen_on_ms;
+      uint32_t t = res.raise_t_ms - t_first;
+      bool hit = false;
+      for (int k = 0; k < nraises && !hit; ++k) {
+        if (!matched[k] && t + RAISE_EARLY_MS >= raises[k] &&
+            t <= raises[k] + RAISE_LATE_MS) {
+          matched[k] = true;
+          hit = true;
+          uint32_t lat = t > raises[k] ? t - raises[k] : 0;
+          st->latency_sum_ms += lat;
+          if (lat > st->latency_max_ms)
+            st->latency_max_ms = lat;
+          uint32_t seen = t_end - t_first;
+          st->wake_sum_ms += seen > raises[k] ? seen - raises[k] : 0;
+        }
+      }
+      if (hit)
+        st->hits++;
+      else
+        st->false_wakes++;
+    }
+  }
+  fclose(f);
+  st->true_raises += nraises;
+  st->duration_s += first ? 0.0 : (t_last - t_first) / 1000.0;
+  return true;
+}
+
+static void print_row(const char *name, const replay_stats_t *st) {
+  double err = st->true_steps
+                   ? 100.0 * ((double)st->steps - st->true_steps) / st->true_steps
+                   : 0.0;
+  double lat = st->hits ? (double)st->latency_sum_ms / st->hits : 0.0;
+  double wake = st->hits ? (double)st->wake_sum_ms / st->hits : 0.0;
+  double ns = st->samples ? (double)st->ns / st->samples : 0.0;
+  double cyc = st->samples ? (double)st->cycles / st->samples : 0.0;
+  printf("%-24.24s %8" PRIu64 " %7.0f %6u %6u %+6.1f%% %3d/%-3d %5d %6.0f %6u "
+         "%7.0f %7.1f %7.0f\n",
+         name, st->samples, st->duration_s, st->true_steps, st->steps, err,
+         st->hits, st->true_raises, st->false_wakes, lat, st->latency_max_ms,
+         wake, ns, cyc);
+}
+
+static void accumulate(replay_stats_t *tot, const replay_stats_t *st) {
+  tot->samples += st->samples;
+  tot->duration_s += st->duration_s;
+  tot->true_steps += st->true_steps;
+  tot->steps += st->steps;
+  tot->true_raises += st->true_raises;
+  tot->hits += st->hits;
+  tot->false_wakes += st->false_wakes;
+  tot->latency_sum_ms += st->latency_sum_ms;
+  tot->wake_sum_ms += st->wake_sum_ms;
+  if (st->latency_max_ms > tot->latency_max_ms)
+    tot->latency_max_ms = st->latency_max_ms;
+  tot->ns += st->ns;
+  tot->cycles += st->cycles;
+}
+
+static int run_manifest(const char *manifest, const replay_opts_t *opt,
+                        replay_stats_t *tot) {
+  FILE *m = fopen(manifest, "r");
+  if (!m) {
+    fprintf(stderr, "cannot open %s\n", manifest);
+    return -1;
+  }
+  char dir[512] = ".";
+  const char *slash = strrchr(manifest, '/');
+  if (slash)
+    snprintf(dir, sizeof(dir), "%.*s", (int)(slash - manifest), manifest);
+
+  char line[1024];
+  int files = 0;
+  while (fgets(line, sizeof(line), m)) {
+    char *hash = strchr(line, '#');
+    if (hash)
+      *hash = '\0';
+    char name[256], raises_s[512] = "-";
+    unsigned steps;
+    int fields = sscanf(line, "%255s %u %511s", name, &steps, raises_s);
+    if (fields < 2)
+      continue;
+    uint32_t raises[MAX_RAISES];
+    int nraises = parse_raises(raises_s, raises);
+    char path[1024];
+    if (name[0] == '/')
+      snprintf(path, sizeof(path), "%s", name);
+    else
+      snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+    replay_stats_t st = {.true_steps = steps};
+    if (!replay_file(path, raises, nraises, opt, &st))
+      continue;
+    print_row(name, &st);
+    accumulate(tot, &st);
+    files++;
+  }
+  fclose(m);
+  return files;
+}
+
+int main(int argc, char **argv) {
+  replay_opts_t opt = {.screen_on_ms = 5000,
+                       .batch = MOTION_TRACE_MAX_BATCH,
+                       .accel_only = false};
+  int argi = 1;
+  while (argi < argc && argv[argi][0] == '-') {
+    if (strcmp(argv[argi], "-a") == 0) {
+      opt.accel_only = true;
+      argi++;
+    } else if (argi + 1 < argc && strcmp(argv[argi], "-s") == 0) {
+      opt.screen_on_ms = (uint32_t)strtoul(argv[argi + 1], NULL, 10);
+      argi += 2;
+    } else if (argi + 1 < argc && strcmp(argv[argi], "-w") == 0) {
+      opt.batch = atoi(argv[argi + 1]);
+      if (opt.batch < 1 || opt.batch > MOTION_TRACE_MAX_BATCH)
+        opt.batch = MOTION_TRACE_MAX_BATCH;
+      argi += 2;
+    } else {
+      break;
+    }
+  }
+  if (argi >= argc) {
+    fprintf(stderr, "usage: %s [-s screen_on_ms] [-w batch] [-a] manifest.txt...\n",
+            argv[0]);
+    return 2;
+  }
+
+  printf("%-24s %8s %7s %6s %6s %7s %7s %5s %6s %6s %7s %7s %7s\n", "trace",
+         "samples", "dur_s", "steps", "found", "err", "raises", "false",
+         "lat_ms", "max_ms", "wake_ms", "ns/smp", "cyc/smp");
+  replay_stats_t tot = {0};
+  int files = 0;
+  for (; argi < argc; ++argi) {
+    int n = run_manifest(argv[argi], &opt, &tot);
+    if (n < 0)
+      return 1;
+    files += n;
+  }
+  if (files == 0) {
+    fprintf(stderr, "no traces replayed\n");
+    return 1;
+  }
+  print_row("TOTAL", &tot);
+  double hours = tot.duration_s / 3600.0;
+  printf("\nfalse wakes/hour: %.2f  raise-to-wake: %s  (cycles are host TSC; 0 "
+         "when unavailable)\n",
+         hours > 0 ? tot.false_wakes / hours : 0.0,
+         opt.accel_only ? "accelerometer only" : "gyro-assisted when recorded");
+  return 0;
+}
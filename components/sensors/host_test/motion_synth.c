@@ -0,0 +1,321 @@
+// Writes a small synthetic *.imt corpus plus its manifests (corpus.txt for
+// motion_replay, activity.txt for activity_eval), so the algorithms can be
+// exercised and compared without recorded traces.
+//
+// Usage: motion_synth [-p period_us] <output_dir>
+//
+// -p writes the corpus at another sample period than the watch's 62.5 Hz,
+// e.g. -p 8000 for the 125 Hz source rate_sim decimates from.
+//
+// The model is deliberately simple: gravity plus a periodic vertical bump
+// per step, arm swing as a pitch oscillation at half the cadence, gaussian
+// noise, wrist raises as a smooth pitch sweep, shaking as a fast pitch
+// oscillation and cycling as broadband road vibration with a steady wrist. The gyro sees the pitch rate about y plus bias and noise.
+// Real recordings from the watch should be preferred for tuning.
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "motion_trace.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define PERIOD_US 16000 // 62.5 Hz, as configured on the watch
+#define MG_PER_LSB (1000.0f / 8192.0f)
+#define DPS_PER_LSB (1.0f / 64.0f) // +-512 dps
+#define BATCH 32
+#define DEG2RAD(d) ((d) * (float)M_PI / 180.0f)
+
+typedef enum { SEG_STILL, SEG_DESK, SEG_WALK, SEG_SHAKE, SEG_CYCLE } seg_kind_t;
+
+typedef struct {
+  seg_kind_t kind;
+  float seconds;
+  float cadence_hz; // steps per second (SEG_WALK), shakes (SEG_SHAKE),
+                    // pedal turns (SEG_CYCLE)
+  float bump_mg;    // vertical bump amplitude (SEG_WALK), pitch swing in
+                    // degrees (SEG_SHAKE), vibration (SEG_CYCLE)
+} segment_t;
+
+typedef struct {
+  float t_s;       // start of the event from the beginning of the trace
+  float pitch_deg; // peak pitch change; > 55 is a deliberate raise
+} gesture_t;
+
+typedef struct {
+  const char *name;
+  segment_t seg[4];
+  int nseg;
+  gesture_t gest[8];
+  int ngest;
+} scenario_t;
+
+static const scenario_t k_scenarios[] = {
+    {"walk_slow.imt", {{SEG_WALK, 120, 1.6f, 250}}, 1, {{0, 0}}, 0},
+    {"walk_brisk.imt", {{SEG_WALK, 120, 2.0f, 320}}, 1, {{0, 0}}, 0},
+    {"run.imt", {{SEG_WALK, 60, 2.7f, 650}}, 1, {{0, 0}}, 0},
+    {"desk.imt",
+     {{SEG_DESK, 300, 0, 0}},
+     1,
+     {{30, 30}, {60, 75}, {100, 35}, {150, 80}, {200, 25}, {240, 70}},
+     6},
+    {"commute.imt",
+     {{SEG_STILL, 30, 0, 0}, {SEG_WALK, 90, 1.8f, 280}, {SEG_STILL, 30, 0, 0}},
+     3,
+     {{60, 75}, {135, 80}},
+     2},
+    // Hand shaking / gesturing in bursts, then a deliberate raise
+    {"shake.imt",
+     {{SEG_SHAKE, 90, 1.4f, 38}, {SEG_STILL, 30, 0, 0}},
+     2,
+     {{100, 70}},
+     1},
+    {"cycle.imt",
+     {{SEG_STILL, 20, 0, 0},
+      {SEG_CYCLE, 150, 1.3f, 70},
+      {SEG_WALK, 60, 1.8f, 280},
+      {SEG_STILL, 20, 0, 0}},
+     4,
+     {{0, 0}},
+     0},
+};
+
+#define RUN_CADENCE_HZ 2.35f // labelled "run" from here
+
+// Shaking comes in 5 s bursts every 15 s
+static bool shake_burst(float t) { return fmodf(t, 15.0f) < 5.0f; }
+
+static uint32_t s_period_us = PERIOD_US;
+
+static uint64_t s_rng = 0x9E3779B97F4A7C15ull;
+
+static float frand(void) {
+  s_rng ^= s_rng << 13;
+  s_rng ^= s_rng >> 7;
+  s_rng ^= s_rng << 17;
+  return (float)((s_rng >> 11) * (1.0 / 9007199254740992.0));
+}
+
+static float gauss(float sigma) {
+  float u1 = frand(), u2 = frand();
+  if (u1 < 1e-9f)
+    u1 = 1e-9f;
+  return sigma * sqrtf(-2.0f * logf(u1)) * cosf(2.0f * (float)M_PI * u2);
+}
+
+// Pitch offset of a gesture: 0.5 s smooth sweep up, 3 s hold, 0.8 s down
+static float gesture_pitch(const gesture_t *g, float t) {
+  float dt = t - g->t_s;
+  if (dt < 0 || dt > 4.3f)
+    return 0.0f;
+  if (dt < 0.5f)
+    return g->pitch_deg * 0.5f * (1.0f - cosf((float)M_PI * dt / 0.5f));
+  if (dt < 3.5f)
+    return g->pitch_deg;
+  return g->pitch_deg * 0.5f * (1.0f + cosf((float)M_PI * (dt - 3.5f) / 0.8f));
+}
+
+static uint32_t count_steps(const scenario_t *sc) {
+  uint32_t steps = 0;
+  for (int i = 0; i < sc->nseg; ++i) {
+    if (sc->seg[i].kind == SEG_WALK)
+      steps += (uint32_t)(sc->seg[i].seconds * sc->seg[i].cadence_hz);
+  }
+  return steps;
+}
+
+static int16_t to_lsb(float v) {
+  if (v > 32767.0f)
+    v = 32767.0f;
+  if (v < -32768.0f)
+    v = -32768.0f;
+  return (int16_t)lrintf(v);
+}
+
+static const char *seg_label(const segment_t *seg) {
+  switch (seg->kind) {
+  case SEG_WALK:
+    return seg->cadence_hz >= RUN_CADENCE_HZ ? "run" : "walk";
+  case SEG_CYCLE:
+    return "cycle";
+  case SEG_SHAKE:
+    return "other";
+  default:
+    return "idle";
+  }
+}
+
+// Ground truth for activity_eval: "<trace> <start_s>:<label>,..."
+static void write_activity_labels(const scenario_t *sc, FILE *f) {
+  fprintf(f, "%-16s ", sc->name);
+  float t = 0.0f;
+  int n = 0;
+  for (int i = 0; i < sc->nseg; ++i) {
+    const segment_t *seg = &sc->seg[i];
+    if (seg->kind == SEG_SHAKE) {
+      for (float b = 0.0f; b < seg->seconds; b += 15.0f) {
+        float on = t + b;
+        fprintf(f, "%s%.0f:other,%.0f:idle", n++ ? "," : "", on, on + 5.0f);
+      }
+    } else {
+      fprintf(f, "%s%.0f:%s", n++ ? "," : "", t, seg_label(seg));
+    }
+    t += seg->seconds;
+  }
+  fprintf(f, "\n");
+}
+
+static int write_scenario(const char *dir, const scenario_t *sc, FILE *manifest,
+                          FILE *labels) {
+  char path[512];
+  snprintf(path, sizeof(path), "%s/%s", dir, sc->name);
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, "cannot create %s\n", path);
+    return -1;
+  }
+  motion_trace_write_header(f, s_period_us, MG_PER_LSB, DPS_PER_LSB,
+                            s_period_us, 0);
+
+  int16_t xyz[BATCH * 3], gyro[BATCH * 3];
+  float prev_pitch = 0.0f;
+  const float gyro_bias[3] = {0.4f, -0.3f, 0.2f}; // dps
+  int fill = 0;
+  uint32_t batch_t_ms = 0;
+  uint64_t sample = 0;
+  const float dt = s_period_us / 1e6f;
+  for (int s = 0; s < sc->nseg; ++s) {
+    const segment_t *seg = &sc->seg[s];
+    uint64_t n = (uint64_t)(seg->seconds / dt);
+    float walk_phase = 0.0f;
+    for (uint64_t i = 0; i < n; ++i, ++sample) {
+      float t = sample * dt;
+      float pitch = -10.0f; // resting wrist, display slightly down
+      float vert = 0.0f, lateral = 0.0f, noise = 4.0f;
+      if (seg->kind == SEG_WALK) {
+        walk_phase += 2.0f * (float)M_PI * seg->cadence_hz * dt;
+        // Heel strike: sharp positive bump, then a softer dip
+        float p = sinf(walk_phase);
+        vert = seg->bump_mg * (p > 0 ? p * p : 0.4f * p);
+        pitch += 15.0f * sinf(0.5f * walk_phase); // arm swing
+        lateral = 0.3f * seg->bump_mg * sinf(0.5f * walk_phase + 0.7f);
+        noise = 25.0f;
+      } else if (seg->kind == SEG_DESK) {
+        // Typing: short bursts of high-frequency jitter
+        noise = fmodf(t, 20.0f) < 6.0f ? 35.0f : 6.0f;
+      } else if (seg->kind == SEG_SHAKE && shake_burst(t)) {
+        // 5 s bursts: pitch swings with a little centripetal acceleration,
+        // building up over the first swing
+        float ph = 2.0f * (float)M_PI * seg->cadence_hz * t;
+        float ramp = fminf(fmodf(t, 15.0f) / 0.7f, 1.0f);
+        pitch += ramp * seg->bump_mg * sinf(ph);
+        lateral = 80.0f * sinf(ph + 0.5f);
+        noise = 30.0f;
+      } else if (seg->kind == SEG_CYCLE) {
+        // Hands on the bar: pitch barely moves, a little sway per pedal
+        // turn, vibration from the road on every axis
+        walk_phase += 2.0f * (float)M_PI * seg->cadence_hz * dt;
+        pitch = -30.0f + 2.0f * sinf(walk_phase);
+        lateral = 30.0f * sinf(walk_phase);
+        noise = seg->bump_mg;
+      }
+      for (int g = 0; g < sc->ngest; ++g)
+        pitch += gesture_pitch(&sc->gest[g], t);
+      float rate = sample ? (pitch - prev_pitch) / dt : 0.0f; // dps about y
+      prev_pitch = pitch;
+
+      float pr = DEG2RAD(pitch);
+      float ax = -sinf(pr) * 1000.0f + gauss(noise);
+      float ay = lateral + gauss(noise);
+      float az = cosf(pr) * 1000.0f + vert + gauss(noise);
+      if (fill == 0)
+        batch_t_ms = (uint32_t)(sample * s_period_us / 1000);
+      xyz[fill * 3 + 0] = to_lsb(ax / MG_PER_LSB);
+      xyz[fill * 3 + 1] = to_lsb(ay / MG_PER_LSB);
+      xyz[fill * 3 + 2] = to_lsb(az / MG_PER_LSB);
+      for (int k = 0; k < 3; ++k) {
+        float dps = gyro_bias[k] + gauss(0.5f) + (k == 1 ? rate : 0.0f);
+        gyro[fill * 3 + k] = to_lsb(dps / DPS_PER_LSB);
+      }
+      if (++fill == BATCH) {
+        motion_trace_write_batch(f, batch_t_ms, 0, xyz, gyro, BATCH);
+        fill = 0;
+      }
+    }
+  }
+  if (fill)
+    motion_trace_write_batch(f, batch_t_ms, 0, xyz, gyro, (uint16_t)fill);
+  fclose(f);
+
+  // Only deliberate raises are labelled; smaller gestures must not wake
+  fprintf(manifest, "%-16s %5u ", sc->name, count_steps(sc));
+  int labelled = 0;
+  for (int g = 0; g < sc->ngest; ++g) {
+    if (sc->gest[g].pitch_deg <= 55.0f)
+      continue;
+    fprintf(manifest, "%s%u", labelled ? "," : "",
+            (unsigned)(sc->gest[g].t_s * 1000.0f));
+    labelled++;
+  }
+  fprintf(manifest, "%s\n", labelled ? "" : "-");
+  write_activity_labels(sc, labels);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int arg = 1;
+  if (argc == 4 && strcmp(argv[1], "-p") == 0) {
+    long p = strtol(argv[2], NULL, 10);
+    if (p < 1000 || p > 100000) {
+      fprintf(stderr, "period out of range: %s\n", argv[2]);
+      return 2;
+    }
+    s_period_us = (uint32_t)p;
+    arg = 3;
+  }
+  if (argc != arg + 1) {
+    fprintf(stderr, "usage: %s [-p period_us] <output_dir>\n", argv[0]);
+    return 2;
+  }
+  const char *dir = argv[arg];
+  if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+    perror(dir);
+    return 1;
+  }
+  char path[512];
+  snprintf(path, sizeof(path), "%s/corpus.txt", dir);
+  FILE *manifest = fopen(path, "w");
+  if (!manifest) {
+    perror(path);
+    return 1;
+  }
+  snprintf(path, sizeof(path), "%s/activity.txt", dir);
+  FILE *labels = fopen(path, "w");
+  if (!labels) {
+    perror(path);
+    fclose(manifest);
+    return 1;
+  }
+  fprintf(manifest, "# trace            steps  raise_ms (synthetic corpus)\n");
+  fprintf(labels, "# trace            start_s:activity,... (synthetic corpus)\n");
+  int rc = 0;
+  for (size_t i = 0; i < sizeof(k_scenarios) / sizeof(k_scenarios[0]); ++i) {
+    if (write_scenario(dir, &k_scenarios[i], manifest, labels) != 0) {
+      rc = 1;
+      break;
+    }
+  }
+  fclose(manifest);
+  fclose(labels);
+  if (rc)
+    return rc;
+  printf("wrote %zu traces, corpus.txt and activity.txt in %s\n",
+         sizeof(k_scenarios) / sizeof(k_scenarios[0]), dir);
+  return 0;
+}
@@ -0,0 +1,325 @@
+// Simulates the accelerometer rate governor (motion_rate.h) on *.imt traces
+// and compares it with fixed rates: step and raise-to-wake accuracy against
+// the manifest, and the sensor work that sets the current draw.
+//
+// Usage: rate_sim [-s screen_on_ms] manifest.txt...
+//
+// Manifests are those of motion_replay. Each rate is produced from the
+// trace by averaging consecutive samples (the IMU's own filter does
+// similar), so traces must be recorded at the highest rate simulated:
+//   motion_synth -p 8000 corpus125 && rate_sim corpus125/corpus.txt
+// Traces at a lower rate (e.g. from the watch at 62.5 Hz) cap HIGH at their
+// own rate. As on the watch, batches are 32 samples at the current rate,
+// the software step detector counts, raise-to-wake runs while the simulated
+// screen is off and the governor picks the rate of the next batch.
+//
+// The current estimate covers the work the rate controls: ESP32-S3 wakeups
+// (light sleep exit, FIFO count and CTRL9 handshake, back to sleep) and the
+// I2C transfer and processing of each sample. Constants are estimates, to be
+// replaced with measurements; the accelerometer's own current, which also
+// falls with the ODR, is not included.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "motion_algo.h"
+#include "motion_rate.h"
+#include "motion_trace.h"
+
+#define WATERMARK 32 // IMU_FIFO_WATERMARK
+#define MAX_RAISES 64
+#define RAISE_EARLY_MS 200
+#define RAISE_LATE_MS 1500
+#define UC_PER_WAKEUP 60.0 // ~2 ms awake at ~30 mA
+#define UC_PER_SAMPLE 5.0  // 6 bytes at 400 kHz plus processing
+#define UC_PER_SWITCH 40.0 // CTRL2, pedometer pages, FIFO reset
+
+enum { MODE_LOW, MODE_MID, MODE_HIGH, MODE_GOVERNED, MODE_COUNT };
+static const char *k_mode_names[MODE_COUNT] = {"fixed 31.25 Hz",
+                                               "fixed 62.5 Hz", "fixed 125 Hz",
+                                               "governed"};
+
+typedef struct {
+  int16_t *xyz;
+  uint32_t *t_ms;
+  size_t n;
+  uint32_t period_us;
+} trace_t;
+
+typedef struct {
+  double duration_s;
+  uint32_t true_steps, steps, abs_step_err;
+  int true_raises, hits, false_wakes;
+  uint64_t latency_sum_ms;
+  uint64_t samples, wakeups, switches;
+  double time_at[MOTION_RATE_COUNT]; // seconds
+  bool capped;
+} sim_stats_t;
+
+static int parse_raises(const char *s, uint32_t *out) {
+  int n = 0;
+  if (strcmp(s, "-") == 0)
+    return 0;
+  while (*s && n < MAX_RAISES) {
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (end == s)
+      break;
+    out[n++] = (uint32_t)v;
+    s = (*end == ',') ? end + 1 : end;
+  }
+  return n;
+}
+
+// Accelerometer samples of a trace with their times, rescaled to Q13 g
+static bool load_trace(const char *path, trace_t *tr) {
+  FILE *f = fopen(path, "rb");
+  motion_trace_header_t hdr;
+  if (!f || !motion_trace_read_header(f, &hdr)) {
+    fprintf(stderr, "cannot read %s\n", path);
+    if (f)
+      fclose(f);
+    return false;
+  }
+  memset(tr, 0, sizeof(*tr));
+  size_t cap = 0;
+  static int16_t xyz[MOTION_TRACE_MAX_BATCH * 3], gyro[MOTION_TRACE_MAX_BATCH * 3];
+  motion_trace_batch_t b;
+  while (motion_trace_read_batch(f, &b, xyz, gyro)) {
+    uint32_t period = (b.flags & MOTION_TRACE_F_GYRO) ? hdr.gyro_period_us
+                                                      : hdr.sample_period_us;
+    if (!tr->period_us)
+      tr->period_us = period;
+    if (tr->n + b.count > cap) {
+      cap = (tr->n + b.count) * 2;
+      tr->xyz = realloc(tr->xyz, cap * 3 * sizeof(int16_t));
+      tr->t_ms = realloc(tr->t_ms, cap * sizeof(uint32_t));
+      if (!tr->xyz || !tr->t_ms) {
+        fclose(f);
+        return false;
+      }
+    }
+    for (int i = 0; i < b.count; ++i) {
+      for (int k = 0; k < 3; ++k) {
+        long v = lrintf(xyz[i * 3 + k] * hdr.mg_per_lsb * 8.192f);
+        tr->xyz[(tr->n + i) * 3 + k] =
+            (int16_t)(v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v);
+      }
+      tr->t_ms[tr->n + i] =
+          b.t_ms + (uint32_t)((uint64_t)i * period / 1000);
+    }
+    tr->n += b.count;
+  }
+  fclose(f);
+  return tr->n > 0;
+}
+
+static void simulate(const trace_t *tr, int mode, const uint32_t *raises,
+                     int nraises, uint32_t screen_on_ms, sim_stats_t *st) {
+  static motion_algo_t algo;
+  motion_rate_gov_t gov;
+  motion_algo_init(&algo);
+  uint32_t t_first = tr->t_ms[0];
+  motion_rate_init(&gov, t_first);
+  motion_rate_t rate = mode == MODE_GOVERNED ? gov.rate : (motion_rate_t)mode;
+  bool matched[MAX_RAISES] = {0};
+  bool screen_on = false;
+  uint32_t screen_off_at = 0;
+  int16_t xyz[WATERMARK * 3];
+  size_t pos = 0;
+  while (pos < tr->n) {
+    // Samples of the trace per sample at this rate
+    uint32_t period = motion_rate_period_us(rate);
+    size_t k = period / tr->period_us;
+    if (k < 1) {
+      k = 1;
+      period = tr->period_us;
+      st->capped = true;
+    }
+    int n = 0;
+    uint32_t t0_ms = tr->t_ms[pos];
+    while (n < WATERMARK && pos + k <= tr->n) {
+      int32_t sum[3] = {0, 0, 0};
+      for (size_t j = 0; j < k; ++j)
+        for (int c = 0; c < 3; ++c)
+          sum[c] += tr->xyz[(pos + j) * 3 + c];
+      for (int c = 0; c < 3; ++c)
+        xyz[n * 3 + c] = (int16_t)(sum[c] / (int32_t)k);
+      pos += k;
+      n++;
+    }
+    if (n == 0)
+      break;
+    motion_batch_t batch = {
+        .xyz = xyz, .n = n, .t0_ms = t0_ms, .period_us = period};
+    uint32_t t_end = t0_ms + (uint32_t)((uint64_t)(n - 1) * period / 1000);
+    if (screen_on && (int32_t)(t0_ms - screen_off_at) >= 0)
+      screen_on = false;
+    bool armed = !screen_on;
+    motion_algo_result_t res;
+    motion_algo_process(&algo, &batch, true, armed, &res);
+    st->steps += res.steps;
+    st->samples += (uint64_t)n;
+    st->wakeups++;
+    st->time_at[rate] += n * period / 1e6;
+
+    if (res.raise) {
+      screen_on = true;
+      screen_off_at = res.raise_t_ms + screen_on_ms;
+      uint32_t t = res.raise_t_ms - t_first;
+      bool hit = false;
+      for (int r = 0; r < nraises && !hit; ++r) {
+        if (!matched[r] && t + RAISE_EARLY_MS >= raises[r] &&
+            t <= raises[r] + RAISE_LATE_MS) {
+          matched[r] = hit = true;
+          st->latency_sum_ms += t > raises[r] ? t - raises[r] : 0;
+        }
+      }
+      if (hit)
+        st->hits++;
+      else
+        st->false_wakes++;
+    }
+
+    if (mode == MODE_GOVERNED) {
+      motion_rate_input_t in = {.motion = res.motion,
+                                .raise_armed = armed,
+                                .activity = motion_algo_activity(&algo)};
+      rate = motion_rate_update(&gov, &in, t_end);
+    }
+  }
+  st->switches += gov.switches;
+  st->true_raises += nraises;
+  st->duration_s += (tr->t_ms[tr->n - 1] - t_first) / 1000.0;
+}
+
+static void accumulate(sim_stats_t *tot, const sim_stats_t *st) {
+  tot->duration_s += st->duration_s;
+  tot->true_steps += st->true_steps;
+  tot->steps += st->steps;
+  tot->abs_step_err += st->abs_step_err;
+  tot->true_raises += st->true_raises;
+  tot->hits += st->hits;
+  tot->false_wakes += st->false_wakes;
+  tot->latency_sum_ms += st->latency_sum_ms;
+  tot->samples += st->samples;
+  tot->wakeups += st->wakeups;
+  tot->switches += st->switches;
+  for (int r = 0; r < MOTION_RATE_COUNT; ++r)
+    tot->time_at[r] += st->time_at[r];
+  tot->capped |= st->capped;
+}
+
+static double est_ua(const sim_stats_t *st) {
+  if (st->duration_s <= 0)
+    return 0.0;
+  return (st->wakeups * UC_PER_WAKEUP + st->samples * UC_PER_SAMPLE +
+          st->switches * UC_PER_SWITCH) /
+         st->duration_s;
+}
+
+static void print_row(const char *name, const sim_stats_t *st) {
+  double err = st->true_steps ? 100.0 * st->abs_step_err / st->true_steps : 0.0;
+  double h = st->duration_s / 3600.0;
+  double total = st->time_at[0] + st->time_at[1] + st->time_at[2];
+  if (total <= 0)
+    total = 1;
+  printf("%-16.16s %6u %6u %6.1f%% %3d/%-3d %5d %6.0f %8.0f %7.0f %5.0f "
+         "%3.0f/%3.0f/%3.0f %7.0f\n",
+         name, st->true_steps, st->steps, err, st->hits, st->true_raises,
+         st->false_wakes, st->hits ? (double)st->latency_sum_ms / st->hits : 0.0,
+         h > 0 ? st->samples / h : 0.0, h > 0 ? st->wakeups / h : 0.0,
+         h > 0 ? st->switches / h : 0.0, 100.0 * st->time_at[0] / total,
+         100.0 * st->time_at[1] / total, 100.0 * st->time_at[2] / total,
+         est_ua(st));
+}
+
+static void print_header(void) {
+  printf("%-16s %6s %6s %7s %7s %5s %6s %8s %7s %5s %11s %7s\n", "trace",
+         "steps", "found", "|err|", "raises", "false", "lat_ms", "smp/h",
+         "wake/h", "sw/h", "L/M/H %", "est_uA");
+}
+
+int main(int argc, char **argv) {
+  uint32_t screen_on_ms = 5000;
+  int argi = 1;
+  if (argi + 1 < argc && strcmp(argv[argi], "-s") == 0) {
+    screen_on_ms = (uint32_t)strtoul(argv[argi + 1], NULL, 10);
+    argi += 2;
+  }
+  if (argi >= argc) {
+    fprintf(stderr, "usage: %s [-s screen_on_ms] manifest.txt...\n", argv[0]);
+    return 2;
+  }
+
+  sim_stats_t tot[MODE_COUNT];
+  memset(tot, 0, sizeof(tot));
+  int files = 0;
+  print_header();
+  for (; argi < argc; ++argi) {
+    FILE *m = fopen(argv[argi], "r");
+    if (!m) {
+      fprintf(stderr, "cannot open %s\n", argv[argi]);
+      return 1;
+    }
+    char dir[512] = ".";
+    const char *slash = strrchr(argv[argi], '/');
+    if (slash)
+      snprintf(dir, sizeof(dir), "%.*s", (int)(slash - argv[argi]), argv[argi]);
+    char line[1024];
+    while (fgets(line, sizeof(line), m)) {
+      char *hash = strchr(line, '#');
+      if (hash)
+        *hash = '\0';
+      char name[256], raises_s[512] = "-";
+      unsigned steps;
+      if (sscanf(line, "%255s %u %511s", name, &steps, raises_s) < 2)
+        continue;
+      uint32_t raises[MAX_RAISES];
+      int nraises = parse_raises(raises_s, raises);
+      char path[1024];
+      if (name[0] == '/')
+        snprintf(path, sizeof(path), "%s", name);
+      else
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+      trace_t tr;
+      if (!load_trace(path, &tr))
+        continue;
+      for (int mode = 0; mode < MODE_COUNT; ++mode) {
+        sim_stats_t st = {.true_steps = steps};
+        simulate(&tr, mode, raises, nraises, screen_on_ms, &st);
+        st.abs_step_err = (uint32_t)abs((int)st.steps - (int)steps);
+        if (mode == MODE_GOVERNED)
+          print_row(name, &st);
+        accumulate(&tot[mode], &st);
+      }
+      free(tr.xyz);
+      free(tr.t_ms);
+      files++;
+    }
+    fclose(m);
+  }
+  if (files == 0) {
+    fprintf(stderr, "no traces simulated\n");
+    return 1;
+  }
+  printf("\n");
+  print_header();
+  for (int mode = 0; mode < MODE_COUNT; ++mode)
+    print_row(k_mode_names[mode], &tot[mode]);
+  if (tot[MODE_HIGH].capped)
+    printf("(traces below 125 Hz: HIGH runs at the trace rate)\n");
+
+  // The governor must not cost accuracy against the watch's fixed 62.5 Hz
+  const sim_stats_t *g = &tot[MODE_GOVERNED], *ref = &tot[MODE_MID];
+  bool ok = g->abs_step_err <= ref->abs_step_err + ref->true_steps / 100 &&
+            g->hits >= ref->hits && g->false_wakes <= ref->false_wakes;
+  printf("governed vs fixed 62.5 Hz: %.0f%% of the samples, %.0f%% of the "
+         "wakeups, est. %.0f%% of the current\n%s\n",
+         100.0 * g->samples / (ref->samples ? ref->samples : 1),
+         100.0 * g->wakeups / (ref->wakeups ? ref->wakeups : 1),
+         100.0 * est_ua(g) / (est_ua(ref) > 0 ? est_ua(ref) : 1),
+         ok ? "OK" : "FAIL");
+  return ok ? 0 : 1;
+}
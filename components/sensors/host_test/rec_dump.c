@@ -0,0 +1,328 @@
+// Reads *.imc recordings (motion_rec.h) from the watch's SD card.
+//
+// Usage: rec_dump [-o out.imt] recording.imc
+//        rec_dump -r trace.imt...
+//        rec_dump -c out.imc trace.imt
+//
+// The first form checks every block (magic, CRC, layout) and the index
+// (each entry must match the block it points to), prints the totals,
+// compression against *.imt, activity labels and gaps between batches, and
+// with -o converts the recording to *.imt for motion_replay/activity_eval.
+// -r round-trips *.imt traces through the encoder in memory, labelled by
+// motion_algo as on the watch, and checks that decoding gives back the
+// same samples; it reports bytes per sample and the encoder cost. -c also
+// writes the result as a recording, as the watch would have.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "motion_algo.h"
+#include "motion_rec.h"
+#include "motion_trace.h"
+
+#define NLABELS 5
+#define GAP_MS 1000 // batches further apart than this count as a gap
+#define MAX_BLOCKS 2048
+
+static const char *k_labels[NLABELS] = {"idle", "walk", "run", "other",
+                                        "cycle"};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static bool read_block(FILE *f, long n, uint8_t *blk) {
+  return fseek(f, n * MOTION_REC_BLOCK_SIZE, SEEK_SET) == 0 &&
+         fread(blk, MOTION_REC_BLOCK_SIZE, 1, f) == 1;
+}
+
+static int dump(const char *path, const char *out_path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return 1;
+  }
+  static uint8_t blk[MOTION_REC_BLOCK_SIZE];
+  static motion_rec_block_t dec;
+  motion_rec_header_t hdr;
+  if (!read_block(f, 0, blk) || !motion_rec_read_header(blk, &hdr)) {
+    fprintf(stderr, "%s: not an IMC1 recording\n", path);
+    fclose(f);
+    return 1;
+  }
+  fseek(f, 0, SEEK_END);
+  long nblocks = ftell(f) / MOTION_REC_BLOCK_SIZE;
+
+  FILE *out = NULL;
+  if (out_path) {
+    out = fopen(out_path, "wb");
+    if (!out || !motion_trace_write_header(out, hdr.sample_period_us,
+                                           hdr.mg_per_lsb, hdr.dps_per_lsb,
+                                           hdr.gyro_period_us,
+                                           hdr.start_epoch)) {
+      fprintf(stderr, "cannot write %s\n", out_path);
+      fclose(f);
+      return 1;
+    }
+  }
+
+  int errors = 0;
+  long data = 0;
+  uint64_t samples = 0, gyro_samples = 0, batches = 0, gaps = 0;
+  uint64_t label_samples[NLABELS] = {0};
+  uint64_t t_first = 0, t_last = 0;
+  motion_rec_index_t idx;
+  bool have_index = false;
+  static int16_t xyz[MOTION_REC_MAX_SAMPLES * 3], gyro[MOTION_REC_MAX_SAMPLES * 3];
+  for (long n = 1; n < nblocks; ++n) {
+    if (!read_block(f, n, blk))
+      break;
+    if (n == nblocks - 1 && motion_rec_read_index(blk, &idx)) {
+      have_index = true;
+      break;
+    }
+    if (!motion_rec_decode(blk, &dec)) {
+      printf("block %ld: bad block\n", n);
+      errors++;
+      continue;
+    }
+    if (dec.hdr.seq != (uint32_t)n) {
+      printf("block %ld: sequence %u\n", n, dec.hdr.seq);
+      errors++;
+    }
+    data++;
+    int row = 0, grow = 0;
+    for (int i = 0; i < dec.hdr.batches; ++i) {
+      const motion_rec_batch_t *b = &dec.batch[i];
+      uint64_t end = b->t0_us + (uint64_t)(b->n ? b->n - 1 : 0) * b->period_us;
+      if (samples && b->t0_us > t_last + GAP_MS * 1000ull)
+        gaps++;
+      if (!samples)
+        t_first = b->t0_us;
+      t_last = end;
+      samples += b->n;
+      batches++;
+      label_samples[b->label < NLABELS ? b->label : 0] += b->n;
+      bool has_gyro = b->flags & MOTION_TRACE_F_GYRO;
+      for (int k = 0; k < b->n; ++k) {
+        for (int c = 0; c < 3; ++c) {
+          xyz[k * 3 + c] = dec.col[c][row + k];
+          if (has_gyro)
+            gyro[k * 3 + c] = dec.col[3 + c][grow + k];
+        }
+      }
+      row += b->n;
+      if (has_gyro) {
+        grow += b->n;
+        gyro_samples += b->n;
+      }
+      // *.imt batches carry ms timestamps; sub-ms parts are dropped
+      if (out && !motion_trace_write_batch(out, (uint32_t)(b->t0_us / 1000),
+                                           b->flags, xyz,
+                                           has_gyro ? gyro : NULL, b->n)) {
+        fprintf(stderr, "write failed\n");
+        errors++;
+      }
+    }
+  }
+
+  // Seek through the index: every entry must match its block
+  if (have_index) {
+    if (idx.blocks != (uint32_t)data || idx.samples != samples) {
+      printf("index: %u blocks / %u samples, file has %ld / %llu\n",
+             idx.blocks, idx.samples, data, (unsigned long long)samples);
+      errors++;
+    }
+    for (uint32_t i = 0; i < idx.count; ++i) {
+      long n = 1 + (long)i * idx.stride;
+      if (!read_block(f, n, blk) || !motion_rec_decode(blk, &dec) ||
+          (uint32_t)((dec.hdr.t0_us - idx.t0_us) / 1000) != idx.t_ms[i]) {
+        printf("index entry %u does not match block %ld\n", i, n);
+        errors++;
+      }
+    }
+  }
+  fclose(f);
+  if (out)
+    fclose(out);
+
+  double dur = samples ? (t_last - t_first) / 1e6 : 0.0;
+  uint64_t imt = sizeof(motion_trace_header_t) +
+                 batches * sizeof(motion_trace_batch_t) +
+                 (samples + gyro_samples) * 6;
+  printf("%s: %ld data blocks, %llu batches, %llu samples (%llu with gyro), "
+         "%.0f s, %llu gaps\n",
+         path, data, (unsigned long long)batches, (unsigned long long)samples,
+         (unsigned long long)gyro_samples, dur, (unsigned long long)gaps);
+  printf("  %.2f bytes/sample on disk (*.imt: %.2f), index %s",
+         samples ? (double)nblocks * MOTION_REC_BLOCK_SIZE / samples : 0.0,
+         samples ? (double)imt / samples : 0.0,
+         have_index ? "present" : "missing (recording cut short)");
+  if (have_index)
+    printf(", %u entries, stride %u", idx.count, idx.stride);
+  printf("\n  labels:");
+  for (int i = 0; i < NLABELS; ++i)
+    printf(" %s %.1f%%", k_labels[i],
+           samples ? 100.0 * label_samples[i] / samples : 0.0);
+  printf("\n%s\n", errors ? "FAIL" : "OK");
+  return errors ? 1 : 0;
+}
+
+// Encode one *.imt trace, decode it again and compare
+static int round_trip(const char *path, const char *imc_path,
+                      uint64_t *bytes_sum, uint64_t *samples_sum,
+                      uint64_t *ns_sum) {
+  FILE *f = fopen(path, "rb");
+  motion_trace_header_t hdr;
+  if (!f || !motion_trace_read_header(f, &hdr)) {
+    fprintf(stderr, "cannot read %s\n", path);
+    if (f)
+      fclose(f);
+    return 1;
+  }
+  static motion_rec_enc_t enc;
+  static motion_algo_t algo;
+  static uint8_t blocks[MAX_BLOCKS + 2][MOTION_REC_BLOCK_SIZE];
+  static int16_t xyz[MOTION_TRACE_MAX_BATCH * 3],
+      gyro[MOTION_TRACE_MAX_BATCH * 3];
+  // Reference copy of what went in
+  static int16_t ref[1 << 22];
+  static motion_rec_block_t dec;
+  size_t nref = 0;
+  int nblocks = 0, errors = 0;
+  uint64_t samples = 0, ns = 0;
+  motion_rec_enc_init(&enc);
+  motion_algo_init(&algo);
+
+  motion_trace_batch_t tb;
+  while (motion_trace_read_batch(f, &tb, xyz, gyro)) {
+    bool has_gyro = tb.flags & MOTION_TRACE_F_GYRO;
+    uint32_t period = has_gyro ? hdr.gyro_period_us : hdr.sample_period_us;
+    motion_batch_t mb = {.xyz = xyz,
+                         .gyro = has_gyro ? gyro : NULL,
+                         .n = tb.count,
+                         .t0_ms = tb.t_ms,
+                         .period_us = period};
+    motion_algo_result_t res;
+    motion_algo_process(&algo, &mb, true, false, &res);
+    for (int i = 0; i < tb.count && nref + 6 <= sizeof(ref) / 2; ++i) {
+      for (int c = 0; c < 3; ++c) {
+        ref[nref++] = xyz[i * 3 + c];
+        ref[nref++] = has_gyro ? gyro[i * 3 + c] : 0;
+      }
+    }
+    motion_rec_batch_t b = {.t0_us = (uint64_t)tb.t_ms * 1000,
+                            .period_us = period,
+                            .n = tb.count,
+                            .flags = tb.flags,
+                            .label = (uint8_t)motion_algo_activity(&algo)};
+    int off = 0;
+    uint64_t t0 = now_ns();
+    while (off < tb.count && nblocks < MAX_BLOCKS) {
+      bool sealed;
+      motion_rec_batch_t part = b;
+      part.t0_us = b.t0_us + (uint64_t)off * period;
+      part.n = (uint16_t)(tb.count - off);
+      off += motion_rec_enc_add(&enc, &part, xyz + off * 3,
+                                has_gyro ? gyro + off * 3 : NULL,
+                                blocks[nblocks], &sealed);
+      if (sealed)
+        nblocks++;
+    }
+    ns += now_ns() - t0;
+    samples += tb.count;
+  }
+  fclose(f);
+  if (nblocks < MAX_BLOCKS && motion_rec_enc_flush(&enc, blocks[nblocks]))
+    nblocks++;
+
+  // Decode and compare
+  size_t k = 0;
+  for (int n = 0; n < nblocks; ++n) {
+    if (!motion_rec_decode(blocks[n], &dec)) {
+      printf("%s: block %d does not decode\n", path, n + 1);
+      errors++;
+      continue;
+    }
+    int row = 0, grow = 0;
+    for (int i = 0; i < dec.hdr.batches; ++i) {
+      bool has_gyro = dec.batch[i].flags & MOTION_TRACE_F_GYRO;
+      for (int s = 0; s < dec.batch[i].n && k + 6 <= nref; ++s) {
+        for (int c = 0; c < 3; ++c) {
+          int16_t g = has_gyro ? dec.col[3 + c][grow + s] : 0;
+          if (dec.col[c][row + s] != ref[k] || g != ref[k + 1])
+            errors++;
+          k += 2;
+        }
+      }
+      row += dec.batch[i].n;
+      if (has_gyro)
+        grow += dec.batch[i].n;
+    }
+  }
+  if (k != nref)
+    errors++;
+
+  if (imc_path) {
+    FILE *out = fopen(imc_path, "wb");
+    uint8_t *hb = blocks[MAX_BLOCKS + 1];
+    motion_rec_header(hb, hdr.sample_period_us, hdr.gyro_period_us,
+                      hdr.mg_per_lsb, hdr.dps_per_lsb, hdr.start_epoch);
+    bool ok = out && fwrite(hb, MOTION_REC_BLOCK_SIZE, 1, out) == 1 &&
+              fwrite(blocks, MOTION_REC_BLOCK_SIZE, (size_t)nblocks, out) ==
+                  (size_t)nblocks;
+    motion_rec_enc_index(&enc, hb);
+    ok = ok && fwrite(hb, MOTION_REC_BLOCK_SIZE, 1, out) == 1;
+    if (out)
+      ok = (fclose(out) == 0) && ok;
+    if (!ok) {
+      fprintf(stderr, "cannot write %s\n", imc_path);
+      errors++;
+    }
+  }
+  printf("%-28.28s %8llu samples %6d blocks %6.2f B/sample %7.0f ns/sample "
+         "%s\n",
+         path, (unsigned long long)samples, nblocks,
+         samples ? (double)nblocks * MOTION_REC_BLOCK_SIZE / samples : 0.0,
+         samples ? (double)ns / samples : 0.0, errors ? "MISMATCH" : "ok");
+  *bytes_sum += (uint64_t)nblocks * MOTION_REC_BLOCK_SIZE;
+  *samples_sum += samples;
+  *ns_sum += ns;
+  return errors ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc >= 3 && strcmp(argv[1], "-r") == 0) {
+    uint64_t bytes = 0, samples = 0, ns = 0;
+    int failed = 0;
+    for (int i = 2; i < argc; ++i)
+      failed += round_trip(argv[i], NULL, &bytes, &samples, &ns);
+    printf("TOTAL %llu samples, %.2f bytes/sample (raw accel+gyro *.imt "
+           "samples: 6-12), %.0f ns/sample to encode\n%s\n",
+           (unsigned long long)samples,
+           samples ? (double)bytes / samples : 0.0,
+           samples ? (double)ns / samples : 0.0, failed ? "FAIL" : "OK");
+    return failed ? 1 : 0;
+  }
+  if (argc == 4 && strcmp(argv[1], "-c") == 0) {
+    uint64_t bytes = 0, samples = 0, ns = 0;
+    return round_trip(argv[3], argv[2], &bytes, &samples, &ns);
+  }
+  const char *out = NULL;
+  int i = 1;
+  if (argc >= 4 && strcmp(argv[1], "-o") == 0) {
+    out = argv[2];
+    i = 3;
+  }
+  if (i >= argc) {
+    fprintf(stderr, "usage: %s [-o out.imt] recording.imc\n"
+                    "       %s -r trace.imt...\n"
+                    "       %s -c out.imc trace.imt\n",
+            argv[0], argv[0], argv[0]);
+    return 2;
+  }
+  return dump(argv[i], out);
+}
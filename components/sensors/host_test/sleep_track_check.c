@@ -0,0 +1,220 @@
+// Host check for the nightly sleep records (sleep_track.c). A child process
+// records simulated nights through the same calls sensors_task makes (one
+// update per any-motion event, the first with a batch's activity), then
+// exits; the parent reopens the file (as after a reboot), reads the nights
+// back and scores the sleep/wake segmentation against the simulated truth.
+// It also estimates the sensor work of a night in sleep mode against the
+// screen-off daytime path.
+//
+// Usage: sleep_track_check <scratch dir> [nights]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sleep_track.h"
+
+#define T0 1735767000 // 2025-01-01 21:30 UTC
+#define MAX_NIGHTS 32
+
+typedef struct {
+  int n;
+  uint8_t events[SLEEP_TRACK_MAX_EPOCHS];
+  uint16_t activity[SLEEP_TRACK_MAX_EPOCHS];
+  uint8_t truth[SLEEP_TRACK_MAX_EPOCHS]; // 1 = asleep
+} night_sim_t;
+
+static uint32_t s_rng;
+static uint32_t rnd(uint32_t n) {
+  s_rng = s_rng * 1103515245u + 12345u;
+  return (s_rng >> 8) % n;
+}
+
+static void awake(night_sim_t *s, int from, int len, int lo, int hi) {
+  for (int e = from; e < from + len && e < s->n; ++e) {
+    s->truth[e] = 0;
+    // Lying awake is not always moving
+    s->events[e] = rnd(4) == 0 ? 0 : (uint8_t)(lo + rnd((uint32_t)(hi - lo)));
+    s->activity[e] = s->events[e] ? (uint16_t)(30 + rnd(150)) : 0;
+  }
+}
+
+// Night k: settling in, sleep with roll-overs, a few awakenings, getting up
+static void make_night(int k, night_sim_t *s) {
+  s_rng = 1000u + (uint32_t)k;
+  memset(s, 0, sizeof(*s));
+  s->n = 420 + (int)rnd(240);
+  for (int e = 0; e < s->n; ++e) {
+    s->truth[e] = 1;
+    if (rnd(30) == 0) { // roll-over
+      s->events[e] = (uint8_t)(1 + rnd(2));
+      s->activity[e] = (uint16_t)(10 + rnd(40));
+    }
+  }
+  int latency = 10 + (int)rnd(30);
+  awake(s, 0, latency, 1, 6);
+  int wakes = (int)rnd(4);
+  for (int w = 0; w < wakes; ++w)
+    awake(s, latency + 40 + (int)rnd((uint32_t)(s->n - latency - 80)),
+          5 + (int)rnd(20), 2, 10);
+  awake(s, s->n - 10 - (int)rnd(20), 30, 3, 12);
+}
+
+static void record_night(int k, const night_sim_t *s) {
+  time_t start = T0 + (time_t)k * 86400;
+  sleep_track_begin(start);
+  for (int e = 0; e < s->n; ++e) {
+    time_t t = start + (time_t)e * 60 + 3;
+    for (int j = 0; j < s->events[e]; ++j)
+      sleep_track_update(t + j * 2, 1, j == 0 ? s->activity[e] : 0);
+    // Epoch timeout wakeup
+    sleep_track_update(start + (time_t)(e + 1) * 60, 0, 0);
+    sleep_track_add_cost(1 + s->events[e], s->events[e] ? 32 : 0);
+  }
+  sleep_track_end(start + (time_t)s->n * 60);
+}
+
+typedef struct {
+  uint32_t epochs, agree, sleep_truth, sleep_hit, wake_truth, wake_hit;
+  int onset_err_max;
+  uint64_t wakeups, samples, idle_wakeups, idle_samples;
+} score_t;
+
+static int check_night(int k, const sleep_track_night_t *got, score_t *sc) {
+  night_sim_t s;
+  make_night(k, &s);
+  int errors = 0;
+  if (got->sum.epochs != s.n || got->sum.start != (uint32_t)(T0 + k * 86400)) {
+    printf("night %d: %u epochs from %u, want %d from %ld\n", k,
+           got->sum.epochs, got->sum.start, s.n, (long)(T0 + k * 86400));
+    return 1;
+  }
+  // Segmenting the stored scores again gives the stored result
+  uint8_t bits[SLEEP_TRACK_MAX_EPOCHS / 8];
+  sleep_track_summary_t sum = got->sum;
+  sleep_track_segment(got->score, s.n, bits, &sum);
+  if (memcmp(bits, got->asleep, (size_t)(s.n + 7) / 8) != 0 ||
+      memcmp(&sum, &got->sum, sizeof(sum)) != 0) {
+    printf("night %d: stored segmentation differs\n", k);
+    errors++;
+  }
+  int onset_truth = 0;
+  while (onset_truth < s.n && !s.truth[onset_truth])
+    onset_truth++;
+  int err = abs((int)got->sum.onset - onset_truth);
+  if (err > sc->onset_err_max)
+    sc->onset_err_max = err;
+
+  for (int e = 0; e < s.n; ++e) {
+    bool a = sleep_track_asleep(got, e);
+    sc->epochs++;
+    sc->agree += a == s.truth[e];
+    if (s.truth[e]) {
+      sc->sleep_truth++;
+      sc->sleep_hit += a;
+    } else {
+      sc->wake_truth++;
+      sc->wake_hit += !a;
+    }
+    // Screen-off daytime path: the on-chip engine is polled every 30 s and
+    // every event opens a 2 s window of gyro-assisted raise detection
+    // (4-sample batches at ~56 Hz)
+    sc->idle_wakeups += 2 + s.events[e] * 28u;
+    sc->idle_samples += s.events[e] * 112u;
+  }
+  sc->wakeups += got->sum.wakeups;
+  sc->samples += got->sum.samples;
+  return errors;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <scratch dir> [nights]\n", argv[0]);
+    return 2;
+  }
+  const char *dir = argv[1];
+  int nights = argc > 2 ? atoi(argv[2]) : 10;
+  if (nights < 1 || nights > MAX_NIGHTS)
+    nights = 10;
+  mkdir(dir, 0755);
+  char path[256];
+  snprintf(path, sizeof(path), "%s/sleep.bin", dir);
+  remove(path);
+
+  // Pure segmentation: no movement at all is one sleep period, constant
+  // movement none
+  static uint8_t score[SLEEP_TRACK_MAX_EPOCHS];
+  uint8_t bits[SLEEP_TRACK_MAX_EPOCHS / 8];
+  sleep_track_summary_t sum;
+  int errors = 0;
+  sleep_track_segment(score, 480, bits, &sum);
+  if (sum.onset != 0 || sum.wake != 480 || sum.sleep_min != 480) {
+    printf("still night: onset %u wake %u sleep %u\n", sum.onset, sum.wake,
+           sum.sleep_min);
+    errors++;
+  }
+  memset(score, 40, sizeof(score));
+  sleep_track_segment(score, 480, bits, &sum);
+  if (sum.onset != 480 || sum.sleep_min != 0) {
+    printf("restless night: onset %u sleep %u\n", sum.onset, sum.sleep_min);
+    errors++;
+  }
+
+  // Writer, then "reboot"
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (sleep_track_init(dir) != ESP_OK)
+      _exit(1);
+    static night_sim_t s;
+    for (int k = 0; k < nights; ++k) {
+      make_night(k, &s);
+      record_night(k, &s);
+    }
+    _exit(0);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    printf("writer failed\n");
+    return 1;
+  }
+
+  if (sleep_track_init(dir) != ESP_OK)
+    return 1;
+  int kept = nights < SLEEP_TRACK_NIGHTS ? nights : SLEEP_TRACK_NIGHTS;
+  score_t sc = {0};
+  static sleep_track_night_t got;
+  for (int back = 0; back < kept; ++back) {
+    if (sleep_track_get(back, &got) != ESP_OK) {
+      printf("night -%d missing\n", back);
+      errors++;
+      continue;
+    }
+    errors += check_night(nights - 1 - back, &got, &sc);
+  }
+  if (sleep_track_get(kept, &got) != ESP_ERR_NOT_FOUND) {
+    printf("night -%d should have been overwritten\n", kept);
+    errors++;
+  }
+
+  struct stat st;
+  double acc = sc.epochs ? 100.0 * sc.agree / sc.epochs : 0.0;
+  printf("%d nights (%d kept, file %ld B): %u epochs, %.1f%% agree, sleep "
+         "%.1f%%, wake %.1f%%, onset error <= %d min\n",
+         nights, kept, stat(path, &st) == 0 ? (long)st.st_size : -1L,
+         sc.epochs, acc, 100.0 * sc.sleep_hit / (sc.sleep_truth ? sc.sleep_truth : 1),
+         100.0 * sc.wake_hit / (sc.wake_truth ? sc.wake_truth : 1),
+         sc.onset_err_max * SLEEP_TRACK_EPOCH_S / 60);
+  printf("sensor work per night: sleep mode %.0f wakeups, %.0f samples "
+         "(31.25 Hz); screen-off path %.0f wakeups, %.0f samples (62.5 Hz, "
+         "gyro windows)\n",
+         (double)sc.wakeups / kept, (double)sc.samples / kept,
+         (double)sc.idle_wakeups / kept, (double)sc.idle_samples / kept);
+  if (acc < 90.0 || sc.onset_err_max > 10)
+    errors++;
+  printf("%s\n", errors ? "FAIL" : "OK");
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+// Host check for the step history store (step_store.c). A child process
+// writes months of simulated walking minute by minute, then exits; the
+// parent opens the same files (as after a reboot) and compares minute, hour
+// and day queries against an in-memory reference, then keeps appending.
+//
+// Usage: step_store_check <scratch dir> [days]
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "step_store.h"
+
+#define T0 1735689600 // 2025-01-01 00:00 UTC
+#define MAX_DAYS 400
+
+static uint16_t *s_ref; // steps per minute since T0
+static int s_days = 120;
+
+static uint32_t s_rng = 7;
+static uint32_t rnd(uint32_t n) {
+  s_rng = s_rng * 1103515245u + 12345u;
+  return (s_rng >> 8) % n;
+}
+
+// A few walks a day, 60-130 steps per minute
+static void make_reference(void) {
+  for (int d = 0; d < s_days; ++d) {
+    int walks = 2 + (int)rnd(5);
+    for (int w = 0; w < walks; ++w) {
+      int start = d * 1440 + 6 * 60 + (int)rnd(15 * 60);
+      int len = 5 + (int)rnd(60);
+      for (int m = start; m < start + len && m < s_days * 1440; ++m)
+        s_ref[m] = (uint16_t)(60 + rnd(70));
+    }
+  }
+}
+
+static void write_history(int from_min, int to_min) {
+  for (int m = from_min; m < to_min; ++m) {
+    time_t t = T0 + (time_t)m * 60;
+    if (s_ref[m]) {
+      // Arrives in two batches within the minute
+      uint32_t a = s_ref[m] / 3;
+      step_store_add(t + 10, a);
+      step_store_add(t + 40, s_ref[m] - a);
+    } else if (m % 5 == 0) {
+      step_store_add(t, 0); // idle tick from sensors_task
+    }
+  }
+}
+
+static int check_minutes(uint32_t from, uint32_t to) {
+  static step_store_point_t pts[512];
+  uint32_t t = from;
+  int errors = 0;
+  while (t < to) {
+    int n = step_store_query(STEP_STORE_MINUTE, t, to, pts, 512);
+    uint32_t next = n ? pts[n - 1].t + 1 : to;
+    // Every reference minute in [t, next) must match exactly
+    int k = 0;
+    for (uint32_t m = t; m < next; ++m) {
+      uint32_t got = (k < n && pts[k].t == m) ? pts[k++].steps : 0;
+      uint32_t want = s_ref[m - T0 / 60];
+      if (got != want && errors++ < 5)
+        printf("minute %u: got %u want %u\n", m, got, want);
+    }
+    if (n < 512)
+      break;
+    t = next;
+  }
+  return errors;
+}
+
+static uint32_t ref_sum(int from_min, int to_min) {
+  uint32_t s = 0;
+  for (int m = from_min; m < to_min; ++m)
+    s += s_ref[m];
+  return s;
+}
+
+static int check_rollups(int first_day, int last_day) {
+  int errors = 0;
+  uint32_t day0 = step_store_unit(STEP_STORE_DAY, T0);
+  for (int d = first_day; d <= last_day; ++d) {
+    uint32_t got = step_store_day_total(T0 + (time_t)d * 86400 + 3600);
+    uint32_t want = ref_sum(d * 1440, (d + 1) * 1440);
+    if (got != want && errors++ < 5)
+      printf("day %d: got %u want %u\n", d, got, want);
+  }
+  // Hours of the most recent days (older ones are overwritten)
+  step_store_point_t pts[24];
+  for (int d = last_day - 30; d <= last_day; ++d) {
+    uint32_t h0 = (day0 + (uint32_t)d) * 24;
+    int n = step_store_query(STEP_STORE_HOUR, h0, h0 + 24, pts, 24);
+    int k = 0;
+    for (int h = 0; h < 24; ++h) {
+      uint32_t got = (k < n && pts[k].t == h0 + (uint32_t)h) ? pts[k++].steps : 0;
+      uint32_t want = ref_sum(d * 1440 + h * 60, d * 1440 + (h + 1) * 60);
+      if (got != want && errors++ < 5)
+        printf("day %d hour %d: got %u want %u\n", d, h, got, want);
+    }
+  }
+  return errors;
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static long file_size(const char *dir, const char *name) {
+  char path[256];
+  struct stat st;
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <scratch dir> [days]\n", argv[0]);
+    return 2;
+  }
+  const char *dir = argv[1];
+  if (argc > 2)
+    s_days = atoi(argv[2]);
+  if (s_days < 2 || s_days > MAX_DAYS)
+    s_days = 120;
+  setenv("TZ", "UTC0", 1);
+  tzset();
+  mkdir(dir, 0755);
+  const char *names[] = {"steps_min.bin", "steps_hr.bin", "steps_day.bin"};
+  for (int i = 0; i < 3; ++i) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, names[i]);
+    remove(path);
+  }
+
+  s_ref = calloc((size_t)(s_days + 1) * 1440, sizeof(uint16_t));
+  if (!s_ref)
+    return 1;
+  make_reference();
+
+  // Writer: all but the last day, then "reboot"
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (step_store_init(dir) != ESP_OK)
+      _exit(1);
+    write_history(0, (s_days - 1) * 1440);
+    _exit(step_store_flush() == ESP_OK ? 0 : 1);
+  }
+  int status = 0;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    printf("writer failed\n");
+    return 1;
+  }
+
+  if (step_store_init(dir) != ESP_OK)
+    return 1;
+  // Continue after the reboot; the last day stays partly in RAM
+  write_history((s_days - 1) * 1440, s_days * 1440 - 7);
+
+  // The minute ring keeps the most recent blocks; check the last 30 days
+  int first_day = s_days > 30 ? s_days - 30 : 0;
+  int errors = check_minutes(T0 / 60 + (uint32_t)first_day * 1440,
+                             T0 / 60 + (uint32_t)s_days * 1440);
+  errors += check_rollups(first_day, s_days - 1);
+
+  // Query cost: one day of minutes, 24 hours, 7 days
+  step_store_point_t pts[1440];
+  uint32_t last_day_min = T0 / 60 + (uint32_t)(s_days - 1) * 1440;
+  uint32_t day = step_store_unit(STEP_STORE_DAY, T0) + (uint32_t)s_days - 1;
+  const int reps = 200;
+  uint64_t t0 = now_ns();
+  for (int i = 0; i < reps; ++i)
+    (void)step_store_query(STEP_STORE_MINUTE, last_day_min - 20 * 1440,
+                           last_day_min - 19 * 1440, pts, 1440);
+  uint64_t t_min = (now_ns() - t0) / reps;
+  t0 = now_ns();
+  for (int i = 0; i < reps; ++i)
+    (void)step_store_query(STEP_STORE_HOUR, day * 24, day * 24 + 24, pts, 24);
+  uint64_t t_hour = (now_ns() - t0) / reps;
+  t0 = now_ns();
+  for (int i = 0; i < reps; ++i)
+    (void)step_store_query(STEP_STORE_DAY, day - 6, day + 1, pts, 7);
+  uint64_t t_day = (now_ns() - t0) / reps;
+
+  uint32_t active = 0;
+  for (int m = 0; m < s_days * 1440; ++m)
+    active += s_ref[m] != 0;
+  printf("%d days, %u active minutes; files: minutes %ld B, hours %ld B, "
+         "days %ld B\n",
+         s_days, active, file_size(dir, names[0]), file_size(dir, names[1]),
+         file_size(dir, names[2]));
+  printf("query: day of minutes %.1f us, 24 hours %.1f us, 7 days %.1f us\n",
+         t_min / 1000.0, t_hour / 1000.0, t_day / 1000.0);
+  printf("%s (%d mismatches)\n", errors ? "FAILED" : "PASSED", errors);
+  free(s_ref);
+  return errors ? 1 : 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+// Host stand-in: the host tools are single-threaded.
+#define portMAX_DELAY 0xFFFFFFFFu
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
@@ -0,0 +1,16 @@
+#pragma once
+// Host stand-in: mutexes are no-ops in the single-threaded host tools.
+#include <stdint.h>
+typedef void *SemaphoreHandle_t;
+static inline SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+  return (SemaphoreHandle_t)1;
+}
+static inline int xSemaphoreTake(SemaphoreHandle_t s, uint32_t t) {
+  (void)s;
+  (void)t;
+  return 1;
+}
+static inline int xSemaphoreGive(SemaphoreHandle_t s) {
+  (void)s;
+  return 1;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensors.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Activity classifier over fixed windows of accelerometer samples, instead
+// of step cadence alone. Per window it computes cheap features in fixed
+// point:
+//   - mean and variance of |a| - 1 g
+//   - zero-crossing count of |a| around its mean (with a dead band)
+//   - variance of pitch (wrist rotation)
+//   - Goertzel power at MOTION_ACTIVITY_BINS low-frequency bins, reduced to
+//     the strongest bin, its frequency and its share of the variance
+// and classifies them with a small decision tree; the output only changes
+// after the same class was seen in two consecutive windows. Inputs are the
+// Q12 magnitude and Q7 pitch from motion_dsp_block().
+#define MOTION_ACTIVITY_WINDOW 128 // samples, ~2 s at 62.5 Hz
+#define MOTION_ACTIVITY_BINS 8     // bins 1..8: ~0.5-3.9 Hz at 62.5 Hz
+
+typedef struct {
+  int32_t mean_q12;   // mean of |a| - 1 g
+  uint32_t std_mg;    // standard deviation of |a|
+  uint32_t pitch_std_q7; // standard deviation of pitch (Q7 degrees)
+  uint16_t zcr;       // crossings of |a| around its mean in the window
+  uint8_t peak_bin;   // strongest Goertzel bin (1..MOTION_ACTIVITY_BINS)
+  uint8_t peak_share; // its share of the variance, Q8 (256 = all of it)
+  uint16_t peak_chz;  // its frequency in 0.01 Hz
+} motion_activity_features_t;
+
+typedef struct {
+  int16_t mag[MOTION_ACTIVITY_WINDOW];
+  int16_t pitch[MOTION_ACTIVITY_WINDOW];
+  int n;
+  uint32_t next_ms; // expected time of the next sample (gap detection)
+  uint32_t period_us;
+  motion_activity_features_t feat; // last completed window
+  sensors_activity_t raw;          // last window's class
+  sensors_activity_t out;          // debounced class
+  uint32_t window_end_ms;          // time of the last window's last sample
+  uint32_t windows;                // completed windows
+} motion_activity_t;
+
+void motion_activity_init(motion_activity_t *a);
+
+// Append n samples, the first taken at t0_ms. A gap in the sample stream
+// (e.g. FIFO streaming paused) restarts the window. Returns true when a
+// window completed; the class is then in `out` (and `raw`).
+bool motion_activity_feed(motion_activity_t *a, const int16_t *mag_q12,
+                          const int16_t *pitch_q7, int n, uint32_t t0_ms,
+                          uint32_t period_us);
+
+// The per-window stages, exposed for the host evaluation tool
+void motion_activity_features(const int16_t *mag_q12, const int16_t *pitch_q7,
+                              int n, uint32_t period_us,
+                              motion_activity_features_t *f);
+sensors_activity_t motion_activity_classify(
+    const motion_activity_features_t *f);
+
+#ifdef __cplusplus
+}
+#endif
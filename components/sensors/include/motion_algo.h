@@ -0,0 +1,81 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "motion_activity.h"
+#include "motion_dsp.h"
+#include "motion_gesture.h"
+#include "sensors.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Step detection, activity classification and raise-to-wake as pure functions
+// over sample batches. No I2C, RTOS or display calls, so the same code runs
+// in sensors_task and in the host replay tool (host_test/). Per-sample math
+// is fixed point (motion_dsp.h).
+
+// A batch of raw IMU samples at a fixed period
+typedef struct {
+  const int16_t *xyz;  // interleaved x/y/z in Q13 g (8192 LSB/g, +-4 g)
+  const int16_t *gyro; // interleaved x/y/z at +-512 dps, NULL if gyro off
+  int n;
+  uint32_t t0_ms;     // time of the first sample
+  uint32_t period_us; // spacing between samples
+} motion_batch_t;
+
+// Pitch history must span the raise lookback (700 ms) at the IMU ODR
+#define MOTION_ALGO_PITCH_HIST 64
+
+typedef struct {
+  // Magnitude low-pass and its state
+  motion_dsp_state_t dsp;
+  // Software step detector
+  bool ready_for_next_peak;
+  uint32_t last_step_ms;
+  // Ring buffer for cadence (last 8 steps)
+  uint32_t step_ts_ms[8];
+  int step_ts_idx, step_ts_num;
+  sensors_activity_t cadence_activity; // from cadence alone
+  // Windowed classifier; its class is used while windows keep completing
+  motion_activity_t classifier;
+  sensors_activity_t activity;
+  // Raise-to-wake detection state
+  int16_t pitch_hist[MOTION_ALGO_PITCH_HIST]; // Q7 degrees
+  uint32_t ts_hist[MOTION_ALGO_PITCH_HIST];
+  int hist_idx, hist_num;
+  uint32_t last_raise_ms;
+  // Used instead of the pitch lookback while gyro samples are present
+  motion_gesture_t gesture;
+} motion_algo_t;
+
+typedef struct {
+  uint32_t steps;      // steps found in the batch (software detector only)
+  bool raise;          // a wrist raise was detected
+  uint32_t raise_t_ms; // time of the sample that completed the raise
+  int16_t raise_dp_q7; // pitch change that triggered it (Q7 degrees)
+  bool raise_gyro;     // found by the gyro-assisted detector
+  bool motion;         // the wrist moved during the batch
+  bool activity_window; // the activity classifier completed a window
+  uint16_t activity_mg; // mean change of |a| between samples (sleep score)
+} motion_algo_result_t;
+
+void motion_algo_init(motion_algo_t *m);
+
+// Run a batch through the algorithms. `count_steps` enables the software
+// detector (off when the on-chip pedometer counts); raise-to-wake is only
+// evaluated when `detect_raise` is set (screen off), gyro-assisted when the
+// batch carries gyro samples (motion_gesture.h).
+void motion_algo_process(motion_algo_t *m, const motion_batch_t *b,
+                         bool count_steps, bool detect_raise,
+                         motion_algo_result_t *out);
+
+// Feed steps counted elsewhere (on-chip pedometer) into the cadence buffer
+void motion_algo_add_steps(motion_algo_t *m, uint32_t steps, uint32_t t_ms);
+
+static inline sensors_activity_t motion_algo_activity(const motion_algo_t *m) {
+  return m->activity;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed-point front end for accelerometer blocks: magnitude, gravity removal,
+// low-pass filter and pitch, without floats or libm (two integer divisions
+// per sample: one Newton step for the square root, one for atan2).
+//
+// Input: interleaved raw x/y/z as read from the QMI8658 at +-4 g (Q13 g,
+// 8192 LSB/g). Outputs per sample:
+//   mag   |a| in Q12 g
+//   lp    low-passed (|a| - 1 g) in Q12 g (alpha 0.1 at 62.5 Hz, state in
+//         Q28; motion_dsp_set_period() keeps the time constant at other
+//         rates)
+//   pitch atan2(-x, sqrt(y^2 + z^2)) in Q7 degrees
+//
+// motion_dsp_block() runs in stages over the block (structure-of-arrays), so
+// the squaring stage can use the ESP32-S3 vector unit through esp-dsp
+// (CONFIG_SENSORS_DSP_ESP_DSP). The portable C stages produce bit-identical
+// output to motion_dsp_ref(), the per-sample reference; host_test checks
+// this and the golden checksum below, and motion_dsp_selftest() repeats the
+// checksum on the device before the accelerated path is trusted.
+#define MOTION_DSP_MAX_BLOCK 64
+#define MOTION_DSP_ONE_G_Q12 4096
+#define MOTION_DSP_DEG_Q7(d) ((int16_t)((d) * 128))
+#define MOTION_DSP_MG_Q12(mg) ((int16_t)((mg) * 4096 / 1000))
+
+// CRC-32 of the outputs for the self-test input (see motion_dsp_selftest)
+#define MOTION_DSP_GOLDEN_CRC 0xAF450AB7u
+
+typedef struct {
+  int32_t lp_q28;
+  int32_t alpha_q15;
+  uint32_t period_us;
+} motion_dsp_state_t;
+
+void motion_dsp_init(motion_dsp_state_t *st);
+
+// Sample spacing of the following blocks (16000 us after init)
+void motion_dsp_set_period(motion_dsp_state_t *st, uint32_t period_us);
+
+// Process n <= MOTION_DSP_MAX_BLOCK samples. Any output pointer may be NULL.
+void motion_dsp_block(motion_dsp_state_t *st, const int16_t *xyz, int n,
+                      int16_t *mag, int16_t *lp, int16_t *pitch);
+
+// Scalar reference for a single sample
+void motion_dsp_ref(motion_dsp_state_t *st, const int16_t xyz[3],
+                    int16_t *mag, int16_t *lp, int16_t *pitch);
+
+// Integer square root (within 1 LSB), as used by the kernel
+uint32_t motion_dsp_sqrt(uint32_t v);
+
+// Enable/disable the esp-dsp stage (no-op in portable builds)
+void motion_dsp_set_accel(bool enable);
+bool motion_dsp_accel_enabled(void);
+
+// Checksum motion_dsp_block() over a fixed pseudo-random input, including
+// saturated and zero samples
+uint32_t motion_dsp_checksum(void);
+
+// True if motion_dsp_checksum() matches MOTION_DSP_GOLDEN_CRC
+bool motion_dsp_selftest(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Gyro-assisted raise-to-wake. The accelerometer pitch and the gyro rate
+// about the y axis are fused in a complementary filter, so the wrist turn is
+// tracked while it happens rather than compared with a pitch sample from
+// half a second earlier. A raise is an upward sweep (gyro rate above a
+// floor, no reversal) that lifts the fused pitch by at least
+// MOTION_GESTURE_RISE_DEG and starts from a calm wrist; shaking keeps
+// reversing direction and never qualifies.
+//
+// Gyro input is raw QMI8658 data at +-512 dps. Positive y rate raises the
+// pitch (gravity moves from +z toward -x). Pure integer code, shared with
+// the host replay tool like motion_algo.c.
+#define MOTION_GESTURE_GYRO_LSB_PER_DPS 64
+#define MOTION_GESTURE_RISE_DEG 45
+#define MOTION_GESTURE_HIST 32 // fused pitch history, >= calm window at ODR
+
+typedef struct {
+  bool valid;        // filter seeded from the accelerometer
+  int32_t pitch_q15; // fused pitch, Q15 degrees
+  // Fused pitch history for the calm check (Q7 degrees)
+  int16_t hist[MOTION_GESTURE_HIST];
+  uint32_t hist_ts[MOTION_GESTURE_HIST];
+  int hist_idx, hist_num;
+  // Current upward sweep
+  bool sweep, sweep_calm;
+  int32_t sweep_start_q15;
+  uint32_t sweep_start_ms, last_up_ms;
+} motion_gesture_t;
+
+void motion_gesture_init(motion_gesture_t *g);
+
+// Forget the filter state, e.g. when the gyro is powered down
+void motion_gesture_reset(motion_gesture_t *g);
+
+// Feed one sample: accelerometer pitch (Q7 degrees) and magnitude (Q12 g)
+// from motion_dsp, raw gyro x/y/z. Returns the pitch rise (Q7 degrees) when
+// a raise completes at this sample and `armed` is set, else 0.
+int16_t motion_gesture_update(motion_gesture_t *g, int16_t pitch_q7,
+                              int16_t mag_q12, const int16_t gyro[3],
+                              uint32_t t_ms, uint32_t period_us, bool armed);
+
+#ifdef __cplusplus
+}
+#endif
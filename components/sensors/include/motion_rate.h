@@ -0,0 +1,62 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "sensors.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Accelerometer rate governor. Picks the IMU output data rate from what the
+// wrist is doing, as a pure function so host_test/rate_sim can replay it:
+//   LOW  31.25 Hz  still
+//   MID  62.5 Hz   moving about, walking, cycling
+//   HIGH 125 Hz    running, and the first seconds of motion after stillness
+//                  while raise-to-wake is armed (where a raise starts)
+// Going up is immediate so the start of a walk or a raise is sampled at the
+// higher rate; going down waits until the reason has been gone for a hold
+// time, and the rate never changes twice within MOTION_RATE_DWELL_MS (every
+// change resets the FIFO and restarts the activity window). With the FIFO
+// watermark fixed in samples, the processing rate follows the ODR: one batch
+// per ~1 s, ~0.5 s or ~0.25 s.
+typedef enum {
+  MOTION_RATE_LOW,
+  MOTION_RATE_MID,
+  MOTION_RATE_HIGH,
+} motion_rate_t;
+
+#define MOTION_RATE_COUNT 3
+#define MOTION_RATE_HIGH_HOLD_MS 3000 // HIGH after its last reason
+#define MOTION_RATE_MID_HOLD_MS 8000  // MID after the last motion
+#define MOTION_RATE_DWELL_MS 1000
+
+typedef struct {
+  motion_rate_t rate;
+  uint32_t changed_ms;
+  uint32_t last_high_ms; // last time HIGH was wanted
+  uint32_t last_mid_ms;  // last motion or activity
+  bool still;            // nothing moved for MOTION_RATE_MID_HOLD_MS
+  uint32_t switches;
+} motion_rate_gov_t;
+
+// What the last batch showed
+typedef struct {
+  bool motion;                 // the wrist moved (batch or any-motion engine)
+  bool raise_armed;            // raise-to-wake is running (screen off)
+  sensors_activity_t activity; // current class
+} motion_rate_input_t;
+
+// Starts at MID, the rate the watch boots with
+void motion_rate_init(motion_rate_gov_t *g, uint32_t now_ms);
+
+// Feed one batch; returns the rate for the next one
+motion_rate_t motion_rate_update(motion_rate_gov_t *g,
+                                 const motion_rate_input_t *in,
+                                 uint32_t now_ms);
+
+static inline uint32_t motion_rate_period_us(motion_rate_t r) {
+  return r == MOTION_RATE_LOW ? 32000u : r == MOTION_RATE_HIGH ? 8000u : 16000u;
+}
+
+#ifdef __cplusplus
+}
+#endif
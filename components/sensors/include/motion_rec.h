@@ -0,0 +1,129 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Columnar, block-compressed IMU recordings (*.imc) for long field
+// captures. The file is a sequence of MOTION_REC_BLOCK_SIZE blocks (one
+// FATFS sector), so every write is sector aligned and any block can be
+// found by offset:
+//   block 0   header (motion_rec_header_t, zero padded)
+//   block 1.. data blocks, each decodable on its own (CRC-32 checked):
+//             motion_rec_block_hdr_t, the batch table (varints: t0 delta,
+//             count, period, flags, activity label), then one column per
+//             axis ax, ay, az, gx, gy, gz. A column is coded as zigzag deltas
+//             in frames of MOTION_REC_FRAME values, each frame bit-packed at
+//             the width of its largest delta.
+//   last      index block (motion_rec_index_t): the start time of every
+//             `stride`-th data block, for seeking. Missing when recording
+//             was cut short; the blocks can then be scanned instead.
+// Gyro columns hold samples of MOTION_TRACE_F_GYRO batches only. Flags are
+// the MOTION_TRACE_F_* values; host_test/rec_dump converts to *.imt.
+#define MOTION_REC_MAGIC "IMC1"
+#define MOTION_REC_VERSION 1
+#define MOTION_REC_BLOCK_SIZE 4096
+#define MOTION_REC_FRAME 32
+#define MOTION_REC_COLUMNS 6
+#define MOTION_REC_MAX_SAMPLES 1024 // per block
+#define MOTION_REC_MAX_BATCHES 96   // per block
+#define MOTION_REC_INDEX_MAX 1016   // entries in the index block
+
+typedef struct __attribute__((packed)) {
+  char magic[4];
+  uint16_t version;
+  uint16_t header_size; // sizeof(motion_rec_header_t)
+  uint32_t block_size;
+  uint32_t sample_period_us; // nominal accelerometer period
+  uint32_t gyro_period_us;   // nominal period of gyro batches
+  float mg_per_lsb;
+  float dps_per_lsb;
+  int64_t start_epoch; // wall clock at start (0 if unknown)
+} motion_rec_header_t;
+
+typedef struct __attribute__((packed)) {
+  char magic[4];     // "IMCB"
+  uint32_t seq;      // data block number, from 1
+  uint32_t crc;      // CRC-32 of the block with this field zero
+  uint64_t t0_us;    // start of the first batch (device uptime)
+  uint16_t batches;
+  uint16_t samples;
+  uint16_t gyro_samples;
+  uint16_t used;     // bytes used, header included
+  uint16_t col_off[MOTION_REC_COLUMNS]; // column starts
+  int16_t first[MOTION_REC_COLUMNS];    // first value of each column
+} motion_rec_block_hdr_t;
+
+typedef struct __attribute__((packed)) {
+  char magic[4];    // "IMCI"
+  uint32_t blocks;  // data blocks in the file
+  uint32_t samples; // accelerometer samples in the file
+  uint32_t stride;  // data blocks per entry
+  uint32_t count;   // entries
+  uint64_t t0_us;   // start of data block 1
+  // t_ms[i]: start of data block 1 + i * stride, ms after t0_us
+  uint32_t t_ms[MOTION_REC_INDEX_MAX];
+} motion_rec_index_t;
+
+typedef struct {
+  uint64_t t0_us;     // first sample
+  uint32_t period_us; // sample spacing
+  uint16_t n;
+  uint8_t flags;      // MOTION_TRACE_F_*
+  uint8_t label;      // sensors_activity_t
+} motion_rec_batch_t;
+
+typedef struct {
+  // Block being filled: batch table and raw columns
+  motion_rec_batch_t batch[MOTION_REC_MAX_BATCHES];
+  int nbatch;
+  int16_t col[MOTION_REC_COLUMNS][MOTION_REC_MAX_SAMPLES];
+  int ncol[MOTION_REC_COLUMNS];
+  // Exact encoded size of the block so far
+  size_t table_bytes;
+  size_t frame_bytes[MOTION_REC_COLUMNS]; // completed frames
+  uint8_t width[MOTION_REC_COLUMNS];      // of the open frame
+  // File totals and the index
+  uint32_t seq;
+  uint32_t samples;
+  motion_rec_index_t index;
+} motion_rec_enc_t;
+
+// Decoded data block; gyro rows belong to MOTION_TRACE_F_GYRO batches
+typedef struct {
+  motion_rec_block_hdr_t hdr;
+  motion_rec_batch_t batch[MOTION_REC_MAX_BATCHES];
+  int16_t col[MOTION_REC_COLUMNS][MOTION_REC_MAX_SAMPLES];
+} motion_rec_block_t;
+
+void motion_rec_enc_init(motion_rec_enc_t *e);
+
+// Header block (MOTION_REC_BLOCK_SIZE bytes)
+void motion_rec_header(uint8_t *out, uint32_t sample_period_us,
+                       uint32_t gyro_period_us, float mg_per_lsb,
+                       float dps_per_lsb, int64_t start_epoch);
+
+// Append up to b->n samples of a batch (xyz and, for MOTION_TRACE_F_GYRO
+// batches, gyro interleaved). When the block fills it is sealed into `out`
+// (MOTION_REC_BLOCK_SIZE bytes) and *sealed is set; call again with the
+// rest. Returns the samples taken.
+int motion_rec_enc_add(motion_rec_enc_t *e, const motion_rec_batch_t *b,
+                       const int16_t *xyz, const int16_t *gyro, uint8_t *out,
+                       bool *sealed);
+
+// Seal the partial block into `out`; false when it is empty
+bool motion_rec_enc_flush(motion_rec_enc_t *e, uint8_t *out);
+
+// Index block for the blocks sealed so far
+void motion_rec_enc_index(const motion_rec_enc_t *e, uint8_t *out);
+
+// Readers. motion_rec_decode() checks the magic, CRC and layout.
+bool motion_rec_read_header(const uint8_t *blk, motion_rec_header_t *h);
+bool motion_rec_decode(const uint8_t *blk, motion_rec_block_t *out);
+bool motion_rec_read_index(const uint8_t *blk, motion_rec_index_t *idx);
+
+#ifdef __cplusplus
+}
+#endif
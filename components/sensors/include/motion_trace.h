@@ -0,0 +1,61 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Raw IMU trace files (*.imt), recorded on the watch and replayed by
+// host_test/motion_replay. Little endian:
+//   header: motion_trace_header_t
+//   then batches: motion_trace_batch_t followed by `count` samples of
+//   int16 x, y, z in sensor LSB (multiply by mg_per_lsb for mg); batches
+//   flagged MOTION_TRACE_F_GYRO then carry `count` gyro x, y, z samples
+//   (multiply by dps_per_lsb for deg/s)
+// Version 1 files (accelerometer only, no dps_per_lsb) are still read.
+#define MOTION_TRACE_MAGIC "IMT1"
+#define MOTION_TRACE_VERSION 2
+#define MOTION_TRACE_MAX_BATCH 256
+
+#define MOTION_TRACE_F_SCREEN_ON 0x01 // display was on during the batch
+#define MOTION_TRACE_F_HW_STEPS 0x02  // on-chip pedometer was counting
+#define MOTION_TRACE_F_GYRO 0x04      // gyro samples follow the accel block
+
+typedef struct __attribute__((packed)) {
+  char magic[4];
+  uint16_t version;
+  uint16_t header_size;      // sizeof(motion_trace_header_t)
+  uint32_t sample_period_us; // nominal ODR period
+  float mg_per_lsb;
+  int64_t start_epoch; // wall clock at start (0 if unknown)
+  // Version 2
+  float dps_per_lsb;       // gyro scale (0 in version 1 files)
+  uint32_t gyro_period_us; // sample spacing of MOTION_TRACE_F_GYRO batches
+} motion_trace_header_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t t_ms;  // time of the first sample (device uptime)
+  uint16_t count; // samples in this batch
+  uint8_t flags;  // MOTION_TRACE_F_*
+  uint8_t reserved;
+} motion_trace_batch_t;
+
+bool motion_trace_write_header(FILE *f, uint32_t sample_period_us,
+                               float mg_per_lsb, float dps_per_lsb,
+                               uint32_t gyro_period_us, int64_t start_epoch);
+// `gyro` may be NULL; otherwise the batch is flagged MOTION_TRACE_F_GYRO
+bool motion_trace_write_batch(FILE *f, uint32_t t_ms, uint8_t flags,
+                              const int16_t *xyz, const int16_t *gyro,
+                              uint16_t count);
+
+// Readers return false at end of file or on a malformed record. `xyz` and
+// `gyro` must hold MOTION_TRACE_MAX_BATCH * 3 values; gyro samples are
+// dropped when `gyro` is NULL.
+bool motion_trace_read_header(FILE *f, motion_trace_header_t *hdr);
+bool motion_trace_read_batch(FILE *f, motion_trace_batch_t *b, int16_t *xyz,
+                             int16_t *gyro);
+
+#ifdef __cplusplus
+}
+#endif
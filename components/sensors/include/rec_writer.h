@@ -0,0 +1,34 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streams IMU batches into an *.imc recording (motion_rec.h). Blocks are
+// encoded into one of two RAM chunks of CONFIG_SENSORS_REC_WRITE_KB while a
+// writer task puts the other one on the card in a single aligned write, so
+// the caller never waits for FATFS. When both chunks are still waiting for
+// the card, batches are dropped (and counted) instead.
+
+// Open `path` and start recording. Runs in the calling task (fopen on FATFS
+// can take a while).
+esp_err_t rec_writer_start(const char *path, uint32_t sample_period_us,
+                           uint32_t gyro_period_us, float mg_per_lsb,
+                           float dps_per_lsb, int64_t start_epoch);
+
+// Append a batch; `gyro` may be NULL. `flags` are MOTION_TRACE_F_* and
+// `label` the activity. Never blocks.
+void rec_writer_add(uint64_t t0_us, uint32_t period_us, const int16_t *xyz,
+                    const int16_t *gyro, int n, uint8_t flags, uint8_t label);
+
+// Write the last block and the index, close the file and wait for it
+esp_err_t rec_writer_stop(void);
+
+bool rec_writer_active(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+#include "sensors.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Publishing side of sensors_subscribe(), used by sensors_task only. Keeps
+// the last step total and activity, and per subscriber what is still held
+// back by its minimum interval.
+
+// Fan `evt` out to the subscribers of its type. For SENSORS_EVENT_STEPS,
+// `steps.delta` is the increment since the previous publish.
+void sensor_hub_publish(const sensors_event_t *evt);
+
+// Deliver coalesced events whose interval has run out; once per batch
+void sensor_hub_flush(uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
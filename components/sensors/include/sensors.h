@@ -1,5 +1,8 @@
 #pragma once
+#include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -8,7 +11,8 @@ typedef enum {
     SENSORS_ACTIVITY_IDLE = 0,
     SENSORS_ACTIVITY_WALK,
     SENSORS_ACTIVITY_RUN,
-    SENSORS_ACTIVITY_OTHER,
+    SENSORS_ACTIVITY_OTHER,   // moving, but not stepping
+    SENSORS_ACTIVITY_CYCLE,
 } sensors_activity_t;
 
 void sensors_init(void);
@@ -17,6 +21,85 @@ uint32_t sensors_get_step_count(void);
 // Returns current activity classification
 sensors_activity_t sensors_get_activity(void);
 
+// Record raw accelerometer/gyro batches with activity labels to an *.imc
+// recording on the SD card (see motion_rec.h, rec_writer.h). NULL picks
+// /sdcard/imu_<epoch>.imc.
+esp_err_t sensors_trace_start(const char *path);
+void sensors_trace_stop(void);
+bool sensors_trace_active(void);
+
+// Sleep tracking (see sleep_track.h): the accelerometer runs at a low rate
+// without gyro or raise-to-wake, and the night is scored per minute from
+// motion events. Applied by sensors_task; with CONFIG_SENSORS_SLEEP_AUTO it
+// also starts after a still period in the sleep hours and ends once the
+// wearer is up after them.
+esp_err_t sensors_sleep_start(void);
+void sensors_sleep_stop(void);
+bool sensors_sleep_active(void);
+
+// Standby (gui/standby.h): the SoC sleeps while the IMU keeps counting
+// steps with the on-chip pedometer and raises INT1 on taps and steps.
+// sensors_standby_enter() parks sensors_task, flushes the step history and
+// returns today's count and the pedometer count; ESP_ERR_NOT_SUPPORTED
+// without the on-chip pedometer. sensors_standby_cancel() releases the task
+// when the SoC did not go to sleep after all.
+esp_err_t sensors_standby_enter(uint32_t *steps, uint32_t *hw_steps);
+void sensors_standby_cancel(void);
+// Before sensors_init() on a boot that resumes from standby: the values
+// saved on entry, so steps counted meanwhile are added to today
+void sensors_standby_resume(uint32_t steps, uint32_t hw_steps, time_t entered);
+// A wake tap was latched when the SoC resumed (valid after sensors_init())
+bool sensors_standby_tap_woke(void);
+
+// Event subscriptions. sensors_task owns the IMU and publishes what it
+// derives from the one sample stream; consumers subscribe instead of polling
+// the getters above. Callbacks run in sensors_task and must return quickly:
+// no I2C, no waiting on the display lock for more than a few ms.
+typedef enum {
+    SENSORS_EVENT_STEPS = 1u << 0,    // new steps, or the midnight reset
+    SENSORS_EVENT_ACTIVITY = 1u << 1, // the activity class changed
+    SENSORS_EVENT_RAISE = 1u << 2,    // raise-to-wake fired
+    SENSORS_EVENT_TAP = 1u << 3,      // tap on the watch
+    SENSORS_EVENT_SAMPLES = 1u << 4,  // raw batch as read from the FIFO
+} sensors_event_type_t;
+
+typedef struct {
+    sensors_event_type_t type;
+    uint32_t time_ms; // esp_timer time of the batch that produced it
+    union {
+        struct {
+            uint32_t total; // today's steps
+            uint32_t delta; // new since the last event delivered
+        } steps;
+        sensors_activity_t activity;
+        struct {
+            bool gyro; // detected by the gyro-assisted gesture
+        } raise;
+        struct {
+            uint8_t count; // 1 single, 2 double
+        } tap;
+        struct {
+            const int16_t *xyz;  // n x/y/z triples, 8192 LSB/g
+            const int16_t *gyro; // n triples at 64 LSB/dps, or NULL
+            int n;
+            int64_t t0_us;       // first sample
+            uint32_t period_us;
+            bool screen_on;
+        } samples;
+    };
+} sensors_event_t;
+
+typedef void (*sensors_event_cb_t)(const sensors_event_t *evt, void *arg);
+
+#define SENSORS_MAX_SUBSCRIBERS 8
+
+// Deliver the event types in `mask` to `cb`. STEPS and ACTIVITY events are
+// coalesced to at most one per `min_interval_ms` (step deltas add up, the
+// latest activity wins) and the rest goes out with the first batch after
+// the interval; RAISE, TAP and SAMPLES are never held back.
+esp_err_t sensors_subscribe(uint32_t mask, uint32_t min_interval_ms,
+                            sensors_event_cb_t cb, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Nightly sleep records on SPIFFS. While sleep mode runs, sensors_task
+// reports movement per SLEEP_TRACK_EPOCH_S epoch (any-motion events plus the
+// activity of one low-ODR sample batch); each epoch gets a 0-255 movement
+// score. When the night ends the scores are split into sleep and wake with a
+// Cole-Kripke style weighted window plus Webster's rescoring rules, and the
+// night is stored in one of SLEEP_TRACK_NIGHTS fixed slots (oldest
+// overwritten). Thread-safe.
+#define SLEEP_TRACK_EPOCH_S 60
+#define SLEEP_TRACK_MAX_EPOCHS 720 // 12 h
+#define SLEEP_TRACK_NIGHTS 7
+
+typedef struct __attribute__((packed)) {
+  uint32_t seq;        // night number, 0 = empty slot
+  uint32_t start;      // UTC time of the first epoch
+  uint16_t epochs;     // epochs recorded
+  uint16_t onset;      // first asleep epoch (== epochs if none)
+  uint16_t wake;       // epoch after the last asleep one
+  uint16_t sleep_min;  // asleep between onset and wake
+  uint16_t waso_min;   // awake between onset and wake
+  uint16_t awakenings; // wake bouts between onset and wake
+  uint32_t wakeups;    // sensor task wakeups during the night
+  uint32_t samples;    // accelerometer samples read during the night
+} sleep_track_summary_t;
+
+typedef struct {
+  sleep_track_summary_t sum;
+  uint8_t score[SLEEP_TRACK_MAX_EPOCHS];       // movement per epoch
+  uint8_t asleep[SLEEP_TRACK_MAX_EPOCHS / 8];  // bit per epoch, LSB first
+} sleep_track_night_t;
+
+static inline bool sleep_track_asleep(const sleep_track_night_t *n, int i) {
+  return (n->asleep[i >> 3] >> (i & 7)) & 1;
+}
+
+// Open or create the night file under `dir` (e.g. "/spiffs")
+esp_err_t sleep_track_init(const char *dir);
+
+// Start a night at `now`; an open night is ended first
+void sleep_track_begin(time_t now);
+
+// Close the epochs that ended before `now`, then add `events` any-motion
+// events and a sample batch's activity (mg, 0 if none was taken) to the
+// epoch containing `now`. Returns false once the night is full.
+bool sleep_track_update(time_t now, uint32_t events, uint16_t activity_mg);
+
+// Account sensor work for the night's summary
+void sleep_track_add_cost(uint32_t wakeups, uint32_t samples);
+
+// End time of the epoch being accumulated (0 when no night is open)
+time_t sleep_track_epoch_end(void);
+
+// Close the night, segment it and store it
+esp_err_t sleep_track_end(time_t now);
+
+bool sleep_track_active(void);
+
+// Stored night `back` nights ago (0 = most recent).
+// ESP_ERR_NOT_FOUND when there is none.
+esp_err_t sleep_track_get(int back, sleep_track_night_t *out);
+
+// Sleep/wake segmentation of n scores into the `asleep` bitmap, filling the
+// onset/wake/sleep_min/waso_min/awakenings fields of `sum`. Pure; exposed
+// for the host check.
+void sleep_track_segment(const uint8_t *score, int n, uint8_t *asleep,
+                         sleep_track_summary_t *sum);
+
+#ifdef __cplusplus
+}
+#endif
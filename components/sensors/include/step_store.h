@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Persistent step history on SPIFFS, kept at three resolutions:
+//   minute  append-only ring of 256-byte blocks; each block holds
+//           (minute delta, steps) varint pairs for minutes with steps, so a
+//           range query binary-searches the block start times and decodes
+//           only the blocks it needs
+//   hour    per-hour totals, a direct-indexed slot file (~2 months)
+//   day     per-day totals, a direct-indexed slot file (~2 years)
+// Updates accumulate in RAM and reach flash at most every
+// CONFIG_SENSORS_STEP_STORE_FLUSH_MIN minutes, when an hour ends or on
+// step_store_flush(). Thread-safe.
+//
+// Time units: minutes are UTC epoch minutes; hours and days are numbered in
+// local time (day 0 = 1970-01-01, hour = day * 24 + hour of day), so a day
+// chart follows the wall clock.
+#define STEP_STORE_BLOCK_SIZE 256
+#define STEP_STORE_BLOCKS 256         // 64 KB, a few months of walking
+#define STEP_STORE_HOUR_SLOTS (24 * 62)
+#define STEP_STORE_DAY_SLOTS 732
+
+typedef enum {
+  STEP_STORE_MINUTE = 0,
+  STEP_STORE_HOUR,
+  STEP_STORE_DAY,
+} step_store_res_t;
+
+typedef struct {
+  uint32_t t;     // unit index (see above)
+  uint32_t steps;
+} step_store_point_t;
+
+// Open or create the store files under `dir` (e.g. "/spiffs")
+esp_err_t step_store_init(const char *dir);
+
+// Account `steps` taken at wall-clock time `now`. Call with 0 steps
+// periodically so pending data is flushed after quiet periods. Ignored until
+// the clock has been set.
+void step_store_add(time_t now, uint32_t steps);
+
+// Write everything pending to flash
+esp_err_t step_store_flush(void);
+
+// Unit index of `t` at resolution `res`
+uint32_t step_store_unit(step_store_res_t res, time_t t);
+
+// Non-zero totals with from <= t < to, oldest first. Returns the number of
+// points written to `out` (at most `max`); continue from out[n - 1].t + 1
+// when it is full.
+int step_store_query(step_store_res_t res, uint32_t from, uint32_t to,
+                     step_store_point_t *out, int max);
+
+// Steps recorded on the local day containing `t`
+uint32_t step_store_day_total(time_t t);
+
+#ifdef __cplusplus
+}
+#endif
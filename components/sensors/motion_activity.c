@@ -0,0 +1,150 @@
+// Windowed feature-based activity classifier (see motion_activity.h)
+
+#include "motion_activity.h"
+#include "motion_dsp.h"
+#include <string.h>
+
+// 2 cos(2 pi k / MOTION_ACTIVITY_WINDOW) in Q14, k = 1..MOTION_ACTIVITY_BINS
+static const int32_t k_goertzel_coef[MOTION_ACTIVITY_BINS] = {
+    32729, 32610, 32413, 32138, 31786, 31357, 30853, 30274,
+};
+
+#define ZC_DEADBAND_Q12 MOTION_DSP_MG_Q12(20)
+#define CONFIRM_WINDOWS 2
+
+// Decision tree thresholds
+#define STILL_STD_MG 45         // below this (and a steady wrist): idle
+#define STILL_PITCH_Q7 MOTION_DSP_DEG_Q7(4)
+#define STEP_STD_MG 60          // stepping needs at least this much bounce
+#define STEP_SHARE_Q8 77        // ...with >= 30% of it in one bin
+#define STEP_MIN_CHZ 120        // ...between 1.2 and 3.6 Hz
+#define STEP_MAX_CHZ 360
+#define RUN_MIN_CHZ 235         // cadence above ~140 steps/min
+#define RUN_STD_MG 300          // or a hard bounce
+#define CYCLE_PITCH_Q7 MOTION_DSP_DEG_Q7(6) // handlebar: steady wrist...
+#define CYCLE_MAX_STD_MG 250    // ...road vibration, not impacts...
+#define CYCLE_MIN_ZCR 30        // ...broadband, so |a| crosses often
+#define OTHER_PITCH_Q7 MOTION_DSP_DEG_Q7(8)
+
+void motion_activity_init(motion_activity_t *a) {
+  memset(a, 0, sizeof(*a));
+  a->raw = SENSORS_ACTIVITY_IDLE;
+  a->out = SENSORS_ACTIVITY_IDLE;
+}
+
+void motion_activity_features(const int16_t *mag_q12, const int16_t *pitch_q7,
+                              int n, uint32_t period_us,
+                              motion_activity_features_t *f) {
+  memset(f, 0, sizeof(*f));
+  if (n <= 0)
+    return;
+  int32_t sum = 0, psum = 0;
+  for (int i = 0; i < n; ++i) {
+    sum += mag_q12[i] - MOTION_DSP_ONE_G_Q12;
+    psum += pitch_q7[i];
+  }
+  int32_t mean = sum / n, pmean = psum / n;
+  f->mean_q12 = mean;
+
+  // Variances, zero crossings
+  int64_t var = 0, pvar = 0;
+  int sign = 0, zc = 0;
+  for (int i = 0; i < n; ++i) {
+    int32_t d = mag_q12[i] - MOTION_DSP_ONE_G_Q12 - mean;
+    int32_t p = pitch_q7[i] - pmean;
+    var += (int64_t)d * d;
+    pvar += (int64_t)p * p;
+    int s = d > ZC_DEADBAND_Q12 ? 1 : d < -ZC_DEADBAND_Q12 ? -1 : 0;
+    if (s != 0) {
+      if (sign != 0 && s != sign)
+        zc++;
+      sign = s;
+    }
+  }
+  f->zcr = (uint16_t)zc;
+  f->std_mg = motion_dsp_sqrt((uint32_t)(var / n)) * 1000u /
+              MOTION_DSP_ONE_G_Q12;
+  f->pitch_std_q7 = motion_dsp_sqrt((uint32_t)(pvar / n));
+
+  // Goertzel: s = x + coef * s1 - s2, power = s1^2 + s2^2 - coef * s1 * s2.
+  // The coefficients assume a full window; shorter ones only blur the bins.
+  int64_t best = 0;
+  for (int k = 0; k < MOTION_ACTIVITY_BINS; ++k) {
+    int32_t c = k_goertzel_coef[k], s1 = 0, s2 = 0;
+    for (int i = 0; i < n; ++i) {
+      int32_t x = mag_q12[i] - MOTION_DSP_ONE_G_Q12 - mean;
+      int32_t s0 = x + (int32_t)(((int64_t)c * s1) >> 14) - s2;
+      s2 = s1;
+      s1 = s0;
+    }
+    int64_t p = (int64_t)s1 * s1 + (int64_t)s2 * s2 -
+                (int64_t)(((int64_t)c * s1) >> 14) * s2;
+    if (p > best) {
+      best = p;
+      f->peak_bin = (uint8_t)(k + 1);
+    }
+  }
+  // A sinusoid puts N/2 of the variance sum into its bin's power
+  if (var > 0) {
+    int64_t share = (best * 512) / ((int64_t)n * var);
+    f->peak_share = (uint8_t)(share > 255 ? 255 : share);
+  }
+  if (period_us > 0)
+    f->peak_chz = (uint16_t)(f->peak_bin * 100000000ull /
+                             ((uint64_t)MOTION_ACTIVITY_WINDOW * period_us));
+}
+
+sensors_activity_t motion_activity_classify(
+    const motion_activity_features_t *f) {
+  if (f->std_mg < STILL_STD_MG && f->pitch_std_q7 < STILL_PITCH_Q7)
+    return SENSORS_ACTIVITY_IDLE;
+  if (f->std_mg >= STEP_STD_MG && f->peak_share >= STEP_SHARE_Q8 &&
+      f->peak_chz >= STEP_MIN_CHZ && f->peak_chz <= STEP_MAX_CHZ) {
+    if (f->peak_chz >= RUN_MIN_CHZ || f->std_mg >= RUN_STD_MG)
+      return SENSORS_ACTIVITY_RUN;
+    return SENSORS_ACTIVITY_WALK;
+  }
+  if (f->pitch_std_q7 < CYCLE_PITCH_Q7 && f->std_mg >= STILL_STD_MG &&
+      f->std_mg < CYCLE_MAX_STD_MG && f->zcr >= CYCLE_MIN_ZCR)
+    return SENSORS_ACTIVITY_CYCLE;
+  if (f->std_mg >= STEP_STD_MG || f->pitch_std_q7 >= OTHER_PITCH_Q7)
+    return SENSORS_ACTIVITY_OTHER;
+  return SENSORS_ACTIVITY_IDLE;
+}
+
+static void finish_window(motion_activity_t *a) {
+  motion_activity_features(a->mag, a->pitch, a->n, a->period_us, &a->feat);
+  sensors_activity_t c = motion_activity_classify(&a->feat);
+  // Switch only when two windows in a row agree
+  if (c != a->out && c == a->raw)
+    a->out = c;
+  a->raw = c;
+  a->windows++;
+  a->n = 0;
+}
+
+bool motion_activity_feed(motion_activity_t *a, const int16_t *mag_q12,
+                          const int16_t *pitch_q7, int n, uint32_t t0_ms,
+                          uint32_t period_us) {
+  if (n <= 0)
+    return false;
+  // More than two sample periods missing: the window would mix two
+  // separate stretches of data
+  if (a->n > 0 && (period_us != a->period_us ||
+                   (int32_t)(t0_ms - a->next_ms) > (int32_t)(period_us / 500)))
+    a->n = 0;
+  a->period_us = period_us;
+  bool done = false;
+  for (int i = 0; i < n; ++i) {
+    a->mag[a->n] = mag_q12[i];
+    a->pitch[a->n] = pitch_q7[i];
+    if (++a->n == MOTION_ACTIVITY_WINDOW) {
+      a->window_end_ms =
+          t0_ms + (uint32_t)((uint64_t)i * period_us / 1000);
+      finish_window(a);
+      done = true;
+    }
+  }
+  a->next_ms = t0_ms + (uint32_t)((uint64_t)n * period_us / 1000);
+  return done;
+}
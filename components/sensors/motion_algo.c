@@ -0,0 +1,202 @@
+// Step, activity and raise-to-wake algorithms (see motion_algo.h)
+
+#include "motion_algo.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Step detector (the low-pass itself is in motion_dsp.c, alpha 0.1)
+#define STEP_THRESH_Q12 MOTION_DSP_MG_Q12(80) // mg (more sensitive)
+#define STEP_MIN_GAP_MS 280
+
+// Raise-to-wake sensitivity (tune to taste)
+#define RAISE_DP_THRESH_Q7 MOTION_DSP_DEG_Q7(55) // min pitch delta for a raise
+#define RAISE_ACCEL_MIN_Q12 MOTION_DSP_MG_Q12(850)  // accel magnitude bounds
+#define RAISE_ACCEL_MAX_Q12 MOTION_DSP_MG_Q12(1150)
+#define RAISE_COOLDOWN_MS 3500     // min ms between wakeups
+#define RAISE_LOOKBACK_MIN_MS 400  // compare with the pitch this long ago...
+#define RAISE_LOOKBACK_MAX_MS 700  // ...but no older than this
+
+// Classifier windows older than this fall back to the cadence classes
+// (e.g. the FIFO stream is paused and only the pedometer counts)
+#define ACTIVITY_STALE_MS 6000
+
+// Software any-motion: gravity-removed magnitude or pitch swing in a batch
+#define MOTION_LP_Q12 MOTION_DSP_MG_Q12(60)
+#define MOTION_PITCH_Q7 MOTION_DSP_DEG_Q7(10)
+
+void motion_algo_init(motion_algo_t *m) {
+  memset(m, 0, sizeof(*m));
+  motion_dsp_init(&m->dsp);
+  m->ready_for_next_peak = true;
+  m->activity = SENSORS_ACTIVITY_IDLE;
+  m->cadence_activity = SENSORS_ACTIVITY_IDLE;
+  motion_activity_init(&m->classifier);
+  motion_gesture_init(&m->gesture);
+}
+
+static void record_step(motion_algo_t *m, uint32_t t_ms) {
+  m->step_ts_ms[m->step_ts_idx] = t_ms;
+  m->step_ts_idx = (m->step_ts_idx + 1) & 7;
+  if (m->step_ts_num < 8)
+    m->step_ts_num++;
+  m->last_step_ms = t_ms;
+}
+
+// Prefer the classifier while its windows are fresh; cadence classes expire
+// the same way once steps stop
+static void select_activity(motion_algo_t *m, uint32_t t_ms) {
+  if (m->classifier.windows > 0 &&
+      (t_ms - m->classifier.window_end_ms) < ACTIVITY_STALE_MS)
+    m->activity = m->classifier.out;
+  else if (m->step_ts_num > 0 && (t_ms - m->last_step_ms) < ACTIVITY_STALE_MS)
+    m->activity = m->cadence_activity;
+  else
+    m->activity = SENSORS_ACTIVITY_IDLE;
+}
+
+// Classify activity by cadence (last N steps)
+static void update_activity(motion_algo_t *m) {
+  if (m->step_ts_num < 2) {
+    m->cadence_activity = SENSORS_ACTIVITY_IDLE;
+    return;
+  }
+  uint32_t oldest = m->step_ts_ms[(m->step_ts_idx - m->step_ts_num + 8) & 7];
+  uint32_t newest = m->step_ts_ms[(m->step_ts_idx - 1 + 8) & 7];
+  uint32_t span_ms = newest - oldest;
+  uint32_t spm = 0;
+  if (span_ms > 0) {
+    spm = 60000u * (uint32_t)(m->step_ts_num - 1) / span_ms;
+  }
+  if (spm > 130)
+    m->cadence_activity = SENSORS_ACTIVITY_RUN;
+  else if (spm > 60)
+    m->cadence_activity = SENSORS_ACTIVITY_WALK;
+  else if (spm > 10)
+    m->cadence_activity = SENSORS_ACTIVITY_OTHER;
+  else
+    m->cadence_activity = SENSORS_ACTIVITY_IDLE;
+}
+
+void motion_algo_add_steps(motion_algo_t *m, uint32_t steps, uint32_t t_ms) {
+  if (steps == 0)
+    return;
+  // Per-step timestamps are not available; stamp the newest ones with the
+  // read time, which is close as long as reads follow the step interrupts
+  for (uint32_t i = 0; i < steps && i < 8; ++i)
+    record_step(m, t_ms);
+  update_activity(m);
+  select_activity(m, t_ms);
+}
+
+// `lp` is the low-passed (|a| - 1 g) from motion_dsp_block()
+static bool detect_step(motion_algo_t *m, int16_t lp, uint32_t t_ms) {
+  // Peak detection. A peak after a long pause starts a new bout; it must not
+  // be rejected, or counting never resumes once the wearer stood still.
+  uint32_t dt = t_ms - m->last_step_ms;
+  if (lp > STEP_THRESH_Q12 && dt > STEP_MIN_GAP_MS) {
+    if (m->ready_for_next_peak) {
+      record_step(m, t_ms);
+      update_activity(m);
+      m->ready_for_next_peak = false;
+      return true;
+    }
+  } else if (lp < STEP_THRESH_Q12 / 2) {
+    m->ready_for_next_peak = true;
+  }
+  return false;
+}
+
+// Returns the pitch change when a raise completes at this sample, else 0
+static int16_t detect_raise(motion_algo_t *m, int16_t pitch, int16_t mag,
+                            uint32_t t_ms, bool armed) {
+  m->pitch_hist[m->hist_idx] = pitch;
+  m->ts_hist[m->hist_idx] = t_ms;
+  m->hist_idx = (m->hist_idx + 1) & (MOTION_ALGO_PITCH_HIST - 1);
+  if (m->hist_num < MOTION_ALGO_PITCH_HIST)
+    m->hist_num++;
+  if (!armed)
+    return 0;
+
+  int16_t pitch_prev = pitch;
+  for (int k = 1; k <= m->hist_num; ++k) {
+    int idx = (m->hist_idx - k + MOTION_ALGO_PITCH_HIST) &
+              (MOTION_ALGO_PITCH_HIST - 1);
+    uint32_t dtms = t_ms - m->ts_hist[idx];
+    if (dtms >= RAISE_LOOKBACK_MIN_MS && dtms <= RAISE_LOOKBACK_MAX_MS) {
+      pitch_prev = m->pitch_hist[idx];
+      break;
+    }
+  }
+  int32_t dp = (int32_t)pitch - pitch_prev; // positive when lifting display up
+  bool accel_ok = (mag > RAISE_ACCEL_MIN_Q12 &&
+                   mag < RAISE_ACCEL_MAX_Q12); // avoid big shakes
+  if (dp > RAISE_DP_THRESH_Q7 && accel_ok)
+    return (int16_t)dp;
+  return 0;
+}
+
+void motion_algo_process(motion_algo_t *m, const motion_batch_t *b,
+                         bool count_steps, bool detect_raise_on,
+                         motion_algo_result_t *out) {
+  int16_t mag[MOTION_DSP_MAX_BLOCK], lp[MOTION_DSP_MAX_BLOCK],
+      pitch[MOTION_DSP_MAX_BLOCK];
+  memset(out, 0, sizeof(*out));
+  if (!b->gyro && m->gesture.valid)
+    motion_gesture_reset(&m->gesture); // gyro powered down
+  motion_dsp_set_period(&m->dsp, b->period_us);
+  uint32_t dmag_sum = 0;
+  int16_t mag_prev = 0;
+  for (int base = 0; base < b->n; base += MOTION_DSP_MAX_BLOCK) {
+    int n = b->n - base;
+    if (n > MOTION_DSP_MAX_BLOCK)
+      n = MOTION_DSP_MAX_BLOCK;
+    motion_dsp_block(&m->dsp, &b->xyz[base * 3], n, mag, lp, pitch);
+    uint32_t t0_ms =
+        b->t0_ms + (uint32_t)((uint64_t)base * b->period_us / 1000);
+    if (motion_activity_feed(&m->classifier, mag, pitch, n, t0_ms,
+                             b->period_us))
+      out->activity_window = true;
+    int16_t pmin = pitch[0], pmax = pitch[0];
+    for (int i = 0; i < n; ++i) {
+      uint32_t t_ms =
+          b->t0_ms + (uint32_t)((uint64_t)(base + i) * b->period_us / 1000);
+      if (count_steps && detect_step(m, lp[i], t_ms))
+        out->steps++;
+      bool armed = detect_raise_on &&
+                   (t_ms - m->last_raise_ms) > RAISE_COOLDOWN_MS;
+      int16_t dp = detect_raise(m, pitch[i], mag[i], t_ms, armed && !b->gyro);
+      if (b->gyro)
+        dp = motion_gesture_update(&m->gesture, pitch[i], mag[i],
+                                   &b->gyro[(base + i) * 3], t_ms,
+                                   b->period_us, armed);
+      if (dp > 0) {
+        m->last_raise_ms = t_ms;
+        if (!out->raise) {
+          out->raise = true;
+          out->raise_t_ms = t_ms;
+          out->raise_dp_q7 = dp;
+          out->raise_gyro = b->gyro != NULL;
+        }
+      }
+      if (lp[i] > MOTION_LP_Q12 || lp[i] < -MOTION_LP_Q12)
+        out->motion = true;
+      if (base + i > 0)
+        dmag_sum += (uint32_t)abs(mag[i] - mag_prev);
+      mag_prev = mag[i];
+      if (pitch[i] < pmin)
+        pmin = pitch[i];
+      if (pitch[i] > pmax)
+        pmax = pitch[i];
+    }
+    if (pmax - pmin > MOTION_PITCH_Q7)
+      out->motion = true;
+  }
+  if (b->n > 1) {
+    uint64_t mg = (uint64_t)dmag_sum * 1000u / MOTION_DSP_ONE_G_Q12 /
+                  (uint32_t)(b->n - 1);
+    out->activity_mg = (uint16_t)(mg > UINT16_MAX ? UINT16_MAX : mg);
+  }
+  select_activity(m, b->n > 0 ? b->t0_ms + (uint32_t)((uint64_t)(b->n - 1) *
+                                                      b->period_us / 1000)
+                              : b->t0_ms);
+}
@@ -0,0 +1,234 @@
+// Fixed-point accelerometer kernel (see motion_dsp.h)
+
+#include "motion_dsp.h"
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+#if CONFIG_SENSORS_DSP_ESP_DSP
+#include "dsps_mul.h"
+#endif
+
+#define LP_ALPHA_Q15 3277 // 0.1
+#define LP_PERIOD_US 16000
+#define LP_LN_KEEP_Q15 3452 // -ln(1 - 0.1)
+
+// round(sqrt((i + 16.5) * 2^26)): first guess for a normalised argument
+static const uint16_t k_sqrt_seed[48] = {
+    33276, 34270, 35235, 36175, 37091, 37985, 38858, 39712, 40548, 41368,
+    42171, 42959, 43733, 44494, 45242, 45977, 46702, 47415, 48117, 48809,
+    49492, 50166, 50830, 51486, 52134, 52773, 53405, 54030, 54647, 55258,
+    55862, 56459, 57051, 57636, 58215, 58789, 59357, 59919, 60477, 61029,
+    61576, 62119, 62657, 63190, 63719, 64243, 64763, 65279,
+};
+
+// atan(r) = r * P(r^2) for r in [0, 1], Q15 (Abramowitz & Stegun 4.4.49)
+#define ATAN_C1 32764
+#define ATAN_C3 -10823
+#define ATAN_C5 5903
+#define ATAN_C7 -2790
+#define ATAN_C9 683
+#define RAD_Q15_TO_DEG_Q7 7334 // 180 / pi * 128, applied as Q15
+
+#if CONFIG_SENSORS_DSP_ESP_DSP
+static bool s_accel = true;
+#else
+static bool s_accel = false;
+#endif
+
+void motion_dsp_set_accel(bool enable) {
+#if CONFIG_SENSORS_DSP_ESP_DSP
+  s_accel = enable;
+#else
+  (void)enable;
+#endif
+}
+
+bool motion_dsp_accel_enabled(void) { return s_accel; }
+
+void motion_dsp_init(motion_dsp_state_t *st) {
+  st->lp_q28 = 0;
+  st->alpha_q15 = LP_ALPHA_Q15;
+  st->period_us = LP_PERIOD_US;
+}
+
+// alpha = 1 - 0.9^(period / 16 ms) = 1 - e^-x, from the series to x^3
+// (within 0.5% up to 64 ms)
+void motion_dsp_set_period(motion_dsp_state_t *st, uint32_t period_us) {
+  if (period_us == st->period_us || period_us == 0)
+    return;
+  if (period_us > 4 * LP_PERIOD_US)
+    period_us = 4 * LP_PERIOD_US;
+  int32_t x = (int32_t)((uint64_t)period_us * LP_LN_KEEP_Q15 / LP_PERIOD_US);
+  int32_t x2 = (x * x) >> 15, x3 = (x2 * x) >> 15;
+  st->alpha_q15 = x - x2 / 2 + x3 / 6;
+  st->period_us = period_us;
+}
+
+// sqrt(v) within 1 LSB: normalise to [2^30, 2^32), table seed, one Newton
+// step (a single integer division)
+static inline uint32_t sqrt32(uint32_t v) {
+  if (v == 0)
+    return 0;
+  int sh = __builtin_clz(v) & ~1;
+  uint32_t n = v << sh;
+  uint32_t r = k_sqrt_seed[(n >> 26) - 16];
+  r = (r + n / r) >> 1;
+  return r >> (sh >> 1);
+}
+
+uint32_t motion_dsp_sqrt(uint32_t v) { return sqrt32(v); }
+
+// Keeps squares within int16: (-32768)^2 >> 15 would not fit
+static inline int16_t sat_sample(int16_t v) { return v == INT16_MIN ? -32767 : v; }
+
+// Square in Q11 g^2 from Q13 g
+static inline int16_t square_q11(int16_t v) {
+  return (int16_t)(((int32_t)v * v) >> 15);
+}
+
+// atan2(a, b) for b >= 0, any common scale; result in Q7 degrees. One
+// division for the octant ratio, then an odd polynomial.
+static inline int16_t atan2_q7(int32_t a, uint32_t b) {
+  uint32_t aa = a < 0 ? (uint32_t)-a : (uint32_t)a;
+  if (aa == 0 && b == 0)
+    return 0;
+  bool swap = aa > b;
+  uint32_t num = swap ? b : aa, den = swap ? aa : b;
+  int32_t r = (int32_t)((num << 15) / den); // num < 2^16, Q15 in [0, 1]
+  int32_t r2 = (r * r) >> 15;
+  int32_t p = ATAN_C9;
+  p = ATAN_C7 + ((p * r2) >> 15);
+  p = ATAN_C5 + ((p * r2) >> 15);
+  p = ATAN_C3 + ((p * r2) >> 15);
+  p = ATAN_C1 + ((p * r2) >> 15);
+  int32_t deg = (((p * r) >> 15) * RAD_Q15_TO_DEG_Q7 + (1 << 14)) >> 15;
+  if (swap)
+    deg = 90 * 128 - deg;
+  return (int16_t)(a < 0 ? -deg : deg);
+}
+
+static inline int16_t lp_step(motion_dsp_state_t *st, int16_t mag) {
+  int32_t hp = (int32_t)mag - MOTION_DSP_ONE_G_Q12;
+  int64_t err = ((int64_t)hp << 16) - st->lp_q28;
+  st->lp_q28 += (int32_t)((err * st->alpha_q15) >> 15);
+  return (int16_t)(st->lp_q28 >> 16);
+}
+
+void motion_dsp_ref(motion_dsp_state_t *st, const int16_t xyz[3],
+                    int16_t *mag, int16_t *lp, int16_t *pitch) {
+  int16_t x = sat_sample(xyz[0]), y = sat_sample(xyz[1]),
+          z = sat_sample(xyz[2]);
+  int32_t sx = square_q11(x), sy = square_q11(y), sz = square_q11(z);
+  int16_t m = (int16_t)sqrt32((uint32_t)(sx + sy + sz) << 13);
+  uint32_t b = sqrt32((uint32_t)((int32_t)y * y) + (uint32_t)((int32_t)z * z));
+  if (mag)
+    *mag = m;
+  int16_t l = lp_step(st, m);
+  if (lp)
+    *lp = l;
+  if (pitch)
+    *pitch = atan2_q7(-(int32_t)x, b);
+}
+
+void motion_dsp_block(motion_dsp_state_t *st, const int16_t *xyz, int n,
+                      int16_t *mag, int16_t *lp, int16_t *pitch) {
+  int16_t ax[MOTION_DSP_MAX_BLOCK], ay[MOTION_DSP_MAX_BLOCK],
+      az[MOTION_DSP_MAX_BLOCK];
+  int16_t sx[MOTION_DSP_MAX_BLOCK], sy[MOTION_DSP_MAX_BLOCK],
+      sz[MOTION_DSP_MAX_BLOCK];
+  int16_t m[MOTION_DSP_MAX_BLOCK];
+  if (n > MOTION_DSP_MAX_BLOCK)
+    n = MOTION_DSP_MAX_BLOCK;
+  if (n <= 0)
+    return;
+
+  // De-interleave and saturate
+  for (int i = 0; i < n; ++i) {
+    ax[i] = sat_sample(xyz[i * 3 + 0]);
+    ay[i] = sat_sample(xyz[i * 3 + 1]);
+    az[i] = sat_sample(xyz[i * 3 + 2]);
+  }
+
+  // Squares (Q11 g^2)
+#if CONFIG_SENSORS_DSP_ESP_DSP
+  if (s_accel) {
+    dsps_mul_s16(ax, ax, sx, n, 1, 1, 1, 15);
+    dsps_mul_s16(ay, ay, sy, n, 1, 1, 1, 15);
+    dsps_mul_s16(az, az, sz, n, 1, 1, 1, 15);
+  } else
+#endif
+  {
+    for (int i = 0; i < n; ++i) {
+      sx[i] = square_q11(ax[i]);
+      sy[i] = square_q11(ay[i]);
+      sz[i] = square_q11(az[i]);
+    }
+  }
+
+  // Magnitude
+  for (int i = 0; i < n; ++i)
+    m[i] = (int16_t)sqrt32((uint32_t)((int32_t)sx[i] + sy[i] + sz[i]) << 13);
+
+  // Pitch needs the y/z norm at full precision: near vertical it is small
+  // and Q11 squares would cost degrees
+  if (pitch) {
+    for (int i = 0; i < n; ++i) {
+      uint32_t b = sqrt32((uint32_t)((int32_t)ay[i] * ay[i]) +
+                          (uint32_t)((int32_t)az[i] * az[i]));
+      pitch[i] = atan2_q7(-(int32_t)ax[i], b);
+    }
+  }
+  if (mag)
+    memcpy(mag, m, (size_t)n * sizeof(int16_t));
+
+  // Gravity removal and low-pass (sequential by nature)
+  for (int i = 0; i < n; ++i) {
+    int16_t l = lp_step(st, m[i]);
+    if (lp)
+      lp[i] = l;
+  }
+}
+
+static uint32_t crc32_update(uint32_t crc, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (int k = 0; k < 8; ++k)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+  }
+  return ~crc;
+}
+
+uint32_t motion_dsp_checksum(void) {
+  int16_t xyz[MOTION_DSP_MAX_BLOCK * 3];
+  int16_t mag[MOTION_DSP_MAX_BLOCK], lp[MOTION_DSP_MAX_BLOCK],
+      pitch[MOTION_DSP_MAX_BLOCK];
+  motion_dsp_state_t st;
+  motion_dsp_init(&st);
+  uint32_t rng = 0x12345678u, crc = 0;
+  for (int blk = 0; blk < 16; ++blk) {
+    for (int i = 0; i < MOTION_DSP_MAX_BLOCK * 3; ++i) {
+      rng = rng * 1664525u + 1013904223u;
+      xyz[i] = (int16_t)(rng >> 16);
+    }
+    // Edge cases: full scale, zero vector, exactly 1 g
+    xyz[0] = INT16_MIN;
+    xyz[1] = INT16_MAX;
+    xyz[2] = INT16_MIN;
+    xyz[3] = xyz[4] = xyz[5] = 0;
+    xyz[6] = xyz[7] = 0;
+    xyz[8] = 8192;
+    motion_dsp_block(&st, xyz, MOTION_DSP_MAX_BLOCK, mag, lp, pitch);
+    crc = crc32_update(crc, mag, sizeof(mag));
+    crc = crc32_update(crc, lp, sizeof(lp));
+    crc = crc32_update(crc, pitch, sizeof(pitch));
+  }
+  return crc;
+}
+
+bool motion_dsp_selftest(void) {
+  return motion_dsp_checksum() == MOTION_DSP_GOLDEN_CRC;
+}
@@ -0,0 +1,95 @@
+// Gyro-assisted raise-to-wake (see motion_gesture.h)
+
+#include "motion_gesture.h"
+#include "motion_dsp.h"
+#include <string.h>
+
+#define RISE_Q15 ((int32_t)MOTION_GESTURE_RISE_DEG << 15) // fused pitch rise
+// The rise is extrapolated by the current rate, so a fast turn is reported
+// before it ends; at least MIN_RISE must have happened already
+#define LOOKAHEAD_MS 80
+#define MIN_RISE_Q15 ((int32_t)20 << 15)
+#define SWEEP_RATE_LSB (30 * MOTION_GESTURE_GYRO_LSB_PER_DPS) // 30 dps
+#define SWEEP_GAP_MS 120     // a sweep may pause this long
+#define CALM_WINDOW_MS 400   // the wrist before the sweep...
+#define CALM_RANGE_Q7 MOTION_DSP_DEG_Q7(30) // ...moved less than this
+#define CALM_MIN_HIST_MS 200 // less history (gyro just on) counts as calm
+// Accelerometer correction, ~0.5 s time constant at 62.5 Hz, only while
+// the accelerometer mostly sees gravity
+#define ACC_GAIN_SHIFT 5
+#define ACC_MIN_Q12 MOTION_DSP_MG_Q12(800)
+#define ACC_MAX_Q12 MOTION_DSP_MG_Q12(1200)
+
+void motion_gesture_init(motion_gesture_t *g) { memset(g, 0, sizeof(*g)); }
+
+void motion_gesture_reset(motion_gesture_t *g) { motion_gesture_init(g); }
+
+// Range of the fused pitch over the calm window before `t_ms`
+static bool calm_before(const motion_gesture_t *g, uint32_t t_ms) {
+  int16_t lo = INT16_MAX, hi = INT16_MIN;
+  uint32_t span = 0;
+  for (int k = 1; k <= g->hist_num; ++k) {
+    int idx = (g->hist_idx - k + MOTION_GESTURE_HIST) & (MOTION_GESTURE_HIST - 1);
+    uint32_t age = t_ms - g->hist_ts[idx];
+    if (age > CALM_WINDOW_MS)
+      break;
+    span = age;
+    if (g->hist[idx] < lo)
+      lo = g->hist[idx];
+    if (g->hist[idx] > hi)
+      hi = g->hist[idx];
+  }
+  if (span < CALM_MIN_HIST_MS)
+    return true;
+  return (int32_t)hi - lo < CALM_RANGE_Q7;
+}
+
+int16_t motion_gesture_update(motion_gesture_t *g, int16_t pitch_q7,
+                              int16_t mag_q12, const int16_t gyro[3],
+                              uint32_t t_ms, uint32_t period_us, bool armed) {
+  int32_t acc_q15 = (int32_t)pitch_q7 << 8;
+  if (!g->valid) {
+    g->pitch_q15 = acc_q15;
+    g->valid = true;
+  }
+  int32_t prev_q15 = g->pitch_q15;
+
+  // Integrate the rate: LSB * us -> Q15 degrees is * 2^15 / (64 * 10^6)
+  int32_t rate = gyro[1];
+  g->pitch_q15 += (int32_t)((int64_t)rate * period_us *
+                            (32768 / MOTION_GESTURE_GYRO_LSB_PER_DPS) /
+                            1000000);
+  if (mag_q12 > ACC_MIN_Q12 && mag_q12 < ACC_MAX_Q12)
+    g->pitch_q15 += (acc_q15 - g->pitch_q15) >> ACC_GAIN_SHIFT;
+
+  // Sweep tracking
+  if (rate > SWEEP_RATE_LSB) {
+    if (!g->sweep) {
+      g->sweep = true;
+      g->sweep_start_q15 = prev_q15;
+      g->sweep_start_ms = t_ms;
+      g->sweep_calm = calm_before(g, t_ms);
+    }
+    g->last_up_ms = t_ms;
+  } else if (g->sweep &&
+             (rate < -SWEEP_RATE_LSB || t_ms - g->last_up_ms > SWEEP_GAP_MS)) {
+    g->sweep = false;
+  }
+
+  g->hist[g->hist_idx] = (int16_t)(g->pitch_q15 >> 8);
+  g->hist_ts[g->hist_idx] = t_ms;
+  g->hist_idx = (g->hist_idx + 1) & (MOTION_GESTURE_HIST - 1);
+  if (g->hist_num < MOTION_GESTURE_HIST)
+    g->hist_num++;
+
+  if (!armed || !g->sweep || !g->sweep_calm)
+    return 0;
+  int32_t rise = g->pitch_q15 - g->sweep_start_q15;
+  int32_t ahead = (int32_t)((int64_t)rate * LOOKAHEAD_MS *
+                            (32768 / MOTION_GESTURE_GYRO_LSB_PER_DPS) / 1000);
+  if (rise >= MIN_RISE_Q15 && rise + ahead >= RISE_Q15) {
+    g->sweep = false; // one wake per sweep
+    return (int16_t)(rise >> 8);
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+// Accelerometer rate governor (see motion_rate.h)
+
+#include "motion_rate.h"
+#include <string.h>
+
+void motion_rate_init(motion_rate_gov_t *g, uint32_t now_ms) {
+  memset(g, 0, sizeof(*g));
+  g->rate = MOTION_RATE_MID;
+  g->changed_ms = now_ms;
+  g->last_high_ms = now_ms - MOTION_RATE_HIGH_HOLD_MS;
+  g->last_mid_ms = now_ms;
+}
+
+motion_rate_t motion_rate_update(motion_rate_gov_t *g,
+                                 const motion_rate_input_t *in,
+                                 uint32_t now_ms) {
+  bool active = in->activity == SENSORS_ACTIVITY_WALK ||
+                in->activity == SENSORS_ACTIVITY_RUN ||
+                in->activity == SENSORS_ACTIVITY_CYCLE;
+  // A wrist raise starts from rest: the first motion after a still period
+  // gets the high rate while the gesture detector is watching
+  if (in->activity == SENSORS_ACTIVITY_RUN ||
+      (in->motion && g->still && in->raise_armed))
+    g->last_high_ms = now_ms;
+  if (in->motion || active) {
+    g->last_mid_ms = now_ms;
+    g->still = false;
+  } else if (now_ms - g->last_mid_ms >= MOTION_RATE_MID_HOLD_MS) {
+    g->still = true;
+  }
+
+  motion_rate_t want = MOTION_RATE_LOW;
+  if (now_ms - g->last_high_ms < MOTION_RATE_HIGH_HOLD_MS)
+    want = MOTION_RATE_HIGH;
+  else if (!g->still)
+    want = MOTION_RATE_MID;
+  // Up at once, down only after the dwell time
+  if (want != g->rate &&
+      (want > g->rate || now_ms - g->changed_ms >= MOTION_RATE_DWELL_MS)) {
+    g->rate = want;
+    g->changed_ms = now_ms;
+    g->switches++;
+  }
+  return g->rate;
+}
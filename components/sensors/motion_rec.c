@@ -0,0 +1,359 @@
+// Columnar IMU recording format (see motion_rec.h)
+
+#include "motion_rec.h"
+#include "motion_trace.h"
+#include <string.h>
+
+#define BLOCK_MAGIC "IMCB"
+#define INDEX_MAGIC "IMCI"
+#define MAX_WIDTH 17 // zigzag of an int16 difference
+#define HDR_BYTES sizeof(motion_rec_block_hdr_t)
+// Upper bound of a batch table entry: t0 delta, count, period, flags, label
+#define ENTRY_MAX_BYTES (10 + 2 + 5 + 2 + 2)
+
+// CRC-32 (IEEE) running state: start from 0xFFFFFFFF, invert at the end
+static uint32_t crc32_update(uint32_t crc, const uint8_t *p, size_t len) {
+  static const uint32_t k_nibble[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+      0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+      0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+  };
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= p[i];
+    crc = (crc >> 4) ^ k_nibble[crc & 15];
+    crc = (crc >> 4) ^ k_nibble[crc & 15];
+  }
+  return crc;
+}
+
+static inline uint32_t zigzag(int32_t v) {
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static inline uint64_t zigzag64(int64_t v) {
+  return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t unzigzag64(uint64_t v) {
+  return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static inline uint8_t bit_width(uint32_t v) {
+  uint8_t w = 0;
+  while (v) {
+    w++;
+    v >>= 1;
+  }
+  return w;
+}
+
+static size_t varint_put(uint8_t *p, uint64_t v) {
+  size_t n = 0;
+  do {
+    uint8_t b = v & 0x7F;
+    v >>= 7;
+    p[n++] = b | (v ? 0x80 : 0);
+  } while (v);
+  return n;
+}
+
+static bool varint_get(const uint8_t *p, size_t end, size_t *pos,
+                       uint64_t *v) {
+  *v = 0;
+  for (int shift = 0; shift < 64 && *pos < end; shift += 7) {
+    uint8_t b = p[(*pos)++];
+    *v |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+static size_t open_frame_bytes(int cnt, uint8_t w) {
+  return cnt ? 1 + ((size_t)cnt * w + 7) / 8 : 0;
+}
+
+static size_t block_bytes(const motion_rec_enc_t *e) {
+  size_t n = HDR_BYTES + e->table_bytes;
+  for (int c = 0; c < MOTION_REC_COLUMNS; ++c)
+    n += e->frame_bytes[c] +
+         open_frame_bytes(e->ncol[c] % MOTION_REC_FRAME, e->width[c]);
+  return n;
+}
+
+static void block_reset(motion_rec_enc_t *e) {
+  e->nbatch = 0;
+  e->table_bytes = 0;
+  for (int c = 0; c < MOTION_REC_COLUMNS; ++c) {
+    e->ncol[c] = 0;
+    e->frame_bytes[c] = 0;
+    e->width[c] = 0;
+  }
+}
+
+void motion_rec_enc_init(motion_rec_enc_t *e) {
+  memset(e, 0, sizeof(*e));
+  memcpy(e->index.magic, INDEX_MAGIC, 4);
+  e->index.stride = 1;
+}
+
+void motion_rec_header(uint8_t *out, uint32_t sample_period_us,
+                       uint32_t gyro_period_us, float mg_per_lsb,
+                       float dps_per_lsb, int64_t start_epoch) {
+  motion_rec_header_t h = {
+      .version = MOTION_REC_VERSION,
+      .header_size = sizeof(motion_rec_header_t),
+      .block_size = MOTION_REC_BLOCK_SIZE,
+      .sample_period_us = sample_period_us,
+      .gyro_period_us = gyro_period_us,
+      .mg_per_lsb = mg_per_lsb,
+      .dps_per_lsb = dps_per_lsb,
+      .start_epoch = start_epoch,
+  };
+  memcpy(h.magic, MOTION_REC_MAGIC, 4);
+  memset(out, 0, MOTION_REC_BLOCK_SIZE);
+  memcpy(out, &h, sizeof(h));
+}
+
+// Bytes the block grows by when `v` joins column c
+static size_t col_cost(const motion_rec_enc_t *e, int c, int16_t v,
+                       uint8_t *width) {
+  int n = e->ncol[c], cnt = n % MOTION_REC_FRAME;
+  int16_t prev = n ? e->col[c][n - 1] : v;
+  uint8_t w = bit_width(zigzag((int32_t)v - prev));
+  if (w < e->width[c])
+    w = e->width[c];
+  *width = w;
+  size_t before = open_frame_bytes(cnt, e->width[c]);
+  if (cnt + 1 == MOTION_REC_FRAME)
+    return 1 + (size_t)MOTION_REC_FRAME * w / 8 - before;
+  return open_frame_bytes(cnt + 1, w) - before;
+}
+
+static void col_push(motion_rec_enc_t *e, int c, int16_t v, uint8_t w) {
+  e->col[c][e->ncol[c]++] = v;
+  if (e->ncol[c] % MOTION_REC_FRAME == 0) {
+    e->frame_bytes[c] += 1 + (size_t)MOTION_REC_FRAME * w / 8;
+    e->width[c] = 0;
+  } else {
+    e->width[c] = w;
+  }
+}
+
+// Encode the block being filled into `out` and start the next one
+static void seal(motion_rec_enc_t *e, uint8_t *out) {
+  memset(out, 0, MOTION_REC_BLOCK_SIZE);
+  motion_rec_block_hdr_t h = {
+      .seq = ++e->seq,
+      .t0_us = e->batch[0].t0_us,
+      .batches = (uint16_t)e->nbatch,
+      .samples = (uint16_t)e->ncol[0],
+      .gyro_samples = (uint16_t)e->ncol[3],
+  };
+  memcpy(h.magic, BLOCK_MAGIC, 4);
+  size_t p = HDR_BYTES;
+  uint64_t prev_t = h.t0_us;
+  for (int i = 0; i < e->nbatch; ++i) {
+    const motion_rec_batch_t *b = &e->batch[i];
+    p += varint_put(out + p, zigzag64((int64_t)(b->t0_us - prev_t)));
+    p += varint_put(out + p, b->n);
+    p += varint_put(out + p, b->period_us);
+    p += varint_put(out + p, b->flags);
+    p += varint_put(out + p, b->label);
+    prev_t = b->t0_us;
+  }
+  for (int c = 0; c < MOTION_REC_COLUMNS; ++c) {
+    const int16_t *x = e->col[c];
+    int n = e->ncol[c];
+    h.col_off[c] = (uint16_t)p;
+    h.first[c] = n ? x[0] : 0;
+    for (int f = 0; f < n; f += MOTION_REC_FRAME) {
+      int cnt = n - f < MOTION_REC_FRAME ? n - f : MOTION_REC_FRAME;
+      uint32_t d[MOTION_REC_FRAME];
+      uint8_t w = 0;
+      for (int i = 0; i < cnt; ++i) {
+        int16_t prev = f + i ? x[f + i - 1] : x[0];
+        d[i] = zigzag((int32_t)x[f + i] - prev);
+        uint8_t wi = bit_width(d[i]);
+        if (wi > w)
+          w = wi;
+      }
+      out[p++] = w;
+      uint64_t acc = 0;
+      int bits = 0;
+      for (int i = 0; i < cnt; ++i) {
+        acc |= (uint64_t)d[i] << bits;
+        bits += w;
+        while (bits >= 8) {
+          out[p++] = (uint8_t)acc;
+          acc >>= 8;
+          bits -= 8;
+        }
+      }
+      if (bits > 0)
+        out[p++] = (uint8_t)acc;
+    }
+  }
+  h.used = (uint16_t)p;
+  memcpy(out, &h, sizeof(h));
+  h.crc = ~crc32_update(0xFFFFFFFFu, out, MOTION_REC_BLOCK_SIZE);
+  memcpy(out, &h, sizeof(h));
+
+  // Index: every stride-th block; halve the resolution when it is full
+  motion_rec_index_t *idx = &e->index;
+  if (h.seq == 1)
+    idx->t0_us = h.t0_us;
+  if ((h.seq - 1) % idx->stride == 0 && idx->count == MOTION_REC_INDEX_MAX) {
+    for (uint32_t i = 0; i < idx->count / 2; ++i)
+      idx->t_ms[i] = idx->t_ms[i * 2];
+    idx->count /= 2;
+    idx->stride *= 2;
+  }
+  if ((h.seq - 1) % idx->stride == 0)
+    idx->t_ms[idx->count++] = (uint32_t)((h.t0_us - idx->t0_us) / 1000);
+  idx->blocks = h.seq;
+  e->samples += h.samples;
+  idx->samples = e->samples;
+  block_reset(e);
+}
+
+int motion_rec_enc_add(motion_rec_enc_t *e, const motion_rec_batch_t *b,
+                       const int16_t *xyz, const int16_t *gyro, uint8_t *out,
+                       bool *sealed) {
+  *sealed = false;
+  bool has_gyro = gyro && (b->flags & MOTION_TRACE_F_GYRO);
+  size_t bytes = block_bytes(e);
+  int taken = 0;
+  for (; taken < b->n; ++taken) {
+    size_t grow = taken == 0 ? ENTRY_MAX_BYTES : 0;
+    uint8_t w[MOTION_REC_COLUMNS] = {0};
+    int cols = has_gyro ? MOTION_REC_COLUMNS : 3;
+    for (int c = 0; c < cols; ++c) {
+      int16_t v = c < 3 ? xyz[taken * 3 + c] : gyro[taken * 3 + c - 3];
+      grow += col_cost(e, c, v, &w[c]);
+    }
+    if (bytes + grow > MOTION_REC_BLOCK_SIZE ||
+        e->ncol[0] == MOTION_REC_MAX_SAMPLES ||
+        (taken == 0 && e->nbatch == MOTION_REC_MAX_BATCHES))
+      break;
+    if (taken == 0) {
+      e->batch[e->nbatch] = *b;
+      e->batch[e->nbatch].n = 0;
+      e->batch[e->nbatch].flags =
+          has_gyro ? (b->flags | MOTION_TRACE_F_GYRO)
+                   : (b->flags & ~MOTION_TRACE_F_GYRO);
+      e->nbatch++;
+      e->table_bytes += ENTRY_MAX_BYTES;
+    }
+    for (int c = 0; c < cols; ++c)
+      col_push(e, c, c < 3 ? xyz[taken * 3 + c] : gyro[taken * 3 + c - 3],
+               w[c]);
+    e->batch[e->nbatch - 1].n++;
+    bytes += grow;
+  }
+  if (taken < b->n && e->nbatch > 0) {
+    seal(e, out);
+    *sealed = true;
+  }
+  return taken;
+}
+
+bool motion_rec_enc_flush(motion_rec_enc_t *e, uint8_t *out) {
+  if (e->nbatch == 0)
+    return false;
+  seal(e, out);
+  return true;
+}
+
+void motion_rec_enc_index(const motion_rec_enc_t *e, uint8_t *out) {
+  memset(out, 0, MOTION_REC_BLOCK_SIZE);
+  memcpy(out, &e->index, sizeof(e->index));
+}
+
+bool motion_rec_read_header(const uint8_t *blk, motion_rec_header_t *h) {
+  memcpy(h, blk, sizeof(*h));
+  return memcmp(h->magic, MOTION_REC_MAGIC, 4) == 0 && h->version >= 1 &&
+         h->block_size == MOTION_REC_BLOCK_SIZE &&
+         h->header_size >= sizeof(*h) && h->sample_period_us > 0 &&
+         h->mg_per_lsb > 0.0f;
+}
+
+bool motion_rec_read_index(const uint8_t *blk, motion_rec_index_t *idx) {
+  memcpy(idx, blk, sizeof(*idx));
+  return memcmp(idx->magic, INDEX_MAGIC, 4) == 0 && idx->stride > 0 &&
+         idx->count <= MOTION_REC_INDEX_MAX;
+}
+
+bool motion_rec_decode(const uint8_t *blk, motion_rec_block_t *out) {
+  motion_rec_block_hdr_t *h = &out->hdr;
+  memcpy(h, blk, sizeof(*h));
+  if (memcmp(h->magic, BLOCK_MAGIC, 4) != 0 || h->used < HDR_BYTES ||
+      h->used > MOTION_REC_BLOCK_SIZE || h->batches > MOTION_REC_MAX_BATCHES ||
+      h->samples > MOTION_REC_MAX_SAMPLES || h->gyro_samples > h->samples)
+    return false;
+  // CRC with the crc field zeroed, without copying the block
+  motion_rec_block_hdr_t zeroed = *h;
+  zeroed.crc = 0;
+  uint32_t crc = crc32_update(0xFFFFFFFFu, (const uint8_t *)&zeroed, HDR_BYTES);
+  crc = crc32_update(crc, blk + HDR_BYTES, MOTION_REC_BLOCK_SIZE - HDR_BYTES);
+  if (~crc != h->crc)
+    return false;
+
+  size_t p = HDR_BYTES, end = h->used;
+  uint64_t t = h->t0_us;
+  uint32_t total = 0, total_gyro = 0;
+  for (int i = 0; i < h->batches; ++i) {
+    uint64_t dt, n, period, flags, label;
+    if (!varint_get(blk, end, &p, &dt) || !varint_get(blk, end, &p, &n) ||
+        !varint_get(blk, end, &p, &period) ||
+        !varint_get(blk, end, &p, &flags) || !varint_get(blk, end, &p, &label))
+      return false;
+    t += (uint64_t)unzigzag64(dt);
+    motion_rec_batch_t *b = &out->batch[i];
+    b->t0_us = t;
+    b->n = (uint16_t)n;
+    b->period_us = (uint32_t)period;
+    b->flags = (uint8_t)flags;
+    b->label = (uint8_t)label;
+    total += b->n;
+    if (b->flags & MOTION_TRACE_F_GYRO)
+      total_gyro += b->n;
+  }
+  if (total != h->samples || total_gyro != h->gyro_samples)
+    return false;
+
+  for (int c = 0; c < MOTION_REC_COLUMNS; ++c) {
+    int n = c < 3 ? h->samples : h->gyro_samples;
+    p = h->col_off[c];
+    size_t col_end = c + 1 < MOTION_REC_COLUMNS ? h->col_off[c + 1] : end;
+    if (p < HDR_BYTES || col_end > end || p > col_end)
+      return false;
+    int32_t x = h->first[c];
+    for (int f = 0; f < n; f += MOTION_REC_FRAME) {
+      int cnt = n - f < MOTION_REC_FRAME ? n - f : MOTION_REC_FRAME;
+      if (p >= col_end)
+        return false;
+      uint8_t w = blk[p++];
+      if (w > MAX_WIDTH || p + ((size_t)cnt * w + 7) / 8 > col_end)
+        return false;
+      uint64_t acc = 0;
+      int bits = 0;
+      for (int i = 0; i < cnt; ++i) {
+        while (bits < w) {
+          acc |= (uint64_t)blk[p++] << bits;
+          bits += 8;
+        }
+        uint32_t d = (uint32_t)(acc & ((1ull << w) - 1));
+        acc >>= w;
+        bits -= w;
+        x += unzigzag(d);
+        out->col[c][f + i] = (int16_t)x;
+      }
+    }
+  }
+  return true;
+}
@@ -0,0 +1,77 @@
+// Reader/writer for the *.imt IMU trace format (see motion_trace.h)
+
+#include "motion_trace.h"
+#include <stddef.h>
+#include <string.h>
+
+// Version 1 headers end before dps_per_lsb
+#define HEADER_V1_SIZE offsetof(motion_trace_header_t, dps_per_lsb)
+
+bool motion_trace_write_header(FILE *f, uint32_t sample_period_us,
+                               float mg_per_lsb, float dps_per_lsb,
+                               uint32_t gyro_period_us, int64_t start_epoch) {
+  motion_trace_header_t hdr = {
+      .version = MOTION_TRACE_VERSION,
+      .header_size = sizeof(motion_trace_header_t),
+      .sample_period_us = sample_period_us,
+      .mg_per_lsb = mg_per_lsb,
+      .start_epoch = start_epoch,
+      .dps_per_lsb = dps_per_lsb,
+      .gyro_period_us = gyro_period_us,
+  };
+  memcpy(hdr.magic, MOTION_TRACE_MAGIC, 4);
+  return fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+}
+
+bool motion_trace_write_batch(FILE *f, uint32_t t_ms, uint8_t flags,
+                              const int16_t *xyz, const int16_t *gyro,
+                              uint16_t count) {
+  if (count == 0)
+    return true;
+  if (count > MOTION_TRACE_MAX_BATCH)
+    return false;
+  flags = gyro ? (flags | MOTION_TRACE_F_GYRO) : (flags & ~MOTION_TRACE_F_GYRO);
+  motion_trace_batch_t b = {.t_ms = t_ms, .count = count, .flags = flags};
+  if (fwrite(&b, sizeof(b), 1, f) != 1 ||
+      fwrite(xyz, sizeof(int16_t) * 3, count, f) != count)
+    return false;
+  return !gyro || fwrite(gyro, sizeof(int16_t) * 3, count, f) == count;
+}
+
+bool motion_trace_read_header(FILE *f, motion_trace_header_t *hdr) {
+  memset(hdr, 0, sizeof(*hdr));
+  if (fread(hdr, HEADER_V1_SIZE, 1, f) != 1)
+    return false;
+  if (memcmp(hdr->magic, MOTION_TRACE_MAGIC, 4) != 0 || hdr->version < 1 ||
+      hdr->version > MOTION_TRACE_VERSION || hdr->header_size < HEADER_V1_SIZE)
+    return false;
+  size_t extra = hdr->header_size - HEADER_V1_SIZE;
+  if (hdr->version >= 2) {
+    if (extra < sizeof(*hdr) - HEADER_V1_SIZE ||
+        fread((char *)hdr + HEADER_V1_SIZE, sizeof(*hdr) - HEADER_V1_SIZE, 1,
+              f) != 1)
+      return false;
+    extra -= sizeof(*hdr) - HEADER_V1_SIZE;
+  }
+  // Skip fields added by newer minor revisions
+  if (extra > 0 && fseek(f, (long)extra, SEEK_CUR) != 0)
+    return false;
+  if (hdr->gyro_period_us == 0)
+    hdr->gyro_period_us = hdr->sample_period_us;
+  return hdr->sample_period_us > 0 && hdr->mg_per_lsb > 0.0f;
+}
+
+bool motion_trace_read_batch(FILE *f, motion_trace_batch_t *b, int16_t *xyz,
+                             int16_t *gyro) {
+  if (fread(b, sizeof(*b), 1, f) != 1)
+    return false;
+  if (b->count == 0 || b->count > MOTION_TRACE_MAX_BATCH)
+    return false;
+  if (fread(xyz, sizeof(int16_t) * 3, b->count, f) != b->count)
+    return false;
+  if (!(b->flags & MOTION_TRACE_F_GYRO))
+    return true;
+  if (gyro)
+    return fread(gyro, sizeof(int16_t) * 3, b->count, f) == b->count;
+  return fseek(f, (long)(sizeof(int16_t) * 3 * b->count), SEEK_CUR) == 0;
+}
@@ -0,0 +1,217 @@
+// Double-buffered *.imc recorder (see rec_writer.h)
+
+#include "rec_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "motion_rec.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "REC";
+
+// A chunk is a whole number of blocks; with the file starting on a cluster
+// and the chunk size dividing the cluster size, no write straddles two
+#define CHUNK_BLOCKS (CONFIG_SENSORS_REC_WRITE_KB * 1024 / MOTION_REC_BLOCK_SIZE)
+#define NCHUNKS 2
+
+typedef struct {
+  uint8_t idx;
+  uint8_t blocks;
+  bool last; // close the file after this one
+} chunk_msg_t;
+
+static SemaphoreHandle_t s_lock;
+static SemaphoreHandle_t s_done;
+static QueueHandle_t s_free; // chunk indices ready to fill
+static QueueHandle_t s_full; // chunk_msg_t for the writer task
+static uint8_t *s_chunk[NCHUNKS];
+static motion_rec_enc_t *s_enc;
+static FILE *s_file;
+static volatile bool s_active;
+static volatile bool s_failed;
+static int s_cur = -1; // chunk being filled
+static int s_fill;     // blocks in it
+static uint32_t s_dropped;
+static uint32_t s_written; // blocks
+
+static void *alloc_buf(size_t size) {
+  void *p = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  return p ? p : malloc(size);
+}
+
+static void writer_task(void *arg) {
+  (void)arg;
+  chunk_msg_t m;
+  for (;;) {
+    if (xQueueReceive(s_full, &m, portMAX_DELAY) != pdTRUE)
+      continue;
+    if (!s_failed && m.blocks &&
+        fwrite(s_chunk[m.idx], MOTION_REC_BLOCK_SIZE, m.blocks, s_file) !=
+            m.blocks) {
+      ESP_LOGE(TAG, "Write failed, dropping the rest of the recording");
+      s_failed = true;
+    }
+    if (!s_failed)
+      s_written += m.blocks;
+    if (m.last)
+      break;
+    (void)xQueueSend(s_free, &m.idx, 0);
+  }
+  if (fclose(s_file) != 0)
+    s_failed = true;
+  s_file = NULL;
+  xSemaphoreGive(s_done);
+  vTaskDelete(NULL);
+}
+
+// Chunk slot for the next sealed block, or NULL. `wait` only from
+// rec_writer_stop(); sensors_task never waits for the card.
+static uint8_t *next_slot(TickType_t wait) {
+  if (s_cur >= 0 && s_fill == CHUNK_BLOCKS) {
+    chunk_msg_t m = {.idx = (uint8_t)s_cur, .blocks = (uint8_t)s_fill};
+    (void)xQueueSend(s_full, &m, portMAX_DELAY);
+    s_cur = -1;
+  }
+  if (s_cur < 0) {
+    uint8_t idx;
+    if (xQueueReceive(s_free, &idx, wait) != pdTRUE)
+      return NULL;
+    s_cur = idx;
+    s_fill = 0;
+  }
+  return s_chunk[s_cur] + (size_t)s_fill * MOTION_REC_BLOCK_SIZE;
+}
+
+esp_err_t rec_writer_start(const char *path, uint32_t sample_period_us,
+                           uint32_t gyro_period_us, float mg_per_lsb,
+                           float dps_per_lsb, int64_t start_epoch) {
+  if (!s_lock) {
+    s_lock = xSemaphoreCreateMutex();
+    s_done = xSemaphoreCreateBinary();
+    s_free = xQueueCreate(NCHUNKS, sizeof(uint8_t));
+    s_full = xQueueCreate(NCHUNKS, sizeof(chunk_msg_t));
+    if (!s_lock || !s_done || !s_free || !s_full)
+      return ESP_ERR_NO_MEM;
+  }
+  if (s_active)
+    return ESP_ERR_INVALID_STATE;
+  // Buffers stay allocated once a recording has been made
+  if (!s_enc) {
+    s_enc = alloc_buf(sizeof(*s_enc));
+    for (int i = 0; i < NCHUNKS; ++i)
+      s_chunk[i] = alloc_buf((size_t)CHUNK_BLOCKS * MOTION_REC_BLOCK_SIZE);
+    if (!s_enc || !s_chunk[0] || !s_chunk[1]) {
+      ESP_LOGE(TAG, "No memory for the recording buffers");
+      free(s_enc);
+      s_enc = NULL;
+      for (int i = 0; i < NCHUNKS; ++i) {
+        free(s_chunk[i]);
+        s_chunk[i] = NULL;
+      }
+      return ESP_ERR_NO_MEM;
+    }
+  }
+  s_file = fopen(path, "wb");
+  if (!s_file)
+    return ESP_FAIL;
+  // Unbuffered: every fwrite() goes to FATFS as whole sectors
+  setvbuf(s_file, NULL, _IONBF, 0);
+
+  for (uint8_t i = 0; i < NCHUNKS; ++i)
+    (void)xQueueSend(s_free, &i, 0);
+  motion_rec_enc_init(s_enc);
+  s_cur = -1;
+  s_dropped = 0;
+  s_written = 0;
+  s_failed = false;
+  motion_rec_header(next_slot(0), sample_period_us, gyro_period_us,
+                    mg_per_lsb, dps_per_lsb, start_epoch);
+  s_fill = 1;
+  if (xTaskCreate(writer_task, "rec_writer", 3072, NULL, 2, NULL) != pdPASS) {
+    fclose(s_file);
+    s_file = NULL;
+    uint8_t idx;
+    while (xQueueReceive(s_free, &idx, 0) == pdTRUE) {
+    }
+    return ESP_ERR_NO_MEM;
+  }
+  s_active = true;
+  ESP_LOGI(TAG, "Recording to %s (%d KB chunks)", path,
+           CONFIG_SENSORS_REC_WRITE_KB);
+  return ESP_OK;
+}
+
+void rec_writer_add(uint64_t t0_us, uint32_t period_us, const int16_t *xyz,
+                    const int16_t *gyro, int n, uint8_t flags, uint8_t label) {
+  if (!s_active || s_failed || n <= 0)
+    return;
+  // Stopping holds the lock while it waits for the card
+  if (xSemaphoreTake(s_lock, 0) != pdTRUE) {
+    s_dropped += (uint32_t)n;
+    return;
+  }
+  if (s_active) {
+    int off = 0;
+    while (off < n) {
+      uint8_t *slot = next_slot(0);
+      if (!slot) {
+        s_dropped += (uint32_t)(n - off);
+        break;
+      }
+      motion_rec_batch_t b = {
+          .t0_us = t0_us + (uint64_t)off * period_us,
+          .period_us = period_us,
+          .n = (uint16_t)(n - off),
+          .flags = flags,
+          .label = label,
+      };
+      bool sealed = false;
+      off += motion_rec_enc_add(s_enc, &b, xyz + off * 3,
+                                gyro ? gyro + off * 3 : NULL, slot, &sealed);
+      if (sealed)
+        s_fill++;
+    }
+  }
+  xSemaphoreGive(s_lock);
+}
+
+esp_err_t rec_writer_stop(void) {
+  if (!s_lock)
+    return ESP_ERR_INVALID_STATE;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  if (!s_active) {
+    xSemaphoreGive(s_lock);
+    return ESP_ERR_INVALID_STATE;
+  }
+  s_active = false;
+  uint8_t *slot = next_slot(portMAX_DELAY);
+  if (motion_rec_enc_flush(s_enc, slot)) {
+    s_fill++;
+    slot = next_slot(portMAX_DELAY);
+  }
+  motion_rec_enc_index(s_enc, slot);
+  s_fill++;
+  chunk_msg_t m = {.idx = (uint8_t)s_cur, .blocks = (uint8_t)s_fill,
+                   .last = true};
+  (void)xQueueSend(s_full, &m, portMAX_DELAY);
+  s_cur = -1;
+  xSemaphoreTake(s_done, portMAX_DELAY);
+  // The writer returned every other chunk before the last one
+  uint8_t idx;
+  while (xQueueReceive(s_free, &idx, 0) == pdTRUE) {
+  }
+  ESP_LOGI(TAG, "Recording closed: %lu blocks, %lu samples, %lu dropped%s",
+           (unsigned long)s_written, (unsigned long)s_enc->samples,
+           (unsigned long)s_dropped, s_failed ? ", write failed" : "");
+  esp_err_t err = s_failed ? ESP_FAIL : ESP_OK;
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+bool rec_writer_active(void) { return s_active; }
@@ -0,0 +1,101 @@
+// Sensor event fan-out (see sensors.h, sensor_hub.h)
+
+#include "sensor_hub.h"
+#include "freertos/FreeRTOS.h"
+
+#define COALESCED (SENSORS_EVENT_STEPS | SENSORS_EVENT_ACTIVITY)
+
+typedef struct {
+  sensors_event_cb_t cb;
+  void *arg;
+  uint32_t mask;
+  uint32_t min_ms;
+  // Coalescing state, only touched by sensors_task
+  uint32_t sent;         // coalesced types delivered at least once
+  uint32_t pending;      // coalesced types held back
+  uint32_t steps_ms;     // last STEPS delivery
+  uint32_t activity_ms;  // last ACTIVITY delivery
+  uint32_t steps_delta;  // held back increments
+} sub_t;
+
+static sub_t s_subs[SENSORS_MAX_SUBSCRIBERS];
+static int s_nsubs;
+static portMUX_TYPE s_sub_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_steps_total;
+static sensors_activity_t s_activity = SENSORS_ACTIVITY_IDLE;
+
+esp_err_t sensors_subscribe(uint32_t mask, uint32_t min_interval_ms,
+                            sensors_event_cb_t cb, void *arg) {
+  if (!cb || !mask)
+    return ESP_ERR_INVALID_ARG;
+  esp_err_t err = ESP_ERR_NO_MEM;
+  portENTER_CRITICAL(&s_sub_mux);
+  if (s_nsubs < SENSORS_MAX_SUBSCRIBERS) {
+    s_subs[s_nsubs] = (sub_t){.cb = cb, .arg = arg, .mask = mask,
+                              .min_ms = min_interval_ms};
+    s_nsubs++;
+    err = ESP_OK;
+  }
+  portEXIT_CRITICAL(&s_sub_mux);
+  return err;
+}
+
+static void deliver(sub_t *s, sensors_event_type_t type, uint32_t now_ms) {
+  sensors_event_t evt = {.type = type, .time_ms = now_ms};
+  if (type == SENSORS_EVENT_STEPS) {
+    evt.steps.total = s_steps_total;
+    evt.steps.delta = s->steps_delta;
+    s->steps_delta = 0;
+    s->steps_ms = now_ms;
+  } else {
+    evt.activity = s_activity;
+    s->activity_ms = now_ms;
+  }
+  s->sent |= type;
+  s->pending &= ~(uint32_t)type;
+  s->cb(&evt, s->arg);
+}
+
+static bool due(const sub_t *s, sensors_event_type_t type, uint32_t now_ms) {
+  if (!(s->sent & type))
+    return true;
+  uint32_t last = type == SENSORS_EVENT_STEPS ? s->steps_ms : s->activity_ms;
+  return now_ms - last >= s->min_ms;
+}
+
+void sensor_hub_publish(const sensors_event_t *evt) {
+  if (evt->type == SENSORS_EVENT_STEPS)
+    s_steps_total = evt->steps.total;
+  else if (evt->type == SENSORS_EVENT_ACTIVITY)
+    s_activity = evt->activity;
+
+  int n = s_nsubs;
+  for (int i = 0; i < n; ++i) {
+    sub_t *s = &s_subs[i];
+    if (!(s->mask & evt->type))
+      continue;
+    if (!(evt->type & COALESCED)) {
+      s->cb(evt, s->arg);
+      continue;
+    }
+    if (evt->type == SENSORS_EVENT_STEPS)
+      s->steps_delta += evt->steps.delta;
+    if (due(s, evt->type, evt->time_ms))
+      deliver(s, evt->type, evt->time_ms);
+    else
+      s->pending |= evt->type;
+  }
+}
+
+void sensor_hub_flush(uint32_t now_ms) {
+  int n = s_nsubs;
+  for (int i = 0; i < n; ++i) {
+    sub_t *s = &s_subs[i];
+    if ((s->pending & SENSORS_EVENT_STEPS) &&
+        due(s, SENSORS_EVENT_STEPS, now_ms))
+      deliver(s, SENSORS_EVENT_STEPS, now_ms);
+    if ((s->pending & SENSORS_EVENT_ACTIVITY) &&
+        due(s, SENSORS_EVENT_ACTIVITY, now_ms))
+      deliver(s, SENSORS_EVENT_ACTIVITY, now_ms);
+  }
+}
@@ -1,27 +1,145 @@
-// QMI8658-based step counting and activity classification with raise-to-wake
+// QMI8658 sampling for step counting, activity classification and
+// raise-to-wake (algorithms live in motion_algo.c and motion_gesture.c).
+// Samples are batched in the IMU FIFO and processed per watermark interrupt;
+// steps can come from the on-chip pedometer (CONFIG_SENSORS_STEP_ENGINE_HW).
+// The gyro is only powered for a short window after motion while the screen
+// is off (CONFIG_SENSORS_RAISE_GYRO). Sleep mode (sleep_track.c) drops to a
+// low accelerometer rate and only wakes on motion or once per epoch. A tap
+// or double tap seen by the on-chip tap engine wakes the screen
+// (CONFIG_SENSORS_TAP_WAKE). In standby the SoC sleeps and only the
+// pedometer, any-motion and tap engines run on the IMU.
+// Results go out to subscribers through sensor_hub.c.
 
 #include "sensors.h"
+#include "motion_algo.h"
+#include "motion_rate.h"
+#include "motion_trace.h"
+#include "rec_writer.h"
+#include "sensor_hub.h"
+#include "sleep_track.h"
+#include "step_store.h"
+#include "day_clock.h"
+#include "i2c_bus.h"
 #include "bsp/esp32_s3_touch_amoled_2_06.h"
+#include "bsp_board_extra.h"
 #include "display_manager.h"
 #include "driver/gpio.h"
+#include "driver/i2c_master.h"
+#include "esp_cpu.h"
 #include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_sleep.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 #include "freertos/task.h"
 #include "qmi8658.h"
 #include <math.h>
+#include <stdio.h>
 #include <time.h>
 
+#ifndef CONFIG_SENSORS_SLEEP_START_HOUR
+#define CONFIG_SENSORS_SLEEP_START_HOUR 22
+#endif
+#ifndef CONFIG_SENSORS_SLEEP_END_HOUR
+#define CONFIG_SENSORS_SLEEP_END_HOUR 8
+#endif
+
 #define IMU_IRQ_GPIO GPIO_NUM_21
 #define IMU_ADDR_HIGH QMI8658_ADDRESS_HIGH
 #define IMU_ADDR_LOW QMI8658_ADDRESS_LOW
 
-// Raise-to-wake sensitivity (tune to taste)
-#define RAISE_DP_THRESH_DEG 55.0f  // min pitch delta to consider a raise
-#define RAISE_ACCEL_MIN_MG 850.0f  // acceptable accel magnitude lower bound
-#define RAISE_ACCEL_MAX_MG 1150.0f // acceptable accel magnitude upper bound
-#define RAISE_COOLDOWN_MS 3500     // min ms between wakeups
+// Hardware FIFO batching: accel samples are queued in the QMI8658 FIFO and
+// pulled in one burst when the watermark interrupt fires, instead of waking
+// for every sample.
+#define IMU_ODR_PERIOD_US 16000   // 62.5 Hz, see imu_try_init_with_addr()
+#define IMU_FIFO_WATERMARK 32     // samples per batch (~0.5 s)
+#define IMU_FIFO_MAX_SAMPLES 64   // FIFO depth configured on the chip
+#define IMU_FIFO_READ_CHUNK 192   // bytes per I2C burst (32 samples)
+#define IMU_ACCEL_MG_PER_LSB (1000.0f / 8192.0f) // +-4 g
+#define IMU_GYRO_DPS_PER_LSB (1.0f / 64.0f)      // +-512 dps
+#define IMU_POLL_PERIOD_MS 20     // fallback when the FIFO is unavailable
+#define IMU_POLL_PERIOD_US (IMU_POLL_PERIOD_MS * 1000u)
+
+// Wake gesture: in 6-DoF mode the accelerometer follows the gyro clock
+// (~56 Hz), each FIFO sample holds accel then gyro, and a small watermark
+// hands samples over every ~70 ms instead of every ~0.5 s
+#define IMU_GYRO_PERIOD_US 17841
+#define IMU_FIFO_WATERMARK_GESTURE 4
+#define IMU_GYRO_SETTLE_MS 80     // gyro turn-on time, samples are skipped
+
+// Sleep mode: accelerometer at half rate, no gyro, no raise-to-wake. With
+// the on-chip engine the task sleeps until an any-motion event or the end of
+// the epoch; the first event of an epoch streams one batch to measure it.
+#define IMU_SLEEP_PERIOD_US 32000 // 31.25 Hz
+#define SLEEP_DEBOUNCE_MS 1000    // later events in a burst count once
+#define SLEEP_AUTO_IDLE_MS (20 * 60 * 1000) // still this long: asleep
+
+// QMI8658 registers used for FIFO access (datasheet names)
+#define IMU_REG_CTRL1 0x02
+#define IMU_REG_CTRL2 0x03
+#define IMU_REG_CTRL3 0x04
+#define IMU_REG_CTRL7 0x08
+#define IMU_REG_CTRL9 0x0A
+#define IMU_REG_FIFO_WTM_TH 0x13
+#define IMU_REG_FIFO_CTRL 0x14
+#define IMU_REG_FIFO_SMPL_CNT 0x15
+#define IMU_REG_FIFO_DATA 0x17
+#define IMU_REG_STATUSINT 0x2D
+#define IMU_CTRL1_FIFO_INT_SEL (1u << 2) // FIFO interrupt on INT1
+#define IMU_CTRL1_INT1_EN (1u << 3)
+#define IMU_CTRL2_4G_125HZ ((0x01 << 4) | 0x06) // aFS, aODR
+#define IMU_CTRL2_4G_62HZ ((0x01 << 4) | 0x07)
+#define IMU_CTRL2_4G_31HZ ((0x01 << 4) | 0x08)
+#define IMU_CTRL3_GYRO_512DPS_56HZ ((0x05 << 4) | 0x07) // gFS, gODR
+#define IMU_CTRL7_GYRO_EN (1u << 1)
+#define IMU_FIFO_MODE_STREAM 0x02
+#define IMU_FIFO_SIZE_64 (0x02 << 2)
+#define IMU_FIFO_RD_MODE (1u << 7)
+#define IMU_CTRL9_CMD_ACK 0x00
+#define IMU_CTRL9_CMD_RST_FIFO 0x04
+#define IMU_CTRL9_CMD_REQ_FIFO 0x05
+#define IMU_STATUSINT_CMD_DONE (1u << 7)
+
+// On-chip pedometer and any-motion engine
+#define IMU_REG_CTRL8 0x09
+#define IMU_REG_CAL1_L 0x0B // CAL1_L..CAL4_H are consecutive
+#define IMU_REG_STATUS1 0x2F
+#define IMU_REG_STEP_CNT_L 0x5A // 24-bit, L/M/H
+#define IMU_CTRL8_ANY_MOTION_EN (1u << 1)
+#define IMU_CTRL8_PEDO_EN (1u << 4)
+#define IMU_CTRL8_ACTIVITY_INT1 (1u << 6) // engine events on INT1
+#define IMU_PED_SIG_COUNT 4            // steps per pedometer update
+#define IMU_PED_SIG_COUNT_STANDBY 200  // the same in standby: a wake threshold
+#define IMU_CTRL9_CMD_CONFIGURE_PEDOMETER 0x0D
+#define IMU_CTRL9_CMD_CONFIGURE_MOTION 0x0E
+#define IMU_CTRL9_CMD_RESET_PEDOMETER 0x0F
+#define IMU_STATUS1_PEDOMETER (1u << 4)
+#define IMU_STATUS1_ANY_MOTION (1u << 5)
+#define IMU_FIFO_MODE_BYPASS 0x00
+#define IMU_ANY_MOTION_THR 0x03   // U3.5 g, ~94 mg
+#define IMU_ANY_MOTION_WINDOW 3   // samples above threshold
+#define IMU_STEP_POLL_MS 30000    // idle refresh of the step counter
+
+// On-chip tap engine. Windows are in samples on the chip and scaled from
+// these times to the current rate.
+#define IMU_REG_TAP_STATUS 0x59
+#define IMU_CTRL8_TAP_EN (1u << 0)
+#define IMU_CTRL9_CMD_CONFIGURE_TAP 0x0C
+#define IMU_STATUS1_TAP (1u << 1)
+#define IMU_TAP_STATUS_NUM_MASK 0x03 // 1 single, 2 double
+#define IMU_TAP_PEAK_WINDOW_MS 64    // the spike of one tap
+#define IMU_TAP_QUIET_MS 160         // no second peak: one tap ends
+#define IMU_TAP_DOUBLE_MS 480        // second tap must start within
+#define IMU_TAP_ALPHA 8              // 1/128: 0.0625, peak filter
+#define IMU_TAP_GAMMA 32             // 1/128: 0.25, settle filter
+#define IMU_TAP_PEAK_THR 1638        // U5.11 g^2: 0.8
+#define IMU_TAP_QUIET_THR 819        // U5.11 g^2: 0.4
+#if CONFIG_SENSORS_TAP_DOUBLE
+#define IMU_TAP_WAKE_COUNT 2 // single taps come from knocks and bumps too
+#else
+#define IMU_TAP_WAKE_COUNT 1
+#endif
 
 static const char *TAG = "SENSORS";
 
@@ -29,35 +147,59 @@ static qmi8658_dev_t s_imu;
 static bool s_imu_ready = false;
 static volatile uint32_t s_step_count = 0; // daily steps
 static sensors_activity_t s_activity = SENSORS_ACTIVITY_IDLE;
-static SemaphoreHandle_t s_wom_sem = NULL; // wake-on-motion semaphore
-static time_t s_last_midnight = 0;
+static SemaphoreHandle_t s_irq_sem = NULL; // FIFO watermark interrupt
+static bool s_irq_ready = false;           // INT1 handler installed
+static bool s_fifo_ready = false;
+static bool s_fifo_streaming = false;
+static bool s_hw_pedometer = false;   // steps come from the on-chip engine
+static uint8_t s_ped_sig_count = IMU_PED_SIG_COUNT;
+static bool s_tap_ready = false;      // tap engine raises INT1
+static uint32_t s_hw_steps_seen = 0;  // last chip counter value
+static volatile bool s_trace_force_stream = false;
+static bool s_gyro_on = false; // FIFO carries gyro samples
+static uint32_t s_gyro_on_ms = 0;
+static uint32_t s_period_us = IMU_ODR_PERIOD_US; // current sample spacing
+static uint32_t s_accel_period_us = IMU_ODR_PERIOD_US; // without the gyro
+static volatile bool s_sleep_want = false; // requested sleep mode
+static bool s_sleep_on = false;            // applied by sensors_task
+static bool s_sleep_auto = false;          // entered by the schedule
+static time_t s_sleep_sampled = 0; // epoch end of the last sleep batch
+static i2c_bus_dev_t s_imu_bus = -1; // the IMU on the shared bus manager
+// Standby handshake with sensors_task (sensors_standby_enter())
+static volatile bool s_standby_want = false;
+static volatile bool s_new_day = false; // set by on_new_day() for the loop
+static SemaphoreHandle_t s_standby_parked = NULL;
+static SemaphoreHandle_t s_standby_release = NULL;
+static uint32_t s_standby_hw_steps = 0;
+static struct {
+  bool on;
+  uint32_t steps;
+  uint32_t hw_steps;
+  time_t entered;
+} s_resume;
+static bool s_resume_tap = false; // the IMU woke the SoC with a tap
 
-static time_t get_midnight_epoch(time_t now) {
-  struct tm tm_now;
-  localtime_r(&now, &tm_now);
-  tm_now.tm_hour = 0;
-  tm_now.tm_min = 0;
-  tm_now.tm_sec = 0;
-  return mktime(&tm_now);
+// Register access through the bus manager, at high priority since batches
+// are time-bound; the driver's own handle while probing
+static esp_err_t imu_read(uint8_t reg, uint8_t *data, uint8_t len) {
+  if (s_imu_bus >= 0)
+    return i2c_bus_read(s_imu_bus, reg, data, len, I2C_BUS_PRIO_HIGH);
+  return qmi8658_read_register(&s_imu, reg, data, len);
 }
 
-static void maybe_reset_daily_counter(void) {
-  time_t now = time(NULL);
-  if (s_last_midnight == 0) {
-    s_last_midnight = get_midnight_epoch(now);
-  }
-  time_t midnight_now = get_midnight_epoch(now);
-  if (midnight_now > s_last_midnight) {
-    s_last_midnight = midnight_now;
-    s_step_count = 0;
-    ESP_LOGI(TAG, "Daily step counter reset at midnight");
-  }
+static esp_err_t imu_write(uint8_t reg, uint8_t value) {
+  if (s_imu_bus >= 0)
+    return i2c_bus_write(s_imu_bus, reg, &value, 1, I2C_BUS_PRIO_HIGH);
+  return qmi8658_write_register(&s_imu, reg, value);
 }
 
 static void IRAM_ATTR imu_irq_isr(void *arg) {
   BaseType_t hp = pdFALSE;
-  if (s_wom_sem) {
-    xSemaphoreGiveFromISR(s_wom_sem, &hp);
+  // The light-sleep wake makes INT1 level-triggered; stay masked until the
+  // task waits again, after it has read the events
+  gpio_intr_disable(IMU_IRQ_GPIO);
+  if (s_irq_sem) {
+    xSemaphoreGiveFromISR(s_irq_sem, &hp);
   }
   if (hp)
     portYIELD_FROM_ISR();
@@ -83,9 +225,21 @@ static esp_err_t imu_setup_irq(void) {
   (void)gpio_set_intr_type(IMU_IRQ_GPIO, GPIO_INTR_NEGEDGE);
   ESP_ERROR_CHECK(gpio_isr_handler_add(IMU_IRQ_GPIO, imu_irq_isr, NULL));
   gpio_intr_enable(IMU_IRQ_GPIO);
+  // Edge interrupts are not seen in light sleep; let the line wake the SoC
+  // so batches are picked up while the CPU sleeps between them
+  (void)gpio_wakeup_enable(IMU_IRQ_GPIO, GPIO_INTR_LOW_LEVEL);
+  (void)esp_sleep_enable_gpio_wakeup();
+  s_irq_ready = true;
   return ESP_OK;
 }
 
+// Unmask INT1 and wait for it; a source still pending fires at once
+static void imu_irq_wait(TickType_t ticks) {
+  if (s_irq_ready)
+    gpio_intr_enable(IMU_IRQ_GPIO);
+  (void)xSemaphoreTake(s_irq_sem, ticks);
+}
+
 static bool imu_try_init_with_addr(uint8_t addr) {
   i2c_master_bus_handle_t bus = bsp_i2c_get_handle();
   if (!bus)
@@ -98,15 +252,426 @@ static bool imu_try_init_with_addr(uint8_t addr) {
   (void)qmi8658_set_accel_odr(&s_imu, QMI8658_ACCEL_ODR_62_5HZ);
   (void)qmi8658_enable_accel(&s_imu, true);
   qmi8658_set_accel_unit_mg(&s_imu, true); // mg units simplify magnitude
+  if (i2c_bus_init(bus) != ESP_OK ||
+      i2c_bus_add_device(addr, CONFIG_I2C_MASTER_FREQUENCY, &s_imu_bus) !=
+          ESP_OK)
+    ESP_LOGW(TAG, "I2C bus manager unavailable, using the driver directly");
   return true;
 }
 
+// CTRL9 command handshake: issue, wait for CmdDone, acknowledge
+static esp_err_t imu_ctrl9_cmd(uint8_t cmd) {
+  esp_err_t err = imu_write(IMU_REG_CTRL9, cmd);
+  if (err != ESP_OK)
+    return err;
+  uint8_t st = 0;
+  for (int i = 0; i < 50; ++i) {
+    err = imu_read(IMU_REG_STATUSINT, &st, 1);
+    if (err == ESP_OK && (st & IMU_STATUSINT_CMD_DONE))
+      break;
+    esp_rom_delay_us(200);
+  }
+  if (!(st & IMU_STATUSINT_CMD_DONE))
+    return ESP_ERR_TIMEOUT;
+  return imu_write(IMU_REG_CTRL9, IMU_CTRL9_CMD_ACK);
+}
+
+static esp_err_t imu_fifo_enable(void) {
+  uint8_t ctrl1 = 0;
+  esp_err_t err = imu_read(IMU_REG_CTRL1, &ctrl1, 1);
+  if (err == ESP_OK)
+    err = imu_write(IMU_REG_CTRL1,
+                    ctrl1 | IMU_CTRL1_FIFO_INT_SEL | IMU_CTRL1_INT1_EN);
+  if (err == ESP_OK)
+    err = imu_write(IMU_REG_FIFO_WTM_TH, IMU_FIFO_WATERMARK);
+  // Stream mode: if we are late the oldest samples are dropped, never stalls
+  if (err == ESP_OK)
+    err = imu_write(IMU_REG_FIFO_CTRL, IMU_FIFO_MODE_STREAM | IMU_FIFO_SIZE_64);
+  if (err == ESP_OK)
+    err = imu_ctrl9_cmd(IMU_CTRL9_CMD_RST_FIFO);
+  return err;
+}
+
+// Stop/start streaming samples to the CPU. In bypass mode the accelerometer
+// keeps running for the on-chip engines but nothing is queued.
+static void imu_fifo_set_streaming(bool on) {
+  if (on == s_fifo_streaming)
+    return;
+  uint8_t mode = on ? IMU_FIFO_MODE_STREAM : IMU_FIFO_MODE_BYPASS;
+  if (imu_write(IMU_REG_FIFO_CTRL, mode | IMU_FIFO_SIZE_64) == ESP_OK) {
+    if (on)
+      (void)imu_ctrl9_cmd(IMU_CTRL9_CMD_RST_FIFO); // drop stale samples
+    s_fifo_streaming = on;
+  }
+}
+
+#if CONFIG_SENSORS_RAISE_GYRO
+// Power the gyro for the wake gesture, or back down to accel only. The FIFO
+// is reset because its sample layout changes.
+static void imu_gyro_set(bool on, uint32_t now_ms) {
+  if (on == s_gyro_on)
+    return;
+  uint8_t ctrl7 = 0;
+  if (imu_read(IMU_REG_CTRL7, &ctrl7, 1) != ESP_OK)
+    return;
+  ctrl7 = on ? (ctrl7 | IMU_CTRL7_GYRO_EN) : (ctrl7 & ~IMU_CTRL7_GYRO_EN);
+  esp_err_t err = ESP_OK;
+  if (on)
+    err = imu_write(IMU_REG_CTRL3, IMU_CTRL3_GYRO_512DPS_56HZ);
+  if (err == ESP_OK)
+    err = imu_write(IMU_REG_CTRL7, ctrl7);
+  if (err != ESP_OK)
+    return;
+  (void)imu_write(IMU_REG_FIFO_WTM_TH,
+                  on ? IMU_FIFO_WATERMARK_GESTURE : IMU_FIFO_WATERMARK);
+  (void)imu_ctrl9_cmd(IMU_CTRL9_CMD_RST_FIFO);
+  s_gyro_on = on;
+  s_gyro_on_ms = now_ms;
+  s_period_us = on ? IMU_GYRO_PERIOD_US : s_accel_period_us;
+  ESP_LOGD(TAG, "Gyro %s", on ? "on" : "off");
+}
+#endif
+
+// Write CAL1_L..CAL4_H and run a CTRL9 configuration command
+static esp_err_t imu_ctrl9_configure(uint8_t cmd, const uint8_t cal[8]) {
+  for (int i = 0; i < 8; ++i) {
+    esp_err_t err = imu_write(IMU_REG_CAL1_L + i, cal[i]);
+    if (err != ESP_OK)
+      return err;
+  }
+  return imu_ctrl9_cmd(cmd);
+}
+
+#if CONFIG_SENSORS_TAP_WAKE
+static uint8_t tap_samples(uint32_t ms, uint32_t period_us) {
+  uint32_t n = (ms * 1000u + period_us / 2) / period_us;
+  return (uint8_t)(n < 2 ? 2 : n > 255 ? 255 : n);
+}
+
+// Tap thresholds are in g^2 and do not depend on the rate
+static esp_err_t imu_tap_configure(uint32_t period_us) {
+  uint8_t peak = tap_samples(IMU_TAP_PEAK_WINDOW_MS, period_us);
+  uint8_t quiet = tap_samples(IMU_TAP_QUIET_MS, period_us);
+  uint8_t dtap = tap_samples(IMU_TAP_DOUBLE_MS, period_us);
+  // Page 1: peak window, axis priority X>Y>Z, tap and double-tap windows,
+  // alpha
+  const uint8_t tap1[8] = {peak, 0x00, quiet, 0x00, dtap, 0x00,
+                           IMU_TAP_ALPHA, 0x01};
+  // Page 2: gamma, peak threshold, quiet threshold
+  const uint8_t tap2[8] = {IMU_TAP_GAMMA,
+                           0x00,
+                           IMU_TAP_PEAK_THR & 0xFF,
+                           IMU_TAP_PEAK_THR >> 8,
+                           IMU_TAP_QUIET_THR & 0xFF,
+                           IMU_TAP_QUIET_THR >> 8,
+                           0x00,
+                           0x02};
+  esp_err_t err = imu_ctrl9_configure(IMU_CTRL9_CMD_CONFIGURE_TAP, tap1);
+  if (err == ESP_OK)
+    err = imu_ctrl9_configure(IMU_CTRL9_CMD_CONFIGURE_TAP, tap2);
+  return err;
+}
+
+// Tap events on INT1, next to whatever engines are already running
+static esp_err_t imu_tap_enable(void) {
+  uint8_t ctrl8 = 0;
+  esp_err_t err = imu_tap_configure(s_accel_period_us);
+  if (err == ESP_OK)
+    err = imu_read(IMU_REG_CTRL8, &ctrl8, 1);
+  if (err == ESP_OK)
+    err = imu_write(IMU_REG_CTRL8,
+                    ctrl8 | IMU_CTRL8_TAP_EN | IMU_CTRL8_ACTIVITY_INT1);
+  return err;
+}
+#endif
+
+#if CONFIG_SENSORS_STEP_ENGINE_HW
+
+// Pedometer timing is counted in samples. Parameters follow the QST
+// reference values for ~62.5 Hz ODR, scaled to the sample period.
+// s_ped_sig_count is the number of steps per count update, and so per
+// pedometer event on INT1.
+static esp_err_t imu_pedometer_configure(uint32_t period_us) {
+  uint32_t count = 125u * IMU_ODR_PERIOD_US / period_us;
+  uint32_t up = 200u * IMU_ODR_PERIOD_US / period_us;
+  uint32_t low = 20u * IMU_ODR_PERIOD_US / period_us;
+  // Page 1: sample count 125, peak-to-peak 0xCC, peak 0x66
+  const uint8_t ped1[8] = {(uint8_t)count, (uint8_t)(count >> 8), 0xCC, 0x00,
+                           0x66, 0x00, 0x00, 0x01};
+  // Page 2: time-up 200, time-low 20, entry count 10, signal count
+  const uint8_t ped2[8] = {(uint8_t)up, (uint8_t)(up >> 8), (uint8_t)low,
+                           0x0A, 0x00, s_ped_sig_count, 0x00, 0x02};
+  esp_err_t err = imu_ctrl9_configure(IMU_CTRL9_CMD_CONFIGURE_PEDOMETER, ped1);
+  if (err == ESP_OK)
+    err = imu_ctrl9_configure(IMU_CTRL9_CMD_CONFIGURE_PEDOMETER, ped2);
+  return err;
+}
+
+// Parked for standby, INT1 (a wake line) carries taps and one pedometer
+// event per IMU_PED_SIG_COUNT_STANDBY steps: the engines share the line, so
+// the step events are thinned out instead; any-motion is off. `ctrl8` is
+// the engine set to run outside standby.
+static void imu_standby_engines(bool park, uint8_t ctrl8) {
+  if (imu_write(IMU_REG_CTRL8, 0) != ESP_OK)
+    return;
+  s_ped_sig_count = park ? IMU_PED_SIG_COUNT_STANDBY : IMU_PED_SIG_COUNT;
+  if (s_hw_pedometer && imu_pedometer_configure(s_accel_period_us) != ESP_OK)
+    ESP_LOGW(TAG, "Pedometer reconfiguration failed");
+  (void)imu_write(IMU_REG_CTRL8, park ? ctrl8 & ~IMU_CTRL8_ANY_MOTION_EN : ctrl8);
+}
+
+// Pedometer plus any-motion detection on the IMU
+static esp_err_t imu_engine_enable(void) {
+  // Any-motion on X/Y/Z (OR), no-motion/significant-motion unused
+  const uint8_t mot1[8] = {IMU_ANY_MOTION_THR, IMU_ANY_MOTION_THR,
+                           IMU_ANY_MOTION_THR, 0x00, 0x00, 0x00, 0x07, 0x01};
+  const uint8_t mot2[8] = {IMU_ANY_MOTION_WINDOW, 0, 0, 0, 0, 0, 0, 0x02};
+  esp_err_t err = imu_pedometer_configure(IMU_ODR_PERIOD_US);
+  if (err == ESP_OK)
+    err = imu_ctrl9_configure(IMU_CTRL9_CMD_CONFIGURE_MOTION, mot1);
+  if (err == ESP_OK)
+    err = imu_ctrl9_configure(IMU_CTRL9_CMD_CONFIGURE_MOTION, mot2);
+  if (err == ESP_OK)
+    err = imu_ctrl9_cmd(IMU_CTRL9_CMD_RESET_PEDOMETER);
+  if (err == ESP_OK)
+    err = imu_write(IMU_REG_CTRL8, IMU_CTRL8_PEDO_EN | IMU_CTRL8_ANY_MOTION_EN |
+                                       IMU_CTRL8_ACTIVITY_INT1);
+  return err;
+}
+#endif
+
+// Change the accelerometer rate (sleep mode, rate governor). The engines are
+// paused while the pedometer is reconfigured; its count is kept. Not while
+// the gyro is on: the accelerometer then follows the gyro clock.
+static void imu_rate_set(uint32_t period_us) {
+  if (period_us == s_accel_period_us)
+    return;
+  uint8_t ctrl2 = period_us >= IMU_SLEEP_PERIOD_US ? IMU_CTRL2_4G_31HZ
+                  : period_us < IMU_ODR_PERIOD_US  ? IMU_CTRL2_4G_125HZ
+                                                   : IMU_CTRL2_4G_62HZ;
+  if (imu_write(IMU_REG_CTRL2, ctrl2) != ESP_OK) {
+    ESP_LOGW(TAG, "Cannot change accelerometer rate");
+    return;
+  }
+  uint8_t ctrl8 = 0;
+  if ((s_hw_pedometer || s_tap_ready) &&
+      imu_read(IMU_REG_CTRL8, &ctrl8, 1) == ESP_OK &&
+      imu_write(IMU_REG_CTRL8, 0) == ESP_OK) {
+#if CONFIG_SENSORS_STEP_ENGINE_HW
+    if (s_hw_pedometer && imu_pedometer_configure(period_us) != ESP_OK)
+      ESP_LOGW(TAG, "Pedometer reconfiguration failed");
+#endif
+#if CONFIG_SENSORS_TAP_WAKE
+    if (s_tap_ready && imu_tap_configure(period_us) != ESP_OK)
+      ESP_LOGW(TAG, "Tap engine reconfiguration failed");
+#endif
+    (void)imu_write(IMU_REG_CTRL8, ctrl8);
+  }
+  s_accel_period_us = period_us;
+  s_period_us = period_us;
+  if (s_fifo_streaming)
+    (void)imu_ctrl9_cmd(IMU_CTRL9_CMD_RST_FIFO); // samples at the old rate
+  ESP_LOGD(TAG, "Accelerometer at %lu us", (unsigned long)period_us);
+}
+
+static esp_err_t imu_read_hw_steps(uint32_t *steps) {
+  uint8_t b[3];
+  esp_err_t err = imu_read(IMU_REG_STEP_CNT_L, b, 3);
+  if (err == ESP_OK)
+    *steps = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16);
+  return err;
+}
+
+// Drain the FIFO into `xyz` and, while the gyro is on, `gyro` (raw,
+// interleaved). Returns the number of samples read.
+static int imu_fifo_read(int16_t *xyz, int16_t *gyro, int max) {
+  uint8_t cnt[2];
+  if (imu_read(IMU_REG_FIFO_SMPL_CNT, cnt, 2) != ESP_OK)
+    return 0;
+  // Count is in 2-byte words: FIFO_STATUS[1:0] are the MSBs
+  size_t bytes = 2u * (((size_t)(cnt[1] & 0x03) << 8) | cnt[0]);
+  // Accel X/Y/Z int16, then gyro X/Y/Z while it is on
+  const size_t stride = s_gyro_on ? 12 : 6;
+  int n = (int)(bytes / stride);
+  if (n > max)
+    n = max;
+  if (n <= 0)
+    return 0;
+  if (imu_ctrl9_cmd(IMU_CTRL9_CMD_REQ_FIFO) != ESP_OK)
+    return 0;
+
+  static uint8_t raw[IMU_FIFO_MAX_SAMPLES * 12];
+  size_t want = (size_t)n * stride, got = 0;
+  while (got < want) {
+    size_t len = want - got;
+    if (len > IMU_FIFO_READ_CHUNK)
+      len = IMU_FIFO_READ_CHUNK;
+    if (imu_read(IMU_REG_FIFO_DATA, raw + got, len) !=
+        ESP_OK)
+      break;
+    got += len;
+  }
+  // Leave FIFO read mode
+  (void)imu_write(IMU_REG_FIFO_CTRL, IMU_FIFO_MODE_STREAM | IMU_FIFO_SIZE_64);
+  n = (int)(got / stride);
+  for (int i = 0; i < n; ++i) {
+    const uint8_t *p = raw + (size_t)i * stride;
+    for (int k = 0; k < 3; ++k) {
+      xyz[i * 3 + k] = (int16_t)(p[k * 2] | (p[k * 2 + 1] << 8));
+      if (stride == 12)
+        gyro[i * 3 + k] = (int16_t)(p[6 + k * 2] | (p[6 + k * 2 + 1] << 8));
+    }
+  }
+  return n;
+}
+
+// Local midnight (day_clock): daily counters start over. The callback runs
+// in the alarm scheduler task and only wakes sensors_task, which owns the
+// counters and the IMU.
+static void on_new_day(time_t day_start, void *arg) {
+  (void)day_start;
+  (void)arg;
+  s_new_day = true;
+  if (s_irq_sem)
+    xSemaphoreGive(s_irq_sem);
+}
+
+static void new_day_reset(void) {
+  s_new_day = false;
+  s_step_count = 0;
+  sensors_event_t evt = {
+      .type = SENSORS_EVENT_STEPS,
+      .time_ms = (uint32_t)(esp_timer_get_time() / 1000ULL),
+  };
+  sensor_hub_publish(&evt);
+  if (s_hw_pedometer && imu_ctrl9_cmd(IMU_CTRL9_CMD_RESET_PEDOMETER) == ESP_OK)
+    s_hw_steps_seen = 0;
+  // Close the finished day in the step history
+  (void)step_store_flush();
+  ESP_LOGI(TAG, "Daily step counter reset at midnight");
+}
+
+// Verify the fixed-point kernel against the checksum computed on the host
+// and log its cost next to the float formulas it replaced, plus the cost of
+// one activity window
+static void dsp_selftest(void) {
+  if (motion_dsp_accel_enabled() && !motion_dsp_selftest()) {
+    ESP_LOGW(TAG, "esp-dsp kernel self-test failed, using portable C");
+    motion_dsp_set_accel(false);
+  }
+  if (!motion_dsp_selftest())
+    ESP_LOGE(TAG, "Motion kernel checksum mismatch");
+
+  static int16_t xyz[MOTION_DSP_MAX_BLOCK * 3];
+  int16_t mag[MOTION_DSP_MAX_BLOCK], lp[MOTION_DSP_MAX_BLOCK],
+      pitch[MOTION_DSP_MAX_BLOCK];
+  for (int i = 0; i < MOTION_DSP_MAX_BLOCK; ++i) {
+    xyz[i * 3 + 0] = (int16_t)(i * 97 - 3000);
+    xyz[i * 3 + 1] = (int16_t)(1500 - i * 41);
+    xyz[i * 3 + 2] = (int16_t)(8192 - i * 13);
+  }
+  motion_dsp_state_t st;
+  motion_dsp_init(&st);
+  uint32_t c0 = esp_cpu_get_cycle_count();
+  motion_dsp_block(&st, xyz, MOTION_DSP_MAX_BLOCK, mag, lp, pitch);
+  uint32_t fixed = esp_cpu_get_cycle_count() - c0;
+
+  volatile float sink = 0.0f;
+  float flp = 0.0f;
+  c0 = esp_cpu_get_cycle_count();
+  for (int i = 0; i < MOTION_DSP_MAX_BLOCK; ++i) {
+    float ax = xyz[i * 3] * IMU_ACCEL_MG_PER_LSB,
+          ay = xyz[i * 3 + 1] * IMU_ACCEL_MG_PER_LSB,
+          az = xyz[i * 3 + 2] * IMU_ACCEL_MG_PER_LSB;
+    float m = sqrtf(ax * ax + ay * ay + az * az);
+    flp = 0.9f * flp + 0.1f * (m - 1000.0f);
+    sink += atan2f(-ax, sqrtf(ay * ay + az * az)) * 57.29578f + flp;
+  }
+  uint32_t flt = esp_cpu_get_cycle_count() - c0;
+  ESP_LOGI(TAG, "Motion kernel (%s): %lu cycles/sample, float %lu",
+           motion_dsp_accel_enabled() ? "esp-dsp" : "C",
+           (unsigned long)(fixed / MOTION_DSP_MAX_BLOCK),
+           (unsigned long)(flt / MOTION_DSP_MAX_BLOCK));
+
+  // Activity classifier, once per window
+  static int16_t wmag[MOTION_ACTIVITY_WINDOW], wpitch[MOTION_ACTIVITY_WINDOW];
+  for (int i = 0; i < MOTION_ACTIVITY_WINDOW; ++i) {
+    wmag[i] = (int16_t)(MOTION_DSP_ONE_G_Q12 + (i * 37) % 401 - 200);
+    wpitch[i] = (int16_t)(i * 23 - 1500);
+  }
+  motion_activity_features_t feat;
+  c0 = esp_cpu_get_cycle_count();
+  motion_activity_features(wmag, wpitch, MOTION_ACTIVITY_WINDOW,
+                           IMU_ODR_PERIOD_US, &feat);
+  (void)motion_activity_classify(&feat);
+  ESP_LOGI(TAG, "Activity classifier: %lu cycles/window",
+           (unsigned long)(esp_cpu_get_cycle_count() - c0));
+}
+
+// After a standby wake, before qmi8658_init() resets the chip: the pedometer
+// count and the tap that may have woken the SoC. The IMU was left running,
+// so a plain device is enough; it is removed again afterwards.
+static bool imu_standby_snapshot(i2c_master_bus_handle_t bus,
+                                 uint32_t *hw_steps) {
+  const uint8_t addrs[] = {IMU_ADDR_HIGH, IMU_ADDR_LOW};
+  for (int i = 0; i < 2; ++i) {
+    i2c_device_config_t cfg = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = addrs[i],
+        .scl_speed_hz = CONFIG_I2C_MASTER_FREQUENCY,
+    };
+    i2c_master_dev_handle_t dev;
+    if (i2c_master_bus_add_device(bus, &cfg, &dev) != ESP_OK)
+      continue;
+    uint8_t reg = IMU_REG_STATUS1, status1 = 0;
+    uint8_t b[4]; // TAP_STATUS, STEP_CNT L/M/H
+    esp_err_t err = i2c_master_transmit_receive(dev, &reg, 1, &status1, 1, 50);
+    reg = IMU_REG_TAP_STATUS;
+    if (err == ESP_OK)
+      err = i2c_master_transmit_receive(dev, &reg, 1, b, sizeof(b), 50);
+    (void)i2c_master_bus_rm_device(dev);
+    if (err != ESP_OK)
+      continue;
+    *hw_steps = (uint32_t)b[1] | ((uint32_t)b[2] << 8) | ((uint32_t)b[3] << 16);
+#if CONFIG_SENSORS_TAP_WAKE
+    s_resume_tap = (status1 & IMU_STATUS1_TAP) &&
+                   (b[0] & IMU_TAP_STATUS_NUM_MASK) >= IMU_TAP_WAKE_COUNT;
+#endif
+    return true;
+  }
+  return false;
+}
+
+// Today's count after a standby: the count saved on entry unless midnight
+// passed meanwhile, plus what the pedometer counted while the SoC slept
+static void standby_restore_steps(bool counted, uint32_t hw_now) {
+  time_t now = time(NULL);
+  struct tm a, b;
+  localtime_r(&s_resume.entered, &a);
+  localtime_r(&now, &b);
+  if (a.tm_year == b.tm_year && a.tm_yday == b.tm_yday &&
+      s_resume.steps > s_step_count)
+    s_step_count = s_resume.steps;
+  if (!counted || hw_now < s_resume.hw_steps)
+    return; // the chip lost its count
+  uint32_t delta = hw_now - s_resume.hw_steps;
+  s_step_count += delta;
+  step_store_add(now, delta);
+  ESP_LOGI(TAG, "%lu steps during standby", (unsigned long)delta);
+}
+
+static void rec_on_samples(const sensors_event_t *evt, void *arg);
+
 void sensors_init(void) {
   ESP_LOGI(TAG, "Initializing sensors (QMI8658)");
+  dsp_selftest();
   if (bsp_i2c_init() != ESP_OK) {
     ESP_LOGE(TAG, "I2C not available");
     return;
   }
+  uint32_t resume_hw = 0;
+  bool resume_counted =
+      s_resume.on && imu_standby_snapshot(bsp_i2c_get_handle(), &resume_hw);
   // Try both possible I2C addresses
   s_imu_ready = imu_try_init_with_addr(IMU_ADDR_HIGH) ||
                 imu_try_init_with_addr(IMU_ADDR_LOW);
@@ -114,155 +679,513 @@ void sensors_init(void) {
     ESP_LOGE(TAG, "QMI8658 init failed");
     return;
   }
-  // Create semaphore and IRQ for wake-on-motion
-  s_wom_sem = xSemaphoreCreateBinary();
-  if (s_wom_sem) {
-    imu_setup_irq();
-    // Configure wake-on-motion threshold (LSB depends on FS/ODR; empirical)
-    (void)qmi8658_enable_wake_on_motion(&s_imu, 12); // ~12 LSB ~ few tens of mg
+  // FIFO watermark interrupt; falls back to polling if either part fails
+  s_irq_sem = xSemaphoreCreateBinary();
+  if (s_irq_sem && imu_setup_irq() == ESP_OK && imu_fifo_enable() == ESP_OK) {
+    s_fifo_ready = true;
+    s_fifo_streaming = true;
+    ESP_LOGI(TAG, "IMU FIFO enabled, watermark %d samples",
+             IMU_FIFO_WATERMARK);
+  } else {
+    ESP_LOGW(TAG, "IMU FIFO unavailable, polling");
+  }
+#if CONFIG_SENSORS_STEP_ENGINE_HW
+  // Without the interrupt line there is nothing to gate streaming on, so the
+  // pedometer only pays off together with the FIFO path
+  if (s_fifo_ready && imu_engine_enable() == ESP_OK) {
+    s_hw_pedometer = true;
+    ESP_LOGI(TAG, "Using on-chip pedometer");
+  } else {
+    ESP_LOGW(TAG, "On-chip pedometer unavailable, counting steps in software");
   }
-  maybe_reset_daily_counter();
+#endif
+#if CONFIG_SENSORS_TAP_WAKE
+  // Taps arrive on the same interrupt line as the FIFO watermark
+  if (s_fifo_ready && imu_tap_enable() == ESP_OK) {
+    s_tap_ready = true;
+    ESP_LOGI(TAG, "Tap to wake enabled (%s tap)",
+             IMU_TAP_WAKE_COUNT == 2 ? "double" : "single");
+  } else {
+    ESP_LOGW(TAG, "Tap engine unavailable");
+  }
+#endif
+  // Today's count survives a reboot through the step history
+  if (step_store_init("/spiffs") == ESP_OK)
+    s_step_count = step_store_day_total(time(NULL));
+  if (s_resume.on)
+    standby_restore_steps(resume_counted, resume_hw);
+  s_standby_parked = xSemaphoreCreateBinary();
+  s_standby_release = xSemaphoreCreateBinary();
+  (void)sleep_track_init("/spiffs");
+  day_clock_register(on_new_day, NULL);
+  (void)sensors_subscribe(SENSORS_EVENT_SAMPLES, 0, rec_on_samples, NULL);
+  (void)day_clock_poll(time(NULL)); // current day, no rollover
 }
 
 uint32_t sensors_get_step_count(void) { return s_step_count; }
 
 sensors_activity_t sensors_get_activity(void) { return s_activity; }
 
-void sensors_task(void *pvParameters) {
-  ESP_LOGI(TAG, "Sensors task started");
-  const TickType_t sample_delay_active = pdMS_TO_TICKS(20); // ~50 Hz
-  const TickType_t sample_delay_idle =
-      pdMS_TO_TICKS(40);     // ~25 Hz when screen off
-  float lp = 0.0f;           // filtered magnitude
-  const float alpha = 0.90f; // LP filter smoothing
-  uint32_t last_step_ms = 0;
-  // Ring buffer for cadence (last 8 steps)
-  uint32_t step_ts_ms[8] = {0};
-  int step_ts_idx = 0, step_ts_num = 0;
-  // Raise-to-wake detection state
-  float pitch_hist[16] = {0};
-  uint32_t ts_hist[16] = {0};
-  int hist_idx = 0, hist_num = 0;
-  uint32_t last_raise_ms = 0;
-
-  bool wom_enabled = true; // enabled in init
-  bool ready_for_next_peak = true;
-  TickType_t last = xTaskGetTickCount();
-  while (1) {
-    maybe_reset_daily_counter();
+// Pull the on-chip step counter into s_step_count and the cadence buffer.
+// Returns the new steps.
+static uint32_t sync_hw_steps(motion_algo_t *algo, uint32_t now_ms) {
+  uint32_t hw;
+  if (imu_read_hw_steps(&hw) != ESP_OK)
+    return 0;
+  uint32_t delta = (hw - s_hw_steps_seen) & 0xFFFFFF;
+  s_hw_steps_seen = hw;
+  if (delta == 0)
+    return 0;
+  s_step_count += delta;
+  motion_algo_add_steps(algo, delta, now_ms);
+  return delta;
+}
 
-    // If display is off, enable WoM but also sample levemente para gesto de
-    // levantar pulso
-    bool screen_on = display_manager_is_on();
-    if (!screen_on) {
-      if (!wom_enabled && s_imu_ready) {
-        (void)qmi8658_enable_wake_on_motion(&s_imu, 12);
-        wom_enabled = true;
-      }
-      /*if (s_wom_sem && xSemaphoreTake(s_wom_sem, 0) == pdTRUE) {
-          ESP_LOGI(TAG, "Wake-on-motion IRQ");
-          display_manager_turn_on();
-          // skip rest of loop; next iter will run as screen_on
-          vTaskDelay(pdMS_TO_TICKS(50));
-          continue;
-      }*/
+static void publish_steps(uint32_t delta, uint32_t now_ms) {
+  if (delta == 0)
+    return;
+  sensors_event_t evt = {.type = SENSORS_EVENT_STEPS, .time_ms = now_ms};
+  evt.steps.total = s_step_count;
+  evt.steps.delta = delta;
+  sensor_hub_publish(&evt);
+}
+
+static void set_activity(sensors_activity_t activity, uint32_t now_ms) {
+  if (activity == s_activity)
+    return;
+  s_activity = activity;
+  sensors_event_t evt = {.type = SENSORS_EVENT_ACTIVITY, .time_ms = now_ms};
+  evt.activity = activity;
+  sensor_hub_publish(&evt);
+}
+
+static void publish_samples(const motion_batch_t *b, int64_t t0_us,
+                            bool screen_on, uint32_t now_ms) {
+  if (b->n <= 0)
+    return;
+  sensors_event_t evt = {.type = SENSORS_EVENT_SAMPLES, .time_ms = now_ms};
+  evt.samples.xyz = b->xyz;
+  evt.samples.gyro = b->gyro;
+  evt.samples.n = b->n;
+  evt.samples.t0_us = t0_us;
+  evt.samples.period_us = b->period_us;
+  evt.samples.screen_on = screen_on;
+  sensor_hub_publish(&evt);
+}
+
+// Standby handshake with sensors_task (see sensors.h): park it, hand back
+// the counts to keep, or release it again
+esp_err_t sensors_standby_enter(uint32_t *steps, uint32_t *hw_steps) {
+  if (!s_hw_pedometer || !s_standby_parked || !s_standby_release)
+    return ESP_ERR_NOT_SUPPORTED;
+  // Left over from a handshake that timed out
+  (void)xSemaphoreTake(s_standby_parked, 0);
+  (void)xSemaphoreTake(s_standby_release, 0);
+  s_standby_want = true;
+  xSemaphoreGive(s_irq_sem);
+  if (xSemaphoreTake(s_standby_parked, pdMS_TO_TICKS(2000)) != pdTRUE) {
+    s_standby_want = false;
+    xSemaphoreGive(s_standby_release);
+    return ESP_ERR_TIMEOUT;
+  }
+  *steps = s_step_count;
+  *hw_steps = s_standby_hw_steps;
+  return ESP_OK;
+}
+
+void sensors_standby_cancel(void) {
+  if (!s_standby_want)
+    return;
+  s_standby_want = false;
+  xSemaphoreGive(s_standby_release);
+}
+
+void sensors_standby_resume(uint32_t steps, uint32_t hw_steps, time_t entered) {
+  s_resume.on = true;
+  s_resume.steps = steps;
+  s_resume.hw_steps = hw_steps;
+  s_resume.entered = entered;
+}
+
+bool sensors_standby_tap_woke(void) { return s_resume_tap; }
+
+// Recorder subscriber. Batches are labelled with the activity as classified
+// after them; sleep mode batches run at another rate than *.imt conversion
+// assumes and are left out.
+static void rec_on_samples(const sensors_event_t *evt, void *arg) {
+  (void)arg;
+  if (s_sleep_on || !rec_writer_active())
+    return;
+  uint8_t flags = (evt->samples.screen_on ? MOTION_TRACE_F_SCREEN_ON : 0) |
+                  (s_hw_pedometer ? MOTION_TRACE_F_HW_STEPS : 0) |
+                  (evt->samples.gyro ? MOTION_TRACE_F_GYRO : 0);
+  rec_writer_add((uint64_t)evt->samples.t0_us, evt->samples.period_us,
+                 evt->samples.xyz, evt->samples.gyro, evt->samples.n, flags,
+                 (uint8_t)s_activity);
+}
+
+esp_err_t sensors_trace_start(const char *path) {
+  if (!s_imu_ready)
+    return ESP_ERR_INVALID_STATE;
+  if (bsp_extra_sdcard_mount() != ESP_OK) {
+    ESP_LOGW(TAG, "Trace: SD card not available");
+    return ESP_ERR_NOT_FOUND;
+  }
+  char auto_path[40];
+  if (!path) {
+    snprintf(auto_path, sizeof(auto_path), "/sdcard/imu_%lu.imc",
+             (unsigned long)time(NULL));
+    path = auto_path;
+  }
+  sensors_trace_stop();
+  esp_err_t err = rec_writer_start(path,
+                                   s_fifo_ready ? IMU_ODR_PERIOD_US
+                                                : IMU_POLL_PERIOD_US,
+                                   IMU_GYRO_PERIOD_US, IMU_ACCEL_MG_PER_LSB,
+                                   IMU_GYRO_DPS_PER_LSB, (int64_t)time(NULL));
+  if (err != ESP_OK)
+    return err;
+  // Keep samples flowing while recording, even with the screen off
+  s_trace_force_stream = true;
+  return ESP_OK;
+}
+
+void sensors_trace_stop(void) {
+  if (!rec_writer_active())
+    return;
+  s_trace_force_stream = false;
+  (void)rec_writer_stop();
+}
+
+bool sensors_trace_active(void) { return rec_writer_active(); }
+
+esp_err_t sensors_sleep_start(void) {
+  if (!s_imu_ready)
+    return ESP_ERR_INVALID_STATE;
+  s_sleep_auto = false;
+  s_sleep_want = true;
+  if (s_irq_sem)
+    xSemaphoreGive(s_irq_sem); // apply it now, not at the next wakeup
+  return ESP_OK;
+}
+
+void sensors_sleep_stop(void) {
+  s_sleep_want = false;
+  if (s_irq_sem)
+    xSemaphoreGive(s_irq_sem);
+}
+
+bool sensors_sleep_active(void) { return s_sleep_want; }
+
+// Engine events latched on the chip since the last call; reading STATUS1
+// clears them. Taps are handled here: they wake the screen whatever mode
+// the task is in.
+static uint8_t imu_read_events(uint32_t now_ms) {
+  uint8_t status1 = 0;
+  if (!s_hw_pedometer && !s_tap_ready)
+    return 0;
+  (void)imu_read(IMU_REG_STATUS1, &status1, 1);
+#if CONFIG_SENSORS_TAP_WAKE
+  uint8_t tap = 0;
+  if (s_tap_ready && (status1 & IMU_STATUS1_TAP) &&
+      imu_read(IMU_REG_TAP_STATUS, &tap, 1) == ESP_OK &&
+      (tap & IMU_TAP_STATUS_NUM_MASK)) {
+    uint8_t count = tap & IMU_TAP_STATUS_NUM_MASK;
+    if (count >= IMU_TAP_WAKE_COUNT) {
+      ESP_LOGI(TAG, "Tap-to-wake (%u)", (unsigned)count);
+      display_manager_turn_on();
+    }
+    sensors_event_t evt = {.type = SENSORS_EVENT_TAP, .time_ms = now_ms};
+    evt.tap.count = count;
+    sensor_hub_publish(&evt);
+  }
+#else
+  (void)now_ms;
+#endif
+  return status1;
+}
+
+// Inside the scheduled sleep hours (local time)?
+static bool sleep_window(time_t now) {
+  struct tm tm;
+  localtime_r(&now, &tm);
+  int from = CONFIG_SENSORS_SLEEP_START_HOUR, to = CONFIG_SENSORS_SLEEP_END_HOUR;
+  if (from <= to)
+    return tm.tm_hour >= from && tm.tm_hour < to;
+  return tm.tm_hour >= from || tm.tm_hour < to;
+}
+
+// Leave a scheduled night once the wearer is up: outside the sleep hours
+// with the screen on or walking. Manual nights run until stopped.
+static void sleep_check_exit(time_t now, bool screen_on,
+                             sensors_activity_t activity) {
+  if (s_sleep_auto && !sleep_window(now) &&
+      (screen_on || activity == SENSORS_ACTIVITY_WALK ||
+       activity == SENSORS_ACTIVITY_RUN))
+    s_sleep_want = false;
+}
+
+// One sleep mode wakeup with the on-chip engine: wait for an any-motion
+// event or the end of the epoch, then account it
+static void sleep_step(motion_algo_t *algo, int16_t *xyz) {
+  time_t now_s = time(NULL), end = sleep_track_epoch_end();
+  uint32_t wait_ms = end > now_s ? (uint32_t)(end - now_s) * 1000u : 1000u;
+  imu_irq_wait(pdMS_TO_TICKS(wait_ms));
+  if (s_sleep_want != s_sleep_on)
+    return;
+
+  uint32_t events = 0;
+  int n = 0;
+  motion_algo_result_t res = {0};
+  uint8_t status1 =
+      imu_read_events((uint32_t)(esp_timer_get_time() / 1000ULL));
+  if (status1 & IMU_STATUS1_ANY_MOTION) {
+    events = 1;
+    if (s_sleep_sampled != sleep_track_epoch_end()) {
+      // One batch per epoch: stream until the watermark would have fired
+      s_sleep_sampled = sleep_track_epoch_end();
+      imu_fifo_set_streaming(true);
+      vTaskDelay(pdMS_TO_TICKS(IMU_FIFO_WATERMARK * IMU_SLEEP_PERIOD_US / 1000 +
+                               20));
+      n = imu_fifo_read(xyz, NULL, IMU_FIFO_MAX_SAMPLES);
+      imu_fifo_set_streaming(false);
+      int64_t now_us = esp_timer_get_time();
+      int64_t t0_us =
+          now_us - (int64_t)(n > 0 ? n - 1 : 0) * IMU_SLEEP_PERIOD_US;
+      motion_batch_t batch = {
+          .xyz = xyz,
+          .n = n,
+          .t0_ms = (uint32_t)(t0_us / 1000),
+          .period_us = IMU_SLEEP_PERIOD_US,
+      };
+      motion_algo_process(algo, &batch, false, false, &res);
+      publish_samples(&batch, t0_us, false, (uint32_t)(now_us / 1000));
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(SLEEP_DEBOUNCE_MS));
     }
+    (void)xSemaphoreTake(s_irq_sem, 0); // edges seen meanwhile
+  }
+
+  now_s = time(NULL);
+  if (s_new_day)
+    new_day_reset();
+  uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+  uint32_t new_steps = sync_hw_steps(algo, now_ms);
+  step_store_add(now_s, new_steps);
+  publish_steps(new_steps, now_ms);
+  set_activity(motion_algo_activity(algo), now_ms);
+  sensor_hub_flush(now_ms);
+  sleep_track_add_cost(1, (uint32_t)n);
+  if (!sleep_track_update(now_s, events, res.activity_mg))
+    s_sleep_want = false; // night full
+  sleep_check_exit(now_s, display_manager_is_on(), s_activity);
+}
+
+// Park for standby: stop streaming, leave taps and a thinned-out pedometer
+// event on INT1 (imu_standby_engines()), get the count to flash, then wait
+// until the SoC sleeps or standby is called off. Otherwise every move or
+// step would wake the SoC.
+static void standby_park(motion_algo_t *algo) {
+  uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+#if CONFIG_SENSORS_STEP_ENGINE_HW
+  uint8_t ctrl8 = 0;
+  bool ctrl8_ok = imu_read(IMU_REG_CTRL8, &ctrl8, 1) == ESP_OK;
+  if (ctrl8_ok)
+    imu_standby_engines(true, ctrl8);
+#endif
+#if CONFIG_SENSORS_RAISE_GYRO
+  imu_gyro_set(false, now_ms);
+#endif
+  imu_fifo_set_streaming(false);
+  time_t now_s = time(NULL);
+  uint32_t new_steps = sync_hw_steps(algo, now_ms);
+  step_store_add(now_s, new_steps);
+  publish_steps(new_steps, now_ms);
+  (void)step_store_flush();
+  (void)imu_read_events(now_ms); // a latched event would hold INT1 low
+  s_standby_hw_steps = s_hw_steps_seen;
+  xSemaphoreGive(s_standby_parked);
+  (void)xSemaphoreTake(s_standby_release, portMAX_DELAY);
+#if CONFIG_SENSORS_STEP_ENGINE_HW
+  if (ctrl8_ok)
+    imu_standby_engines(false, ctrl8);
+#endif
+  (void)xSemaphoreTake(s_irq_sem, 0);
+}
+
+void sensors_task(void *pvParameters) {
+  ESP_LOGI(TAG, "Sensors task started");
+  static motion_algo_t algo;
+  static int16_t xyz[IMU_FIFO_MAX_SAMPLES * 3];
+  static int16_t gyro[IMU_FIFO_MAX_SAMPLES * 3];
+  motion_algo_init(&algo);
+  const uint32_t raise_window_ms = CONFIG_SENSORS_RAISE_WINDOW_MS;
+  uint32_t last_motion_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+  motion_rate_gov_t rate_gov;
+  motion_rate_init(&rate_gov, last_motion_ms);
+  TickType_t poll_wake = xTaskGetTickCount();
 
+  while (1) {
     if (!s_imu_ready) {
       vTaskDelay(pdMS_TO_TICKS(1000));
       continue;
     }
-    // Display is on: prefer normal sampling, disable WoM to avoid extra
-    // interrupts
-    if (screen_on && wom_enabled) {
-      (void)qmi8658_disable_wake_on_motion(&s_imu);
-      wom_enabled = false;
+    if (s_standby_want) {
+      standby_park(&algo);
+      continue;
     }
 
-    float ax, ay, az;
-    if (qmi8658_read_accel(&s_imu, &ax, &ay, &az) == ESP_OK) {
-      // ax,ay,az in mg
-      float mag = sqrtf(ax * ax + ay * ay + az * az); // mg
-      float hp = mag - 1000.0f;                       // remove gravity
-      lp = alpha * lp + (1.0f - alpha) * hp;
-
-      // Peak detection
-      const float THRESH = 80.0f; // mg (more sensitive)
+    if (s_sleep_want != s_sleep_on) {
+      time_t now_s = time(NULL);
       uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
-      uint32_t dt = now_ms - last_step_ms;
-      if (lp > THRESH && dt > 280 && dt < 2000) {
-        if (ready_for_next_peak) {
-          s_step_count++;
-          // cadence buffer
-          step_ts_ms[step_ts_idx] = now_ms;
-          step_ts_idx = (step_ts_idx + 1) & 7;
-          if (step_ts_num < 8)
-            step_ts_num++;
-          last_step_ms = now_ms;
-          ready_for_next_peak = false;
-        }
-      } else if (lp < THRESH * 0.5f) {
-        ready_for_next_peak = true;
-      }
-
-      // Classify activity by cadence (last N steps)
-      if (step_ts_num >= 2) {
-        uint32_t oldest = step_ts_ms[(step_ts_idx - step_ts_num + 8) & 7];
-        uint32_t newest = step_ts_ms[(step_ts_idx - 1 + 8) & 7];
-        uint32_t span_ms = newest - oldest;
-        float spm = 0.0f;
-        if (span_ms > 0) {
-          spm = 60000.0f * (float)(step_ts_num - 1) / (float)span_ms;
-        }
-        if (spm > 130.0f)
-          s_activity = SENSORS_ACTIVITY_RUN;
-        else if (spm > 60.0f)
-          s_activity = SENSORS_ACTIVITY_WALK;
-        else if (spm > 10.0f)
-          s_activity = SENSORS_ACTIVITY_OTHER;
-        else
-          s_activity = SENSORS_ACTIVITY_IDLE;
+      s_sleep_on = s_sleep_want;
+      if (s_sleep_on) {
+#if CONFIG_SENSORS_RAISE_GYRO
+        if (s_fifo_ready)
+          imu_gyro_set(false, now_ms);
+#endif
+        if (s_hw_pedometer)
+          imu_fifo_set_streaming(false);
+        imu_rate_set(IMU_SLEEP_PERIOD_US);
+        sleep_track_begin(now_s);
       } else {
-        s_activity = SENSORS_ACTIVITY_IDLE;
+        (void)sleep_track_end(now_s);
+        imu_rate_set(IMU_ODR_PERIOD_US);
+        motion_rate_init(&rate_gov, now_ms);
+        s_sleep_auto = false;
+        last_motion_ms = now_ms; // a fresh idle period before re-entry
       }
+    }
+    if (s_sleep_on && s_hw_pedometer) {
+      sleep_step(&algo, xyz);
+      continue;
+    }
 
-      // Raise-to-wake: compute pitch angle from accel (degrees)
-      // pitch ~ rotation around Y: -ax against gravity
-      float ax_g = ax / 1000.0f, ay_g = ay / 1000.0f, az_g = az / 1000.0f;
-      float pitch = (float)(atan2f(-ax_g, sqrtf(ay_g * ay_g + az_g * az_g)) *
-                            180.0f / (float)M_PI);
-      // uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
-      pitch_hist[hist_idx] = pitch;
-      ts_hist[hist_idx] = now_ms;
-      hist_idx = (hist_idx + 1) & 15;
-      if (hist_num < 16)
-        hist_num++;
-
-      if (!screen_on) {
-        // Compare with sample ~400-600ms atrás
-        float pitch_prev = pitch;
-        for (int k = 1; k <= hist_num; ++k) {
-          int idx = (hist_idx - k + 16) & 15;
-          uint32_t dtms = now_ms - ts_hist[idx];
-          if (dtms >= 400 && dtms <= 700) {
-            pitch_prev = pitch_hist[idx];
-            break;
-          }
-        }
-        float dp = pitch - pitch_prev; // positive when lifting display up
-        bool accel_ok = (mag > RAISE_ACCEL_MIN_MG &&
-                         mag < RAISE_ACCEL_MAX_MG); // avoid big shakes
-        bool cooldown_ok = (now_ms - last_raise_ms) > RAISE_COOLDOWN_MS;
-        if (dp > RAISE_DP_THRESH_DEG && accel_ok && cooldown_ok) {
-          ESP_LOGI(TAG, "Raise-to-wake: dp=%.1f pitch=%.1f prev=%.1f", dp,
-                   pitch, pitch_prev);
-          last_raise_ms = now_ms;
-          display_manager_turn_on();
-          // let next iter process as screen_on
-        }
+    int n = 0;
+    bool any_motion = false;
+    if (s_fifo_ready) {
+      // Give up waiting for the watermark edge after two batch periods, so a
+      // missed interrupt only delays processing instead of stalling it
+      uint32_t wtm = s_gyro_on ? IMU_FIFO_WATERMARK_GESTURE : IMU_FIFO_WATERMARK;
+      TickType_t timeout = s_fifo_streaming
+                               ? pdMS_TO_TICKS(2 * wtm * s_period_us / 1000 + 1)
+                               : pdMS_TO_TICKS(IMU_STEP_POLL_MS);
+      imu_irq_wait(timeout);
+      uint32_t irq_ms = (uint32_t)(esp_timer_get_time() / 1000ULL);
+      uint8_t status1 = imu_read_events(irq_ms);
+      any_motion = s_hw_pedometer && (status1 & IMU_STATUS1_ANY_MOTION);
+      if (any_motion)
+        last_motion_ms = irq_ms;
+      if (s_fifo_streaming)
+        n = imu_fifo_read(xyz, gyro, IMU_FIFO_MAX_SAMPLES);
+    } else {
+      // Poll on a fixed grid so the batches can be stamped with the poll
+      // period rather than the chip's ODR; restart the grid after a stall
+      TickType_t poll_ticks = pdMS_TO_TICKS(IMU_POLL_PERIOD_MS);
+      if (xTaskGetTickCount() - poll_wake > poll_ticks)
+        poll_wake = xTaskGetTickCount();
+      vTaskDelayUntil(&poll_wake, poll_ticks);
+      float ax, ay, az; // mg
+      if (qmi8658_read_accel(&s_imu, &ax, &ay, &az) == ESP_OK) {
+        xyz[0] = (int16_t)lrintf(ax / IMU_ACCEL_MG_PER_LSB);
+        xyz[1] = (int16_t)lrintf(ay / IMU_ACCEL_MG_PER_LSB);
+        xyz[2] = (int16_t)lrintf(az / IMU_ACCEL_MG_PER_LSB);
+        n = 1;
       }
     }
-    TickType_t delay = screen_on ? sample_delay_active : sample_delay_idle;
-    vTaskDelayUntil(&last, delay);
+
+    time_t now_s = time(NULL);
+    if (s_new_day)
+      new_day_reset();
+    bool screen_on = display_manager_is_on();
+    // The newest sample was taken just now; older ones are spaced one ODR
+    // period apart (one poll period without the FIFO)
+    int64_t now_us = esp_timer_get_time();
+    uint32_t now_ms = (uint32_t)(now_us / 1000);
+    // Gyro samples are usable once it has settled after power-up
+    bool gyro_ok = s_fifo_ready && s_gyro_on &&
+                   (now_ms - s_gyro_on_ms) >= IMU_GYRO_SETTLE_MS;
+    uint32_t period_us = s_fifo_ready ? s_period_us : IMU_POLL_PERIOD_US;
+    int64_t t0_us = now_us - (int64_t)(n > 0 ? n - 1 : 0) * period_us;
+    motion_batch_t batch = {
+        .xyz = xyz,
+        .gyro = gyro_ok ? gyro : NULL,
+        .n = n,
+        .t0_ms = (uint32_t)(t0_us / 1000),
+        .period_us = period_us,
+    };
+
+    motion_algo_result_t res;
+    motion_algo_process(&algo, &batch, !s_hw_pedometer,
+                        !screen_on && !s_sleep_on, &res);
+    s_step_count += res.steps;
+    uint32_t new_steps = res.steps;
+    if (res.raise) {
+      ESP_LOGI(TAG, "Raise-to-wake%s: dp=%.1f", res.raise_gyro ? " (gyro)" : "",
+               res.raise_dp_q7 / 128.0f);
+      display_manager_turn_on();
+      screen_on = true;
+      sensors_event_t evt = {.type = SENSORS_EVENT_RAISE, .time_ms = now_ms};
+      evt.raise.gyro = res.raise_gyro;
+      sensor_hub_publish(&evt);
+    }
+
+    // The software engine has no any-motion interrupt; the batch itself says
+    // whether the wrist moved
+    if (!s_hw_pedometer && res.motion)
+      last_motion_ms = now_ms;
+    bool moving = (now_ms - last_motion_ms) < raise_window_ms;
+    if (s_hw_pedometer) {
+      new_steps += sync_hw_steps(&algo, now_ms);
+      // Screen off and still: leave the samples on the IMU. Motion reopens
+      // the stream long enough to see a wrist raise.
+      imu_fifo_set_streaming(screen_on || moving || s_trace_force_stream);
+    }
+#if CONFIG_SENSORS_RAISE_GYRO
+    if (s_fifo_ready)
+      imu_gyro_set(!screen_on && moving && s_fifo_streaming && !s_sleep_on,
+                   now_ms);
+#endif
+    set_activity(motion_algo_activity(&algo), now_ms);
+    step_store_add(now_s, new_steps);
+    publish_steps(new_steps, now_ms);
+#if CONFIG_SENSORS_RATE_GOVERNOR
+    // Rate for the next batches. The gyro window samples at its own rate
+    // and covers the raise itself; recordings stay at 62.5 Hz.
+    if (s_fifo_ready && !s_sleep_on) {
+#if CONFIG_SENSORS_RAISE_GYRO
+      bool accel_raise = false;
+#else
+      bool accel_raise = !screen_on;
+#endif
+      motion_rate_input_t in = {.motion = res.motion || any_motion,
+                                .raise_armed = accel_raise,
+                                .activity = s_activity};
+      motion_rate_t rate = motion_rate_update(&rate_gov, &in, now_ms);
+      if (sensors_trace_active())
+        rate = MOTION_RATE_MID;
+      if (!s_gyro_on)
+        imu_rate_set(motion_rate_period_us(rate));
+    }
+#endif
+    publish_samples(&batch, t0_us, screen_on, now_ms);
+    sensor_hub_flush(now_ms);
+
+    if (s_sleep_on) {
+      // Without the any-motion engine every batch that moved is an event
+      sleep_track_add_cost(1, (uint32_t)n);
+      if (!sleep_track_update(now_s, res.motion ? 1 : 0, res.activity_mg))
+        s_sleep_want = false;
+      sleep_check_exit(now_s, screen_on, s_activity);
+    }
+#if CONFIG_SENSORS_SLEEP_AUTO && !CONFIG_STANDBY_NIGHT_STANDBY
+    else if (!s_sleep_want && !screen_on && sleep_window(now_s) &&
+             (now_ms - last_motion_ms) > SLEEP_AUTO_IDLE_MS) {
+      ESP_LOGI(TAG, "Still for %d min in sleep hours, tracking sleep",
+               SLEEP_AUTO_IDLE_MS / 60000);
+      s_sleep_auto = true;
+      s_sleep_want = true;
+    }
+#endif
   }
 }
@@ -0,0 +1,317 @@
+// Nightly sleep records (see sleep_track.h)
+
+#include "sleep_track.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "SLEEP";
+
+// Movement score of an epoch: any-motion events plus batch activity
+#define SCORE_PER_EVENT 4
+#define SCORE_MG_PER_POINT 4
+
+// Cole-Kripke window over epochs i-4..i+2; asleep when the weighted sum of
+// scores stays below the threshold (a lone event in a still night does)
+static const uint16_t k_weights[7] = {106, 54, 58, 76, 230, 74, 67};
+#define WINDOW_BEFORE 4
+#define SLEEP_THRESH 6000
+
+// Webster rescoring: after at least `wake` awake epochs, the first `sleep`
+// asleep epochs are rescored awake
+static const struct {
+  uint8_t wake, sleep;
+} k_rescore[] = {{15, 4}, {10, 3}, {4, 1}};
+// Sleep bouts of at most `len` epochs with `wake` awake epochs on both sides
+// are rescored awake
+static const struct {
+  uint8_t len, wake;
+} k_isolated[] = {{6, 10}, {10, 20}};
+
+static SemaphoreHandle_t s_lock;
+static bool s_ready;
+static char s_path[48];
+static uint32_t s_seq; // newest stored night
+static sleep_track_night_t s_night; // night being recorded
+static bool s_open;
+static int s_epoch;                 // epoch being accumulated
+static uint32_t s_events;
+static uint16_t s_activity;
+
+static void set_bit(uint8_t *bits, int i, bool on) {
+  if (on)
+    bits[i >> 3] |= (uint8_t)(1u << (i & 7));
+  else
+    bits[i >> 3] &= (uint8_t)~(1u << (i & 7));
+}
+
+static bool get_bit(const uint8_t *bits, int i) {
+  return (bits[i >> 3] >> (i & 7)) & 1;
+}
+
+void sleep_track_segment(const uint8_t *score, int n, uint8_t *asleep,
+                         sleep_track_summary_t *sum) {
+  memset(asleep, 0, (size_t)(n + 7) / 8);
+  for (int i = 0; i < n; ++i) {
+    uint32_t d = 0;
+    for (int k = 0; k < 7; ++k) {
+      int j = i + k - WINDOW_BEFORE;
+      if (j >= 0 && j < n)
+        d += (uint32_t)k_weights[k] * score[j];
+    }
+    set_bit(asleep, i, d < SLEEP_THRESH);
+  }
+
+  // The start of a sleep bout after a stretch awake is often lying still
+  // while still awake
+  int wake_run = 0, left = 0;
+  for (int i = 0; i < n; ++i) {
+    if (!get_bit(asleep, i)) {
+      wake_run++;
+      left = 0;
+      continue;
+    }
+    if (wake_run > 0) {
+      left = 0;
+      for (size_t r = 0; r < sizeof(k_rescore) / sizeof(k_rescore[0]); ++r) {
+        if (wake_run >= k_rescore[r].wake) {
+          left = k_rescore[r].sleep;
+          break;
+        }
+      }
+      wake_run = 0;
+    }
+    if (left > 0) {
+      set_bit(asleep, i, false);
+      left--;
+    }
+  }
+
+  // Short sleep bouts between long wake periods; the record's ends count
+  // as awake, and a removed bout joins the wake runs around it
+  int i = 0, prev_wake = 0, carry = n;
+  while (i < n) {
+    if (!get_bit(asleep, i)) {
+      int s = i;
+      while (i < n && !get_bit(asleep, i))
+        i++;
+      prev_wake = carry + (i - s);
+      carry = 0;
+      continue;
+    }
+    if (carry > 0) { // record starts asleep
+      prev_wake = carry;
+      carry = 0;
+    }
+    int s = i;
+    while (i < n && get_bit(asleep, i))
+      i++;
+    int len = i - s, next_wake = 0;
+    while (i + next_wake < n && !get_bit(asleep, i + next_wake))
+      next_wake++;
+    if (i + next_wake == n)
+      next_wake = n;
+    for (size_t r = 0; r < sizeof(k_isolated) / sizeof(k_isolated[0]); ++r) {
+      if (len <= k_isolated[r].len && prev_wake >= k_isolated[r].wake &&
+          next_wake >= k_isolated[r].wake) {
+        for (int j = s; j < s + len; ++j)
+          set_bit(asleep, j, false);
+        carry = prev_wake + len;
+        break;
+      }
+    }
+  }
+
+  // Summary over the sleep period, first to last asleep epoch
+  int onset = n, wake = 0, slept = 0, awakenings = 0;
+  for (int j = 0; j < n; ++j) {
+    if (get_bit(asleep, j)) {
+      if (onset == n)
+        onset = j;
+      wake = j + 1;
+    }
+  }
+  for (int j = onset; j < wake; ++j) {
+    if (get_bit(asleep, j))
+      slept++;
+    else if (get_bit(asleep, j - 1))
+      awakenings++;
+  }
+  sum->onset = (uint16_t)onset;
+  sum->wake = (uint16_t)(onset < n ? wake : n);
+  sum->sleep_min = (uint16_t)(slept * SLEEP_TRACK_EPOCH_S / 60);
+  sum->waso_min = (uint16_t)((onset < n ? wake - onset - slept : 0) *
+                             SLEEP_TRACK_EPOCH_S / 60);
+  sum->awakenings = (uint16_t)awakenings;
+}
+
+static long slot_offset(uint32_t seq) {
+  return (long)(seq % SLEEP_TRACK_NIGHTS) * (long)sizeof(sleep_track_night_t);
+}
+
+esp_err_t sleep_track_init(const char *dir) {
+  if (s_ready)
+    return ESP_OK;
+  if (!s_lock) {
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock)
+      return ESP_ERR_NO_MEM;
+  }
+  snprintf(s_path, sizeof(s_path), "%s/sleep.bin", dir);
+  FILE *f = fopen(s_path, "r+b");
+  if (!f)
+    f = fopen(s_path, "w+b");
+  if (!f) {
+    ESP_LOGE(TAG, "Cannot open %s", s_path);
+    return ESP_FAIL;
+  }
+  // Slots hold nights by sequence number; the file grows as they fill
+  s_seq = 0;
+  int nights = 0;
+  for (int i = 0; i < SLEEP_TRACK_NIGHTS; ++i) {
+    sleep_track_summary_t sum;
+    if (fseek(f, (long)i * (long)sizeof(sleep_track_night_t), SEEK_SET) != 0 ||
+        fread(&sum, sizeof(sum), 1, f) != 1)
+      break;
+    if (sum.seq != 0 && sum.epochs <= SLEEP_TRACK_MAX_EPOCHS) {
+      nights++;
+      if (sum.seq > s_seq)
+        s_seq = sum.seq;
+    }
+  }
+  fclose(f);
+  s_open = false;
+  s_ready = true;
+  ESP_LOGI(TAG, "Sleep history: %d/%d nights", nights, SLEEP_TRACK_NIGHTS);
+  return ESP_OK;
+}
+
+// Store the score of the epoch being accumulated and move to the next
+static void close_epoch(void) {
+  uint32_t score = s_events * SCORE_PER_EVENT + s_activity / SCORE_MG_PER_POINT;
+  s_night.score[s_epoch] = (uint8_t)(score > 255 ? 255 : score);
+  s_epoch++;
+  s_events = 0;
+  s_activity = 0;
+}
+
+void sleep_track_begin(time_t now) {
+  if (s_open)
+    (void)sleep_track_end(now);
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  memset(&s_night, 0, sizeof(s_night));
+  s_night.sum.start = (uint32_t)(now - now % SLEEP_TRACK_EPOCH_S);
+  s_epoch = 0;
+  s_events = 0;
+  s_activity = 0;
+  s_open = true;
+  xSemaphoreGive(s_lock);
+  ESP_LOGI(TAG, "Sleep tracking started");
+}
+
+bool sleep_track_update(time_t now, uint32_t events, uint16_t activity_mg) {
+  if (!s_open)
+    return false;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  // A clock set backwards lands in the current epoch
+  long idx = now >= (time_t)s_night.sum.start
+                 ? (long)(now - s_night.sum.start) / SLEEP_TRACK_EPOCH_S
+                 : s_epoch;
+  while (s_epoch < idx && s_epoch < SLEEP_TRACK_MAX_EPOCHS)
+    close_epoch();
+  bool room = s_epoch < SLEEP_TRACK_MAX_EPOCHS;
+  if (room) {
+    s_events += events;
+    if (activity_mg > s_activity)
+      s_activity = activity_mg;
+  }
+  xSemaphoreGive(s_lock);
+  return room;
+}
+
+void sleep_track_add_cost(uint32_t wakeups, uint32_t samples) {
+  if (!s_open)
+    return;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  s_night.sum.wakeups += wakeups;
+  s_night.sum.samples += samples;
+  xSemaphoreGive(s_lock);
+}
+
+time_t sleep_track_epoch_end(void) {
+  if (!s_open)
+    return 0;
+  return (time_t)s_night.sum.start + (time_t)(s_epoch + 1) * SLEEP_TRACK_EPOCH_S;
+}
+
+bool sleep_track_active(void) { return s_open; }
+
+esp_err_t sleep_track_end(time_t now) {
+  if (!s_open)
+    return ESP_ERR_INVALID_STATE;
+  (void)sleep_track_update(now, 0, 0);
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  // The epoch in progress counts if it has anything in it
+  if (s_epoch < SLEEP_TRACK_MAX_EPOCHS && (s_events || s_activity))
+    close_epoch();
+  s_open = false;
+  sleep_track_summary_t *sum = &s_night.sum;
+  sum->epochs = (uint16_t)s_epoch;
+  if (sum->epochs == 0) {
+    xSemaphoreGive(s_lock);
+    return ESP_OK;
+  }
+  sleep_track_segment(s_night.score, sum->epochs, s_night.asleep, sum);
+  esp_err_t err = ESP_FAIL;
+  if (s_ready) {
+    sum->seq = s_seq + 1;
+    FILE *f = fopen(s_path, "r+b");
+    if (f) {
+      // Extend the file with empty slots up to this one
+      bool ok = fseek(f, 0, SEEK_END) == 0;
+      static const sleep_track_night_t empty;
+      for (long len = ok ? ftell(f) : -1; ok && len >= 0 &&
+                                          len < slot_offset(sum->seq);
+           len += (long)sizeof(empty))
+        ok = fwrite(&empty, sizeof(empty), 1, f) == 1;
+      ok = ok && fseek(f, slot_offset(sum->seq), SEEK_SET) == 0 &&
+           fwrite(&s_night, sizeof(s_night), 1, f) == 1;
+      ok = (fclose(f) == 0) && ok;
+      if (ok) {
+        s_seq = sum->seq;
+        err = ESP_OK;
+      }
+    }
+  }
+  ESP_LOGI(TAG,
+           "Night: %u epochs, onset %u, %u min asleep, %u min awake, %u "
+           "awakenings; %lu wakeups, %lu samples%s",
+           sum->epochs, sum->onset, sum->sleep_min, sum->waso_min,
+           sum->awakenings, (unsigned long)sum->wakeups,
+           (unsigned long)sum->samples, err == ESP_OK ? "" : " (not stored)");
+  xSemaphoreGive(s_lock);
+  return err;
+}
+
+esp_err_t sleep_track_get(int back, sleep_track_night_t *out) {
+  if (!s_ready)
+    return ESP_ERR_INVALID_STATE;
+  if (back < 0 || back >= SLEEP_TRACK_NIGHTS || (uint32_t)back >= s_seq)
+    return ESP_ERR_NOT_FOUND;
+  xSemaphoreTake(s_lock, portMAX_DELAY);
+  uint32_t seq = s_seq - (uint32_t)back;
+  esp_err_t err = ESP_ERR_NOT_FOUND;
+  FILE *f = fopen(s_path, "rb");
+  if (f) {
+    if (fseek(f, slot_offset(seq), SEEK_SET) == 0 &&
+        fread(out, sizeof(*out), 1, f) == 1 && out->sum.seq == seq &&
+        out->sum.epochs <= SLEEP_TRACK_MAX_EPOCHS)
+      err = ESP_OK;
+    fclose(f);
+  }
+  xSemaphoreGive(s_lock);
+  return err;
+}
@@ -0,0 +1,485 @@
+// Persistent step history (see step_store.h)
+
+#include "step_store.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
+#ifndef CONFIG_SENSORS_STEP_STORE_FLUSH_MIN
+#define CONFIG_SENSORS_STEP_STORE_FLUSH_MIN 10
+#endif
+
+static const char *TAG = "STEPS";
+
+#define MIN_VALID_TIME 1704067200 // 2024-01-01: clock not set before this
+
+// Minute log block: header, then (delta, steps) varint pairs
+typedef struct __attribute__((packed)) {
+  uint32_t seq;      // write order, 0 = never used
+  uint32_t base_min; // minute of the first entry
+  uint16_t used;     // payload bytes
+  uint16_t reserved;
+} block_hdr_t;
+
+#define BLOCK_PAYLOAD (STEP_STORE_BLOCK_SIZE - sizeof(block_hdr_t))
+
+typedef struct {
+  block_hdr_t hdr;
+  uint8_t data[BLOCK_PAYLOAD];
+} block_t;
+
+// Hour/day rollup slot; key 0 = empty
+typedef struct __attribute__((packed)) {
+  uint32_t key;
+  uint32_t steps;
+} slot_t;
+
+typedef struct {
+  uint32_t key, steps;
+  bool dirty;
+} rollup_t;
+
+static SemaphoreHandle_t s_lock;
+static bool s_ready;
+static char s_min_path[48], s_hour_path[48], s_day_path[48];
+
+// Minute ring: start minute of every block, oldest block and block count
+static uint32_t s_base[STEP_STORE_BLOCKS];
+static int s_first, s_count;
+static block_t s_head; // newest block, kept in RAM and rewritten on flush
+static int s_head_idx;
+static bool s_head_dirty;
+static uint32_t s_last_min; // minute of the last entry in s_head
+static uint32_t s_cur_min, s_cur_steps; // minute being accumulated
+
+static rollup_t s_hour, s_day;
+static uint32_t s_last_flush_min;
+
+static void lock(void) { xSemaphoreTake(s_lock, portMAX_DELAY); }
+static void unlock(void) { xSemaphoreGive(s_lock); }
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant)
+static int32_t days_from_civil(int y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = (unsigned)(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int32_t)doe - 719468;
+}
+
+uint32_t step_store_unit(step_store_res_t res, time_t t) {
+  if (res == STEP_STORE_MINUTE)
+    return (uint32_t)(t / 60);
+  struct tm tm;
+  localtime_r(&t, &tm);
+  uint32_t day = (uint32_t)days_from_civil(tm.tm_year + 1900,
+                                           (unsigned)tm.tm_mon + 1,
+                                           (unsigned)tm.tm_mday);
+  return res == STEP_STORE_DAY ? day : day * 24 + (uint32_t)tm.tm_hour;
+}
+
+static int put_varint(uint8_t *p, uint32_t v) {
+  int n = 0;
+  while (v >= 0x80) {
+    p[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  p[n++] = (uint8_t)v;
+  return n;
+}
+
+static int get_varint(const uint8_t *p, int len, uint32_t *v) {
+  uint32_t r = 0;
+  for (int i = 0; i < len && i < 5; ++i) {
+    r |= (uint32_t)(p[i] & 0x7F) << (7 * i);
+    if (!(p[i] & 0x80)) {
+      *v = r;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+static bool file_write_at(const char *path, long off, const void *buf,
+                          size_t len) {
+  FILE *f = fopen(path, "r+b");
+  if (!f)
+    return false;
+  bool ok = fseek(f, off, SEEK_SET) == 0 && fwrite(buf, 1, len, f) == len;
+  ok = (fclose(f) == 0) && ok;
+  return ok;
+}
+
+// Make sure `path` exists with at least `size` bytes (zero filled)
+static bool file_ensure(const char *path, long size) {
+  FILE *f = fopen(path, "r+b");
+  if (!f)
+    f = fopen(path, "w+b");
+  if (!f)
+    return false;
+  bool ok = fseek(f, 0, SEEK_END) == 0;
+  long len = ok ? ftell(f) : -1;
+  static const uint8_t zero[STEP_STORE_BLOCK_SIZE];
+  while (ok && len < size) {
+    size_t n = (size_t)(size - len);
+    if (n > sizeof(zero))
+      n = sizeof(zero);
+    ok = fwrite(zero, 1, n, f) == n;
+    len += (long)n;
+  }
+  ok = (fclose(f) == 0) && ok;
+  return ok;
+}
+
+static bool block_valid(const block_hdr_t *h) {
+  return h->seq != 0 && h->used <= BLOCK_PAYLOAD;
+}
+
+static bool read_block(int idx, block_t *b) {
+  FILE *f = fopen(s_min_path, "rb");
+  if (!f)
+    return false;
+  bool ok = fseek(f, (long)idx * STEP_STORE_BLOCK_SIZE, SEEK_SET) == 0 &&
+            fread(b, sizeof(*b), 1, f) == 1;
+  fclose(f);
+  return ok && block_valid(&b->hdr);
+}
+
+// Decode a block; calls emit() for every entry, returns the last minute
+typedef bool (*emit_fn)(uint32_t min, uint32_t steps, void *ctx);
+
+static uint32_t decode_block(const block_t *b, emit_fn emit, void *ctx) {
+  uint32_t m = b->hdr.base_min;
+  int pos = 0;
+  while (pos < b->hdr.used) {
+    uint32_t delta, steps;
+    int n1 = get_varint(&b->data[pos], b->hdr.used - pos, &delta);
+    int n2 = n1 ? get_varint(&b->data[pos + n1], b->hdr.used - pos - n1,
+                             &steps)
+                : 0;
+    if (!n2)
+      break;
+    pos += n1 + n2;
+    m += delta;
+    if (emit && !emit(m, steps, ctx))
+      break;
+  }
+  return m;
+}
+
+static bool flush_head(void) {
+  if (!s_head_dirty)
+    return true;
+  if (!file_write_at(s_min_path, (long)s_head_idx * STEP_STORE_BLOCK_SIZE,
+                     &s_head, sizeof(s_head)))
+    return false;
+  s_head_dirty = false;
+  return true;
+}
+
+// Append one (minute, steps) entry, moving to a new block when full
+static void append_minute(uint32_t min, uint32_t steps) {
+  // A clock set backwards must not break the time order of the ring;
+  // attribute such steps to the newest minute instead
+  if (s_head.hdr.used && min < s_last_min)
+    min = s_last_min;
+  uint8_t enc[10];
+  uint32_t delta = s_head.hdr.used ? min - s_last_min : 0;
+  int n = put_varint(enc, delta);
+  n += put_varint(enc + n, steps);
+
+  if (s_head.hdr.seq == 0 || s_head.hdr.used + n > (int)BLOCK_PAYLOAD) {
+    if (s_head.hdr.seq != 0) {
+      if (!flush_head())
+        ESP_LOGE(TAG, "Failed to write step block %d", s_head_idx);
+      s_head_idx = (s_head_idx + 1) % STEP_STORE_BLOCKS;
+      if (s_count == STEP_STORE_BLOCKS)
+        s_first = (s_first + 1) % STEP_STORE_BLOCKS;
+      else
+        s_count++;
+    } else {
+      s_count = 1;
+      s_first = s_head_idx;
+    }
+    uint32_t seq = s_head.hdr.seq + 1;
+    memset(&s_head, 0, sizeof(s_head));
+    s_head.hdr.seq = seq;
+    s_head.hdr.base_min = min;
+    s_base[s_head_idx] = min;
+    n = put_varint(enc, 0);
+    n += put_varint(enc + n, steps);
+  }
+  memcpy(&s_head.data[s_head.hdr.used], enc, (size_t)n);
+  s_head.hdr.used += (uint16_t)n;
+  s_last_min = min;
+  s_head_dirty = true;
+}
+
+static void commit_minute(void) {
+  if (s_cur_steps) {
+    append_minute(s_cur_min, s_cur_steps > 0xFFFF ? 0xFFFF : s_cur_steps);
+    s_cur_steps = 0;
+  }
+}
+
+static bool read_slot(const char *path, int nslots, uint32_t key, slot_t *s) {
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  bool ok = fseek(f, (long)(key % nslots) * sizeof(slot_t), SEEK_SET) == 0 &&
+            fread(s, sizeof(*s), 1, f) == 1;
+  fclose(f);
+  return ok && s->key == key;
+}
+
+static bool write_rollup(const char *path, int nslots, rollup_t *r) {
+  if (!r->dirty)
+    return true;
+  slot_t s = {.key = r->key, .steps = r->steps};
+  if (!file_write_at(path, (long)(r->key % nslots) * sizeof(slot_t), &s,
+                     sizeof(s)))
+    return false;
+  r->dirty = false;
+  return true;
+}
+
+static void rollup_switch(const char *path, int nslots, rollup_t *r,
+                          uint32_t key) {
+  if (r->key == key)
+    return;
+  slot_t s;
+  r->key = key;
+  r->steps = read_slot(path, nslots, key, &s) ? s.steps : 0;
+  r->dirty = false;
+}
+
+static esp_err_t flush_locked(uint32_t now_min) {
+  commit_minute();
+  bool ok = flush_head();
+  ok = write_rollup(s_hour_path, STEP_STORE_HOUR_SLOTS, &s_hour) && ok;
+  ok = write_rollup(s_day_path, STEP_STORE_DAY_SLOTS, &s_day) && ok;
+  s_last_flush_min = now_min;
+  if (!ok)
+    ESP_LOGE(TAG, "Step history flush failed");
+  return ok ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t step_store_init(const char *dir) {
+  if (s_ready)
+    return ESP_OK;
+  if (!s_lock) {
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock)
+      return ESP_ERR_NO_MEM;
+  }
+  snprintf(s_min_path, sizeof(s_min_path), "%s/steps_min.bin", dir);
+  snprintf(s_hour_path, sizeof(s_hour_path), "%s/steps_hr.bin", dir);
+  snprintf(s_day_path, sizeof(s_day_path), "%s/steps_day.bin", dir);
+  if (!file_ensure(s_min_path, (long)STEP_STORE_BLOCKS * STEP_STORE_BLOCK_SIZE) ||
+      !file_ensure(s_hour_path, (long)STEP_STORE_HOUR_SLOTS * sizeof(slot_t)) ||
+      !file_ensure(s_day_path, (long)STEP_STORE_DAY_SLOTS * sizeof(slot_t))) {
+    ESP_LOGE(TAG, "Cannot create step history files in %s", dir);
+    return ESP_FAIL;
+  }
+
+  // Recover the ring from the block headers: blocks were written in
+  // sequence order, so the valid ones form one run ending at the newest
+  FILE *f = fopen(s_min_path, "rb");
+  if (!f)
+    return ESP_FAIL;
+  uint32_t seq[STEP_STORE_BLOCKS];
+  int newest = -1;
+  for (int i = 0; i < STEP_STORE_BLOCKS; ++i) {
+    block_hdr_t h;
+    seq[i] = 0;
+    if (fseek(f, (long)i * STEP_STORE_BLOCK_SIZE, SEEK_SET) == 0 &&
+        fread(&h, sizeof(h), 1, f) == 1 && block_valid(&h)) {
+      seq[i] = h.seq;
+      s_base[i] = h.base_min;
+      if (newest < 0 || h.seq > seq[newest])
+        newest = i;
+    }
+  }
+  fclose(f);
+
+  memset(&s_head, 0, sizeof(s_head));
+  s_first = s_count = s_head_idx = 0;
+  if (newest >= 0) {
+    s_head_idx = newest;
+    s_count = 1;
+    int i = newest;
+    while (s_count < STEP_STORE_BLOCKS) {
+      int prev = (i + STEP_STORE_BLOCKS - 1) % STEP_STORE_BLOCKS;
+      if (seq[prev] == 0 || seq[prev] + 1 != seq[i])
+        break;
+      i = prev;
+      s_count++;
+    }
+    s_first = i;
+    if (read_block(newest, &s_head)) {
+      s_last_min = decode_block(&s_head, NULL, NULL);
+    } else {
+      memset(&s_head, 0, sizeof(s_head));
+      s_count = 0;
+    }
+  }
+  s_head_dirty = false;
+  s_cur_steps = 0;
+  memset(&s_hour, 0, sizeof(s_hour));
+  memset(&s_day, 0, sizeof(s_day));
+  s_ready = true;
+  ESP_LOGI(TAG, "Step history: %d/%d minute blocks", s_count,
+           STEP_STORE_BLOCKS);
+  return ESP_OK;
+}
+
+void step_store_add(time_t now, uint32_t steps) {
+  if (!s_ready || now < MIN_VALID_TIME)
+    return;
+  uint32_t min = (uint32_t)(now / 60);
+  lock();
+  if (s_last_flush_min == 0)
+    s_last_flush_min = min;
+  if (steps) {
+    uint32_t hour = step_store_unit(STEP_STORE_HOUR, now);
+    // A new hour writes the finished one out first
+    if (s_hour.key && s_hour.key != hour)
+      (void)flush_locked(min);
+    rollup_switch(s_hour_path, STEP_STORE_HOUR_SLOTS, &s_hour, hour);
+    rollup_switch(s_day_path, STEP_STORE_DAY_SLOTS, &s_day, hour / 24);
+    if (min != s_cur_min) {
+      commit_minute();
+      s_cur_min = min;
+    }
+    s_cur_steps += steps;
+    s_hour.steps += steps;
+    s_hour.dirty = true;
+    s_day.steps += steps;
+    s_day.dirty = true;
+  }
+  bool pending = s_cur_steps || s_head_dirty || s_hour.dirty || s_day.dirty;
+  if (pending &&
+      min - s_last_flush_min >= CONFIG_SENSORS_STEP_STORE_FLUSH_MIN)
+    (void)flush_locked(min);
+  unlock();
+}
+
+esp_err_t step_store_flush(void) {
+  if (!s_ready)
+    return ESP_ERR_INVALID_STATE;
+  lock();
+  esp_err_t err = flush_locked((uint32_t)(time(NULL) / 60));
+  unlock();
+  return err;
+}
+
+typedef struct {
+  uint32_t from, to;
+  step_store_point_t *out;
+  int max, n;
+} query_ctx_t;
+
+// Entries arrive in time order; equal minutes (flushed mid-minute) merge
+static bool emit_point(uint32_t t, uint32_t steps, void *p) {
+  query_ctx_t *q = (query_ctx_t *)p;
+  if (t >= q->to)
+    return false;
+  if (t < q->from)
+    return true;
+  if (q->n > 0 && q->out[q->n - 1].t == t) {
+    q->out[q->n - 1].steps += steps;
+    return true;
+  }
+  if (q->n == q->max)
+    return false;
+  q->out[q->n].t = t;
+  q->out[q->n].steps = steps;
+  q->n++;
+  return true;
+}
+
+static void query_minutes(query_ctx_t *q) {
+  // Last block starting at or before `from` (earlier entries are older)
+  int lo = 0, hi = s_count - 1, start = 0;
+  while (lo <= hi) {
+    int mid = (lo + hi) / 2;
+    if (s_base[(s_first + mid) % STEP_STORE_BLOCKS] <= q->from) {
+      start = mid;
+      lo = mid + 1;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  static block_t blk;
+  for (int i = start; i < s_count && q->n < q->max; ++i) {
+    int idx = (s_first + i) % STEP_STORE_BLOCKS;
+    if (s_base[idx] >= q->to)
+      break;
+    const block_t *b = &s_head;
+    if (idx != s_head_idx) {
+      if (!read_block(idx, &blk))
+        continue;
+      b = &blk;
+    }
+    decode_block(b, emit_point, q);
+  }
+  if (s_cur_steps)
+    emit_point(s_cur_min, s_cur_steps, q);
+}
+
+static void query_rollup(query_ctx_t *q, const char *path, int nslots,
+                         const rollup_t *live) {
+  if (q->to - q->from > (uint32_t)nslots)
+    q->from = q->to - (uint32_t)nslots; // older slots are overwritten
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return;
+  long pos = -1;
+  for (uint32_t k = q->from; k < q->to && q->n < q->max; ++k) {
+    slot_t s = {0};
+    if (live->key == k) {
+      s.key = k;
+      s.steps = live->steps;
+    } else {
+      long off = (long)(k % nslots) * sizeof(slot_t);
+      if (off != pos && fseek(f, off, SEEK_SET) != 0)
+        break;
+      if (fread(&s, sizeof(s), 1, f) != 1)
+        break;
+      pos = off + sizeof(s);
+    }
+    if (s.key == k && s.steps)
+      emit_point(k, s.steps, q);
+  }
+  fclose(f);
+}
+
+int step_store_query(step_store_res_t res, uint32_t from, uint32_t to,
+                     step_store_point_t *out, int max) {
+  if (!s_ready || !out || max <= 0 || from >= to)
+    return 0;
+  query_ctx_t q = {.from = from, .to = to, .out = out, .max = max, .n = 0};
+  lock();
+  if (res == STEP_STORE_MINUTE)
+    query_minutes(&q);
+  else if (res == STEP_STORE_HOUR)
+    query_rollup(&q, s_hour_path, STEP_STORE_HOUR_SLOTS, &s_hour);
+  else
+    query_rollup(&q, s_day_path, STEP_STORE_DAY_SLOTS, &s_day);
+  unlock();
+  return q.n;
+}
+
+uint32_t step_store_day_total(time_t t) {
+  uint32_t day = step_store_unit(STEP_STORE_DAY, t);
+  step_store_point_t p;
+  return step_store_query(STEP_STORE_DAY, day, day + 1, &p, 1) ? p.steps : 0;
+}
@@ -98,6 +98,10 @@ bool settings_get_time_format_24h(void);
 // Restore factory defaults and persist
 bool settings_reset_defaults(void);
 
+// Hash of the current values; standby (gui/standby.h) keeps it to tell
+// whether its saved UI state still matches the settings after a resume
+uint32_t settings_hash(void);
+
 // Maintenance: format SPIFFS storage partition
 bool settings_format_spiffs(void);
 
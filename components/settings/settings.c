@@ -1,6 +1,7 @@
 #include "settings.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_system.h"
 #include "bsp/display.h"
 #include "bsp/esp32_s3_touch_amoled_2_06.h"
 #include "bsp_board_extra.h"
@@ -11,7 +12,7 @@
 #include "esp_spiffs.h"
 #include "lvgl.h"
 #include "freertos/FreeRTOS.h"
-#include "freertos/timers.h"
+#include "timer_svc.h"
 #include "cJSON.h"
 #include <string.h>
 #include "nvs_flash.h"
@@ -181,26 +182,29 @@ static bool time_format_24h = true; // true = 24h format, false = 12h format
 static bool spiffs_ready = false;
 
 // Debounced save timer (to limit flash writes when sliders change)
-static TimerHandle_t s_save_timer = NULL;
+#define SAVE_DELAY_MS 10000
+#define SAVE_SLACK_MS 5000 // a late save shares a wakeup with other timers
+static timer_svc_id_t s_save_timer = -1;
 // Forward declarations for internal JSON IO
 static bool settings_write_json(void);
 static bool settings_read_json(void);
-static void save_timer_cb(TimerHandle_t xTimer)
+static void save_timer_cb(void *arg)
 {
-    (void)xTimer;
+    (void)arg;
     (void)settings_write_json();
 }
 static void schedule_save(void)
 {
-    const TickType_t delay_ticks = pdMS_TO_TICKS(10000); // 10 seconds
-    if (!s_save_timer) {
-        s_save_timer = xTimerCreate("settings_save", delay_ticks, pdFALSE, NULL, save_timer_cb);
+    if (s_save_timer < 0) {
+        const timer_svc_config_t cfg = {
+            .name = "settings_save",
+            .slack_ms = SAVE_SLACK_MS,
+            .cb = save_timer_cb,
+        };
+        if (timer_svc_add(&cfg, &s_save_timer) != ESP_OK) return;
     }
-    if (!s_save_timer) return;
-    // Restart (or start) timer with 10s
-    (void)xTimerStop(s_save_timer, 0);
-    (void)xTimerChangePeriod(s_save_timer, delay_ticks, 0);
-    (void)xTimerStart(s_save_timer, 0);
+    // Restart (or start) the one-shot with 10s
+    (void)timer_svc_arm(s_save_timer, SAVE_DELAY_MS);
 }
 
 #define SETTINGS_PARTITION "storage"
@@ -213,7 +217,7 @@ static bool settings_mount_spiffs(void)
     esp_vfs_spiffs_conf_t conf = {
         .base_path = "/spiffs",
         .partition_label = SETTINGS_PARTITION,
-        .max_files = 4,
+        .max_files = 8, // settings, icons, media, step history
         .format_if_mount_failed = false,
     };
     esp_err_t ret = esp_vfs_spiffs_register(&conf);
@@ -352,7 +356,9 @@ void settings_init(void) {
     bsp_display_brightness_set(brightness);
 
     struct tm loaded;
-    if (settings_load_time(&loaded) == ESP_OK) {
+    if (esp_reset_reason() == ESP_RST_DEEPSLEEP) {
+        ESP_LOGI(TAG, "Woke from standby, keeping the RTC time");
+    } else if (settings_load_time(&loaded) == ESP_OK) {
         ESP_LOGI(TAG, "Restoring RTC from NVS");
         rtc_set_time(&loaded);
     } else {
@@ -485,6 +491,21 @@ static void apply_defaults(void)
     time_format_24h = true;
 }
 
+uint32_t settings_hash(void)
+{
+    // FNV-1a over the persisted values
+    const uint32_t vals[] = {
+        brightness, display_timeout_ms, sound_enabled, bluetooth_enabled,
+        notify_volume, step_goal, time_format_24h,
+    };
+    uint32_t h = 2166136261u;
+    const uint8_t *p = (const uint8_t *)vals;
+    for (size_t i = 0; i < sizeof(vals); ++i) {
+        h = (h ^ p[i]) * 16777619u;
+    }
+    return h;
+}
+
 bool settings_reset_defaults(void)
 {
     apply_defaults();
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Shared periodic timers. Clients give a period and how late they may run
+// (slack); one task sleeps until the earliest deadline and then runs every
+// client already due, so timers with nearby deadlines share one CPU wakeup.
+// Periodic clients are due on multiples of their period on the esp_timer
+// clock, so every 1 s client lines up with every 5 s and 5 min client.
+//
+// Callbacks run in the service task, one after the other; keep them short.
+// UI clients take the display lock themselves and set `screen`, which holds
+// them while the screen is off and runs them at once when it comes back.
+
+#define TIMER_SVC_MAX_CLIENTS 16
+
+typedef int timer_svc_id_t; // -1 is never a valid id
+
+typedef void (*timer_svc_cb_t)(void *arg);
+
+typedef struct {
+    const char *name;   // for the stats; kept by pointer
+    uint32_t period_ms; // 0: one-shot, run once per timer_svc_arm()
+    uint32_t slack_ms;  // how late it may run to share a wakeup
+    bool screen;        // only while the screen is on
+    timer_svc_cb_t cb;
+    void *arg;
+} timer_svc_config_t;
+
+typedef struct {
+    const char *name;
+    uint32_t period_ms;
+    uint32_t runs;        // callbacks run
+    uint32_t wakeups;     // wakeups this client's deadline caused
+    uint32_t max_late_ms; // worst time past its due time
+} timer_svc_client_stats_t;
+
+// Early in app_main; idempotent
+esp_err_t timer_svc_init(void);
+
+// Periodic clients start on their next period boundary; one-shots wait for
+// timer_svc_arm(). A callback already taken for a run may still run once
+// after its client is removed, so UI clients check their objects under the
+// display lock.
+esp_err_t timer_svc_add(const timer_svc_config_t *cfg, timer_svc_id_t *id);
+esp_err_t timer_svc_remove(timer_svc_id_t id);
+
+// (Re)start a one-shot `delay_ms` from now, pushing back one already
+// pending (debouncing). A periodic client runs after `delay_ms` and then
+// on its period boundaries again.
+esp_err_t timer_svc_arm(timer_svc_id_t id, uint32_t delay_ms);
+// Stop a client without removing it; timer_svc_arm() starts it again
+esp_err_t timer_svc_disarm(timer_svc_id_t id);
+
+// From the display manager: screen clients are held while it is off
+void timer_svc_set_screen(bool on);
+
+// Per-client counters for up to `max` clients, returns how many. `wakeups`
+// (optional) gets the service's total.
+size_t timer_svc_get_stats(timer_svc_client_stats_t *out, size_t max,
+                           uint32_t *wakeups);
+void timer_svc_log_stats(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,285 @@
+// Coalesced periodic and one-shot timers (see timer_svc.h)
+
+#include "timer_svc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+static const char *TAG = "TIMER_SVC";
+
+#define SVC_TASK_STACK 4096 // settings save runs here (JSON to SPIFFS)
+#define SVC_TASK_PRIO 3
+#define TICK_US (portTICK_PERIOD_MS * 1000LL)
+#define STATS_LOG_US (600LL * 1000000LL) // wakeup log, at most this often
+
+typedef struct {
+    timer_svc_config_t cfg;
+    int64_t due_us;
+    bool armed;
+    bool used;
+    uint8_t gen; // bumped on reuse so stale ids do not touch a new client
+    uint32_t runs;
+    uint32_t wakeups;
+    uint32_t max_late_ms;
+} client_t;
+
+typedef struct {
+    timer_svc_cb_t cb;
+    void *arg;
+} fire_t;
+
+static client_t s_clients[TIMER_SVC_MAX_CLIENTS];
+static SemaphoreHandle_t s_lock;
+static SemaphoreHandle_t s_wake;
+static bool s_screen = true;
+static uint32_t s_wakeups;
+static int64_t s_stats_logged_us;
+
+static int64_t next_boundary(int64_t now, uint32_t period_ms) {
+    int64_t period = (int64_t)period_ms * 1000;
+    return (now / period + 1) * period;
+}
+
+static bool client_live(const client_t *c) {
+    return c->used && c->armed && (s_screen || !c->cfg.screen);
+}
+
+// Client from an id, NULL if stale. Called with s_lock held.
+static client_t *client_get(timer_svc_id_t id) {
+    int i = id & 0xff;
+    if (id < 0 || i >= TIMER_SVC_MAX_CLIENTS)
+        return NULL;
+    client_t *c = &s_clients[i];
+    return c->used && c->gen == (uint8_t)(id >> 8) ? c : NULL;
+}
+
+// Take every client due by `now` and reschedule it. Called with s_lock held.
+static int take_due(int64_t now, fire_t *fire) {
+    int n = 0;
+    for (int i = 0; i < TIMER_SVC_MAX_CLIENTS; ++i) {
+        client_t *c = &s_clients[i];
+        if (!client_live(c) || c->due_us > now)
+            continue;
+        uint32_t late_ms = (uint32_t)((now - c->due_us) / 1000);
+        if (late_ms > c->max_late_ms)
+            c->max_late_ms = late_ms;
+        c->runs++;
+        fire[n++] = (fire_t){ .cb = c->cfg.cb, .arg = c->cfg.arg };
+        if (c->cfg.period_ms)
+            c->due_us = next_boundary(now, c->cfg.period_ms);
+        else
+            c->armed = false;
+    }
+    return n;
+}
+
+// Earliest deadline (due time plus slack), 0 if nothing is armed. Called
+// with s_lock held.
+static int64_t next_deadline(int *owner) {
+    int64_t best = 0;
+    *owner = -1;
+    for (int i = 0; i < TIMER_SVC_MAX_CLIENTS; ++i) {
+        const client_t *c = &s_clients[i];
+        if (!client_live(c))
+            continue;
+        int64_t deadline = c->due_us + (int64_t)c->cfg.slack_ms * 1000;
+        if (best == 0 || deadline < best) {
+            best = deadline;
+            *owner = i;
+        }
+    }
+    return best;
+}
+
+static TickType_t wait_ticks(int64_t deadline) {
+    if (deadline == 0)
+        return portMAX_DELAY;
+    int64_t left = deadline - esp_timer_get_time();
+    if (left <= 0)
+        return 0;
+    // One more tick, so a partly elapsed tick never wakes us early
+    return (TickType_t)((left + TICK_US - 1) / TICK_US) + 1;
+}
+
+static void log_stats_due(int64_t now) {
+    if (now - s_stats_logged_us < STATS_LOG_US)
+        return;
+    s_stats_logged_us = now;
+    timer_svc_log_stats();
+}
+
+static void svc_task(void *arg) {
+    (void)arg;
+    fire_t fire[TIMER_SVC_MAX_CLIENTS];
+    int owner = -1;
+    bool timed_out = false;
+    for (;;) {
+        int64_t now = esp_timer_get_time();
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int n = take_due(now, fire);
+        // Only timeouts are wakeups of our own; API calls come from a task
+        // that was running anyway
+        if (timed_out) {
+            s_wakeups++;
+            if (n && owner >= 0 && s_clients[owner].used)
+                s_clients[owner].wakeups++;
+        }
+        int64_t deadline = next_deadline(&owner);
+        xSemaphoreGive(s_lock);
+
+        for (int k = 0; k < n; ++k)
+            fire[k].cb(fire[k].arg);
+        log_stats_due(now);
+        timed_out = xSemaphoreTake(s_wake, wait_ticks(deadline)) != pdTRUE;
+    }
+}
+
+esp_err_t timer_svc_init(void) {
+    if (s_lock)
+        return ESP_OK;
+    s_wake = xSemaphoreCreateBinary();
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+    if (!lock || !s_wake)
+        return ESP_ERR_NO_MEM;
+    s_lock = lock;
+    s_stats_logged_us = esp_timer_get_time();
+    if (xTaskCreate(svc_task, "timer_svc", SVC_TASK_STACK, NULL, SVC_TASK_PRIO,
+                    NULL) != pdPASS)
+        return ESP_ERR_NO_MEM;
+    return ESP_OK;
+}
+
+esp_err_t timer_svc_add(const timer_svc_config_t *cfg, timer_svc_id_t *id) {
+    if (!cfg || !cfg->cb)
+        return ESP_ERR_INVALID_ARG;
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    esp_err_t err = ESP_ERR_NO_MEM;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < TIMER_SVC_MAX_CLIENTS; ++i) {
+        client_t *c = &s_clients[i];
+        if (c->used)
+            continue;
+        uint8_t gen = c->gen + 1;
+        *c = (client_t){ .cfg = *cfg, .used = true, .gen = gen };
+        if (cfg->period_ms) {
+            c->due_us = next_boundary(esp_timer_get_time(), cfg->period_ms);
+            c->armed = true;
+        }
+        if (id)
+            *id = (timer_svc_id_t)((gen << 8) | i);
+        err = ESP_OK;
+        break;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (err == ESP_OK)
+        xSemaphoreGive(s_wake);
+    else
+        ESP_LOGE(TAG, "No room for %s", cfg->name ? cfg->name : "client");
+    return err;
+}
+
+esp_err_t timer_svc_remove(timer_svc_id_t id) {
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    client_t *c = client_get(id);
+    if (c) {
+        c->used = false;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+esp_err_t timer_svc_arm(timer_svc_id_t id, uint32_t delay_ms) {
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    client_t *c = client_get(id);
+    if (c) {
+        c->due_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+        c->armed = true;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+
+    if (err == ESP_OK)
+        xSemaphoreGive(s_wake);
+    return err;
+}
+
+esp_err_t timer_svc_disarm(timer_svc_id_t id) {
+    if (!s_lock)
+        return ESP_ERR_INVALID_STATE;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    client_t *c = client_get(id);
+    if (c) {
+        c->armed = false;
+        err = ESP_OK;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+void timer_svc_set_screen(bool on) {
+    if (!s_lock)
+        return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    if (on && !s_screen) {
+        // What the screen shows is stale; refresh it before the first frame
+        int64_t now = esp_timer_get_time();
+        for (int i = 0; i < TIMER_SVC_MAX_CLIENTS; ++i) {
+            client_t *c = &s_clients[i];
+            if (c->used && c->armed && c->cfg.screen && c->cfg.period_ms)
+                c->due_us = now;
+        }
+    }
+    s_screen = on;
+    xSemaphoreGive(s_lock);
+    xSemaphoreGive(s_wake);
+}
+
+size_t timer_svc_get_stats(timer_svc_client_stats_t *out, size_t max,
+                           uint32_t *wakeups) {
+    size_t n = 0;
+    if (!s_lock)
+        return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    for (int i = 0; i < TIMER_SVC_MAX_CLIENTS && n < max; ++i) {
+        const client_t *c = &s_clients[i];
+        if (!c->used)
+            continue;
+        out[n++] = (timer_svc_client_stats_t){
+            .name = c->cfg.name,
+            .period_ms = c->cfg.period_ms,
+            .runs = c->runs,
+            .wakeups = c->wakeups,
+            .max_late_ms = c->max_late_ms,
+        };
+    }
+    if (wakeups)
+        *wakeups = s_wakeups;
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+void timer_svc_log_stats(void) {
+    timer_svc_client_stats_t st[TIMER_SVC_MAX_CLIENTS];
+    uint32_t wakeups = 0;
+    size_t n = timer_svc_get_stats(st, TIMER_SVC_MAX_CLIENTS, &wakeups);
+    ESP_LOGI(TAG, "%lu wakeups for %u clients", (unsigned long)wakeups,
+             (unsigned)n);
+    for (size_t i = 0; i < n; ++i) {
+        ESP_LOGI(TAG, "  %-16s %7lu ms: %lu runs, %lu own wakeups, %lu ms late max",
+                 st[i].name ? st[i].name : "?", (unsigned long)st[i].period_ms,
+                 (unsigned long)st[i].runs, (unsigned long)st[i].wakeups,
+                 (unsigned long)st[i].max_late_ms);
+    }
+}
@@ -12,6 +12,7 @@
 #include "sensors.h"
 #include "settings.h"
 #include "ui.h"
+#include "app_icons.h"
 #include "esp_wifi.h"
 #include "esp_bt.h"
 #include "esp_sleep.h"
@@ -20,6 +21,9 @@
 #include "ble_sync.h"
 #include "media_player.h"
 #include "esp_lvgl_port.h"
+#include "standby.h"
+#include "timer_svc.h"
+#include "ui_msg.h"
 
 static const char *TAG = "MAIN";
 
@@ -30,8 +34,13 @@ static void power_init(void) {
 }
 
 extern "C" void app_main(void) {
+  standby_wake_t wake = standby_resume_begin();
   power_init();
   esp_event_loop_create_default();
+  // Before any driver registers its periodic work
+  ESP_ERROR_CHECK(timer_svc_init());
+  // Before BLE or the PMU can post to the UI
+  ESP_ERROR_CHECK(ui_msg_init());
   display_manager_pm_early_init();
 
   // Override LVGL stack before BSP init
@@ -51,6 +60,10 @@ extern "C" void app_main(void) {
   
   bsp_extra_init();
   settings_init();
+  app_icons_init();
+
+  sensors_init();
+  xTaskCreate(sensors_task, "sensors", 4096, NULL, 3, NULL);
 
   media_player_init_lvgl_fs();
 
@@ -61,7 +74,9 @@ extern "C" void app_main(void) {
 
   xTaskCreate(ui_task, "ui", 8000, NULL, 4, NULL);
 
-  audio_alert_play_startup();
+  if (wake == STANDBY_WAKE_NONE) {
+    audio_alert_play_startup();
+  }
 
   esp_pm_config_t pm_cfg = {
     .max_freq_mhz = 240,